@@ -0,0 +1,25 @@
+#ifndef AUDIOBLOCKLISTENER_HPP
+#define AUDIOBLOCKLISTENER_HPP
+
+#ifdef __APPLE__
+#include <csound.hpp>
+#else
+#include "csound/csound.hpp"
+#endif
+
+//-----------------------------------------------------------------------------
+// Hook into the Csound performance thread. Listeners are added to a
+// CsoundSession before it starts; OnSessionStart runs on the starting thread
+// once the csd has compiled and OnAudioBlock runs on the performance thread
+// before every ksmps block, so it must not block or allocate.
+//-----------------------------------------------------------------------------
+class AudioBlockListener {
+
+public:
+
+	virtual ~AudioBlockListener() {}
+	virtual void OnSessionStart(Csound &csound) {}
+	virtual void OnAudioBlock(Csound &csound) = 0;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "AudioDeadlineMonitor.hpp"
+
+#include <chrono>
+
+AudioDeadlineMonitor::AudioDeadlineMonitor() :
+	m_nPeriodNs(0),
+	m_nNearMissNs(0),
+	m_nBlockStartNs(0),
+	m_ulBlocks(0),
+	m_ulNearMisses(0),
+	m_ulOverruns(0),
+	m_ulTotalNs(0),
+	m_nMaxBlockNs(0),
+	m_nLastOverrunNs(0),
+	m_ulEventHead(0)
+{
+	for(uint32_t i = 0; i < k_unHistogramBins; i++) m_rulHistogram[i] = 0;
+	for(uint32_t i = 0; i < k_unEventRingSize; i++){
+		m_rEvents[i].nTimestampNs = 0;
+		m_rEvents[i].nBlockNs = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Must be called before the performance thread starts.
+//-----------------------------------------------------------------------------
+void AudioDeadlineMonitor::SetPeriod(int nKsmps, double dSampleRate)
+{
+	if(dSampleRate <= 0.0) return;
+	m_nPeriodNs = (int64_t)((double)nKsmps * 1.0e9 / dSampleRate);
+	if(m_nNearMissNs == 0) m_nNearMissNs = (m_nPeriodNs * 8) / 10;
+}
+
+//-----------------------------------------------------------------------------
+void AudioDeadlineMonitor::SetNearMissThreshold(float fFractionOfPeriod)
+{
+	m_nNearMissNs = (int64_t)((double)m_nPeriodNs * fFractionOfPeriod);
+}
+
+//-----------------------------------------------------------------------------
+int64_t AudioDeadlineMonitor::NowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//-----------------------------------------------------------------------------
+// Performance thread only.
+//-----------------------------------------------------------------------------
+void AudioDeadlineMonitor::BeginBlock()
+{
+	m_nBlockStartNs = NowNs();
+}
+
+//-----------------------------------------------------------------------------
+// Performance thread only. Updates the counters with relaxed stores, the
+// block count is published last so a reader never sees a histogram ahead
+// of it.
+//-----------------------------------------------------------------------------
+void AudioDeadlineMonitor::EndBlock()
+{
+	if(m_nPeriodNs <= 0) return;
+
+	int64_t nEndNs = NowNs();
+	int64_t nBlockNs = nEndNs - m_nBlockStartNs;
+
+	uint64_t ulBin = (uint64_t)(nBlockNs * 20 / m_nPeriodNs);
+	if(ulBin >= k_unHistogramBins) ulBin = k_unHistogramBins - 1;
+	m_rulHistogram[ulBin].fetch_add(1, std::memory_order_relaxed);
+	m_ulTotalNs.fetch_add((uint64_t)nBlockNs, std::memory_order_relaxed);
+
+	if(nBlockNs > m_nMaxBlockNs.load(std::memory_order_relaxed)){
+		m_nMaxBlockNs.store(nBlockNs, std::memory_order_relaxed);
+	}
+
+	if(nBlockNs >= m_nNearMissNs){
+		if(nBlockNs > m_nPeriodNs){
+			m_ulOverruns.fetch_add(1, std::memory_order_relaxed);
+			m_nLastOverrunNs.store(nEndNs, std::memory_order_relaxed);
+		} else {
+			m_ulNearMisses.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		uint64_t ulHead = m_ulEventHead.load(std::memory_order_relaxed);
+		EventSlot& slot = m_rEvents[ulHead % k_unEventRingSize];
+		slot.nTimestampNs.store(m_nBlockStartNs, std::memory_order_relaxed);
+		slot.nBlockNs.store(nBlockNs, std::memory_order_relaxed);
+		m_ulEventHead.store(ulHead + 1, std::memory_order_release);
+	}
+
+	m_ulBlocks.fetch_add(1, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Safe to call from any thread. Counters may be a block apart from each
+// other, which is fine for display and logging.
+//-----------------------------------------------------------------------------
+void AudioDeadlineMonitor::GetSnapshot(Snapshot &snapshot) const
+{
+	snapshot.ulBlocks = m_ulBlocks.load(std::memory_order_acquire);
+	snapshot.ulNearMisses = m_ulNearMisses.load(std::memory_order_relaxed);
+	snapshot.ulOverruns = m_ulOverruns.load(std::memory_order_relaxed);
+	snapshot.dPeriodMs = (double)m_nPeriodNs / 1.0e6;
+	snapshot.dMaxBlockMs = (double)m_nMaxBlockNs.load(std::memory_order_relaxed) / 1.0e6;
+	snapshot.dMeanBlockMs = snapshot.ulBlocks ? (double)m_ulTotalNs.load(std::memory_order_relaxed) / 1.0e6 / (double)snapshot.ulBlocks : 0.0;
+	snapshot.nLastOverrunNs = m_nLastOverrunNs.load(std::memory_order_relaxed);
+	for(uint32_t i = 0; i < k_unHistogramBins; i++){
+		snapshot.rulHistogram[i] = m_rulHistogram[i].load(std::memory_order_relaxed);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Copies out the near miss and overrun events recorded since ulCursor and
+// advances it. Events the ring has already overwritten are skipped.
+//-----------------------------------------------------------------------------
+uint32_t AudioDeadlineMonitor::DrainEvents(DeadlineEvent *pEvents, uint32_t unMaxEvents, uint64_t &ulCursor) const
+{
+	uint64_t ulHead = m_ulEventHead.load(std::memory_order_acquire);
+	// a cursor from a previous session's monitor starts over
+	if(ulCursor > ulHead) ulCursor = 0;
+	if(ulHead - ulCursor > k_unEventRingSize) ulCursor = ulHead - k_unEventRingSize;
+
+	uint32_t unCount = 0;
+	uint64_t ulFirst = ulCursor;
+	while(ulCursor < ulHead && unCount < unMaxEvents){
+		const EventSlot& slot = m_rEvents[ulCursor % k_unEventRingSize];
+		int64_t nBlockNs = slot.nBlockNs.load(std::memory_order_relaxed);
+		pEvents[unCount].nTimestampNs = slot.nTimestampNs.load(std::memory_order_relaxed);
+		pEvents[unCount].fBlockMs = (float)((double)nBlockNs / 1.0e6);
+		pEvents[unCount].bOverrun = nBlockNs > m_nPeriodNs;
+		unCount++;
+		ulCursor++;
+	}
+
+	// drop anything the producer lapped while we were copying, and the slot
+	// it may be writing now, which is the oldest one; the fence keeps the
+	// slot reads above ahead of the head read
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t ulNewHead = m_ulEventHead.load(std::memory_order_relaxed);
+	if(ulNewHead + 1 > k_unEventRingSize && ulNewHead + 1 - k_unEventRingSize > ulFirst){
+		uint64_t ulLapped = ulNewHead + 1 - k_unEventRingSize - ulFirst;
+		if(ulLapped >= unCount) return 0;
+		for(uint32_t i = 0; i + ulLapped < unCount; i++) pEvents[i] = pEvents[i + ulLapped];
+		unCount -= (uint32_t)ulLapped;
+	}
+	return unCount;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the block time, as a fraction of the period, below which the given
+// percentile (0 - 1) of blocks fall. Resolution is one histogram bin.
+//-----------------------------------------------------------------------------
+double AudioDeadlineMonitor::Snapshot::LoadPercentile(double dPercentile) const
+{
+	uint64_t ulTotal = 0;
+	for(uint32_t i = 0; i < k_unHistogramBins; i++) ulTotal += rulHistogram[i];
+	if(ulTotal == 0) return 0.0;
+
+	uint64_t ulTarget = (uint64_t)(dPercentile * (double)ulTotal);
+	uint64_t ulSum = 0;
+	for(uint32_t i = 0; i < k_unHistogramBins; i++){
+		ulSum += rulHistogram[i];
+		if(ulSum > ulTarget) return (double)(i + 1) * 0.05;
+	}
+	return (double)k_unHistogramBins * 0.05;
+}
@@ -0,0 +1,85 @@
+#ifndef AUDIODEADLINEMONITOR_HPP
+#define AUDIODEADLINEMONITOR_HPP
+
+#include <atomic>
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Times every ksmps block on the Csound performance thread and compares it
+// with the block period (ksmps / sr). All counters are lock-free so the
+// performance thread never waits on a reader. Timestamps come from
+// steady_clock so audio events can be lined up with render frames.
+//
+// When Csound drives a blocking audio driver, time spent waiting on the
+// device lands in whichever block fills the output buffer. Run with
+// -+rtaudio=null to measure pure compute.
+//-----------------------------------------------------------------------------
+class AudioDeadlineMonitor {
+
+public:
+
+	// histogram bins cover 0 - 200% of the period in 5% steps, the last bin
+	// collects everything above that
+	static const uint32_t k_unHistogramBins = 41;
+	static const uint32_t k_unEventRingSize = 256;
+
+	struct Snapshot
+	{
+		uint64_t ulBlocks;
+		uint64_t ulNearMisses;
+		uint64_t ulOverruns;
+		double dPeriodMs;
+		double dMeanBlockMs;
+		double dMaxBlockMs;
+		int64_t nLastOverrunNs;
+		uint64_t rulHistogram[k_unHistogramBins];
+
+		double LoadPercentile(double dPercentile) const;
+	};
+
+	// a block that crossed the near miss threshold
+	struct DeadlineEvent
+	{
+		int64_t nTimestampNs;
+		float fBlockMs;
+		bool bOverrun;
+	};
+
+	AudioDeadlineMonitor();
+
+	void SetPeriod(int nKsmps, double dSampleRate);
+	void SetNearMissThreshold(float fFractionOfPeriod);
+
+	void BeginBlock();
+	void EndBlock();
+
+	void GetSnapshot(Snapshot &snapshot) const;
+	uint32_t DrainEvents(DeadlineEvent *pEvents, uint32_t unMaxEvents, uint64_t &ulCursor) const;
+
+	static int64_t NowNs();
+
+private:
+
+	int64_t m_nPeriodNs;
+	int64_t m_nNearMissNs;
+	int64_t m_nBlockStartNs;
+
+	std::atomic<uint64_t> m_ulBlocks;
+	std::atomic<uint64_t> m_ulNearMisses;
+	std::atomic<uint64_t> m_ulOverruns;
+	std::atomic<uint64_t> m_ulTotalNs;
+	std::atomic<int64_t> m_nMaxBlockNs;
+	std::atomic<int64_t> m_nLastOverrunNs;
+	std::atomic<uint64_t> m_rulHistogram[k_unHistogramBins];
+
+	// single producer ring, readers keep their own cursor
+	std::atomic<uint64_t> m_ulEventHead;
+	struct EventSlot
+	{
+		std::atomic<int64_t> nTimestampNs;
+		std::atomic<int64_t> nBlockNs;
+	};
+	EventSlot m_rEvents[k_unEventRingSize];
+};
+
+#endif
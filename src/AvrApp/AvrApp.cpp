@@ -1,8 +1,13 @@
 #include "AvrApp.hpp"
+#include "Profiler.hpp"
+#include "AllocationTracker.hpp"
 
 #include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
 
-#ifdef __APPLE__
+#if defined(__APPLE__) || defined(__linux__)
 #define _stricmp strcasecmp
 #include <strings.h>
 #endif
@@ -12,12 +17,44 @@ AvrApp::AvrApp(int argc, char** argv) :
 	m_pVR(nullptr), 
 	m_pGraphics(nullptr), 
 	m_pExFlags(nullptr),
+	m_pJobSystem(nullptr),
+	m_pSessionRecorder(nullptr),
+	m_pSessionReplayer(nullptr),
 //	m_pAudio(nullptr),
 	m_bDebugGL(false),
 	m_bVSyncBlank(true),
-	m_bOpenGLFinishHack(true),
+	m_bOpenGLFinishHack(false),
 	m_bPrintDebugMsgs(false),
-	m_bDevMode(false)  
+	m_bDevMode(false),
+	m_bLockMemory(false),
+	m_nAudioThreads(0),
+	m_fCrossfadeTime(2.0f),
+	m_bLatencyTest(false),
+	m_fLatencyTestSeconds(30.0f),
+	m_fLatencyBudgetMs(50.0f),
+	m_fSoakHours(0.0f),
+	m_fSoakBudgetMb(8.0f),
+	m_fMemoryReportSeconds(-1.0f),
+	m_bPipeline(false),
+	m_nWorkerThreads(-1),
+	m_bHud(false),
+	m_bHudEyes(false),
+	m_bRecordScreen(false),
+	m_nFramesInFlight(2),
+	m_bLateStart(false),
+	m_bDynamicResolution(true),
+	m_fDynamicResolutionMin(0.6f),
+	m_fDynamicResolutionMax(1.4f),
+	m_bLateLatch(true),
+	m_bLateLatchAsked(false),
+	m_eLogLevel(LogLevel_Info),
+	m_bMockVR(false),
+	m_fMockVRFrequency(90.0f),
+	m_unMockVRWidth(0),
+	m_unMockVRHeight(0),
+	m_fMockVRIpd(0.0f),
+	m_bReplayRealTime(true),
+	m_nExitCode(0)
 {
 
 	for( int i = 0; i < argc; i++ )
@@ -34,6 +71,11 @@ AvrApp::AvrApp(int argc, char** argv) :
 		{
 			m_bOpenGLFinishHack = false;
 		}
+		else if(!_stricmp(argv[i], "-glfinishhack"))
+		{
+			// the old drain before the swap, frames are paced with fences now
+			m_bOpenGLFinishHack = true;
+		}
 		else if(!_stricmp(argv[i], "-printdebugmsgs"))
 		{
 			m_bPrintDebugMsgs = true;
@@ -42,8 +84,213 @@ AvrApp::AvrApp(int argc, char** argv) :
 		{
 			m_bDevMode = true;
 		}
+		else if(!_stricmp(argv[i], "-latencytest"))
+		{
+			// headless: no hmd, null audio driver, hidden window
+			m_bLatencyTest = true;
+			m_bDevMode = true;
+			if(i + 1 < argc && atof(argv[i + 1]) > 0.0) m_fLatencyTestSeconds = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-latencybudget") && i + 1 < argc)
+		{
+			m_fLatencyBudgetMs = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-soak") && i + 1 < argc)
+		{
+			// headless, runs the given simulated hours as fast as frames render
+			// and fails if memory grew more than the soak budget
+			m_fSoakHours = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-soakbudget") && i + 1 < argc)
+		{
+			//megabytes
+			m_fSoakBudgetMb = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-memreport") && i + 1 < argc)
+		{
+			//simulated seconds between memory reports, 0 for none
+			m_fMemoryReportSeconds = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-pipeline"))
+		{
+			// simulate the next frame on its own thread while this one renders
+			m_bPipeline = true;
+		}
+		else if(!_stricmp(argv[i], "-mlock"))
+		{
+			m_bLockMemory = true;
+		}
+		else if(!_stricmp(argv[i], "-audiosched") && i + 1 < argc)
+		{
+			if(!BParseSchedPolicy(argv[++i], m_audioThreadPolicy.eSchedPolicy))
+			{
+				std::cout << "Warning: unknown scheduling policy " << argv[i] << ", expected fifo, rr or default" << std::endl;
+			}
+		}
+		else if(!_stricmp(argv[i], "-audiopriority") && i + 1 < argc)
+		{
+			m_audioThreadPolicy.nPriority = atoi(argv[++i]);
+			if(m_audioThreadPolicy.eSchedPolicy == ThreadPolicy::Sched_Default)
+			{
+				m_audioThreadPolicy.eSchedPolicy = ThreadPolicy::Sched_Fifo;
+			}
+		}
+		else if(!_stricmp(argv[i], "-audiothreads") && i + 1 < argc)
+		{
+			m_nAudioThreads = atoi(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-crossfade") && i + 1 < argc)
+		{
+			m_fCrossfadeTime = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-audiocpus") && i + 1 < argc)
+		{
+			m_audioThreadPolicy.ulCpuMask = ParseCpuMask(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-rendercpus") && i + 1 < argc)
+		{
+			m_renderThreadPolicy.ulCpuMask = ParseCpuMask(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-workercpus") && i + 1 < argc)
+		{
+			m_workerThreadPolicy.ulCpuMask = ParseCpuMask(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-workers") && i + 1 < argc)
+		{
+			m_nWorkerThreads = atoi(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-hud"))
+		{
+			m_bHud = true;
+		}
+		else if(!_stricmp(argv[i], "-hudeyes"))
+		{
+			m_bHudEyes = true;
+		}
+		else if(!_stricmp(argv[i], "-recordscreen"))
+		{
+			//a png of the companion window every frame, reads back synchronously so the gpu drains each frame
+			m_bRecordScreen = true;
+		}
+		else if(!_stricmp(argv[i], "-framesinflight") && i + 1 < argc)
+		{
+			m_nFramesInFlight = atoi(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-latestart"))
+		{
+			// dev mode only, with a headset the compositor decides when the frame starts
+			m_bLateStart = true;
+		}
+		else if(!_stricmp(argv[i], "-nodynres"))
+		{
+			// eye targets at exactly the recommended size
+			m_bDynamicResolution = false;
+		}
+		else if(!_stricmp(argv[i], "-dynresmin") && i + 1 < argc)
+		{
+			m_fDynamicResolutionMin = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-dynresmax") && i + 1 < argc)
+		{
+			m_fDynamicResolutionMax = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-nolatelatch"))
+		{
+			// both eyes drawn with the head pose from the top of the frame
+			m_bLateLatch = false;
+			m_bLateLatchAsked = true;
+		}
+		else if(!_stricmp(argv[i], "-latelatch"))
+		{
+			// even under -mockvr, see below
+			m_bLateLatch = true;
+			m_bLateLatchAsked = true;
+		}
+		else if(!_stricmp(argv[i], "-loglevel") && i + 1 < argc)
+		{
+			if(!Logger::BParseLevel(argv[++i], m_eLogLevel))
+			{
+				std::cout << "Warning: unknown log level " << argv[i] << ", expected debug, info, warning or error" << std::endl;
+			}
+		}
+		else if(!_stricmp(argv[i], "-mockvr"))
+		{
+			//stereo path without a headset, replaying a pose trace if one follows
+			m_bMockVR = true;
+			if(i + 1 < argc && argv[i + 1][0] != '-') m_strMockVRTrace = argv[++i];
+		}
+		else if(!_stricmp(argv[i], "-mockvrfps") && i + 1 < argc)
+		{
+			//0 runs unpaced
+			m_fMockVRFrequency = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-mockvrsize") && i + 2 < argc)
+		{
+			m_unMockVRWidth = (uint32_t)atoi(argv[++i]);
+			m_unMockVRHeight = (uint32_t)atoi(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-mockvripd") && i + 1 < argc)
+		{
+			//millimetres
+			m_fMockVRIpd = (float)atof(argv[++i]);
+		}
+		else if(!_stricmp(argv[i], "-recordposes") && i + 1 < argc)
+		{
+			m_strRecordPoses = argv[++i];
+		}
+		else if(!_stricmp(argv[i], "-record") && i + 1 < argc)
+		{
+			m_strRecordSession = argv[++i];
+		}
+		else if(!_stricmp(argv[i], "-replay") && i + 1 < argc)
+		{
+			m_strReplaySession = argv[++i];
+		}
+		else if(!_stricmp(argv[i], "-replayfast"))
+		{
+			//as fast as the frames render, nothing waits for a display
+			m_bReplayRealTime = false;
+			m_bVSyncBlank = false;
+			m_fMockVRFrequency = 0.0f;
+		}
 	}	
 
+	if(!m_strReplaySession.empty())
+	{
+		if(!m_strRecordSession.empty())
+		{
+			std::cout << "Warning: -record is ignored while replaying a session" << std::endl;
+			m_strRecordSession.clear();
+		}
+		//which frames a simulation thread coalesces depends on timing, a replay has to simulate every frame
+		m_bPipeline = false;
+	}
+
+	//the mock hands out poses a frame period apart so its runs repeat, but the pose
+	//sampler takes its snapshots on the wall clock; latching them gives that up, so
+	//under -mockvr it is off unless -latelatch asks for it
+	if(m_bMockVR && !m_bLateLatchAsked) m_bLateLatch = false;
+
+	if(m_fSoakHours > 0.0f)
+	{
+		//no hmd unless the mock one is asked for, and nothing waits for a display
+		if(!m_bMockVR) m_bDevMode = true;
+		m_bVSyncBlank = false;
+		m_fMockVRFrequency = 0.0f;
+	}
+	//reports by default whenever there is something to watch
+	if(m_fMemoryReportSeconds < 0.0f)
+	{
+		m_fMemoryReportSeconds = (m_fSoakHours > 0.0f || AllocationTracker::BIsEnabled()) ? 600.0f : 0.0f;
+	}
+
+	// with memory locked, touch the real-time stacks up front so they never fault later
+	if(m_bLockMemory)
+	{
+		m_audioThreadPolicy.unPrefaultStackBytes = 256 * 1024;
+		m_renderThreadPolicy.unPrefaultStackBytes = 256 * 1024;
+	}
+
 	m_pExFlags = std::make_unique<ExecutionFlags>();
 
 	m_pExFlags->flagDebugOpenGL = m_bDebugGL;
@@ -51,15 +298,92 @@ AvrApp::AvrApp(int argc, char** argv) :
 	m_pExFlags->flagGLFinishHack = m_bOpenGLFinishHack;
 	m_pExFlags->flagDPrint = m_bPrintDebugMsgs;
 	m_pExFlags->flagDevMode = m_bDevMode;
+	m_pExFlags->flagLockMemory = m_bLockMemory;
+	m_pExFlags->nAudioThreads = m_nAudioThreads;
+	m_pExFlags->fCrossfadeTime = m_fCrossfadeTime;
+	m_pExFlags->flagLatencyTest = m_bLatencyTest;
+	m_pExFlags->fSoakHours = m_fSoakHours;
+	m_pExFlags->fSoakBudgetMb = m_fSoakBudgetMb;
+	m_pExFlags->fMemoryReportSeconds = m_fMemoryReportSeconds;
+	m_pExFlags->flagPipeline = m_bPipeline;
+	m_pExFlags->flagHud = m_bHud;
+	m_pExFlags->flagHudEyes = m_bHudEyes;
+	m_pExFlags->flagRecordScreen = m_bRecordScreen;
+	m_pExFlags->nFramesInFlight = m_nFramesInFlight;
+	m_pExFlags->flagLateStart = m_bLateStart;
+	m_pExFlags->flagDynamicResolution = m_bDynamicResolution;
+	m_pExFlags->fDynamicResolutionMin = m_fDynamicResolutionMin;
+	m_pExFlags->fDynamicResolutionMax = m_fDynamicResolutionMax;
+	m_pExFlags->flagLateLatch = m_bLateLatch;
+	m_pExFlags->flagMockVR = m_bMockVR;
+	m_pExFlags->strMockVRTrace = m_strMockVRTrace;
+	m_pExFlags->fMockVRFrequency = m_fMockVRFrequency;
+	m_pExFlags->unMockVRWidth = m_unMockVRWidth;
+	m_pExFlags->unMockVRHeight = m_unMockVRHeight;
+	m_pExFlags->fMockVRIpd = m_fMockVRIpd;
+	m_pExFlags->strRecordPoses = m_strRecordPoses;
+	m_pExFlags->audioThreadPolicy = m_audioThreadPolicy;
+	m_pExFlags->renderThreadPolicy = m_renderThreadPolicy;
+	m_pExFlags->workerThreadPolicy = m_workerThreadPolicy;
+}
+
+//--------------------------------------------
+// Exit() only runs after a good start; a start that failed part way still
+// has the log writer to stop.
+//--------------------------------------------
+AvrApp::~AvrApp(){
+
+	Logger::Stop();
 }
 
 //--------------------------------------------
 bool AvrApp::BInitialise(){
 
+	//everything after this logs without blocking on the file or the console
+	Logger::SetMinLevel(m_eLogLevel);
+	Logger::BStart("avr.log");
+
+	if(m_pExFlags->flagLockMemory && !BLockProcessMemory()){
+		std::cout << "Warning: process memory could not be locked" << std::endl;
+	}
+
+	//the main thread is the render thread
+	AVR_PROFILE_THREAD("render");
+	if(!m_pExFlags->renderThreadPolicy.BIsDefault()){
+		BApplyThreadPolicy("render", m_pExFlags->renderThreadPolicy);
+	}
 	
+	//by default a worker for every core the render and audio threads leave free
+	if(m_nWorkerThreads < 0){
+		int nCores = (int)std::thread::hardware_concurrency();
+		m_nWorkerThreads = nCores > 2 ? nCores - 2 : 0;
+	}
+	m_pJobSystem = std::make_unique<JobSystem>();
+	if(!m_pJobSystem->BStart((uint32_t)m_nWorkerThreads, m_pExFlags->workerThreadPolicy)){
+		std::cout << "Error: job system not started" << std::endl;
+		return false;
+	}
+
+	//everything that drives the session goes to or comes from the log
+	uint32_t unSessionFlags = m_pExFlags->flagDevMode ? k_unSessionDevMode : 0;
+	if(!m_strRecordSession.empty()){
+		m_pSessionRecorder = std::make_unique<SessionRecorder>();
+		if(!m_pSessionRecorder->BStart(m_strRecordSession, unSessionFlags)) return false;
+	} else if(!m_strReplaySession.empty()){
+		m_pSessionReplayer = std::make_unique<SessionReplayer>();
+		if(!m_pSessionReplayer->BOpen(m_strReplaySession)) return false;
+		if((m_pSessionReplayer->GetFlags() & k_unSessionDevMode) != unSessionFlags){
+			std::cout << "Error: " << m_strReplaySession << " was recorded " << (unSessionFlags ? "with a headset, replay it without -dev" : "in dev mode, replay it with -dev") << std::endl;
+			return false;
+		}
+		m_pSessionReplayer->SetRealTime(m_bReplayRealTime);
+	}
+
 	if(!m_pExFlags->flagDevMode){
 		//initialise OpenVR
 		m_pVR = std::make_unique<VR_Manager>(m_pExFlags);
+		m_pVR->SetJobSystem(m_pJobSystem.get());
+		m_pVR->SetSession(m_pSessionRecorder.get(), m_pSessionReplayer.get());
 
 		if(!m_pVR->BInit()){
 			std::cout << "Error: OpenVR system not initialised!" << std::endl;
@@ -72,11 +396,13 @@ bool AvrApp::BInitialise(){
 			return false;
 		}
 
-		std::cout << "OpenVR initialised" << std::endl;
+		std::cout << (m_bMockVR ? "Mock VR initialised" : "OpenVR initialised") << std::endl;
 	}
 
 	//initialise OpenGL
 	m_pGraphics = std::make_unique<Graphics>(m_pExFlags);
+	m_pGraphics->SetJobSystem(m_pJobSystem.get());
+	m_pGraphics->SetSession(m_pSessionRecorder.get(), m_pSessionReplayer.get());
 
 	if(!m_pGraphics->BInitGL()){
 		std::cout << "Error: OpenGL context not initialised!" << std::endl;
@@ -93,6 +419,9 @@ bool AvrApp::BInitialise(){
 	} 
 
 	std::cout << "OpenGL initialised" << std::endl;
+
+	//the audio thread has picked up its policy by now
+	PrintThreadPolicyReport();
 	
 	//initialise CSound
 //	m_pAudio = std::make_unique<CsoundSession>(csdName);
@@ -113,9 +442,20 @@ bool AvrApp::BInitialise(){
 void AvrApp::RunMainLoop(){
 
 	bool bQuit = false;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 
 	while (!bQuit)
 	{
+		AVR_PROFILE_SCOPE("Frame");
+		if(m_bLatencyTest && std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count() > m_fLatencyTestSeconds){
+			break;
+		}
+		if(m_pGraphics->BSoakDone()) break;
+
+		//the session frame starts ahead of the input it covers
+		if(m_pSessionRecorder) m_pSessionRecorder->BeginFrame();
+		if(m_pSessionReplayer && !m_pSessionReplayer->BBeginFrame()) break;
+
 		if(!m_pExFlags->flagDevMode){
 			bQuit = m_pVR->HandleInput();
 		}
@@ -130,9 +470,25 @@ void AvrApp::RunMainLoop(){
 // ----------------------------------------
 void AvrApp::Exit(){
 
+	if(m_bLatencyTest && !m_pGraphics->BReportLatency(m_fLatencyBudgetMs)){
+		m_nExitCode = 1;
+	}
+	//with the context still current, the census needs it
+	if(!m_pGraphics->BReportSoak()) m_nExitCode = 1;
+
 	if(!m_pExFlags->flagDevMode){
 		m_pVR->ExitVR();
 	}
 
 	m_pGraphics->CleanUpGL(m_pVR);
+
+	//after the simulation has stopped, nothing records any more
+	if(m_pSessionRecorder) m_pSessionRecorder->Stop();
+	if(m_pSessionReplayer && !m_pSessionReplayer->BReport()) m_nExitCode = 1;
+
+	//nothing submits work any more
+	m_pJobSystem->Stop();
+
+	//last, so the shutdown is logged too
+	Logger::Stop();
 }
@@ -5,6 +5,10 @@
 #include "Graphics.hpp"
 //#include "CsoundSession.hpp"
 #include "SystemInfo.hpp"
+#include "JobSystem.hpp"
+#include "Logger.hpp"
+#include "SessionRecorder.hpp"
+#include "SessionReplayer.hpp"
 
 #include <string>
 #include <memory>
@@ -13,9 +17,11 @@ class AvrApp {
 
 public:
 	AvrApp(int argc, char** argv);
+	~AvrApp();
 	bool BInitialise();
 	void Exit();
 	void RunMainLoop();
+	int GetExitCode() const { return m_nExitCode; }
 	
 private:
 	
@@ -23,11 +29,51 @@ private:
 	std::unique_ptr<Graphics> m_pGraphics;
 	//std::unique_ptr<CsoundSession> m_pAudio;
 	std::unique_ptr<ExecutionFlags> m_pExFlags;
+	std::unique_ptr<JobSystem> m_pJobSystem;
+	std::unique_ptr<SessionRecorder> m_pSessionRecorder;
+	std::unique_ptr<SessionReplayer> m_pSessionReplayer;
 
 	bool m_bDebugGL;
 	bool m_bVSyncBlank;
 	bool m_bOpenGLFinishHack;
 	bool m_bPrintDebugMsgs;
 	bool m_bDevMode;
+	bool m_bLockMemory;
+	int m_nAudioThreads;
+	float m_fCrossfadeTime;
+	bool m_bLatencyTest;
+	float m_fLatencyTestSeconds;
+	float m_fLatencyBudgetMs;
+	float m_fSoakHours;
+	float m_fSoakBudgetMb;
+	float m_fMemoryReportSeconds;
+	bool m_bPipeline;
+	int m_nWorkerThreads;
+	bool m_bHud;
+	bool m_bHudEyes;
+	bool m_bRecordScreen;
+	int m_nFramesInFlight;
+	bool m_bLateStart;
+	bool m_bDynamicResolution;
+	float m_fDynamicResolutionMin;
+	float m_fDynamicResolutionMax;
+	bool m_bLateLatch;
+	bool m_bLateLatchAsked;
+	ELogLevel m_eLogLevel;
+	bool m_bMockVR;
+	std::string m_strMockVRTrace;
+	float m_fMockVRFrequency;
+	uint32_t m_unMockVRWidth;
+	uint32_t m_unMockVRHeight;
+	float m_fMockVRIpd;
+	std::string m_strRecordPoses;
+	std::string m_strRecordSession;
+	std::string m_strReplaySession;
+	bool m_bReplayRealTime;
+	int m_nExitCode;
+
+	ThreadPolicy m_audioThreadPolicy;
+	ThreadPolicy m_renderThreadPolicy;
+	ThreadPolicy m_workerThreadPolicy;
 };
 #endif
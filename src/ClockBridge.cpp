@@ -0,0 +1,248 @@
+#include "ClockBridge.hpp"
+#include "AudioDeadlineMonitor.hpp"
+
+#include <cmath>
+#include <cstddef>
+
+// loop bandwidth in Hz, wide while locking on, then narrow so block bursts
+// and scheduler jitter are averaged out and only the drift is followed
+static const double s_dLockBandwidthHz = 1.0;
+static const double s_dTrackBandwidthHz = 0.1;
+static const double s_dLockSeconds = 2.0;
+// a block this far off the prediction means a stall or an xrun, start over
+static const double s_dResetPeriods = 8.0;
+static const double s_dTwoPi = 6.283185307179586;
+
+ClockBridge::ClockBridge() :
+	m_pActiveCsound(nullptr),
+	m_pLoopCsound(nullptr),
+	m_nBlockSample(0),
+	m_unKsmps(0),
+	m_dSr(0.0),
+	m_nOutputLatencyNs(0),
+	m_ulLoopBlocks(0),
+	m_dT0(0.0),
+	m_dT1(0.0),
+	m_dE2(0.0),
+	m_dNominalPeriodNs(0.0),
+	m_unEstimateSeq(0),
+	m_nEstOriginNs(0),
+	m_nEstOriginSample(0),
+	m_dEstNsPerSample(0.0),
+	m_nEstOutputLatencyNs(0),
+	m_dEstSr(0.0),
+	m_unEventHead(0),
+	m_unEventTail(0),
+	m_ulLateEvents(0),
+	m_nFramePhotonNs(0),
+	m_pSessionRecorder(nullptr)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Runs before the new session's first block, while the previous session may
+// still be playing. From here on only the new session drives the estimate.
+//-----------------------------------------------------------------------------
+void ClockBridge::OnSessionStart(Csound &csound)
+{
+	m_pActiveCsound.store(&csound, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Runs before each block of every session, only the newest one counts.
+//-----------------------------------------------------------------------------
+void ClockBridge::OnAudioBlock(Csound &csound)
+{
+	if(m_pActiveCsound.load(std::memory_order_acquire) != &csound) return;
+
+	// a new session restarts the sample count, so the loop starts over
+	if(m_pLoopCsound != &csound){
+		m_dSr = csound.GetSr();
+		m_unKsmps = (uint32_t)csound.GetKsmps();
+		if(m_dSr <= 0.0 || m_unKsmps == 0) return;
+		m_dNominalPeriodNs = (double)m_unKsmps * 1.0e9 / m_dSr;
+		m_nOutputLatencyNs = (int64_t)((double)csound.GetOutputBufferSize() * 1.0e9 / m_dSr);
+		m_nBlockSample = 0;
+		m_ulLoopBlocks = 0;
+		m_pLoopCsound = &csound;
+	}
+
+	double dNowNs = (double)AudioDeadlineMonitor::NowNs();
+
+	if(m_ulLoopBlocks == 0){
+		ResetLoop((int64_t)dNowNs);
+	}else{
+		double dError = dNowNs - m_dT1;
+		if(std::fabs(dError) > s_dResetPeriods * m_dNominalPeriodNs){
+			ResetLoop((int64_t)dNowNs);
+		}else{
+			double dPeriodS = m_dNominalPeriodNs * 1.0e-9;
+			double dBandwidth = (double)m_ulLoopBlocks * dPeriodS < s_dLockSeconds ? s_dLockBandwidthHz : s_dTrackBandwidthHz;
+			double dOmega = s_dTwoPi * dBandwidth * dPeriodS;
+			double dB = std::sqrt(2.0) * dOmega;
+			double dC = dOmega * dOmega;
+
+			m_dT0 = m_dT1;
+			m_dT1 += dB * dError + m_dE2;
+			m_dE2 += dC * dError;
+		}
+	}
+	m_ulLoopBlocks++;
+
+	PublishEstimate();
+	DispatchEvents(csound);
+
+	m_nBlockSample += m_unKsmps;
+}
+
+//-----------------------------------------------------------------------------
+void ClockBridge::ResetLoop(int64_t nNowNs)
+{
+	m_dT0 = (double)nNowNs;
+	m_dE2 = m_dNominalPeriodNs;
+	m_dT1 = m_dT0 + m_dE2;
+	m_ulLoopBlocks = 0;
+}
+
+//-----------------------------------------------------------------------------
+void ClockBridge::PublishEstimate()
+{
+	uint32_t unSeq = m_unEstimateSeq.load(std::memory_order_relaxed);
+	m_unEstimateSeq.store(unSeq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_nEstOriginNs.store((int64_t)m_dT0, std::memory_order_relaxed);
+	m_nEstOriginSample.store(m_nBlockSample, std::memory_order_relaxed);
+	m_dEstNsPerSample.store(m_dE2 / (double)m_unKsmps, std::memory_order_relaxed);
+	m_nEstOutputLatencyNs.store(m_nOutputLatencyNs, std::memory_order_relaxed);
+	m_dEstSr.store(m_dSr, std::memory_order_relaxed);
+	m_unEstimateSeq.store(unSeq + 2, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Sends everything queued since the last block. p2 is the offset from the
+// start of the block about to be computed; an event whose sample has
+// already passed starts now and is counted as late.
+//-----------------------------------------------------------------------------
+void ClockBridge::DispatchEvents(Csound &csound)
+{
+	uint32_t unTail = m_unEventTail.load(std::memory_order_relaxed);
+	uint32_t unHead = m_unEventHead.load(std::memory_order_acquire);
+
+	while(unTail != unHead){
+		ScheduledEvent &event = m_rEvents[unTail % k_unMaxEvents];
+
+		int64_t nOffset = event.nSample - m_nBlockSample;
+		if(nOffset < 0){
+			nOffset = 0;
+			m_ulLateEvents.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		MYFLT rFields[k_unMaxFields + 1];
+		rFields[0] = event.rFields[0];
+		rFields[1] = (MYFLT)((double)nOffset / m_dSr);
+		for(uint32_t i = 1; i < event.unFields; i++) rFields[i + 1] = event.rFields[i];
+		csound.ScoreEvent('i', rFields, (long)event.unFields + 1);
+
+		unTail++;
+	}
+	m_unEventTail.store(unTail, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// The steady clock time the frame being rendered will reach the eyes.
+//-----------------------------------------------------------------------------
+void ClockBridge::SetFramePhotonTime(int64_t nPhotonNs)
+{
+	m_nFramePhotonNs = nPhotonNs;
+}
+
+//-----------------------------------------------------------------------------
+// The sample heard when the current frame is seen, -1 without an estimate.
+//-----------------------------------------------------------------------------
+int64_t ClockBridge::GetFramePhotonSample() const
+{
+	return SampleHeardAt(m_nFramePhotonNs);
+}
+
+//-----------------------------------------------------------------------------
+bool ClockBridge::BGetEstimate(ClockEstimate &estimate) const
+{
+	for(int nTry = 0; nTry < 4; nTry++){
+		uint32_t unSeq = m_unEstimateSeq.load(std::memory_order_acquire);
+		estimate.nOriginNs = m_nEstOriginNs.load(std::memory_order_relaxed);
+		estimate.nOriginSample = m_nEstOriginSample.load(std::memory_order_relaxed);
+		estimate.dNsPerSample = m_dEstNsPerSample.load(std::memory_order_relaxed);
+		estimate.nOutputLatencyNs = m_nEstOutputLatencyNs.load(std::memory_order_relaxed);
+		estimate.dSr = m_dEstSr.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(!(unSeq & 1) && m_unEstimateSeq.load(std::memory_order_relaxed) == unSeq){
+			estimate.bValid = estimate.dNsPerSample > 0.0;
+			return estimate.bValid;
+		}
+	}
+	estimate.bValid = false;
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Which sample of the newest session comes out of the speakers at a given
+// steady clock time. -1 without an estimate.
+//-----------------------------------------------------------------------------
+int64_t ClockBridge::SampleHeardAt(int64_t nTimeNs) const
+{
+	ClockEstimate estimate;
+	if(!BGetEstimate(estimate)) return -1;
+	double dSamples = (double)(nTimeNs - estimate.nOutputLatencyNs - estimate.nOriginNs) / estimate.dNsPerSample;
+	return estimate.nOriginSample + (int64_t)std::floor(dSamples + 0.5);
+}
+
+//-----------------------------------------------------------------------------
+// The steady clock time a sample is heard. -1 without an estimate.
+//-----------------------------------------------------------------------------
+int64_t ClockBridge::TimeSampleHeard(int64_t nSample) const
+{
+	ClockEstimate estimate;
+	if(!BGetEstimate(estimate)) return -1;
+	double dNs = (double)(nSample - estimate.nOriginSample) * estimate.dNsPerSample;
+	return estimate.nOriginNs + estimate.nOutputLatencyNs + (int64_t)dNs;
+}
+
+//-----------------------------------------------------------------------------
+// Render thread. Queues an i statement to start on nSample. Fails if the
+// queue is full or the event has too many fields.
+//-----------------------------------------------------------------------------
+bool ClockBridge::BScheduleEvent(int64_t nSample, const MYFLT *pFields, uint32_t unFields)
+{
+	if(unFields == 0 || unFields > k_unMaxFields) return false;
+
+	uint32_t unHead = m_unEventHead.load(std::memory_order_relaxed);
+	if(unHead - m_unEventTail.load(std::memory_order_acquire) >= k_unMaxEvents) return false;
+
+	ScheduledEvent &event = m_rEvents[unHead % k_unMaxEvents];
+	event.nSample = nSample;
+	event.unFields = unFields;
+	for(uint32_t i = 0; i < unFields; i++) event.rFields[i] = pFields[i];
+
+	m_unEventHead.store(unHead + 1, std::memory_order_release);
+
+	if(m_pSessionRecorder){
+		SessionScoreEvent scoreEvent;
+		scoreEvent.nSample = nSample;
+		scoreEvent.unFields = unFields;
+		scoreEvent.unPadding = 0;
+		for(uint32_t i = 0; i < unFields; i++) scoreEvent.rdFields[i] = (double)pFields[i];
+		m_pSessionRecorder->Record(SessionRecord_ScoreEvent, &scoreEvent, (uint32_t)(offsetof(SessionScoreEvent, rdFields) + unFields * sizeof(double)));
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Render thread. Queues an i statement to be heard at a steady clock time,
+// usually GetFramePhotonNs() so the sound lands with the frame.
+//-----------------------------------------------------------------------------
+bool ClockBridge::BScheduleEventAtTime(int64_t nTimeNs, const MYFLT *pFields, uint32_t unFields)
+{
+	int64_t nSample = SampleHeardAt(nTimeNs);
+	if(nSample < 0) return false;
+	return BScheduleEvent(nSample, pFields, unFields);
+}
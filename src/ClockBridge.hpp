@@ -0,0 +1,112 @@
+#ifndef CLOCKBRIDGE_HPP
+#define CLOCKBRIDGE_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include "AudioBlockListener.hpp"
+#include "SessionRecorder.hpp"
+
+//-----------------------------------------------------------------------------
+// Relates the three clocks a frame cares about: the steady clock the render
+// thread runs on, the compositor's predicted photon time for the frame and
+// the sample position of the newest Csound session.
+//
+// Block starts are stamped on the steady clock and run through a second
+// order delay locked loop, which smooths out the bursts Csound computes
+// blocks in and tracks the drift of the audio device against the host
+// clock. The filtered estimate is published to the render thread, which
+// can then turn a frame's photon time into the sample that is being heard
+// at that moment, and queue score events for an exact sample. Queued
+// events are sent from the performance thread with p2 set to their offset
+// from the start of the next block, so with --sample-accurate they start
+// on that sample.
+//-----------------------------------------------------------------------------
+class ClockBridge : public AudioBlockListener {
+
+public:
+
+	static const uint32_t k_unMaxEvents = 64;
+	static const uint32_t k_unMaxFields = 16;
+
+	struct ClockEstimate
+	{
+		bool bValid;
+		int64_t nOriginNs;		// filtered steady clock time of nOriginSample being computed
+		int64_t nOriginSample;
+		double dNsPerSample;		// follows the device clock, not the nominal rate
+		int64_t nOutputLatencyNs;	// from being computed to being heard
+		double dSr;
+	};
+
+	ClockBridge();
+
+	// AudioBlockListener
+	void OnSessionStart(Csound &csound) override;
+	void OnAudioBlock(Csound &csound) override;
+
+	// render thread
+	void SetFramePhotonTime(int64_t nPhotonNs);
+	int64_t GetFramePhotonNs() const { return m_nFramePhotonNs; }
+	int64_t GetFramePhotonSample() const;
+
+	bool BGetEstimate(ClockEstimate &estimate) const;
+	int64_t SampleHeardAt(int64_t nTimeNs) const;
+	int64_t TimeSampleHeard(int64_t nSample) const;
+
+	// pFields starts at p1, p2 is filled in when the event is sent
+	bool BScheduleEvent(int64_t nSample, const MYFLT *pFields, uint32_t unFields);
+	bool BScheduleEventAtTime(int64_t nTimeNs, const MYFLT *pFields, uint32_t unFields);
+	uint64_t GetLateEventCount() const { return m_ulLateEvents.load(std::memory_order_relaxed); }
+	// queued events are logged to it as they are queued, null stops it
+	void SetSessionRecorder(SessionRecorder *pRecorder) { m_pSessionRecorder = pRecorder; }
+
+private:
+
+	void ResetLoop(int64_t nNowNs);
+	void PublishEstimate();
+	void DispatchEvents(Csound &csound);
+
+	// audio side, newest session only
+	std::atomic<Csound*> m_pActiveCsound;
+	Csound* m_pLoopCsound;
+	int64_t m_nBlockSample;
+	uint32_t m_unKsmps;
+	double m_dSr;
+	int64_t m_nOutputLatencyNs;
+	uint64_t m_ulLoopBlocks;
+
+	// loop state, ns: t0 filtered time of this block, t1 predicted time
+	// of the next, e2 filtered block period
+	double m_dT0;
+	double m_dT1;
+	double m_dE2;
+	double m_dNominalPeriodNs;
+
+	// estimate handed to the render thread, guarded by a sequence count
+	// (odd while being written)
+	std::atomic<uint32_t> m_unEstimateSeq;
+	std::atomic<int64_t> m_nEstOriginNs;
+	std::atomic<int64_t> m_nEstOriginSample;
+	std::atomic<double> m_dEstNsPerSample;
+	std::atomic<int64_t> m_nEstOutputLatencyNs;
+	std::atomic<double> m_dEstSr;
+
+	// render thread -> performance thread, single producer single consumer
+	struct ScheduledEvent
+	{
+		int64_t nSample;
+		uint32_t unFields;
+		MYFLT rFields[k_unMaxFields];
+	};
+	ScheduledEvent m_rEvents[k_unMaxEvents];
+	std::atomic<uint32_t> m_unEventHead;
+	std::atomic<uint32_t> m_unEventTail;
+	std::atomic<uint64_t> m_ulLateEvents;
+
+	// render thread
+	int64_t m_nFramePhotonNs;
+	SessionRecorder *m_pSessionRecorder;
+};
+
+#endif
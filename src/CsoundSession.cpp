@@ -1,14 +1,98 @@
 #include "CsoundSession.hpp"
 #include <iostream>
+#include <thread>
+#include <chrono>
 
 
 void CsoundSession::StartThread(){
 	if(Compile((char *)m_csd.c_str()) == 0){
+		m_bAudioThreadPolicyApplied = false;
+		m_deadlineMonitor.SetPeriod(GetKsmps(), GetSr());
+		m_nPaceStartNs = 0;
+		m_nPaceBlocks = 0;
+		for(AudioBlockListener *pListener : m_vecBlockListeners) pListener->OnSessionStart(*this);
 		m_pt = new CsoundPerformanceThread(this);	
+		m_pt->SetProcessCallback(PerformanceThreadCallback, this);
+		m_pt->SetDeadlineMonitor(&m_deadlineMonitor);
 		m_pt->Play();
 	}
 };
 
+//------------------------------------------------------------
+// Starts the performance once any options and the audio thread
+// policy have been set. Waits briefly for the performance thread
+// to apply its policy so the startup report is complete.
+//------------------------------------------------------------
+bool CsoundSession::BStartSession(std::string const &csdFileName){
+	if(csdFileName.empty()) return false;
+
+	m_csd = csdFileName;
+	StartThread();
+	if(!m_pt) return false;
+
+	if(!m_audioThreadPolicy.BIsDefault()){
+		for(int i = 0; i < 500 && !m_bAudioThreadPolicyApplied; i++){
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	return true;
+};
+
+//------------------------------------------------------------
+void CsoundSession::SetAudioThreadPolicy(ThreadPolicy const &policy){
+	m_audioThreadPolicy = policy;
+};
+
+//------------------------------------------------------------
+// Runs independent instruments on nThreads threads each k-cycle
+// (Csound's -j). Has to be set before the csd is compiled.
+//------------------------------------------------------------
+void CsoundSession::SetAudioThreadCount(int nThreads){
+	if(nThreads < 2) return;
+	std::string strOption = "-j " + std::to_string(nThreads);
+	SetOption((char *)strOption.c_str());
+};
+
+//------------------------------------------------------------
+// Listeners have to be added before the session is started.
+//------------------------------------------------------------
+void CsoundSession::AddBlockListener(AudioBlockListener *pListener){
+	m_vecBlockListeners.push_back(pListener);
+};
+
+//------------------------------------------------------------
+// With the null audio driver nothing blocks the performance
+// thread, so it is held back to one ksmps period per block to
+// behave like a real device.
+//------------------------------------------------------------
+void CsoundSession::SetRealtimePacing(bool bPace){
+	m_bPaceToRealtime = bPace;
+};
+
+//------------------------------------------------------------
+// Called on the performance thread before every ksmps block.
+//------------------------------------------------------------
+void CsoundSession::PerformanceThreadCallback(void *pData){
+	CsoundSession *pSession = (CsoundSession*)pData;
+
+	if(!pSession->m_bAudioThreadPolicyApplied.load(std::memory_order_relaxed)){
+		if(!pSession->m_audioThreadPolicy.BIsDefault()){
+			BApplyThreadPolicy("audio", pSession->m_audioThreadPolicy);
+		}
+		pSession->m_bAudioThreadPolicyApplied = true;
+	}
+
+	if(pSession->m_bPaceToRealtime){
+		int64_t nNowNs = AudioDeadlineMonitor::NowNs();
+		if(pSession->m_nPaceStartNs == 0) pSession->m_nPaceStartNs = nNowNs;
+		int64_t nTargetNs = pSession->m_nPaceStartNs + (int64_t)((double)pSession->m_nPaceBlocks * pSession->GetKsmps() * 1.0e9 / pSession->GetSr());
+		if(nTargetNs > nNowNs) std::this_thread::sleep_for(std::chrono::nanoseconds(nTargetNs - nNowNs));
+		pSession->m_nPaceBlocks++;
+	}
+
+	for(AudioBlockListener *pListener : pSession->m_vecBlockListeners) pListener->OnAudioBlock(*pSession);
+};
+
 //------------------------------------------------------------
 void CsoundSession::PlayScore(){
 	if(m_pt->GetStatus() == 0) m_pt->Play();
@@ -28,6 +112,7 @@ void CsoundSession::StopPerformance(){
 	if(m_pt){
 		if(m_pt->GetStatus() == 0) m_pt->Stop();
 		m_pt->Join();
+		delete m_pt;
 		m_pt = NULL;
 	}
 	Reset();
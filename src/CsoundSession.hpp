@@ -5,32 +5,57 @@
 
 #ifdef __APPLE__
 #include <csound.hpp>
-#elif _WIN32
+#else
 #include "csound/csound.hpp"
 #endif
 
 #include "csPerfThread.hpp"
+#include "ThreadPolicy.hpp"
+#include "AudioDeadlineMonitor.hpp"
+#include "AudioBlockListener.hpp"
+
+#include <atomic>
+#include <vector>
 
 class CsoundSession : public Csound{
 
 	std::string m_csd;
 	CsoundPerformanceThread *m_pt;
+	ThreadPolicy m_audioThreadPolicy;
+	std::atomic<bool> m_bAudioThreadPolicyApplied;
+	AudioDeadlineMonitor m_deadlineMonitor;
+	std::vector<AudioBlockListener*> m_vecBlockListeners;
+	bool m_bPaceToRealtime;
+	int64_t m_nPaceStartNs;
+	int64_t m_nPaceBlocks;
+
+	static void PerformanceThreadCallback(void *pData);
 
 public:
 
 	CsoundSession(std::string const &csdFileName) : Csound() {
 		m_pt = NULL;
 		m_csd = "";
+		m_bAudioThreadPolicyApplied = false;
+		m_bPaceToRealtime = false;
+		m_nPaceStartNs = 0;
+		m_nPaceBlocks = 0;
 		if(!csdFileName.empty()){
 			m_csd = csdFileName;
 			StartThread(); 
 		}
 	};
 	void StartThread();
+	bool BStartSession(std::string const &csdFileName);
+	void SetAudioThreadPolicy(ThreadPolicy const &policy);
+	void SetAudioThreadCount(int nThreads);
+	void AddBlockListener(AudioBlockListener *pListener);
+	void SetRealtimePacing(bool bPace);
 	void PlayScore();
 	void ResetSession(std::string const &csdFileName);
 	void StopPerformance();
 	void AudioLoop();
+	const AudioDeadlineMonitor& GetDeadlineMonitor() const { return m_deadlineMonitor; }
 
 };
 
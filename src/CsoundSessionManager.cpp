@@ -0,0 +1,254 @@
+#include "CsoundSessionManager.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <iostream>
+#include <chrono>
+
+CsoundSessionManager::CsoundSessionManager() :
+	m_bSwapping(false),
+	m_nAudioThreads(0),
+	m_fCrossfadeSeconds(2.0f),
+	m_bHeadless(false),
+	m_bExclusiveOutput(false)
+{
+}
+
+CsoundSessionManager::~CsoundSessionManager(){
+	Stop();
+}
+
+//------------------------------------------------------------
+void CsoundSessionManager::SetAudioThreadPolicy(ThreadPolicy const &policy){
+	m_audioThreadPolicy = policy;
+}
+
+//------------------------------------------------------------
+void CsoundSessionManager::SetAudioThreadCount(int nThreads){
+	m_nAudioThreads = nThreads;
+}
+
+//------------------------------------------------------------
+void CsoundSessionManager::SetCrossfadeTime(float fSeconds){
+	if(fSeconds < 0.001f) fSeconds = 0.001f;
+	m_fCrossfadeSeconds = fSeconds;
+}
+
+//------------------------------------------------------------
+// Renders to the null audio driver, paced to real time, for
+// runs without an audio device.
+//------------------------------------------------------------
+void CsoundSessionManager::SetHeadless(bool bHeadless){
+	m_bHeadless = bHeadless;
+}
+
+//------------------------------------------------------------
+// Attached to every session this manager creates. Has to be
+// added before BStart.
+//------------------------------------------------------------
+void CsoundSessionManager::AddBlockListener(AudioBlockListener *pListener){
+	m_vecBlockListeners.push_back(pListener);
+}
+
+//------------------------------------------------------------
+// Starts the first session and fades it in. Blocks until the
+// session is running.
+//------------------------------------------------------------
+bool CsoundSessionManager::BStart(std::string const &csdFileName){
+	CsoundSession *pSession = CreateSession(csdFileName);
+	if(!pSession) return false;
+
+	std::shared_ptr<ChannelBinding> pBinding = std::make_shared<ChannelBinding>();
+	if(!BBindChannels(pSession, *pBinding)){
+		pSession->StopPerformance();
+		delete pSession;
+		return false;
+	}
+
+	*pBinding->fadeTime = (MYFLT)m_fCrossfadeSeconds;
+	*pBinding->masterGain = 1.0;
+	std::atomic_store(&m_pActiveBinding, pBinding);
+
+	m_bExclusiveOutput = BIsExclusiveOutput(pSession, m_strOutputDevice);
+	if(m_bExclusiveOutput){
+		std::cout << "Warning: " << m_strOutputDevice << " can't be opened by two sessions at once, hot swapping is off" << std::endl;
+	}
+	return true;
+}
+
+//------------------------------------------------------------
+// Starts swapping to a new csd in the background. Returns false
+// if a swap is already in progress or the output device can't
+// hold two sessions.
+//------------------------------------------------------------
+bool CsoundSessionManager::BRequestSwap(std::string const &csdFileName){
+	if(m_bExclusiveOutput){
+		std::cout << "Error: swap to " << csdFileName << " refused, " << m_strOutputDevice << " is exclusive and the crossfade needs two sessions on it. Use a shared device (ALSA default or dmix, JACK, PulseAudio, WASAPI shared) to hot swap" << std::endl;
+		return false;
+	}
+	if(m_bSwapping) return false;
+	if(m_swapThread.joinable()) m_swapThread.join();
+
+	m_bSwapping = true;
+	m_swapThread = std::thread(&CsoundSessionManager::SwapThread, this, csdFileName);
+	return true;
+}
+
+//------------------------------------------------------------
+// Waits for any swap to finish and stops the active session.
+// Callers have to drop their binding first.
+//------------------------------------------------------------
+void CsoundSessionManager::Stop(){
+	if(m_swapThread.joinable()) m_swapThread.join();
+
+	std::shared_ptr<ChannelBinding> pBinding = std::atomic_load(&m_pActiveBinding);
+	std::atomic_store(&m_pActiveBinding, std::shared_ptr<ChannelBinding>());
+	if(pBinding) RetireSession(pBinding);
+}
+
+//------------------------------------------------------------
+std::shared_ptr<ChannelBinding> CsoundSessionManager::GetBinding() const {
+	return std::atomic_load(&m_pActiveBinding);
+}
+
+//------------------------------------------------------------
+// Compiles the csd on a new instance and starts it. Output is
+// silent until masterGain is raised.
+//------------------------------------------------------------
+CsoundSession* CsoundSessionManager::CreateSession(std::string const &csdFileName){
+	//options and thread policy have to be in place before the csd is compiled
+	CsoundSession *pSession = new CsoundSession("");
+#ifdef _WIN32
+	pSession->SetOption("-b -128");
+	pSession->SetOption("-B 1024");
+#endif
+	//events scheduled through the clock bridge start on their sample, not the next block
+	pSession->SetOption("--sample-accurate");
+	pSession->SetAudioThreadCount(m_nAudioThreads);
+	pSession->SetAudioThreadPolicy(m_audioThreadPolicy);
+	if(m_bHeadless){
+		pSession->SetOption("-+rtaudio=null");
+		pSession->SetRealtimePacing(true);
+	}
+	for(AudioBlockListener *pListener : m_vecBlockListeners) pSession->AddBlockListener(pListener);
+	//the perf thread takes its rings before its first block, these keep it from allocating them
+	Profiler::ReserveThreads(1);
+	Logger::ReserveThreads(1);
+	if(!pSession->BStartSession(csdFileName)){
+		std::cout << "Error: Csound session could not be started with " << csdFileName << std::endl;
+		delete pSession;
+		return nullptr;
+	}
+	return pSession;
+}
+
+//------------------------------------------------------------
+// Waits until nobody else holds the binding, then stops and
+// deletes its session.
+//------------------------------------------------------------
+void CsoundSessionManager::RetireSession(std::shared_ptr<ChannelBinding> &pBinding){
+	while(pBinding.use_count() > 1){
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	pBinding->pSession->StopPerformance();
+	delete pBinding->pSession;
+	pBinding.reset();
+}
+
+//------------------------------------------------------------
+// Background half of a swap. The new session runs silently until
+// it has warmed up, then the binding is switched and both
+// sessions ramp their master gain over the crossfade window.
+//------------------------------------------------------------
+void CsoundSessionManager::SwapThread(std::string csdFileName){
+	CsoundSession *pSession = CreateSession(csdFileName);
+	if(!pSession){
+		//a device held by another program exclusively, hog mode say, only shows up here
+		std::cout << "Error: swap to " << csdFileName << " failed, the current session keeps playing. If the output device is held exclusively, the new session could not open it" << std::endl;
+		m_bSwapping = false;
+		return;
+	}
+
+	std::shared_ptr<ChannelBinding> pNewBinding = std::make_shared<ChannelBinding>();
+	if(!BBindChannels(pSession, *pNewBinding)){
+		pSession->StopPerformance();
+		delete pSession;
+		m_bSwapping = false;
+		return;
+	}
+
+	WaitForWarmUp(pSession);
+
+	std::shared_ptr<ChannelBinding> pOldBinding = std::atomic_load(&m_pActiveBinding);
+
+	if(pOldBinding){
+		*pOldBinding->fadeTime = (MYFLT)m_fCrossfadeSeconds;
+		*pOldBinding->masterGain = 0.0;
+	}
+	*pNewBinding->fadeTime = (MYFLT)m_fCrossfadeSeconds;
+	*pNewBinding->masterGain = 1.0;
+	std::atomic_store(&m_pActiveBinding, pNewBinding);
+
+	std::cout << "Csound session swapped to " << csdFileName << std::endl;
+
+	if(pOldBinding){
+		std::this_thread::sleep_for(std::chrono::duration<float>(m_fCrossfadeSeconds + 0.05f));
+		RetireSession(pOldBinding);
+	}
+
+	m_bSwapping = false;
+}
+
+//------------------------------------------------------------
+// Looks up the session wide channels the host writes.
+//------------------------------------------------------------
+bool CsoundSessionManager::BBindChannels(CsoundSession *pSession, ChannelBinding &binding){
+	binding.pSession = pSession;
+
+	if(pSession->GetChannelPtr(binding.masterGain, "masterGain", CSOUND_INPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
+		std::cout << "GetChannelPtr could not get the masterGain input" << std::endl;
+		return false;
+	}
+	if(pSession->GetChannelPtr(binding.fadeTime, "fadeTime", CSOUND_INPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
+		std::cout << "GetChannelPtr could not get the fadeTime input" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------
+// Lets the new session run ~100ms of blocks so instrument init,
+// hrtf table loading and first touch of its memory are done
+// before it is heard. Gives up after two seconds.
+//------------------------------------------------------------
+void CsoundSessionManager::WaitForWarmUp(CsoundSession *pSession){
+	const AudioDeadlineMonitor &monitor = pSession->GetDeadlineMonitor();
+	AudioDeadlineMonitor::Snapshot snapshot;
+	monitor.GetSnapshot(snapshot);
+	if(snapshot.dPeriodMs <= 0.0) return;
+
+	uint64_t ulTargetBlocks = (uint64_t)(100.0 / snapshot.dPeriodMs);
+	for(int i = 0; i < 2000; i++){
+		monitor.GetSnapshot(snapshot);
+		if(snapshot.ulBlocks >= ulTargetBlocks) return;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+//------------------------------------------------------------
+// From the rtaudio module and device the session opened. Only
+// what can be told from those, a device another program has
+// taken exclusively shows up as a failed swap instead.
+//------------------------------------------------------------
+bool CsoundSessionManager::BIsExclusiveOutput(CsoundSession *pSession, std::string &strDevice){
+	const char *pchModule = (const char*)pSession->QueryGlobalVariable("_RTAUDIO");
+	const char *pchOutput = pSession->GetOutputName();
+	std::string strModule = pchModule ? pchModule : "";
+	std::string strOutput = pchOutput ? pchOutput : "";
+	strDevice = strOutput + " (" + (strModule.empty() ? "default" : strModule) + ")";
+
+	if(strModule == "asio") return true;
+	if(strModule == "alsa") return strOutput.compare(0, 7, "dac:hw:") == 0 || strOutput.compare(0, 11, "dac:plughw:") == 0;
+	return false;
+}
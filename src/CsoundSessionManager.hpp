@@ -0,0 +1,82 @@
+#ifndef CSOUNDSESSIONMANAGER_HPP
+#define CSOUNDSESSIONMANAGER_HPP
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "CsoundSession.hpp"
+
+//-----------------------------------------------------------------------------
+// Channel pointers for one running session. The render thread fetches the
+// current binding once per frame and holds it until the next one, the
+// session behind it is not stopped while anyone still holds it. Per source
+// parameters don't go through named channels, see SourceParameterTable.
+//-----------------------------------------------------------------------------
+struct ChannelBinding
+{
+	CsoundSession *pSession;
+	MYFLT* masterGain;
+	MYFLT* fadeTime;
+};
+
+//-----------------------------------------------------------------------------
+// Double buffered Csound sessions. A swap compiles and warms up the new csd
+// on a second instance in the background, publishes its channel binding and
+// crossfades the two outputs, then retires the old instance off the render
+// thread.
+//
+// Both instances have the output device open during the crossfade and the
+// system mixes them. A device only one client can open, an ALSA hw: or
+// plughw: device or ASIO, can't do that: the new session would fail to open
+// it or cut the old one off. On those a swap is refused and the running
+// session keeps playing.
+//-----------------------------------------------------------------------------
+class CsoundSessionManager {
+
+public:
+
+	CsoundSessionManager();
+	~CsoundSessionManager();
+
+	void SetAudioThreadPolicy(ThreadPolicy const &policy);
+	void SetAudioThreadCount(int nThreads);
+	void SetCrossfadeTime(float fSeconds);
+	void SetHeadless(bool bHeadless);
+	void AddBlockListener(AudioBlockListener *pListener);
+
+	bool BStart(std::string const &csdFileName);
+	bool BRequestSwap(std::string const &csdFileName);
+	bool BIsSwapping() const { return m_bSwapping; }
+	void Stop();
+
+	std::shared_ptr<ChannelBinding> GetBinding() const;
+
+private:
+
+	CsoundSession* CreateSession(std::string const &csdFileName);
+	void RetireSession(std::shared_ptr<ChannelBinding> &pBinding);
+	void SwapThread(std::string csdFileName);
+
+	static bool BBindChannels(CsoundSession *pSession, ChannelBinding &binding);
+	static void WaitForWarmUp(CsoundSession *pSession);
+	static bool BIsExclusiveOutput(CsoundSession *pSession, std::string &strDevice);
+
+	// only ever read and written through std::atomic_load / std::atomic_store
+	std::shared_ptr<ChannelBinding> m_pActiveBinding;
+
+	std::thread m_swapThread;
+	std::atomic<bool> m_bSwapping;
+
+	ThreadPolicy m_audioThreadPolicy;
+	int m_nAudioThreads;
+	float m_fCrossfadeSeconds;
+	bool m_bHeadless;
+	bool m_bExclusiveOutput;
+	std::string m_strOutputDevice;
+	std::vector<AudioBlockListener*> m_vecBlockListeners;
+};
+
+#endif
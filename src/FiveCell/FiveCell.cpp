@@ -7,10 +7,11 @@
 #include <assert.h>
 #include <math.h>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include "stb_image.h"
 
-#ifdef __APPLE__ 
+#if defined(__APPLE__) || defined(__linux__)
 #include "GLFW/glfw3.h"
 #elif _WIN32 
 #include "glfw3.h"
@@ -18,6 +19,7 @@
 
 //#include "log.h"
 #include "ShaderManager.hpp"
+#include "Profiler.hpp"
 //#include "utils.h"
 
 #define PI 3.14159265359
@@ -26,69 +28,37 @@
 #define _countof(x) (sizeof(x)/sizeof((x)[0]))
 #endif
 
-bool FiveCell::setup(std::string csd, GLuint skyboxProg, GLuint soundObjProg, GLuint groundPlaneProg, GLuint fiveCellProg, GLuint quadShaderProg){
+bool FiveCell::setup(std::string csd, GLuint skyboxProg, GLuint soundObjProg, GLuint groundPlaneProg, GLuint fiveCellProg, GLuint quadShaderProg, const ThreadPolicy& audioPolicy, int audioThreads, float crossfadeTime, bool headless){
+
+	simTime = 0.0;
+	prevRotAngle = 0.0;
+	currRotAngle = 0.0;
 
 //************************************************************
 //Csound performance thread
 //************************************************************
 	std::string csdName = "";
 	if(!csd.empty()) csdName = csd;
-	session = new CsoundSession(csdName);
-#ifdef _WIN32
-	session->SetOption("-b -128"); 
-	session->SetOption("-B 1024");
-#endif
-	for(int i = 0; i < 5; i++){
-		std::string val1 = "azimuth" + std::to_string(i);
-		const char* azimuth = val1.c_str();	
-		if(session->GetChannelPtr(hrtfVals[3 * i], azimuth, CSOUND_INPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
-			std::cout << "GetChannelPtr could not get the azimuth input" << std::endl;
-			return false;
-		}
-		std::string val2 = "elevation" + std::to_string(i);
-		const char* elevation = val2.c_str();
-		if(session->GetChannelPtr(hrtfVals[(3 * i) + 1], elevation, CSOUND_INPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
-			std::cout << "GetChannelPtr could not get the elevation input" << std::endl;
-			return false;
-		}	
-		std::string val3 = "distance" + std::to_string(i);
-		const char* distance = val3.c_str();
-		if(session->GetChannelPtr(hrtfVals[(3 * i) + 2], distance, CSOUND_INPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
-			std::cout << "GetChannelPtr could not get the distance input" << std::endl;
-			return false;
-		}
-	}
-
-//********* output values from csound to avr *******************//
-	const char* vert0 = "vert0";
-	if(session->GetChannelPtr(vert0Vol, vert0, CSOUND_OUTPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
-		std::cout << "Csound output value vert0Vol not available" << std::endl;
-		return false;
-	} 
-
-	const char* vert1 = "vert1";
-	if(session->GetChannelPtr(vert1Vol, vert1, CSOUND_OUTPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
-		std::cout << "Csound output value vert1Vol not available" << std::endl;
+	csdFileName = csdName;
+	sessionManager = new CsoundSessionManager();
+	sessionManager->SetAudioThreadCount(audioThreads);
+	sessionManager->SetAudioThreadPolicy(audioPolicy);
+	sessionManager->SetCrossfadeTime(crossfadeTime);
+	sessionManager->SetHeadless(headless);
+	sessionManager->AddBlockListener(&latencyProbe);
+	sessionManager->AddBlockListener(&sourceParams);
+	sessionManager->AddBlockListener(&clockBridge);
+	//raw source audio for the shaders, the ring has to exist before the session starts
+	if(!waveformStream.BInit(5)){
+		std::cout << "Waveform stream could not be created" << std::endl;
 		return false;
 	}
-
-	const char* vert2 = "vert2";
-	if(session->GetChannelPtr(vert2Vol, vert2, CSOUND_OUTPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
-		std::cout << "Csound output value vert2Vol not available" << std::endl;
-		return false;
-	}
-
-	const char* vert3 = "vert3";
-	if(session->GetChannelPtr(vert3Vol, vert3, CSOUND_OUTPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
-		std::cout << "Csound output value vert3Vol not available" << std::endl;
-		return false;
-	}
-
-	const char* vert4 = "vert4";
-	if(session->GetChannelPtr(vert4Vol, vert4, CSOUND_OUTPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) != 0){
-		std::cout << "Csound output value vert4Vol not available" << std::endl;
+	sessionManager->AddBlockListener(&waveformStream);
+	if(!sessionManager->BStart(csdName)){
+		std::cout << "Csound session could not be started with " << csdName << std::endl;
 		return false;
 	}
+	binding = sessionManager->GetBinding();
 //**********************************************************
 
 	//glEnable(GL_DEPTH_TEST);
@@ -125,7 +95,7 @@ bool FiveCell::setup(std::string csd, GLuint skyboxProg, GLuint soundObjProg, GL
 	//for(int i = 0; i < _countof(soundObjects); i++){
 
 	for(int i = 0; i < 5; i++){
-		if(!soundObjects[i].setup(soundObjProg)){
+		if(!soundObjects[i].setup(soundObjProg, i)){
 			std::cout << "ERROR: SoundObject " << std::to_string(i) << " init failed" << std::endl;
 			return false;
 		}
@@ -797,19 +767,113 @@ bool FiveCell::setup(std::string csd, GLuint skyboxProg, GLuint soundObjProg, GL
 
 }
 
-void FiveCell::update(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 camFront, glm::vec3 camPos){
+//------------------------------------------------------------
+// One fixed simulation step. The polychoron turns at 0.2 rad/s
+// of simulation time. The angle is kept in [0, 2pi) so it
+// keeps its precision over days of running.
+//------------------------------------------------------------
+void FiveCell::step(double stepSeconds){
+	simTime += stepSeconds;
+	prevRotAngle = currRotAngle;
+	currRotAngle = fmod(simTime * 0.2, 2.0 * PI);
+}
 
-//***********************************************************************************************************
-// Update Stuff Here
-//*********************************************************************************************************
+//------------------------------------------------------------
+// Per-frame work is spread over the job system if there is
+// one, otherwise it runs on the calling thread.
+//------------------------------------------------------------
+void FiveCell::setJobSystem(JobSystem* jobs){
+	jobSystem = jobs;
+}
 
-	
-	//for(int i = 0; i < 5; i++){
-	//	std::cout << std::to_string(i) << " --- " << std::to_string(vertArray5Cell[i].x) << " : " << std::to_string(vertArray5Cell[i].y) << " : " << std::to_string(vertArray5Cell[i].z) << " : " << std::to_string(vertArray5Cell[i].w) << std::endl;
-	//}
-		
-	currentFrame = glfwGetTime();
-	deltaTime = currentFrame - lastFrame;
+//------------------------------------------------------------
+// Records what goes to and comes back from the orchestra each
+// frame, or replays what came back and checks what goes out
+// still matches the recording.
+//------------------------------------------------------------
+void FiveCell::setSession(SessionRecorder* recorder, SessionReplayer* replayer){
+	sessionRecorder = recorder;
+	sessionReplayer = replayer;
+	clockBridge.SetSessionRecorder(recorder);
+}
+
+//------------------------------------------------------------
+// Starts running the simulation a frame ahead of the render
+// thread. Without it update simulates inline.
+//------------------------------------------------------------
+bool FiveCell::startSimulationThread(const ThreadPolicy& policy){
+	return simThread.BStart([this]{ simulationThreadFrame(); }, policy);
+}
+
+//------------------------------------------------------------
+// Render thread, once per frame. Runs the simulation or hands
+// the input to the simulation thread, then takes the newest
+// frame that has been finished.
+//------------------------------------------------------------
+void FiveCell::update(const SimulationInput& input){
+	AVR_PROFILE_SCOPE("FiveCell::update");
+
+	//pick up the channels of whichever session is current, a swap may have happened since the last frame
+	binding = sessionManager->GetBinding();
+
+	if(simThread.BIsRunning()){
+		{
+			//steps the simulation hasn't picked up yet carry over
+			std::lock_guard<std::mutex> lock(simInputMutex);
+			uint32_t steps = pendingSimInput.steps + input.steps;
+			pendingSimInput = input;
+			pendingSimInput.steps = steps;
+		}
+		simThread.Kick();
+	} else {
+		simulate(input, framePackets.GetWriteBuffer());
+		framePackets.Publish();
+	}
+
+	if(!framePackets.BAcquire()) return;
+	const FramePacket& packet = framePackets.GetReadBuffer();
+	if(!packet.valid) return;
+
+	for(int i = 0; i < 5; i++){
+		soundObjects[i].update(packet.soundModelMatrices[i]);
+	}
+	latencyProbe.SetFrameAudio(packet.audioBlockNs, packet.updateNs);
+}
+
+//------------------------------------------------------------
+void FiveCell::simulationThreadFrame(){
+	SimulationInput input;
+	{
+		std::lock_guard<std::mutex> lock(simInputMutex);
+		input = pendingSimInput;
+		pendingSimInput.steps = 0;
+	}
+	simulate(input, framePackets.GetWriteBuffer());
+	framePackets.Publish();
+}
+
+//------------------------------------------------------------
+// Everything a frame needs that isn't GL: the 4D rotation, the
+// projected vertices, the HRTF parameters for the orchestra and
+// the sound object transforms. Runs on the render thread or the
+// simulation thread, never both.
+//------------------------------------------------------------
+void FiveCell::simulate(const SimulationInput& input, FramePacket& packet){
+	AVR_PROFILE_SCOPE("FiveCell::simulate");
+
+	for(uint32_t i = 0; i < input.steps; i++) step(input.stepSeconds);
+
+	glm::mat4 viewMat = input.viewMat;
+	glm::vec3 camPos = input.camPos;
+	float alpha = input.alpha;
+
+	//the rotation angle between the last two simulation steps,
+	//unwrapped when the last step crossed 2pi
+	double rotDelta = currRotAngle - prevRotAngle;
+	if(rotDelta < 0.0) rotDelta += 2.0 * PI;
+	float rotAngle = (float)fmod(prevRotAngle + rotDelta * alpha, 2.0 * PI);
+	float cosRot = cos(rotAngle);
+	float sinRot = sin(rotAngle);
 	
 	//_update_fps_counter(window);
 		
@@ -822,22 +886,22 @@ void FiveCell::update(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 camFront,
 	rotationZW = glm::mat4(
 		1.0f, 0.0f, 0.0f, 0.0f,
 		0.0f, 1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f, cos(glfwGetTime() * 0.2f), -sin(glfwGetTime() * 0.2f),
-		0.0f, 0.0f, sin(glfwGetTime() * 0.2f), cos(glfwGetTime() * 0.2f)
+		0.0f, 0.0f, cosRot, -sinRot,
+		0.0f, 0.0f, sinRot, cosRot
 	);
 
 	rotationXW = glm::mat4(	
-		cos(glfwGetTime() * 0.2f), 0.0f, 0.0f, sin(glfwGetTime() * 0.2f),
+		cosRot, 0.0f, 0.0f, sinRot,
 		0.0f, 1.0f, 0.0f, 0.0f,
 		0.0f, 0.0f, 1.0f, 0.0f, 
-		-sin(glfwGetTime() * 0.2f), 0.0f, 0.0f, cos(glfwGetTime() * 0.2f) 
+		-sinRot, 0.0f, 0.0f, cosRot 
 	);
 
 	rotationYW = glm::mat4(	
 		1.0f, 0.0f, 0.0f, 0.0f,
-		0.0f, cos(glfwGetTime() * 0.2f), 0.0f, -sin(glfwGetTime() * 0.2f),
+		0.0f, cosRot, 0.0f, -sinRot,
 		0.0f, 0.0f, 1.0f, 0.0f, 
-		0.0f, sin(glfwGetTime() * 0.2f), 0.0f, cos(glfwGetTime() * 0.2f)
+		0.0f, sinRot, 0.0f, cosRot
 	);
 	//coords of verts to use for hrtf calculations 
 	glm::vec3 projectedVerts [5];
@@ -845,22 +909,23 @@ void FiveCell::update(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 camFront,
 	//for(int i = 0; i < _countof(vertArray); i++){
 		
 	//get values from csound
-	float vert0AudioSig = *vert0Vol;
-	float vert1AudioSig = *vert1Vol;
-	float vert2AudioSig = *vert2Vol;
-	float vert3AudioSig = *vert3Vol;
-	float vert4AudioSig = *vert4Vol;
-	//std::cout << vert0AudioSig << std::endl;		
-
-	vertRms[0] = vert0AudioSig;
-	vertRms[1] = vert1AudioSig;
-	vertRms[2] = vert2AudioSig;
-	vertRms[3] = vert3AudioSig;
-	vertRms[4] = vert4AudioSig;
+	packet.audioBlockNs = latencyProbe.SampleBridge();
+	sourceParams.ReadLevels(vertRms, 5);
+	//std::cout << vertRms[0] << std::endl;		
+	//a replay sees the levels the orchestra produced then, whatever it produces now
+	if(sessionRecorder) sessionRecorder->Record(SessionRecord_ChannelsOut, input.frame, vertRms, sizeof(vertRms));
+	if(sessionReplayer) sessionReplayer->BRead(input.frame, SessionRecord_ChannelsOut, vertRms, sizeof(vertRms));
+	float channelsIn[5 * SourceParameterTable::k_unParamsPerSource];
 
-	for(int i = 0; i < 5; i++){
+	glm::mat4 rotation4D = rotationYW * rotationZW * rotationXW;
+	glm::vec4 viewerPosCameraSpace = viewMat * glm::vec4(camPos, 1.0f);
+	glm::vec4 viewerPosWorldSpace = glm::vec4(camPos, 1.0f);
+
+	//each source only touches its own slots, so ranges of them can run on the job system
+	auto simulateSources = [&](uint32_t begin, uint32_t end){
+	for(uint32_t i = begin; i < end; i++){
 
-		glm::vec4 rotatedVert = rotationYW * rotationZW * rotationXW * vertArray5Cell[i];
+		glm::vec4 rotatedVert = rotation4D * vertArray5Cell[i];
 
 		//std::cout << std::to_string(vertArray[i].x) << " : " << std::to_string(vertArray[i].y) << " : " << std::to_string(vertArray[i].z) << " : " << std::to_string(vertArray[i].w) << std::endl;
 
@@ -877,10 +942,6 @@ void FiveCell::update(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 camFront,
 		glm::vec4 posWorldSpace = fiveCellModelMatrix * glm::vec4(projectedVerts[i], 1.0);
 		//calculate azimuth and elevation values for hrtf
 		
-		glm::vec4 viewerPosCameraSpace = viewMat * glm::vec4(camPos, 1.0f);
-		glm::vec4 viewerPosWorldSpace = glm::vec4(camPos, 1.0f);;
-		//std::cout << i << " --> " << viewerPosWorldSpace.x << " : " << viewerPosWorldSpace.y << " : " << viewerPosWorldSpace.z << std::endl;
-
 		glm::vec4 soundPosCameraSpace = posCameraSpace;
 		glm::vec4 soundPosWorldSpace = posWorldSpace;
 
@@ -924,16 +985,33 @@ void FiveCell::update(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 camFront,
 		//std::cout << i << " --> " << elevation << std::endl;
 		//float elevation = 0.0f;
 
-		*hrtfVals[3 * i] = (MYFLT)azimuth;
-		*hrtfVals[(3 * i) + 1] = (MYFLT)elevation;
-		*hrtfVals[(3 * i) + 2] = (MYFLT)rCamSpace;
+		sourceParams.SetSource(i, azimuth, elevation, rCamSpace);
+		channelsIn[i * SourceParameterTable::k_unParamsPerSource + 0] = azimuth;
+		channelsIn[i * SourceParameterTable::k_unParamsPerSource + 1] = elevation;
+		channelsIn[i * SourceParameterTable::k_unParamsPerSource + 2] = rCamSpace;
 
-		//std::cout << std::to_string(i) << " --- " << std::to_string(*hrtfVals[3 * i]) << " : " << std::to_string(*hrtfVals[(3 * i) + 1]) << " : " << std::to_string(*hrtfVals[(3 * i) + 2]) << std::endl;
+		//std::cout << std::to_string(i) << " --- " << std::to_string(azimuth) << " : " << std::to_string(elevation) << " : " << std::to_string(rCamSpace) << std::endl;
 		
 		//update sound object position
-		soundObjects[i].update(glm::vec3(posWorldSpace), vertRms[i]);	
+		packet.soundModelMatrices[i] = soundObjects[i].modelMatrixFor(glm::vec3(posWorldSpace), vertRms[i], rotAngle);	
 		//std::cout << std::to_string(projectedVerts[i].x) << " : " << std::to_string(projectedVerts[i].y) << " : " << std::to_string(projectedVerts[i].z) << std::endl;
 	}
+	};
+	if(jobSystem) jobSystem->ParallelFor(5, sourcesPerJob, simulateSources);
+	else simulateSources(0, 5);
+
+	//all five sources reach the orchestra together on the next block
+	sourceParams.Publish();
+	if(sessionRecorder) sessionRecorder->Record(SessionRecord_ChannelsIn, input.frame, channelsIn, sizeof(channelsIn));
+	if(sessionReplayer){
+		float recordedIn[5 * SourceParameterTable::k_unParamsPerSource];
+		if(sessionReplayer->BRead(input.frame, SessionRecord_ChannelsIn, recordedIn, sizeof(recordedIn)) && memcmp(recordedIn, channelsIn, sizeof(channelsIn)) != 0){
+			sessionReplayer->ReportDivergence(input.frame, "source parameters");
+		}
+	}
+	if(input.poseNs != 0) latencyProbe.HandOffPose(input.poseNs);
+	packet.updateNs = AudioDeadlineMonitor::NowNs();
+	packet.valid = true;
 
 	
 
@@ -943,6 +1021,7 @@ void FiveCell::update(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 camFront,
 }
 
 void FiveCell::draw(GLuint skyboxProg, GLuint groundPlaneProg, GLuint soundObjProg, GLuint fiveCellProg, GLuint quadShaderProg, glm::mat4 projMat, glm::mat4 viewMat, glm::mat4 eyeMat){
+	AVR_PROFILE_SCOPE("FiveCell::draw");
 		
 //**********************************************************************************************************
 // Draw Stuff Here
@@ -1088,6 +1167,7 @@ void FiveCell::draw(GLuint skyboxProg, GLuint groundPlaneProg, GLuint soundObjPr
 	//draw sound test objects
 	//for(int i = 0; i < _countof(soundObjects); i++){
 
+	waveformStream.Bind(soundObjProg, 1);
 	for(int i = 0; i < 5; i++){
 		soundObjects[i].draw(projMat, viewEyeMat, lightPos, light2Pos, camPosPerEye, soundObjProg);
 	}	
@@ -1109,13 +1189,40 @@ void FiveCell::draw(GLuint skyboxProg, GLuint groundPlaneProg, GLuint soundObjPr
 	//glfwSetCursorPosCallback(window, mouse_callback);
 	//glfwSetWindowSizeCallback(window, glfw_window_size_callback);
 	//glfwSetErrorCallback(glfw_error_callback);
-		
-	lastFrame = currentFrame;
+}
+
+//------------------------------------------------------------
+// Audio block timing for the render thread to poll. Null until
+// setup has started the Csound session.
+//------------------------------------------------------------
+const AudioDeadlineMonitor* FiveCell::GetAudioDeadlineMonitor() const {
+	if(!binding) return nullptr;
+	return &binding->pSession->GetDeadlineMonitor();
+}
+
+//------------------------------------------------------------
+// Compiles the current csd again and crossfades to it, so the
+// orchestra can be edited and reloaded while running.
+//------------------------------------------------------------
+bool FiveCell::BReloadOrchestra(){
+	return sessionManager->BRequestSwap(csdFileName);
+}
+
+//------------------------------------------------------------
+// Once per frame, before the eyes are drawn.
+//------------------------------------------------------------
+void FiveCell::uploadWaveforms(){
+	waveformStream.Upload();
 }
 
 void FiveCell::exit(){
-	//stop csound
-	session->StopPerformance();
+	//the simulation thread writes source parameters, it goes first
+	simThread.Stop();
+	//stop csound, the manager waits for every binding to be released
+	binding.reset();
+	sessionManager->Stop();
+	delete sessionManager;
+	waveformStream.CleanUp();
 	//close GL context and any other GL resources
 	glfwTerminate();
 }
@@ -6,25 +6,68 @@
 #include <string>
 
 #include "SoundObject.hpp"
-#include "CsoundSession.hpp"
+#include "CsoundSessionManager.hpp"
+#include "LatencyProbe.hpp"
+#include "ClockBridge.hpp"
+#include "SourceParameterTable.hpp"
+#include "WaveformStream.hpp"
+#include "SimulationThread.hpp"
+#include "TripleBuffer.hpp"
+#include "JobSystem.hpp"
+#include "SessionRecorder.hpp"
+#include "SessionReplayer.hpp"
+
+//what the render thread hands the simulation each frame
+struct SimulationInput
+{
+	glm::mat4 viewMat;
+	glm::vec3 camPos;
+	uint32_t steps = 0;		//fixed steps due since the last input
+	double stepSeconds = 0.0;
+	float alpha = 0.0f;
+	int64_t poseNs = 0;		//for the latency probe
+	uint64_t frame = 0;		//session log frame the input belongs to
+};
+
+//everything the render thread needs from one simulated frame
+struct FramePacket
+{
+	bool valid = false;
+	glm::mat4 soundModelMatrices[5];
+	int64_t audioBlockNs = 0;	//for the latency probe
+	int64_t updateNs = 0;
+};
 
 class FiveCell {
 
 public:
-	bool setup(std::string csd, GLuint skyboxProg, GLuint soundObjProg, GLuint groundPlaneProg, GLuint fiveCellProg, GLuint quadShaderProg);
-	void update(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 camFront, glm::vec3 camPos);
+	bool setup(std::string csd, GLuint skyboxProg, GLuint soundObjProg, GLuint groundPlaneProg, GLuint fiveCellProg, GLuint quadShaderProg, const ThreadPolicy& audioPolicy, int audioThreads, float crossfadeTime, bool headless);
+	void setJobSystem(JobSystem* jobs);
+	void setSession(SessionRecorder* recorder, SessionReplayer* replayer);
+	bool startSimulationThread(const ThreadPolicy& policy);
+	void update(const SimulationInput& input);
 	void draw(GLuint skyboxProg, GLuint groundPlaneProg, GLuint soundObjProg, GLuint fiveCellProg, GLuint quadShaderProg, glm::mat4 projMat, glm::mat4 viewMat, glm::mat4 eyeMat);
+	void uploadWaveforms();
 	void exit();
+	const AudioDeadlineMonitor* GetAudioDeadlineMonitor() const;
+	bool BReloadOrchestra();
+	LatencyProbe& GetLatencyProbe() { return latencyProbe; }
+	ClockBridge& GetClockBridge() { return clockBridge; }
 
 private:
 
+	void step(double stepSeconds);
+	void simulate(const SimulationInput& input, FramePacket& packet);
+	void simulationThreadFrame();
+
 	glm::vec4 cameraPos;
 	glm::vec3 camPosPerEye;
 	//glm::vec3 cameraFront;
 	//glm::vec3 cameraUp;
-	float deltaTime;
-	float lastFrame;
-	float currentFrame;
+	//simulation state, advanced in fixed steps
+	double simTime;
+	double prevRotAngle;
+	double currRotAngle;
 	//bool needDraw;
 	//float radius;
 
@@ -101,12 +144,29 @@ private:
 	//GLint quad_cameraPosLoc;
 
 	//Csound
-	CsoundSession *session;
-	MYFLT* vert0Vol;
-	MYFLT* vert1Vol;
-	MYFLT* vert2Vol;
-	MYFLT* vert3Vol;
-	MYFLT* vert4Vol;
-	MYFLT* hrtfVals[15];
+	CsoundSessionManager *sessionManager;
+	std::shared_ptr<ChannelBinding> binding;
+	std::string csdFileName;
+	LatencyProbe latencyProbe;
+	ClockBridge clockBridge;
+	SourceParameterTable sourceParams;
+	WaveformStream waveformStream;
+
+	//simulation runs a frame ahead on its own thread when started,
+	//otherwise inline in update
+	SimulationThread simThread;
+	TripleBuffer<FramePacket> framePackets;
+	std::mutex simInputMutex;
+	SimulationInput pendingSimInput;
+
+	//not owned, null runs everything inline
+	JobSystem* jobSystem = nullptr;
+	//five sources are far below what is worth a job, this only
+	//splits the loop once there are enough of them
+	static const uint32_t sourcesPerJob = 16;
+
+	//not owned, either or neither
+	SessionRecorder* sessionRecorder = nullptr;
+	SessionReplayer* sessionReplayer = nullptr;
 };
 #endif
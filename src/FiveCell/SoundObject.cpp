@@ -1,7 +1,8 @@
 #include "SoundObject.hpp"
 #include "ShaderManager.hpp"
+#include "Profiler.hpp"
 
-#ifdef __APPLE__ 
+#if defined(__APPLE__) || defined(__linux__)
 #include "GLFW/glfw3.h"
 #elif _WIN32 
 #include "glfw3.h"
@@ -10,7 +11,7 @@
 #include <iostream>
 #include <vector>
 
-bool SoundObject::setup(GLuint soundObjProg){
+bool SoundObject::setup(GLuint soundObjProg, int sourceIndex){
 
 		//Sound source vertices
 	float soundVerts [24] = {
@@ -110,6 +111,10 @@ bool SoundObject::setup(GLuint soundObjProg){
 	soundObj_cameraPosLoc = glGetUniformLocation(soundObjProg, "camPos");
 	
 	soundObj_scaleValLoc = glGetUniformLocation(soundObjProg, "scale");
+
+	//which row of the waveform stream this object reads
+	soundObj_waveSourceLoc = glGetUniformLocation(soundObjProg, "waveSource");
+	waveSource = sourceIndex;
 	
 	//only use during development as computationally expensive
 	bool validProgram = is_valid(soundObjProg);
@@ -121,6 +126,7 @@ bool SoundObject::setup(GLuint soundObjProg){
 	glBindVertexArray(0);
 	
 	identityModelMat = glm::mat4(1.0);
+	soundModelMatrix = identityModelMat;
 	
 	return true;
 }
@@ -131,21 +137,26 @@ bool SoundObject::setup(GLuint soundObjProg){
 //	scaleMat = glm::scale(identityModelMat, scaleVec);
 //}
 
-void SoundObject::update(glm::vec3 translationVal, float scaleVal){
+//any thread, only reads state fixed at setup
+glm::mat4 SoundObject::modelMatrixFor(glm::vec3 translationVal, float scaleVal, float rotAngle) const {
 
 	float scaleFull = 0.5f;
 	float scaleCalc = scaleVal * scaleFull;
 	float scaleBase = 0.1f;
 	glm::vec3 scaleVec = glm::vec3(scaleCalc + scaleBase);
 	glm::mat4 scaleMat = glm::scale(identityModelMat, scaleVec);
-	float soundModelRotAngle = glfwGetTime() * 0.2f;
-	glm::mat4 rotateSoundModel = glm::rotate(identityModelMat, soundModelRotAngle, glm::vec3(0, 1, 0));;
+	glm::mat4 rotateSoundModel = glm::rotate(identityModelMat, rotAngle, glm::vec3(0, 1, 0));;
 	//glm::vec3 finalTranslation = translationVal + glm::vec3(0.0, 2.0, 0.0);
 	glm::mat4 translateMat = glm::translate(identityModelMat, translationVal);
-	soundModelMatrix = translateMat * rotateSoundModel * scaleMat;
+	return translateMat * rotateSoundModel * scaleMat;
+}
+
+void SoundObject::update(const glm::mat4& modelMatrix){
+	soundModelMatrix = modelMatrix;
 }
 
 void SoundObject::draw(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 lightPosition, glm::vec3 light2Position, glm::vec3 cameraPosition, GLuint soundObjProg){
+	AVR_PROFILE_SCOPE("SoundObject::draw");
 
 	glEnable(GL_CULL_FACE);
 	glBindVertexArray(soundVAO);
@@ -158,6 +169,7 @@ void SoundObject::draw(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 lightPosi
 	glUniform3f(soundObj_lightPosLoc, lightPosition.x, lightPosition.y, lightPosition.z);
 	glUniform3f(soundObj_light2PosLoc, light2Position.x, light2Position.y, light2Position.z);
 	glUniform3f(soundObj_cameraPosLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+	glUniform1i(soundObj_waveSourceLoc, waveSource);
 
 	glDrawElements(GL_TRIANGLES, 36 * sizeof(unsigned int), GL_UNSIGNED_INT, (void*)0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -12,8 +12,9 @@
 class SoundObject {
 
 public:
-	bool setup(GLuint soundObjProg);
-	void update(glm::vec3 translationVal, float scaleVal);
+	bool setup(GLuint soundObjProg, int sourceIndex);
+	glm::mat4 modelMatrixFor(glm::vec3 translationVal, float scaleVal, float rotAngle) const;
+	void update(const glm::mat4& modelMatrix);
 	void draw(glm::mat4 projMat, glm::mat4 viewMat, glm::vec3 lightPosition, glm::vec3 light2Position, glm::vec3 cameraPosition, GLuint soundObjProg);
 private:
 
@@ -28,6 +29,9 @@ private:
 	GLint soundObj_light2PosLoc;
 	GLint soundObj_cameraPosLoc;
 	GLint soundObj_scaleValLoc;
+	GLint soundObj_waveSourceLoc;
+
+	int waveSource;
 
 	glm::mat4 identityModelMat;
 	//glm::mat4 scaleMat;
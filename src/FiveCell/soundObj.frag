@@ -5,8 +5,14 @@ uniform vec3 light2Pos;
 uniform vec3 camPos;
 uniform samplerCube skybox;
 
+uniform samplerBuffer waveform;
+uniform int waveHead;
+uniform int waveLength;
+uniform int waveSource;
+
 in vec3 fragPos_worldSpace;
 in vec3 normal_worldSpace;
+in vec3 pos_modelSpace;
 
 out vec4 colour_out;
 
@@ -20,6 +26,15 @@ void main(){
 	colour_out = vec4(texture(skybox, R).rgb, 1.0);
 //*********************************************//
 
+//********** oscilloscope trace ***************//
+	// the last 1024 samples across the object's width
+	float x = clamp(pos_modelSpace.x * 0.5 + 0.5, 0.0, 1.0);
+	int sampleIndex = (waveHead - 1 - int(x * 1023.0) + waveLength) % waveLength;
+	float wave = texelFetch(waveform, waveSource * waveLength + sampleIndex).r;
+	float trace = 1.0 - smoothstep(0.0, 0.04, abs(pos_modelSpace.y - wave));
+	colour_out.rgb = mix(colour_out.rgb, vec3(1.0), trace * 0.8);
+//*********************************************//
+
 //********** reflective surface ***************//
 	//vec3 I = normalize(fragPos_worldSpace - camPos);
 	//vec3 R = reflect(I, normalize(normal_worldSpace));
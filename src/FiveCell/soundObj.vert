@@ -7,14 +7,27 @@ uniform mat4 projMat;
 uniform mat4 viewMat;
 uniform mat4 soundModelMat;
 
+//raw audio of every source, see WaveformStream
+uniform samplerBuffer waveform;
+uniform int waveHead;
+uniform int waveLength;
+uniform int waveSource;
+
 out vec3 fragPos_worldSpace;
 out vec3 normal_worldSpace;
+out vec3 pos_modelSpace;
 
 void main(){
 
-	gl_Position = projMat * viewMat * soundModelMat * vec4(position, 1.0);	
+	//push each corner out along its normal by a recent sample, 64 samples apart
+	int sampleIndex = (waveHead - 1 - gl_VertexID * 64 + waveLength) % waveLength;
+	float wave = texelFetch(waveform, waveSource * waveLength + sampleIndex).r;
+	vec3 displaced = position + normal * wave * 0.5;
+
+	gl_Position = projMat * viewMat * soundModelMat * vec4(displaced, 1.0);	
 
-	fragPos_worldSpace = vec3(soundModelMat * vec4(position, 1.0)).xyz;  	
+	pos_modelSpace = position;
+	fragPos_worldSpace = vec3(soundModelMat * vec4(displaced, 1.0)).xyz;  	
 	normal_worldSpace = mat3(transpose(inverse(soundModelMat))) * normal;
 
 }
@@ -0,0 +1,199 @@
+#include "LatencyProbe.hpp"
+#include "AudioDeadlineMonitor.hpp"
+
+#include <cstdio>
+
+LatencyProbe::LatencyProbe() :
+	m_nLastBlockEndNs(0),
+	m_nPeriodNs(0),
+	m_nOutputLatencyNs(0),
+	m_unPendingSeq(0),
+	m_nPendingPoseNs(0),
+	m_nPendingWriteNs(0),
+	m_bPendingValid(false),
+	m_nPoseNs(0),
+	m_nFrameAudioNs(0),
+	m_nUpdateNs(0),
+	m_nDrawNs(0),
+	m_nSubmitNs(0)
+{
+	for(int i = 0; i < Latency_Count; i++){
+		m_rulCounts[i] = 0;
+		for(uint32_t j = 0; j < k_unHistogramBins; j++) m_rHistograms[i][j] = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Picks up the block period and the output buffer latency of a session.
+//-----------------------------------------------------------------------------
+void LatencyProbe::OnSessionStart(Csound &csound)
+{
+	double dSr = csound.GetSr();
+	if(dSr <= 0.0) return;
+	m_nPeriodNs = (int64_t)((double)csound.GetKsmps() * 1.0e9 / dSr);
+	m_nOutputLatencyNs = (int64_t)((double)csound.GetOutputBufferSize() * 1.0e9 / dSr);
+}
+
+//-----------------------------------------------------------------------------
+// Runs before each block, so the previous block has just finished and its
+// channel values are now visible to the render thread. A pose probe left by
+// the render thread is heard from this block on.
+//-----------------------------------------------------------------------------
+void LatencyProbe::OnAudioBlock(Csound &csound)
+{
+	int64_t nNowNs = AudioDeadlineMonitor::NowNs();
+	m_nLastBlockEndNs.store(nNowNs, std::memory_order_release);
+
+	uint32_t unSeq = m_unPendingSeq.load(std::memory_order_acquire);
+	if((unSeq & 1) || !m_bPendingValid.load(std::memory_order_relaxed)) return;
+
+	int64_t nPoseNs = m_nPendingPoseNs.load(std::memory_order_relaxed);
+	int64_t nWriteNs = m_nPendingWriteNs.load(std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(m_unPendingSeq.load(std::memory_order_relaxed) != unSeq) return;
+
+	bool bExpected = true;
+	if(!m_bPendingValid.compare_exchange_strong(bExpected, false)) return;
+
+	Record(Latency_PoseToWrite, nWriteNs - nPoseNs);
+	Record(Latency_PoseToBlock, nNowNs - nPoseNs);
+	Record(Latency_PoseToOutput, nNowNs + m_nPeriodNs.load(std::memory_order_relaxed) + m_nOutputLatencyNs.load(std::memory_order_relaxed) - nPoseNs);
+}
+
+//-----------------------------------------------------------------------------
+void LatencyProbe::BeginFrame()
+{
+	m_nFrameAudioNs = 0;
+	m_nUpdateNs = 0;
+	m_nDrawNs = 0;
+	m_nSubmitNs = 0;
+}
+
+//-----------------------------------------------------------------------------
+// The time the pose (or dev camera input) used for the next frame was read.
+//-----------------------------------------------------------------------------
+void LatencyProbe::MarkPose()
+{
+	m_nPoseNs = AudioDeadlineMonitor::NowNs();
+}
+
+//-----------------------------------------------------------------------------
+// Any thread. Records the age of the newest audio block at the moment its
+// values are read and returns the block's end time.
+//-----------------------------------------------------------------------------
+int64_t LatencyProbe::SampleBridge()
+{
+	int64_t nBlockEndNs = m_nLastBlockEndNs.load(std::memory_order_acquire);
+	if(nBlockEndNs != 0) Record(Latency_AudioToBridge, AudioDeadlineMonitor::NowNs() - nBlockEndNs);
+	return nBlockEndNs;
+}
+
+//-----------------------------------------------------------------------------
+// Render thread. The block end the frame's simulation sampled and when the
+// simulation finished, which may have been on another thread.
+//-----------------------------------------------------------------------------
+void LatencyProbe::SetFrameAudio(int64_t nBlockEndNs, int64_t nUpdateNs)
+{
+	m_nFrameAudioNs = nBlockEndNs;
+	m_nUpdateNs = nUpdateNs;
+}
+
+//-----------------------------------------------------------------------------
+// Hands the pose a frame was simulated with to the audio thread along with
+// the time the HRTF parameters were written. Called by whichever thread
+// writes them, one writer at a time.
+//-----------------------------------------------------------------------------
+void LatencyProbe::HandOffPose(int64_t nPoseNs)
+{
+	uint32_t unSeq = m_unPendingSeq.load(std::memory_order_relaxed);
+	m_unPendingSeq.store(unSeq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_nPendingPoseNs.store(nPoseNs, std::memory_order_relaxed);
+	m_nPendingWriteNs.store(AudioDeadlineMonitor::NowNs(), std::memory_order_relaxed);
+	m_bPendingValid.store(true, std::memory_order_relaxed);
+	m_unPendingSeq.store(unSeq + 2, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+void LatencyProbe::MarkDraw()
+{
+	m_nDrawNs = AudioDeadlineMonitor::NowNs();
+}
+
+//-----------------------------------------------------------------------------
+void LatencyProbe::MarkSubmit()
+{
+	m_nSubmitNs = AudioDeadlineMonitor::NowNs();
+}
+
+//-----------------------------------------------------------------------------
+void LatencyProbe::EndFrame()
+{
+	if(m_nFrameAudioNs == 0) return;
+
+	if(m_nUpdateNs) Record(Latency_AudioToUpdate, m_nUpdateNs - m_nFrameAudioNs);
+	if(m_nDrawNs) Record(Latency_AudioToDraw, m_nDrawNs - m_nFrameAudioNs);
+	if(m_nSubmitNs) Record(Latency_AudioToSubmit, m_nSubmitNs - m_nFrameAudioNs);
+}
+
+//-----------------------------------------------------------------------------
+void LatencyProbe::Record(ELatencyMetric eMetric, int64_t nLatencyNs)
+{
+	if(nLatencyNs < 0) nLatencyNs = 0;
+	uint64_t ulBin = (uint64_t)nLatencyNs / 100000;
+	if(ulBin >= k_unHistogramBins) ulBin = k_unHistogramBins - 1;
+	m_rHistograms[eMetric][ulBin].fetch_add(1, std::memory_order_relaxed);
+	m_rulCounts[eMetric].fetch_add(1, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+uint64_t LatencyProbe::GetCount(ELatencyMetric eMetric) const
+{
+	return m_rulCounts[eMetric].load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+// Upper edge of the bin the percentile (0 - 1) falls in.
+//-----------------------------------------------------------------------------
+double LatencyProbe::GetPercentileMs(ELatencyMetric eMetric, double dPercentile) const
+{
+	uint64_t ulTotal = 0;
+	for(uint32_t i = 0; i < k_unHistogramBins; i++) ulTotal += m_rHistograms[eMetric][i].load(std::memory_order_relaxed);
+	if(ulTotal == 0) return 0.0;
+
+	uint64_t ulTarget = (uint64_t)(dPercentile * (double)ulTotal);
+	uint64_t ulSum = 0;
+	for(uint32_t i = 0; i < k_unHistogramBins; i++){
+		ulSum += m_rHistograms[eMetric][i].load(std::memory_order_relaxed);
+		if(ulSum > ulTarget) return (double)(i + 1) * 0.1;
+	}
+	return (double)k_unHistogramBins * 0.1;
+}
+
+//-----------------------------------------------------------------------------
+const char* LatencyProbe::MetricName(ELatencyMetric eMetric)
+{
+	switch(eMetric)
+	{
+	case Latency_AudioToBridge: return "audio block -> bridge";
+	case Latency_AudioToUpdate: return "audio block -> update";
+	case Latency_AudioToDraw:   return "audio block -> draw";
+	case Latency_AudioToSubmit: return "audio block -> submit";
+	case Latency_PoseToWrite:   return "pose -> hrtf write";
+	case Latency_PoseToBlock:   return "pose -> audio block";
+	case Latency_PoseToOutput:  return "pose -> audio output";
+	default:                    return "unknown";
+	}
+}
+
+//-----------------------------------------------------------------------------
+void LatencyProbe::PrintReport() const
+{
+	std::printf("Latency report (ms)              count      p50      p95      p99\n");
+	for(int i = 0; i < Latency_Count; i++){
+		ELatencyMetric eMetric = (ELatencyMetric)i;
+		std::printf("  %-28s %8llu %8.1f %8.1f %8.1f\n", MetricName(eMetric),
+			(unsigned long long)GetCount(eMetric),
+			GetPercentileMs(eMetric, 0.50), GetPercentileMs(eMetric, 0.95), GetPercentileMs(eMetric, 0.99));
+	}
+}
@@ -0,0 +1,93 @@
+#ifndef LATENCYPROBE_HPP
+#define LATENCYPROBE_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include "AudioBlockListener.hpp"
+
+//-----------------------------------------------------------------------------
+// Timestamps the two paths between sound and picture.
+//
+// Audio to visual: the end of the Csound block whose levels a frame reads,
+// then the level read (bridge), the end of the frame's simulation, the end
+// of the eye draws and the submit to the compositor.
+//
+// Pose to audio: the pose a frame was simulated with, the HRTF parameter
+// write, the start of the first block that reads it and that block reaching
+// the output (block end plus the -B buffer).
+//
+// Frame marks are render thread only, SampleBridge and HandOffPose run on
+// whichever thread simulates, OnAudioBlock is the performance thread. Each
+// metric is a lock-free histogram with 0.1ms bins.
+//-----------------------------------------------------------------------------
+class LatencyProbe : public AudioBlockListener {
+
+public:
+
+	enum ELatencyMetric
+	{
+		Latency_AudioToBridge = 0,
+		Latency_AudioToUpdate,
+		Latency_AudioToDraw,
+		Latency_AudioToSubmit,
+		Latency_PoseToWrite,
+		Latency_PoseToBlock,
+		Latency_PoseToOutput,
+		Latency_Count
+	};
+
+	static const uint32_t k_unHistogramBins = 2500;
+
+	LatencyProbe();
+
+	// AudioBlockListener
+	void OnSessionStart(Csound &csound) override;
+	void OnAudioBlock(Csound &csound) override;
+
+	void BeginFrame();
+	void MarkPose();
+	void MarkDraw();
+	void MarkSubmit();
+	void EndFrame();
+	int64_t GetPoseNs() const { return m_nPoseNs; }
+	void SetFrameAudio(int64_t nBlockEndNs, int64_t nUpdateNs);
+
+	// simulation side, render or simulation thread
+	int64_t SampleBridge();
+	void HandOffPose(int64_t nPoseNs);
+
+	uint64_t GetCount(ELatencyMetric eMetric) const;
+	double GetPercentileMs(ELatencyMetric eMetric, double dPercentile) const;
+	void PrintReport() const;
+
+	static const char* MetricName(ELatencyMetric eMetric);
+
+private:
+
+	void Record(ELatencyMetric eMetric, int64_t nLatencyNs);
+
+	std::atomic<uint32_t> m_rHistograms[Latency_Count][k_unHistogramBins];
+	std::atomic<uint64_t> m_rulCounts[Latency_Count];
+
+	// audio side
+	std::atomic<int64_t> m_nLastBlockEndNs;
+	std::atomic<int64_t> m_nPeriodNs;
+	std::atomic<int64_t> m_nOutputLatencyNs;
+
+	// pose probe handed from the render thread to the next audio block,
+	// guarded by a sequence count (odd while being written)
+	std::atomic<uint32_t> m_unPendingSeq;
+	std::atomic<int64_t> m_nPendingPoseNs;
+	std::atomic<int64_t> m_nPendingWriteNs;
+	std::atomic<bool> m_bPendingValid;
+
+	// render side
+	int64_t m_nPoseNs;
+	int64_t m_nFrameAudioNs;
+	int64_t m_nUpdateNs;
+	int64_t m_nDrawNs;
+	int64_t m_nSubmitNs;
+};
+
+#endif
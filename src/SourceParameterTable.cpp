@@ -0,0 +1,126 @@
+#include "SourceParameterTable.hpp"
+
+#include <iostream>
+
+SourceParameterTable::SourceParameterTable() :
+	m_nNewestSession(0),
+	m_unParamSeq(0),
+	m_unLevelSeq(0)
+{
+	for(int i = 0; i < 2; i++){
+		m_rSessions[i].pCsound = nullptr;
+		m_rSessions[i].pParams = nullptr;
+		m_rSessions[i].pLevels = nullptr;
+		m_rSessions[i].unParamLength = 0;
+		m_rSessions[i].unLevelLength = 0;
+	}
+
+	// distance starts at 1 so no source divides by zero before the first frame
+	for(uint32_t i = 0; i < k_unMaxSources; i++){
+		m_rfPending[i * k_unParamsPerSource] = 0.0f;
+		m_rfPending[i * k_unParamsPerSource + 1] = 0.0f;
+		m_rfPending[i * k_unParamsPerSource + 2] = 1.0f;
+		for(uint32_t j = 0; j < k_unParamsPerSource; j++){
+			m_rfParams[i * k_unParamsPerSource + j] = m_rfPending[i * k_unParamsPerSource + j];
+		}
+		m_rfLevels[i] = 0.0f;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Looks up the two tables of a newly compiled session. The slot the newest
+// session isn't using is the one being retired, or empty.
+//-----------------------------------------------------------------------------
+void SourceParameterTable::OnSessionStart(Csound &csound)
+{
+	int nSlot = 1 - m_nNewestSession.load(std::memory_order_relaxed);
+	if(m_rSessions[0].pCsound.load() == nullptr) nSlot = 0;
+	SessionTables &tables = m_rSessions[nSlot];
+
+	int nParamLength = csound.GetTable(tables.pParams, k_nParamTable);
+	int nLevelLength = csound.GetTable(tables.pLevels, k_nLevelTable);
+	if(nParamLength <= 0 || nLevelLength <= 0){
+		std::cout << "Error: csd has no source parameter tables " << k_nParamTable << " and " << k_nLevelTable << std::endl;
+		return;
+	}
+	tables.unParamLength = (uint32_t)nParamLength;
+	tables.unLevelLength = (uint32_t)nLevelLength;
+
+	tables.pCsound.store(&csound, std::memory_order_release);
+	m_nNewestSession.store(nSlot, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// The bulk transfer. Runs on the performance thread between blocks, so the
+// orchestra never sees the table change mid block.
+//-----------------------------------------------------------------------------
+void SourceParameterTable::OnAudioBlock(Csound &csound)
+{
+	int nSlot = 0;
+	if(m_rSessions[0].pCsound.load(std::memory_order_acquire) != &csound){
+		nSlot = 1;
+		if(m_rSessions[1].pCsound.load(std::memory_order_acquire) != &csound) return;
+	}
+	SessionTables &tables = m_rSessions[nSlot];
+
+	uint32_t unParams = tables.unParamLength < k_unMaxSources * k_unParamsPerSource ? tables.unParamLength : k_unMaxSources * k_unParamsPerSource;
+
+	// parameters in, skipped for this block if the render thread is mid publish
+	uint32_t unSeq = m_unParamSeq.load(std::memory_order_acquire);
+	if(!(unSeq & 1)){
+		for(uint32_t i = 0; i < unParams; i++) tables.rScratch[i] = (MYFLT)m_rfParams[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(m_unParamSeq.load(std::memory_order_relaxed) == unSeq){
+			for(uint32_t i = 0; i < unParams; i++) tables.pParams[i] = tables.rScratch[i];
+		}
+	}
+
+	// levels out, from whichever session is newest
+	if(nSlot != m_nNewestSession.load(std::memory_order_acquire)) return;
+
+	uint32_t unLevels = tables.unLevelLength < k_unMaxSources ? tables.unLevelLength : k_unMaxSources;
+	uint32_t unLevelSeq = m_unLevelSeq.load(std::memory_order_relaxed);
+	m_unLevelSeq.store(unLevelSeq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for(uint32_t i = 0; i < unLevels; i++) m_rfLevels[i].store((float)tables.pLevels[i], std::memory_order_relaxed);
+	m_unLevelSeq.store(unLevelSeq + 2, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Render thread. Values are staged until Publish.
+//-----------------------------------------------------------------------------
+void SourceParameterTable::SetSource(uint32_t unSource, float fAzimuth, float fElevation, float fDistance)
+{
+	if(unSource >= k_unMaxSources) return;
+	float *pSource = &m_rfPending[unSource * k_unParamsPerSource];
+	pSource[0] = fAzimuth;
+	pSource[1] = fElevation;
+	pSource[2] = fDistance;
+}
+
+//-----------------------------------------------------------------------------
+// Makes the staged set visible to the next audio block as a whole.
+//-----------------------------------------------------------------------------
+void SourceParameterTable::Publish()
+{
+	uint32_t unSeq = m_unParamSeq.load(std::memory_order_relaxed);
+	m_unParamSeq.store(unSeq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for(uint32_t i = 0; i < k_unMaxSources * k_unParamsPerSource; i++) m_rfParams[i].store(m_rfPending[i], std::memory_order_relaxed);
+	m_unParamSeq.store(unSeq + 2, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Render thread. Retries a couple of times if a block lands mid read, then
+// settles for what it has; levels only drive visuals.
+//-----------------------------------------------------------------------------
+void SourceParameterTable::ReadLevels(float *pLevels, uint32_t unCount) const
+{
+	if(unCount > k_unMaxSources) unCount = k_unMaxSources;
+	for(int nTry = 0; nTry < 3; nTry++){
+		uint32_t unSeq = m_unLevelSeq.load(std::memory_order_acquire);
+		for(uint32_t i = 0; i < unCount; i++) pLevels[i] = m_rfLevels[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(!(unSeq & 1) && m_unLevelSeq.load(std::memory_order_relaxed) == unSeq) return;
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef SOURCEPARAMETERTABLE_HPP
+#define SOURCEPARAMETERTABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include "AudioBlockListener.hpp"
+
+//-----------------------------------------------------------------------------
+// Moves every source's parameters between the host and the orchestra as one
+// block per control period instead of one named channel per value.
+//
+// The render thread writes azimuth, elevation and distance for all sources
+// into a staging buffer and publishes it; before each ksmps block the
+// performance thread copies the latest complete set into function table
+// k_nParamTable (three values per source, indexed by source ID) and copies
+// the per-source levels the orchestra wrote to k_nLevelTable back out.
+// Both directions are guarded by a sequence count so neither side sees a
+// half written set and neither side waits.
+//-----------------------------------------------------------------------------
+class SourceParameterTable : public AudioBlockListener {
+
+public:
+
+	// must match the ftgen numbers in the csd
+	static const int k_nParamTable = 100;
+	static const int k_nLevelTable = 101;
+
+	static const uint32_t k_unMaxSources = 64;
+	static const uint32_t k_unParamsPerSource = 3;
+
+	SourceParameterTable();
+
+	// AudioBlockListener
+	void OnSessionStart(Csound &csound) override;
+	void OnAudioBlock(Csound &csound) override;
+
+	// render thread
+	void SetSource(uint32_t unSource, float fAzimuth, float fElevation, float fDistance);
+	void Publish();
+	void ReadLevels(float *pLevels, uint32_t unCount) const;
+
+private:
+
+	// one per running session so both sides of a crossfade get parameters
+	struct SessionTables
+	{
+		std::atomic<Csound*> pCsound;
+		MYFLT* pParams;
+		MYFLT* pLevels;
+		uint32_t unParamLength;
+		uint32_t unLevelLength;
+		// copy of the staging set, so a torn read never reaches the table
+		MYFLT rScratch[k_unMaxSources * k_unParamsPerSource];
+	};
+	SessionTables m_rSessions[2];
+	std::atomic<int> m_nNewestSession;
+
+	// render thread -> audio
+	float m_rfPending[k_unMaxSources * k_unParamsPerSource];
+	std::atomic<uint32_t> m_unParamSeq;
+	std::atomic<float> m_rfParams[k_unMaxSources * k_unParamsPerSource];
+
+	// audio -> render thread
+	std::atomic<uint32_t> m_unLevelSeq;
+	std::atomic<float> m_rfLevels[k_unMaxSources];
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "AllocationTracker.hpp"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <intrin.h>
+#pragma intrinsic(_ReturnAddress)
+#define AVR_RETURN_ADDRESS() ((uintptr_t)_ReturnAddress())
+#else
+#include <cxxabi.h>
+#include <dlfcn.h>
+#define AVR_RETURN_ADDRESS() ((uintptr_t)__builtin_return_address(0))
+#endif
+
+#ifdef AVR_TRACK_ALLOCATIONS
+
+namespace
+{
+	static_assert((AllocationTracker::k_unMaxSites & (AllocationTracker::k_unMaxSites - 1)) == 0, "the site hash masks by the table size");
+
+	// a site that finds this many slots taken goes to the overflow slot
+	const uint32_t k_unMaxProbes = 64;
+	const uint32_t k_unOverflowSlot = AllocationTracker::k_unMaxSites;
+	const uint32_t k_unBlockMagic = 0xA11C0A7E;
+
+	// in front of every block, keeps what follows it 16 byte aligned
+	struct BlockHeader
+	{
+		uint64_t ulSize;
+		uint32_t unSlot;
+		uint32_t unMagic;
+	};
+	static_assert(sizeof(BlockHeader) == 16, "the header must keep malloc's alignment");
+
+	struct Site
+	{
+		std::atomic<uintptr_t> ulSite;
+		std::atomic<int64_t> nLiveBytes;
+		std::atomic<int64_t> nLiveBlocks;
+		std::atomic<uint64_t> ulAllocations;
+	};
+
+	// zero initialised before anything runs, so allocations from static
+	// constructors are counted too
+	Site s_rSites[AllocationTracker::k_unSiteSlots];
+
+	uint32_t FindSlot(uintptr_t ulSite)
+	{
+		if(ulSite == 0) return k_unOverflowSlot;
+
+		uint32_t unHash = (uint32_t)(((uint64_t)ulSite * 0x9E3779B97F4A7C15ull) >> 40);
+		for(uint32_t unProbe = 0; unProbe < k_unMaxProbes; unProbe++)
+		{
+			uint32_t unSlot = (unHash + unProbe) & (AllocationTracker::k_unMaxSites - 1);
+			uintptr_t ulSeen = s_rSites[unSlot].ulSite.load(std::memory_order_relaxed);
+			if(ulSeen == ulSite) return unSlot;
+			if(ulSeen == 0)
+			{
+				if(s_rSites[unSlot].ulSite.compare_exchange_strong(ulSeen, ulSite, std::memory_order_relaxed)) return unSlot;
+				// another thread took it, maybe for the same site
+				if(ulSeen == ulSite) return unSlot;
+			}
+		}
+		return k_unOverflowSlot;
+	}
+
+	void* Allocate(size_t unSize, uintptr_t ulSite)
+	{
+		if(unSize > SIZE_MAX - sizeof(BlockHeader)) return nullptr;
+
+		BlockHeader* pHeader = (BlockHeader*)std::malloc(sizeof(BlockHeader) + unSize);
+		if(!pHeader) return nullptr;
+
+		uint32_t unSlot = FindSlot(ulSite);
+		pHeader->ulSize = unSize;
+		pHeader->unSlot = unSlot;
+		pHeader->unMagic = k_unBlockMagic;
+
+		Site &site = s_rSites[unSlot];
+		site.nLiveBytes.fetch_add((int64_t)unSize, std::memory_order_relaxed);
+		site.nLiveBlocks.fetch_add(1, std::memory_order_relaxed);
+		site.ulAllocations.fetch_add(1, std::memory_order_relaxed);
+		return pHeader + 1;
+	}
+
+	// what operator new has to do when malloc comes back empty
+	void* AllocateOrThrow(size_t unSize, uintptr_t ulSite)
+	{
+		if(unSize == 0) unSize = 1;
+		for(;;)
+		{
+			void* pBlock = Allocate(unSize, ulSite);
+			if(pBlock) return pBlock;
+
+			std::new_handler handler = std::get_new_handler();
+			if(!handler) throw std::bad_alloc();
+			handler();
+		}
+	}
+
+	void* AllocateNoThrow(size_t unSize, uintptr_t ulSite)
+	{
+		try
+		{
+			return AllocateOrThrow(unSize, ulSite);
+		}
+		catch(...)
+		{
+			return nullptr;
+		}
+	}
+
+	void Release(void* pBlock)
+	{
+		if(!pBlock) return;
+
+		BlockHeader* pHeader = (BlockHeader*)pBlock - 1;
+		if(pHeader->unMagic == k_unBlockMagic && pHeader->unSlot < AllocationTracker::k_unSiteSlots)
+		{
+			Site &site = s_rSites[pHeader->unSlot];
+			site.nLiveBytes.fetch_sub((int64_t)pHeader->ulSize, std::memory_order_relaxed);
+			site.nLiveBlocks.fetch_sub(1, std::memory_order_relaxed);
+			// a second delete of the same block isn't charged twice
+			pHeader->unMagic = 0;
+		}
+		std::free(pHeader);
+	}
+}
+
+// the replacements live with the functions the monitor calls, so linking
+// from the static library always brings them along
+void* operator new(size_t unSize) { return AllocateOrThrow(unSize, AVR_RETURN_ADDRESS()); }
+void* operator new[](size_t unSize) { return AllocateOrThrow(unSize, AVR_RETURN_ADDRESS()); }
+void* operator new(size_t unSize, const std::nothrow_t&) noexcept { return AllocateNoThrow(unSize, AVR_RETURN_ADDRESS()); }
+void* operator new[](size_t unSize, const std::nothrow_t&) noexcept { return AllocateNoThrow(unSize, AVR_RETURN_ADDRESS()); }
+void operator delete(void* pBlock) noexcept { Release(pBlock); }
+void operator delete[](void* pBlock) noexcept { Release(pBlock); }
+void operator delete(void* pBlock, const std::nothrow_t&) noexcept { Release(pBlock); }
+void operator delete[](void* pBlock, const std::nothrow_t&) noexcept { Release(pBlock); }
+void operator delete(void* pBlock, size_t) noexcept { Release(pBlock); }
+void operator delete[](void* pBlock, size_t) noexcept { Release(pBlock); }
+
+#endif
+
+//-----------------------------------------------------------------------------
+bool AllocationTracker::BIsEnabled()
+{
+#ifdef AVR_TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void AllocationTracker::GetTotals(SiteStats &totals)
+{
+	totals = SiteStats();
+#ifdef AVR_TRACK_ALLOCATIONS
+	for(uint32_t unSlot = 0; unSlot < k_unSiteSlots; unSlot++)
+	{
+		totals.nLiveBytes += s_rSites[unSlot].nLiveBytes.load(std::memory_order_relaxed);
+		totals.nLiveBlocks += s_rSites[unSlot].nLiveBlocks.load(std::memory_order_relaxed);
+		totals.ulAllocations += s_rSites[unSlot].ulAllocations.load(std::memory_order_relaxed);
+	}
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void AllocationTracker::GetSites(SiteStats* pSites)
+{
+	for(uint32_t unSlot = 0; unSlot < k_unSiteSlots; unSlot++)
+	{
+		pSites[unSlot] = SiteStats();
+#ifdef AVR_TRACK_ALLOCATIONS
+		pSites[unSlot].ulSite = s_rSites[unSlot].ulSite.load(std::memory_order_relaxed);
+		pSites[unSlot].nLiveBytes = s_rSites[unSlot].nLiveBytes.load(std::memory_order_relaxed);
+		pSites[unSlot].nLiveBlocks = s_rSites[unSlot].nLiveBlocks.load(std::memory_order_relaxed);
+		pSites[unSlot].ulAllocations = s_rSites[unSlot].ulAllocations.load(std::memory_order_relaxed);
+#endif
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Goes through dladdr where there is one. The demangler allocates with
+// malloc, so describing a site never shows up as a site itself.
+//-----------------------------------------------------------------------------
+void AllocationTracker::DescribeSite(uintptr_t ulSite, char* pchBuffer, size_t unBytes)
+{
+	if(unBytes == 0) return;
+	if(ulSite == 0)
+	{
+		snprintf(pchBuffer, unBytes, "(other sites)");
+		return;
+	}
+
+#ifndef _WIN32
+	Dl_info info;
+	if(!dladdr((void*)ulSite, &info)) info.dli_fname = nullptr;
+	if(info.dli_fname && info.dli_sname)
+	{
+		int nStatus = 0;
+		char* pchDemangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &nStatus);
+		const char* pchName = (nStatus == 0 && pchDemangled) ? pchDemangled : info.dli_sname;
+		snprintf(pchBuffer, unBytes, "%s+0x%" PRIxPTR, pchName, ulSite - (uintptr_t)info.dli_saddr);
+		std::free(pchDemangled);
+		return;
+	}
+	if(info.dli_fname)
+	{
+		const char* pchFile = info.dli_fname;
+		for(const char* pch = info.dli_fname; *pch; pch++)
+		{
+			if(*pch == '/') pchFile = pch + 1;
+		}
+		snprintf(pchBuffer, unBytes, "%s+0x%" PRIxPTR, pchFile, ulSite - (uintptr_t)info.dli_fbase);
+		return;
+	}
+#endif
+	snprintf(pchBuffer, unBytes, "0x%" PRIxPTR, ulSite);
+}
@@ -0,0 +1,53 @@
+#ifndef ALLOCATIONTRACKER_HPP
+#define ALLOCATIONTRACKER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "avrConfig.h"
+
+//-----------------------------------------------------------------------------
+// Live heap bytes and blocks by call site. The global operator new and
+// delete are replaced; each block carries a small header naming the site
+// that asked for it, so a delete is charged back to the same site wherever
+// it happens.
+//
+// A site is the return address of operator new, the code that called new.
+// For containers that is usually the container code inlined into its user.
+// Sites go into a fixed table the first time they allocate and keep their
+// slot for the rest of the run, so two snapshots compare slot by slot. Once
+// the table is full, new sites are counted together in the last slot.
+//
+// malloc, calloc and what libraries allocate for themselves outside
+// operator new are not seen.
+//
+// Built with -DAVR_TRACK_ALLOCATIONS=ON only, otherwise the standard
+// operators are left alone and everything here reports nothing.
+//-----------------------------------------------------------------------------
+class AllocationTracker {
+
+public:
+
+	static const uint32_t k_unMaxSites = 4096;
+	// the slots a snapshot fills, the last one is every site that didn't fit
+	static const uint32_t k_unSiteSlots = k_unMaxSites + 1;
+
+	struct SiteStats
+	{
+		uintptr_t ulSite = 0;			// 0 for an empty slot
+		int64_t nLiveBytes = 0;
+		int64_t nLiveBlocks = 0;
+		uint64_t ulAllocations = 0;		// since the start
+	};
+
+	static bool BIsEnabled();
+
+	// everything live, ulSite is 0
+	static void GetTotals(SiteStats &totals);
+	// any thread, fills k_unSiteSlots entries, reads while the counters move
+	static void GetSites(SiteStats* pSites);
+	// symbol and offset where the platform can tell, the address otherwise
+	static void DescribeSite(uintptr_t ulSite, char* pchBuffer, size_t unBytes);
+};
+
+#endif
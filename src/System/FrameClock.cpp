@@ -0,0 +1,110 @@
+#include "FrameClock.hpp"
+
+#include <chrono>
+
+namespace
+{
+	// a longer frame (breakpoint, window drag, hitch) is not caught up on
+	const double k_dMaxFrameDelta = 0.25;
+	// and no frame runs more steps than this, whatever is left is dropped
+	const uint32_t k_unMaxStepsPerFrame = 8;
+
+	int64_t SteadyNowNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+FrameClock::FrameClock() :
+	m_nStartNs(-1),
+	m_nFrameNs(0),
+	m_dFrameTime(0.0),
+	m_dFrameDelta(0.0),
+	m_ulFrameIndex(0),
+	m_dStepSeconds(1.0 / 90.0),
+	m_dTimeScale(1.0),
+	m_bPaused(false),
+	m_dSimTime(0.0),
+	m_dSimDelta(0.0),
+	m_dAccumulator(0.0),
+	m_unStepsThisFrame(0),
+	m_bHasNextSimDelta(false),
+	m_dNextSimDelta(0.0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Samples the clock for this frame and adds the frame's simulation time to
+// the step accumulator. Call once, at the top of the frame.
+//-----------------------------------------------------------------------------
+void FrameClock::Tick()
+{
+	int64_t nNowNs = SteadyNowNs();
+	if(m_nStartNs < 0) m_nStartNs = nNowNs;
+	m_nFrameNs = nNowNs;
+
+	double dFrameTime = (double)(nNowNs - m_nStartNs) * 1.0e-9;
+	m_dFrameDelta = m_ulFrameIndex == 0 ? 0.0 : dFrameTime - m_dFrameTime;
+	m_dFrameTime = dFrameTime;
+	m_ulFrameIndex++;
+
+	double dSimDelta;
+	if(m_bHasNextSimDelta){
+		dSimDelta = m_dNextSimDelta;
+		m_bHasNextSimDelta = false;
+	}else{
+		dSimDelta = m_dFrameDelta > k_dMaxFrameDelta ? k_dMaxFrameDelta : m_dFrameDelta;
+		dSimDelta = m_bPaused ? 0.0 : dSimDelta * m_dTimeScale;
+	}
+
+	m_dSimDelta = dSimDelta;
+	m_dAccumulator += dSimDelta;
+	m_unStepsThisFrame = 0;
+}
+
+//-----------------------------------------------------------------------------
+// True while another fixed step is due this frame, each call consumes one.
+// Use as while(clock.BStep()) Simulate(clock.GetStepSeconds());
+//-----------------------------------------------------------------------------
+bool FrameClock::BStep()
+{
+	if(m_dAccumulator < m_dStepSeconds) return false;
+
+	if(m_unStepsThisFrame >= k_unMaxStepsPerFrame){
+		// behind by more than we can catch up on, keep only the interpolation part
+		while(m_dAccumulator >= m_dStepSeconds) m_dAccumulator -= m_dStepSeconds;
+		return false;
+	}
+
+	m_dAccumulator -= m_dStepSeconds;
+	m_dSimTime += m_dStepSeconds;
+	m_unStepsThisFrame++;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void FrameClock::SetFixedStep(double dStepSeconds)
+{
+	if(dStepSeconds < 0.0001) dStepSeconds = 0.0001;
+	m_dStepSeconds = dStepSeconds;
+}
+
+//-----------------------------------------------------------------------------
+void FrameClock::SetTimeScale(double dScale)
+{
+	if(dScale < 0.0) dScale = 0.0;
+	m_dTimeScale = dScale;
+}
+
+//-----------------------------------------------------------------------------
+void FrameClock::SetPaused(bool bPaused)
+{
+	m_bPaused = bPaused;
+}
+
+//-----------------------------------------------------------------------------
+void FrameClock::SetNextSimDelta(double dSimDelta)
+{
+	m_dNextSimDelta = dSimDelta;
+	m_bHasNextSimDelta = true;
+}
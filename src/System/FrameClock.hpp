@@ -0,0 +1,72 @@
+#ifndef FRAMECLOCK_HPP
+#define FRAMECLOCK_HPP
+
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// The one place a frame reads the time. Tick() samples the steady clock once
+// at the top of the frame and everything else in the frame asks the clock
+// instead of reading time itself. GetFrameNs() is on the same steady clock
+// as the audio side timestamps.
+//
+// Simulation advances in fixed steps: after Tick(), BStep() returns true
+// once per step that is due, and GetAlpha() is how far the frame sits
+// between the last two steps, for interpolating what gets drawn.
+//
+// Pausing and time scaling only affect simulation time. A session replay
+// feeds each frame's recorded delta back through SetNextSimDelta(), which
+// reproduces the same steps and the same interpolation regardless of the
+// real frame timing.
+//-----------------------------------------------------------------------------
+class FrameClock {
+
+public:
+
+	FrameClock();
+
+	void Tick();
+	bool BStep();
+
+	void SetFixedStep(double dStepSeconds);
+	void SetTimeScale(double dScale);
+	void SetPaused(bool bPaused);
+
+	double GetTimeScale() const { return m_dTimeScale; }
+	bool BIsPaused() const { return m_bPaused; }
+
+	// real time, unaffected by pause and scale
+	int64_t GetFrameNs() const { return m_nFrameNs; }
+	double GetFrameTime() const { return m_dFrameTime; }
+	double GetFrameDelta() const { return m_dFrameDelta; }
+	uint64_t GetFrameIndex() const { return m_ulFrameIndex; }
+
+	// simulation time
+	double GetStepSeconds() const { return m_dStepSeconds; }
+	double GetSimTime() const { return m_dSimTime; }
+	double GetAlpha() const { return m_dAccumulator / m_dStepSeconds; }
+	double GetSimDelta() const { return m_dSimDelta; }
+
+	// the next Tick() advances the simulation by exactly this, for a session replay
+	void SetNextSimDelta(double dSimDelta);
+
+private:
+
+	int64_t m_nStartNs;
+	int64_t m_nFrameNs;
+	double m_dFrameTime;
+	double m_dFrameDelta;
+	uint64_t m_ulFrameIndex;
+
+	double m_dStepSeconds;
+	double m_dTimeScale;
+	bool m_bPaused;
+	double m_dSimTime;
+	double m_dSimDelta;
+	double m_dAccumulator;
+	uint32_t m_unStepsThisFrame;
+
+	bool m_bHasNextSimDelta;
+	double m_dNextSimDelta;
+};
+
+#endif
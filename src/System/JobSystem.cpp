@@ -0,0 +1,290 @@
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	// index of this thread's queue, external threads use the shared one
+	const uint32_t k_unExternalThread = 0xffffffff;
+	thread_local uint32_t s_unWorkerIndex = k_unExternalThread;
+
+	struct ScratchArena
+	{
+		char* pBase = nullptr;
+		size_t unUsed = 0;
+		bool bWarned = false;
+
+		~ScratchArena() { std::free(pBase); }
+	};
+	thread_local ScratchArena s_scratch;
+}
+
+JobSystem::JobSystem() :
+	m_bQuit(false),
+	m_unQueued(0)
+{
+	// the shared queue exists even with no workers
+	m_vecQueues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+}
+
+JobSystem::~JobSystem()
+{
+	Stop();
+}
+
+//-----------------------------------------------------------------------------
+// Starts the workers. Zero is valid, all work then runs on the threads that
+// submit it.
+//-----------------------------------------------------------------------------
+bool JobSystem::BStart(uint32_t unWorkers, const ThreadPolicy &policy)
+{
+	if(!m_vecWorkers.empty()) return false;
+
+	m_policy = policy;
+	m_bQuit = false;
+
+	std::unique_ptr<JobQueue> pShared = std::move(m_vecQueues.back());
+	m_vecQueues.clear();
+	for(uint32_t i = 0; i < unWorkers; i++) m_vecQueues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+	m_vecQueues.push_back(std::move(pShared));
+
+	for(uint32_t i = 0; i < unWorkers; i++){
+		m_vecWorkers.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+	}
+
+	std::cout << "JobSystem: " << unWorkers << " workers" << std::endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Workers finish what is queued before they exit.
+//-----------------------------------------------------------------------------
+void JobSystem::Stop()
+{
+	if(m_vecWorkers.empty()) return;
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bQuit = true;
+	}
+	m_wakeCondition.notify_all();
+	for(std::thread &worker : m_vecWorkers) worker.join();
+	m_vecWorkers.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Queues on the caller's own queue if it is a worker, otherwise on the
+// shared one. A full queue runs the job right here.
+//-----------------------------------------------------------------------------
+void JobSystem::Submit(const Job &job)
+{
+	if(job.pCounter) job.pCounter->m_nPending.fetch_add(1, std::memory_order_relaxed);
+	Enqueue(job);
+}
+
+//-----------------------------------------------------------------------------
+// The job's counter already includes it.
+//-----------------------------------------------------------------------------
+void JobSystem::Enqueue(const Job &job)
+{
+	if(m_vecWorkers.empty()){
+		Execute(job);
+		return;
+	}
+
+	uint32_t unQueue = s_unWorkerIndex < m_vecWorkers.size() ? s_unWorkerIndex : (uint32_t)m_vecQueues.size() - 1;
+	if(!BPush(*m_vecQueues[unQueue], job)){
+		Execute(job);
+		return;
+	}
+
+	m_unQueued.fetch_add(1, std::memory_order_release);
+	m_wakeCondition.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// Holds the job until every job counted on after has finished.
+//-----------------------------------------------------------------------------
+void JobSystem::SubmitAfter(const Job &job, JobCounter &after)
+{
+	{
+		std::lock_guard<std::mutex> lock(after.m_mutex);
+		if(!after.BIsDone()){
+			if(job.pCounter) job.pCounter->m_nPending.fetch_add(1, std::memory_order_relaxed);
+			after.m_vecContinuations.push_back(job);
+			return;
+		}
+	}
+	Submit(job);
+}
+
+//-----------------------------------------------------------------------------
+// Runs other jobs until the counter reaches zero. The count reaches zero
+// under the counter's lock, taking it once more means the thread that got
+// it there is done with the counter and it can go.
+//-----------------------------------------------------------------------------
+void JobSystem::Wait(JobCounter &counter)
+{
+	while(!counter.BIsDone()){
+		Job job;
+		if(BTakeJob(job)) Execute(job);
+		else std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+//-----------------------------------------------------------------------------
+void JobSystem::WorkerMain(uint32_t unWorker)
+{
+	s_unWorkerIndex = unWorker;
+	std::string strName = "worker " + std::to_string(unWorker);
+	AVR_PROFILE_THREAD(strName.c_str());
+	if(!m_policy.BIsDefault()) BApplyThreadPolicy(strName.c_str(), m_policy);
+
+	for(;;){
+		Job job;
+		if(BTakeJob(job)){
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		if(m_bQuit && m_unQueued.load(std::memory_order_acquire) == 0) return;
+		// the timeout covers a notify that lands between the take and the wait
+		m_wakeCondition.wait_for(lock, std::chrono::milliseconds(1), [this]{
+			return m_bQuit || m_unQueued.load(std::memory_order_acquire) > 0;
+		});
+	}
+}
+
+//-----------------------------------------------------------------------------
+bool JobSystem::BPush(JobQueue &queue, const Job &job)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if(queue.unCount == k_unQueueCapacity) return false;
+	queue.rJobs[(queue.unHead + queue.unCount) % k_unQueueCapacity] = job;
+	queue.unCount++;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+bool JobSystem::BPopBack(JobQueue &queue, Job &job)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if(queue.unCount == 0) return false;
+	queue.unCount--;
+	job = queue.rJobs[(queue.unHead + queue.unCount) % k_unQueueCapacity];
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+bool JobSystem::BPopFront(JobQueue &queue, Job &job)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if(queue.unCount == 0) return false;
+	job = queue.rJobs[queue.unHead];
+	queue.unHead = (queue.unHead + 1) % k_unQueueCapacity;
+	queue.unCount--;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Own queue newest first (still warm in cache), then the shared queue, then
+// the oldest job of every other worker.
+//-----------------------------------------------------------------------------
+bool JobSystem::BTakeJob(Job &job)
+{
+	if(m_unQueued.load(std::memory_order_acquire) == 0) return false;
+
+	uint32_t unQueues = (uint32_t)m_vecQueues.size();
+	uint32_t unShared = unQueues - 1;
+	bool bTaken = false;
+
+	if(s_unWorkerIndex < unShared) bTaken = BPopBack(*m_vecQueues[s_unWorkerIndex], job);
+	if(!bTaken) bTaken = BPopFront(*m_vecQueues[unShared], job);
+
+	uint32_t unStart = s_unWorkerIndex < unShared ? s_unWorkerIndex + 1 : 0;
+	for(uint32_t i = 0; !bTaken && i < unShared; i++){
+		uint32_t unVictim = (unStart + i) % unShared;
+		if(unVictim == s_unWorkerIndex) continue;
+		bTaken = BPopFront(*m_vecQueues[unVictim], job);
+	}
+
+	if(bTaken) m_unQueued.fetch_sub(1, std::memory_order_relaxed);
+	return bTaken;
+}
+
+//-----------------------------------------------------------------------------
+// Scratch taken by the job is handed back when it returns.
+//-----------------------------------------------------------------------------
+void JobSystem::Execute(const Job &job)
+{
+	size_t unScratchMark = s_scratch.unUsed;
+	job.pfnRun(job.pContext, job.unBegin, job.unEnd);
+	s_scratch.unUsed = unScratchMark;
+
+	if(job.pCounter) FinishOne(*job.pCounter);
+}
+
+//-----------------------------------------------------------------------------
+// Releases the jobs held on the counter when the last one finishes. The
+// last job stays counted until its continuations are out, so nothing sees
+// the counter done while it is still being used here.
+//-----------------------------------------------------------------------------
+void JobSystem::FinishOne(JobCounter &counter)
+{
+	int32_t nPending = counter.m_nPending.load(std::memory_order_relaxed);
+	while(nPending > 1){
+		if(counter.m_nPending.compare_exchange_weak(nPending, nPending - 1, std::memory_order_acq_rel)) return;
+	}
+
+	// local, a released job run inline can finish another counter in here
+	std::vector<Job> vecReleased;
+	std::unique_lock<std::mutex> lock(counter.m_mutex);
+	while(!counter.m_vecContinuations.empty()){
+		vecReleased.swap(counter.m_vecContinuations);
+		lock.unlock();
+		// counted when they were held
+		for(const Job &job : vecReleased) Enqueue(job);
+		vecReleased.clear();
+		lock.lock();
+	}
+	// the list keeps its capacity for the next round
+	if(vecReleased.capacity() > counter.m_vecContinuations.capacity()) counter.m_vecContinuations.swap(vecReleased);
+	// under the lock, so SubmitAfter() either lands in the loop above or sees it done
+	counter.m_nPending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+//-----------------------------------------------------------------------------
+// Bump allocation from this thread's arena. Null once the arena is full.
+//-----------------------------------------------------------------------------
+void* JobSystem::AllocScratch(size_t unBytes, size_t unAlign)
+{
+	if(!s_scratch.pBase){
+		s_scratch.pBase = (char*)std::malloc(k_unScratchBytes);
+		if(!s_scratch.pBase) return nullptr;
+	}
+
+	size_t unOffset = (s_scratch.unUsed + unAlign - 1) & ~(unAlign - 1);
+	if(unOffset + unBytes > k_unScratchBytes){
+		if(!s_scratch.bWarned){
+			std::cout << "Warning: job scratch arena exhausted (" << k_unScratchBytes << " bytes)" << std::endl;
+			s_scratch.bWarned = true;
+		}
+		return nullptr;
+	}
+
+	s_scratch.unUsed = unOffset + unBytes;
+	return s_scratch.pBase + unOffset;
+}
+
+//-----------------------------------------------------------------------------
+// Frees everything this thread took from its arena outside of jobs.
+//-----------------------------------------------------------------------------
+void JobSystem::ResetScratch()
+{
+	s_scratch.unUsed = 0;
+}
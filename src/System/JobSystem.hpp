@@ -0,0 +1,180 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ThreadPolicy.hpp"
+
+class JobCounter;
+
+//-----------------------------------------------------------------------------
+// One unit of work: a function over the index range [unBegin, unEnd) of
+// whatever pContext points at. Jobs don't own their context, whoever
+// submits them waits on the counter before it goes away.
+//-----------------------------------------------------------------------------
+struct Job
+{
+	void (*pfnRun)(const void* pContext, uint32_t unBegin, uint32_t unEnd);
+	const void* pContext;
+	uint32_t unBegin;
+	uint32_t unEnd;
+	JobCounter* pCounter;
+};
+
+//-----------------------------------------------------------------------------
+// Counts the jobs of a group still to finish. Jobs submitted to run after a
+// counter are held on it and released when it reaches zero.
+//
+// A counter can go away once JobSystem::Wait() on it has returned, not as
+// soon as BIsDone() is true.
+//-----------------------------------------------------------------------------
+class JobCounter {
+
+public:
+
+	JobCounter() : m_nPending(0) {}
+	bool BIsDone() const { return m_nPending.load(std::memory_order_acquire) == 0; }
+
+private:
+
+	friend class JobSystem;
+
+	std::atomic<int32_t> m_nPending;
+	std::mutex m_mutex;
+	std::vector<Job> m_vecContinuations;
+};
+
+//-----------------------------------------------------------------------------
+// Work stealing scheduler for per-frame work. Each worker takes from the
+// back of its own queue and steals from the front of the others; threads
+// that aren't workers (render, simulation) submit to a shared queue and
+// run jobs themselves while they wait, so a wait never idles a core.
+//
+// Every thread has a scratch arena. Memory from AllocScratch inside a job
+// is released when the job returns; outside a job it lives until the
+// thread calls ResetScratch, normally once per frame.
+//
+// With no workers everything runs inline on the calling thread.
+//-----------------------------------------------------------------------------
+class JobSystem {
+
+public:
+
+	static const uint32_t k_unQueueCapacity = 1024;
+	static const size_t k_unScratchBytes = 256 * 1024;
+
+	JobSystem();
+	~JobSystem();
+
+	bool BStart(uint32_t unWorkers, const ThreadPolicy &policy);
+	void Stop();
+	uint32_t GetWorkerCount() const { return (uint32_t)m_vecWorkers.size(); }
+
+	void Submit(const Job &job);
+	void SubmitAfter(const Job &job, JobCounter &after);
+	void Wait(JobCounter &counter);
+
+	// fn(unBegin, unEnd) over [0, unCount) in chunks of at least unGrain,
+	// returns when all of it has run
+	template <typename F>
+	void ParallelFor(uint32_t unCount, uint32_t unGrain, const F &fn);
+
+	// fn() as one job counted on counter, fn has to outlive the wait
+	template <typename F>
+	void Run(const F &fn, JobCounter &counter);
+
+	static void* AllocScratch(size_t unBytes, size_t unAlign = 16);
+	static void ResetScratch();
+
+private:
+
+	struct JobQueue
+	{
+		std::mutex mutex;
+		Job rJobs[k_unQueueCapacity];
+		uint32_t unHead = 0;
+		uint32_t unCount = 0;
+	};
+
+	void WorkerMain(uint32_t unWorker);
+	void Enqueue(const Job &job);
+	bool BPush(JobQueue &queue, const Job &job);
+	bool BPopBack(JobQueue &queue, Job &job);
+	bool BPopFront(JobQueue &queue, Job &job);
+	bool BTakeJob(Job &job);
+	void Execute(const Job &job);
+	void FinishOne(JobCounter &counter);
+
+	template <typename F>
+	static void RunRange(const void* pContext, uint32_t unBegin, uint32_t unEnd)
+	{
+		(*(const F*)pContext)(unBegin, unEnd);
+	}
+
+	template <typename F>
+	static void RunOnce(const void* pContext, uint32_t, uint32_t)
+	{
+		(*(const F*)pContext)();
+	}
+
+	std::vector<std::thread> m_vecWorkers;
+	// one per worker, then the shared queue for everyone else
+	std::vector<std::unique_ptr<JobQueue>> m_vecQueues;
+	ThreadPolicy m_policy;
+
+	std::atomic<bool> m_bQuit;
+	std::atomic<uint32_t> m_unQueued;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeCondition;
+};
+
+//-----------------------------------------------------------------------------
+template <typename F>
+void JobSystem::ParallelFor(uint32_t unCount, uint32_t unGrain, const F &fn)
+{
+	if(unGrain == 0) unGrain = 1;
+	uint32_t unThreads = GetWorkerCount() + 1;
+	if(unCount <= unGrain || unThreads == 1){
+		fn(0, unCount);
+		return;
+	}
+
+	uint32_t unChunk = (unCount + unThreads - 1) / unThreads;
+	if(unChunk < unGrain) unChunk = unGrain;
+
+	JobCounter counter;
+	for(uint32_t unBegin = unChunk; unBegin < unCount; unBegin += unChunk){
+		Job job;
+		job.pfnRun = &RunRange<F>;
+		job.pContext = &fn;
+		job.unBegin = unBegin;
+		job.unEnd = unBegin + unChunk < unCount ? unBegin + unChunk : unCount;
+		job.pCounter = &counter;
+		Submit(job);
+	}
+	// the first chunk runs here
+	fn(0, unChunk);
+	Wait(counter);
+}
+
+//-----------------------------------------------------------------------------
+template <typename F>
+void JobSystem::Run(const F &fn, JobCounter &counter)
+{
+	Job job;
+	job.pfnRun = &RunOnce<F>;
+	job.pContext = &fn;
+	job.unBegin = 0;
+	job.unEnd = 1;
+	job.pCounter = &counter;
+	Submit(job);
+}
+
+#endif
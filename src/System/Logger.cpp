@@ -0,0 +1,285 @@
+#include "Logger.hpp"
+#include "Profiler.hpp"
+#include "ThreadRingPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// how long the writer sleeps between batches
+	const std::chrono::milliseconds k_writeInterval(20);
+
+	struct LogMessage
+	{
+		int64_t nTimeNs;
+		ELogLevel eLevel;
+		uint32_t unThreadId;
+		uint32_t unLength;
+		char rchText[Logger::k_unMessageBytes];
+	};
+
+	// one producer, the owning thread, and one consumer, whoever holds the drain lock
+	struct LogRing
+	{
+		LogMessage rMessages[Logger::k_unMessagesPerThread];
+		std::atomic<uint64_t> ulHead;
+		std::atomic<uint64_t> ulTail;
+		std::atomic<bool> bInUse;
+		uint32_t unThreadId;
+	};
+
+	// never destroyed, threads may still log while the statics go
+	ThreadRingPool<LogRing> &s_rings = *new ThreadRingPool<LogRing>();
+
+	std::atomic<int> s_nMinLevel(LogLevel_Info);
+	std::atomic<uint64_t> s_ulDropped(0);
+	std::atomic<bool> s_bRunning(false);
+	const int64_t s_nStartNs = Profiler::NowNs();
+
+	// the drain lock also guards the file and the batch buffers
+	std::mutex s_drainMutex;
+	FILE* s_pFile = nullptr;
+	std::vector<LogMessage> s_vecBatch;
+	std::string s_strFile;
+	std::string s_strOut;
+	std::string s_strErr;
+
+	std::mutex s_wakeMutex;
+	std::condition_variable s_wake;
+	bool s_bStopRequested = false;
+
+	const char* LevelTag(ELogLevel eLevel)
+	{
+		switch(eLevel){
+			case LogLevel_Debug: return "D";
+			case LogLevel_Info: return "I";
+			case LogLevel_Warning: return "W";
+			case LogLevel_Error: return "E";
+		}
+		return "?";
+	}
+
+	// a log still running when the statics go is stopped before the rings and
+	// the file it writes, so no path out of main leaves the writer joinable
+	struct LogWriter
+	{
+		std::thread thread;
+		~LogWriter() { Logger::Stop(); }
+	};
+	LogWriter s_writer;
+
+	//-----------------------------------------------------------------------------
+	// Takes everything out of the rings, orders it by time across threads and
+	// writes it with one call per destination.
+	//-----------------------------------------------------------------------------
+	void DrainAll()
+	{
+		std::lock_guard<std::mutex> drainLock(s_drainMutex);
+
+		s_vecBatch.clear();
+		s_rings.ForEach([](LogRing &ring){
+			uint64_t ulTail = ring.ulTail.load(std::memory_order_relaxed);
+			uint64_t ulHead = ring.ulHead.load(std::memory_order_acquire);
+			for(uint64_t ul = ulTail; ul < ulHead; ul++){
+				s_vecBatch.push_back(ring.rMessages[ul % Logger::k_unMessagesPerThread]);
+			}
+			ring.ulTail.store(ulHead, std::memory_order_release);
+		});
+
+		uint64_t ulDropped = s_ulDropped.exchange(0);
+		if(s_vecBatch.empty() && ulDropped == 0) return;
+
+		std::stable_sort(s_vecBatch.begin(), s_vecBatch.end(), [](const LogMessage &a, const LogMessage &b){
+			return a.nTimeNs < b.nTimeNs;
+		});
+
+		s_strFile.clear();
+		s_strOut.clear();
+		s_strErr.clear();
+		char rchPrefix[48];
+		for(const LogMessage &message : s_vecBatch){
+			std::snprintf(rchPrefix, sizeof(rchPrefix), "[%10.3f %s %2u] ", (double)(message.nTimeNs - s_nStartNs) * 1.0e-9, LevelTag(message.eLevel), message.unThreadId);
+			s_strFile += rchPrefix;
+			s_strFile.append(message.rchText, message.unLength);
+			if(message.unLength == 0 || message.rchText[message.unLength - 1] != '\n') s_strFile += '\n';
+
+			std::string &strConsole = message.eLevel >= LogLevel_Warning ? s_strErr : s_strOut;
+			strConsole.append(message.rchText, message.unLength);
+		}
+		if(ulDropped > 0){
+			std::snprintf(rchPrefix, sizeof(rchPrefix), "Logger: %llu messages dropped\n", (unsigned long long)ulDropped);
+			s_strFile += rchPrefix;
+			s_strErr += rchPrefix;
+		}
+
+		if(s_pFile && !s_strFile.empty()){
+			std::fwrite(s_strFile.data(), 1, s_strFile.size(), s_pFile);
+			std::fflush(s_pFile);
+		}
+		if(!s_strOut.empty()){
+			std::fwrite(s_strOut.data(), 1, s_strOut.size(), stdout);
+			std::fflush(stdout);
+		}
+		if(!s_strErr.empty()){
+			std::fwrite(s_strErr.data(), 1, s_strErr.size(), stderr);
+		}
+	}
+
+	void WriterLoop()
+	{
+		AVR_PROFILE_THREAD("log writer");
+		std::unique_lock<std::mutex> lock(s_wakeMutex);
+		while(!s_bStopRequested){
+			s_wake.wait_for(lock, k_writeInterval);
+			lock.unlock();
+			{
+				AVR_PROFILE_SCOPE("log drain");
+				DrainAll();
+			}
+			lock.lock();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Opens the file, truncating it, and starts the writer. Without a file the
+// log still goes to the console.
+//-----------------------------------------------------------------------------
+bool Logger::BStart(const char* pchFilePath)
+{
+	if(s_bRunning) return true;
+
+	{
+		std::lock_guard<std::mutex> drainLock(s_drainMutex);
+		s_pFile = pchFilePath ? std::fopen(pchFilePath, "w") : nullptr;
+		s_vecBatch.reserve(k_unMessagesPerThread * 4);
+	}
+	if(pchFilePath && !s_pFile){
+		Write(LogLevel_Error, "Error: could not open %s for the log\n", pchFilePath);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(s_wakeMutex);
+		s_bStopRequested = false;
+	}
+	s_writer.thread = std::thread(WriterLoop);
+	s_bRunning = true;
+	return s_pFile != nullptr || !pchFilePath;
+}
+
+//-----------------------------------------------------------------------------
+void Logger::Stop()
+{
+	if(!s_bRunning) return;
+	s_bRunning = false;
+
+	{
+		std::lock_guard<std::mutex> lock(s_wakeMutex);
+		s_bStopRequested = true;
+	}
+	s_wake.notify_one();
+	s_writer.thread.join();
+
+	DrainAll();
+	std::lock_guard<std::mutex> drainLock(s_drainMutex);
+	if(s_pFile) std::fclose(s_pFile);
+	s_pFile = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void Logger::ReserveThreads(uint32_t unThreads)
+{
+	s_rings.Reserve(unThreads);
+}
+
+//-----------------------------------------------------------------------------
+void Logger::SetMinLevel(ELogLevel eLevel)
+{
+	s_nMinLevel = eLevel;
+}
+
+//-----------------------------------------------------------------------------
+bool Logger::BIsEnabled(ELogLevel eLevel)
+{
+	return (int)eLevel >= s_nMinLevel.load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+bool Logger::BParseLevel(const char* pchLevel, ELogLevel &eLevel)
+{
+	if(!std::strcmp(pchLevel, "debug")) eLevel = LogLevel_Debug;
+	else if(!std::strcmp(pchLevel, "info")) eLevel = LogLevel_Info;
+	else if(!std::strcmp(pchLevel, "warning")) eLevel = LogLevel_Warning;
+	else if(!std::strcmp(pchLevel, "error")) eLevel = LogLevel_Error;
+	else return false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void Logger::Write(ELogLevel eLevel, const char* pchFormat, ...)
+{
+	va_list args;
+	va_start(args, pchFormat);
+	WriteV(eLevel, pchFormat, args);
+	va_end(args);
+}
+
+//-----------------------------------------------------------------------------
+void Logger::WriteV(ELogLevel eLevel, const char* pchFormat, va_list args)
+{
+	if(!BIsEnabled(eLevel)) return;
+
+	LogRing* pRing = s_rings.GetThreadRing();
+	uint64_t ulHead = pRing->ulHead.load(std::memory_order_relaxed);
+	uint64_t ulQueued = ulHead - pRing->ulTail.load(std::memory_order_acquire);
+	if(ulQueued >= k_unMessagesPerThread){
+		s_ulDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	LogMessage &message = pRing->rMessages[ulHead % k_unMessagesPerThread];
+	message.nTimeNs = Profiler::NowNs();
+	message.eLevel = eLevel;
+	message.unThreadId = pRing->unThreadId;
+	int nLength = std::vsnprintf(message.rchText, k_unMessageBytes, pchFormat, args);
+	message.unLength = nLength < 0 ? 0 : std::min((uint32_t)nLength, k_unMessageBytes - 1);
+	pRing->ulHead.store(ulHead + 1, std::memory_order_release);
+
+	if(!s_bRunning.load(std::memory_order_acquire)) DrainAll();
+	// a burst, get the writer going before the ring fills rather than drop
+	else if(ulQueued + 1 == k_unMessagesPerThread / 2) s_wake.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+void Logger::Flush()
+{
+	DrainAll();
+}
+
+//-----------------------------------------------------------------------------
+// The window restarts on the first message a second or more after the last
+// one started; only the thread that restarts it collects the count.
+//-----------------------------------------------------------------------------
+bool LogRateLimiter::BAllow(uint32_t &unSuppressed)
+{
+	unSuppressed = 0;
+	int64_t nNowNs = Profiler::NowNs();
+	int64_t nWindowNs = m_nWindowNs.load(std::memory_order_relaxed);
+	if(nNowNs - nWindowNs >= 1000000000LL && m_nWindowNs.compare_exchange_strong(nWindowNs, nNowNs)){
+		m_unInWindow = 0;
+		unSuppressed = m_unSuppressed.exchange(0);
+	}
+
+	if(m_unInWindow.fetch_add(1) < m_unPerSecond) return true;
+	m_unSuppressed++;
+	return false;
+}
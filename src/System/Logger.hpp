@@ -0,0 +1,87 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+
+enum ELogLevel
+{
+	LogLevel_Debug = 0,
+	LogLevel_Info,
+	LogLevel_Warning,
+	LogLevel_Error
+};
+
+//-----------------------------------------------------------------------------
+// Asynchronous log. Write() formats printf style into a ring owned by the
+// calling thread and returns; a background thread drains every ring a few
+// times a second and hands the whole batch to the file and the console in
+// one write each. Producers never take a lock or touch a file, so logging
+// from the render thread, the audio thread or a driver callback costs a
+// format and a copy.
+//
+// A full ring drops the message and counts it, the drops are reported with
+// the next batch. Messages longer than a slot are cut short.
+//
+// Before BStart() and after Stop() messages are written straight away on
+// the calling thread.
+//-----------------------------------------------------------------------------
+class Logger {
+
+public:
+
+	static const uint32_t k_unMessagesPerThread = 256;
+	static const uint32_t k_unMessageBytes = 480;
+
+	static bool BStart(const char* pchFilePath);
+	static void Stop();
+
+	// rings made ahead for threads about to start, so their first message
+	// doesn't allocate
+	static void ReserveThreads(uint32_t unThreads);
+
+	static void SetMinLevel(ELogLevel eLevel);
+	static bool BIsEnabled(ELogLevel eLevel);
+	static bool BParseLevel(const char* pchLevel, ELogLevel &eLevel);
+
+	static void Write(ELogLevel eLevel, const char* pchFormat, ...);
+	static void WriteV(ELogLevel eLevel, const char* pchFormat, va_list args);
+
+	// blocks until everything logged so far has been written
+	static void Flush();
+};
+
+//-----------------------------------------------------------------------------
+// At most a number of messages a second from one call site, for anything
+// that can repeat every frame. What it holds back is counted and reported
+// with the next message it lets through.
+//-----------------------------------------------------------------------------
+class LogRateLimiter {
+
+public:
+
+	explicit LogRateLimiter(uint32_t unPerSecond) : m_unPerSecond(unPerSecond), m_nWindowNs(0), m_unInWindow(0), m_unSuppressed(0) {}
+
+	// returns how many were suppressed before this one through unSuppressed
+	bool BAllow(uint32_t &unSuppressed);
+
+private:
+
+	uint32_t m_unPerSecond;
+	std::atomic<int64_t> m_nWindowNs;
+	std::atomic<uint32_t> m_unInWindow;
+	std::atomic<uint32_t> m_unSuppressed;
+};
+
+#define AVR_LOG_RATE_LIMITED(perSecond, level, ...) \
+	do { \
+		static LogRateLimiter s_logLimiter(perSecond); \
+		uint32_t unLogSuppressed = 0; \
+		if(Logger::BIsEnabled(level) && s_logLimiter.BAllow(unLogSuppressed)){ \
+			if(unLogSuppressed > 0) Logger::Write(level, "(%u similar messages suppressed)\n", unLogSuppressed); \
+			Logger::Write(level, __VA_ARGS__); \
+		} \
+	} while(0)
+
+#endif
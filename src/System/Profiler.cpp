@@ -0,0 +1,151 @@
+#include "Profiler.hpp"
+#include "ThreadRingPool.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct ProfileEvent
+	{
+		const char* pchName;
+		int64_t nBeginNs;
+		int64_t nEndNs;
+	};
+
+	// one writer, the owning thread; dumps read it from anywhere
+	struct ThreadRing
+	{
+		ProfileEvent rEvents[Profiler::k_unEventsPerThread];
+		std::atomic<uint64_t> ulWritten;
+		std::atomic<bool> bInUse;
+		uint32_t unThreadId;
+		std::string strName;
+		std::mutex nameMutex;
+	};
+
+	// never destroyed, threads may still record while the statics go
+	ThreadRingPool<ThreadRing> &s_rings = *new ThreadRingPool<ThreadRing>();
+
+	// JSON strings, the names are ours but thread names might not be
+	void WriteEscaped(std::ofstream& file, const char* pch)
+	{
+		for(; *pch; pch++){
+			if(*pch == '"' || *pch == '\\') file << '\\';
+			if((unsigned char)*pch >= 0x20) file << *pch;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+bool Profiler::BIsEnabled()
+{
+#ifdef AVR_ENABLE_PROFILER
+	return true;
+#else
+	return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+int64_t Profiler::NowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//-----------------------------------------------------------------------------
+void Profiler::ReserveThreads(uint32_t unThreads)
+{
+#ifdef AVR_ENABLE_PROFILER
+	s_rings.Reserve(unThreads);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void Profiler::SetThreadName(const char* pchName)
+{
+	ThreadRing* pRing = s_rings.GetThreadRing();
+	std::lock_guard<std::mutex> lock(pRing->nameMutex);
+	pRing->strName = pchName;
+}
+
+//-----------------------------------------------------------------------------
+void Profiler::Record(const char* pchName, int64_t nBeginNs, int64_t nEndNs)
+{
+	ThreadRing* pRing = s_rings.GetThreadRing();
+	uint64_t ulIndex = pRing->ulWritten.load(std::memory_order_relaxed);
+	ProfileEvent &event = pRing->rEvents[ulIndex % k_unEventsPerThread];
+	event.pchName = pchName;
+	event.nBeginNs = nBeginNs;
+	event.nEndNs = nEndNs;
+	pRing->ulWritten.store(ulIndex + 1, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Copies each ring out first, then checks how far the owner wrote in the
+// meantime; anything it may have overwritten during the copy is dropped.
+//-----------------------------------------------------------------------------
+bool Profiler::BDump(const std::string& strPath)
+{
+	std::ofstream file(strPath);
+	if(!file){
+		std::cout << "Error: could not open " << strPath << " for the profile" << std::endl;
+		return false;
+	}
+
+	std::vector<ProfileEvent> vecEvents;
+	vecEvents.reserve(k_unEventsPerThread);
+	size_t unTotal = 0;
+	bool bFirst = true;
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[\n";
+
+	std::vector<ThreadRing*> vecRings;
+	s_rings.GetRings(vecRings);
+	for(ThreadRing* pRing : vecRings){
+
+		uint64_t ulEnd = pRing->ulWritten.load(std::memory_order_acquire);
+		uint64_t ulBegin = ulEnd > k_unEventsPerThread ? ulEnd - k_unEventsPerThread : 0;
+		vecEvents.clear();
+		for(uint64_t ul = ulBegin; ul < ulEnd; ul++) vecEvents.push_back(pRing->rEvents[ul % k_unEventsPerThread]);
+
+		uint64_t ulNow = pRing->ulWritten.load(std::memory_order_acquire);
+		uint64_t ulValidFrom = ulNow > k_unEventsPerThread ? ulNow - k_unEventsPerThread : 0;
+		// one more for the slot the owner may be halfway through
+		if(ulNow > ulEnd) ulValidFrom++;
+		size_t unSkip = ulValidFrom > ulBegin ? (size_t)(ulValidFrom - ulBegin) : 0;
+
+		std::string strName;
+		{
+			std::lock_guard<std::mutex> nameLock(pRing->nameMutex);
+			strName = pRing->strName.empty() ? "thread " + std::to_string(pRing->unThreadId) : pRing->strName;
+		}
+		if(!bFirst) file << ",\n";
+		bFirst = false;
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pRing->unThreadId << ",\"args\":{\"name\":\"";
+		WriteEscaped(file, strName.c_str());
+		file << "\"}}";
+
+		for(size_t i = unSkip; i < vecEvents.size(); i++){
+			const ProfileEvent &event = vecEvents[i];
+			file << ",\n{\"name\":\"";
+			WriteEscaped(file, event.pchName);
+			file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << pRing->unThreadId
+				<< ",\"ts\":" << (double)event.nBeginNs * 1.0e-3
+				<< ",\"dur\":" << (double)(event.nEndNs - event.nBeginNs) * 1.0e-3 << "}";
+		}
+		if(vecEvents.size() > unSkip) unTotal += vecEvents.size() - unSkip;
+	}
+
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	file.close();
+
+	std::cout << "Profiler: wrote " << unTotal << " events to " << strPath << std::endl;
+	return true;
+}
@@ -0,0 +1,70 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "avrConfig.h"
+
+//-----------------------------------------------------------------------------
+// Scoped CPU timing markers. AVR_PROFILE_SCOPE("name") times the rest of the
+// enclosing scope and writes it to a ring of events owned by the calling
+// thread, so recording never takes a lock. Names must be string literals,
+// only the pointer is kept.
+//
+// The rings are dumped as Chrome trace_event JSON (chrome://tracing or
+// Perfetto) on demand or when the render loop stalls. The dump reads while
+// the threads keep writing and drops whatever was overwritten meanwhile. It
+// only holds the ring pool's lock to list the rings, so a thread taking its
+// first ring never waits for the file.
+//
+// Built with -DAVR_ENABLE_PROFILER=ON only, otherwise the macros compile to
+// nothing.
+//-----------------------------------------------------------------------------
+class Profiler {
+
+public:
+
+	static const uint32_t k_unEventsPerThread = 16384;
+
+	static bool BIsEnabled();
+	static void SetThreadName(const char* pchName);
+	static void Record(const char* pchName, int64_t nBeginNs, int64_t nEndNs);
+	static int64_t NowNs();
+	// rings made ahead for threads about to start, which then take one on
+	// their first marker without allocating
+	static void ReserveThreads(uint32_t unThreads);
+
+	// any thread, writes everything still in the rings
+	static bool BDump(const std::string& strPath);
+};
+
+//-----------------------------------------------------------------------------
+class ProfileScope {
+
+public:
+
+	explicit ProfileScope(const char* pchName) : m_pchName(pchName), m_nBeginNs(Profiler::NowNs()) {}
+	~ProfileScope() { Profiler::Record(m_pchName, m_nBeginNs, Profiler::NowNs()); }
+
+private:
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	const char* m_pchName;
+	int64_t m_nBeginNs;
+};
+
+#ifdef AVR_ENABLE_PROFILER
+#define AVR_PROFILE_CONCAT_INNER(a, b) a##b
+#define AVR_PROFILE_CONCAT(a, b) AVR_PROFILE_CONCAT_INNER(a, b)
+#define AVR_PROFILE_SCOPE(name) ProfileScope AVR_PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define AVR_PROFILE_THREAD(name) Profiler::SetThreadName(name)
+#else
+#define AVR_PROFILE_SCOPE(name) ((void)0)
+#define AVR_PROFILE_THREAD(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef SESSIONLOG_HPP
+#define SESSIONLOG_HPP
+
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Layout of a session log, written by SessionRecorder and read back by
+// SessionReplayer. A file header, then records one after the other, each
+// a SessionRecordHeader and its payload padded to 8 bytes, so a mapped
+// file can be read in place. Records carry the frame they belong to and
+// are only ever appended; the records of one frame need not be adjacent.
+//
+// Payloads are plain structs of fixed size types in the byte order of the
+// machine that wrote them, a log is read back on the same platform.
+//-----------------------------------------------------------------------------
+
+static const char k_rchSessionLogMagic[8] = { 'A', 'V', 'R', 'S', 'E', 'S', 'S', '1' };
+static const uint32_t k_unSessionLogVersion = 1;
+
+// header flags
+static const uint32_t k_unSessionDevMode = 1u << 0;
+
+enum ESessionRecord
+{
+	SessionRecord_Frame = 1,		// SessionFrame, one per frame
+	SessionRecord_HmdPose,			// SessionPose, as WaitGetPoses returned it
+	SessionRecord_Input,			// SessionInput, the actions HandleInput resolved
+	SessionRecord_DevCamera,		// SessionDevCamera, the keyboard camera without a headset
+	SessionRecord_ChannelsIn,		// float per source parameter handed to the orchestra
+	SessionRecord_ChannelsOut,		// float per source level read back from it
+	SessionRecord_ScoreEvent		// SessionScoreEvent
+};
+
+struct SessionFileHeader
+{
+	char rchMagic[8];
+	uint32_t unVersion;
+	uint32_t unFlags;
+	int64_t nStartNs;
+};
+
+struct SessionRecordHeader
+{
+	uint32_t unType;
+	uint32_t unSize;				// payload bytes, without the padding
+	uint64_t ulFrame;
+};
+
+struct SessionFrame
+{
+	int64_t nFrameNs;				// steady clock at the top of the frame
+	double dSimDelta;				// what the frame clock advanced the simulation by
+};
+
+struct SessionPose
+{
+	uint32_t unValid;
+	float rfPose[12];				// 3x4 device to tracking, row major
+};
+
+struct SessionInput
+{
+	static const uint32_t k_unRotate3D = 1u << 0;
+	static const uint32_t k_unAnalogValid = 1u << 1;
+	// then valid and hidden for each hand
+	static uint32_t HandValid(uint32_t unHand) { return 1u << (2 + unHand * 2); }
+	static uint32_t HandHidden(uint32_t unHand) { return 1u << (3 + unHand * 2); }
+
+	uint32_t unFlags;
+	float rfAnalog[2];
+	float rfHandPose[2][12];
+};
+
+struct SessionDevCamera
+{
+	float rfPos[3];
+	float rfFront[3];
+};
+
+struct SessionScoreEvent
+{
+	static const uint32_t k_unMaxFields = 16;
+
+	int64_t nSample;
+	uint32_t unFields;
+	uint32_t unPadding;
+	double rdFields[k_unMaxFields];	// p1 on, only unFields of them are written
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "SessionRecorder.hpp"
+#include "Profiler.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// written out at least this often, sooner once this much is waiting
+	const std::chrono::milliseconds k_writeInterval(250);
+	const size_t k_unWakeBytes = 256 * 1024;
+	// an hour at 90 Hz is a few hundred MB, the buffer never needs to grow mid frame
+	const size_t k_unReserveBytes = 1024 * 1024;
+
+	uint32_t PaddedSize(uint32_t unSize) { return (unSize + 7u) & ~7u; }
+}
+
+//-----------------------------------------------------------------------------
+SessionRecorder::SessionRecorder() :
+	m_pFile(nullptr),
+	m_ulFrame(0),
+	m_bStopping(false),
+	m_ulBytesWritten(0),
+	m_bWriteFailed(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+SessionRecorder::~SessionRecorder()
+{
+	Stop();
+}
+
+//-----------------------------------------------------------------------------
+bool SessionRecorder::BStart(const std::string &strPath, uint32_t unFlags)
+{
+	if(m_pFile) return false;
+
+	m_pFile = std::fopen(strPath.c_str(), "wb");
+	if(!m_pFile){
+		std::cout << "Error: could not open " << strPath << " to record the session" << std::endl;
+		return false;
+	}
+	m_strPath = strPath;
+
+	SessionFileHeader header;
+	std::memcpy(header.rchMagic, k_rchSessionLogMagic, sizeof(header.rchMagic));
+	header.unVersion = k_unSessionLogVersion;
+	header.unFlags = unFlags;
+	header.nStartNs = Profiler::NowNs();
+	if(std::fwrite(&header, sizeof(header), 1, m_pFile) != 1){
+		std::cout << "Error: could not write the session header to " << strPath << std::endl;
+		std::fclose(m_pFile);
+		m_pFile = nullptr;
+		return false;
+	}
+	m_ulBytesWritten = sizeof(header);
+
+	m_vecPending.reserve(k_unReserveBytes);
+	m_vecWriting.reserve(k_unReserveBytes);
+	m_ulFrame.store(0, std::memory_order_relaxed);
+	m_bStopping = false;
+	m_bWriteFailed = false;
+	m_writer = std::thread(&SessionRecorder::WriterLoop, this);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Writes whatever is still buffered and closes the file.
+//-----------------------------------------------------------------------------
+void SessionRecorder::Stop()
+{
+	if(!m_pFile) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_one();
+	m_writer.join();
+
+	std::fclose(m_pFile);
+	m_pFile = nullptr;
+
+	std::cout << "SessionRecorder: " << GetFrame() << " frames, " << m_ulBytesWritten / 1024 << " KB in " << m_strPath << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Any thread. A record is never split between two writes, so a file cut
+// short by a crash still ends on a whole record or a partial last one.
+//-----------------------------------------------------------------------------
+void SessionRecorder::Record(ESessionRecord eType, uint64_t ulFrame, const void *pData, uint32_t unSize)
+{
+	if(!m_pFile) return;
+
+	SessionRecordHeader header;
+	header.unType = (uint32_t)eType;
+	header.unSize = unSize;
+	header.ulFrame = ulFrame;
+
+	bool bWake;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t unOffset = m_vecPending.size();
+		m_vecPending.resize(unOffset + sizeof(header) + PaddedSize(unSize), 0);
+		std::memcpy(&m_vecPending[unOffset], &header, sizeof(header));
+		std::memcpy(&m_vecPending[unOffset + sizeof(header)], pData, unSize);
+		bWake = m_vecPending.size() >= k_unWakeBytes;
+	}
+	if(bWake) m_wake.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+void SessionRecorder::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for(;;){
+		m_wake.wait_for(lock, k_writeInterval, [this]{ return m_bStopping || m_vecPending.size() >= k_unWakeBytes; });
+		bool bStopping = m_bStopping;
+		m_vecWriting.swap(m_vecPending);
+		lock.unlock();
+
+		if(!m_vecWriting.empty() && !m_bWriteFailed){
+			if(std::fwrite(m_vecWriting.data(), 1, m_vecWriting.size(), m_pFile) != m_vecWriting.size()){
+				std::cout << "Error: writing " << m_strPath << " failed, the rest of the session is not recorded" << std::endl;
+				m_bWriteFailed = true;
+			}
+			std::fflush(m_pFile);
+			m_ulBytesWritten += m_vecWriting.size();
+		}
+		m_vecWriting.clear();
+
+		lock.lock();
+		if(bStopping && m_vecPending.empty()) return;
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef SESSIONRECORDER_HPP
+#define SESSIONRECORDER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SessionLog.hpp"
+
+//-----------------------------------------------------------------------------
+// Appends everything that drives a session to a SessionLog file, for
+// SessionReplayer to feed back later. Record() copies the record into a
+// buffer under a short lock and returns, a background thread writes the
+// buffer out a few times a second, so no frame waits on the disk.
+//
+// BeginFrame() is called once at the very top of the main loop and moves
+// the frame every following record is stamped with. Records made for an
+// earlier frame, from a thread running behind, pass the frame explicitly.
+//-----------------------------------------------------------------------------
+class SessionRecorder {
+
+public:
+
+	SessionRecorder();
+	~SessionRecorder();
+
+	bool BStart(const std::string &strPath, uint32_t unFlags);
+	void Stop();
+	bool BIsRecording() const { return m_pFile != nullptr; }
+
+	void BeginFrame() { m_ulFrame.fetch_add(1, std::memory_order_relaxed); }
+	uint64_t GetFrame() const { return m_ulFrame.load(std::memory_order_relaxed); }
+
+	void Record(ESessionRecord eType, uint64_t ulFrame, const void *pData, uint32_t unSize);
+	void Record(ESessionRecord eType, const void *pData, uint32_t unSize) { Record(eType, GetFrame(), pData, unSize); }
+
+	template<typename T>
+	void Record(ESessionRecord eType, const T &data) { Record(eType, GetFrame(), &data, (uint32_t)sizeof(T)); }
+
+private:
+
+	void WriterLoop();
+
+	std::FILE *m_pFile;
+	std::string m_strPath;
+	std::atomic<uint64_t> m_ulFrame;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::vector<uint8_t> m_vecPending;
+	std::vector<uint8_t> m_vecWriting;
+	bool m_bStopping;
+	std::thread m_writer;
+
+	uint64_t m_ulBytesWritten;
+	bool m_bWriteFailed;
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "SessionReplayer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const uint64_t k_ulNoFrame = std::numeric_limits<uint64_t>::max();
+
+	size_t PaddedSize(uint32_t unSize) { return (unSize + 7u) & ~7u; }
+}
+
+//-----------------------------------------------------------------------------
+SessionReplayer::SessionReplayer() :
+	m_pData(nullptr),
+	m_unBytes(0),
+	m_ulFrameCount(0),
+	m_ulFrame(0),
+	m_bRealTime(true),
+	m_nFirstFrameNs(0),
+	m_ulDivergences(0),
+	m_ulFirstDivergedFrame(k_ulNoFrame),
+	m_pchFirstDivergence(nullptr)
+{
+	std::memset(&m_header, 0, sizeof(m_header));
+}
+
+//-----------------------------------------------------------------------------
+SessionReplayer::~SessionReplayer()
+{
+	Close();
+}
+
+//-----------------------------------------------------------------------------
+// Maps the log and builds the frame index. A record cut short at the end,
+// from a session that didn't exit cleanly, is left out.
+//-----------------------------------------------------------------------------
+bool SessionReplayer::BOpen(const std::string &strPath)
+{
+	Close();
+	m_strPath = strPath;
+
+#ifdef _WIN32
+	std::ifstream file(strPath, std::ios::binary | std::ios::ate);
+	if(!file){
+		std::cout << "Error: could not open session " << strPath << std::endl;
+		return false;
+	}
+	m_vecFile.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)m_vecFile.data(), (std::streamsize)m_vecFile.size());
+	m_pData = m_vecFile.data();
+	m_unBytes = m_vecFile.size();
+#else
+	int nFd = open(strPath.c_str(), O_RDONLY);
+	if(nFd < 0){
+		std::cout << "Error: could not open session " << strPath << std::endl;
+		return false;
+	}
+	struct stat fileStat;
+	if(fstat(nFd, &fileStat) == 0 && fileStat.st_size > 0){
+		void *pMapped = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, nFd, 0);
+		if(pMapped != MAP_FAILED){
+			m_pData = (const uint8_t*)pMapped;
+			m_unBytes = (size_t)fileStat.st_size;
+		}
+	}
+	close(nFd);
+#endif
+
+	if(m_unBytes < sizeof(SessionFileHeader)){
+		std::cout << "Error: session " << strPath << " is empty" << std::endl;
+		Close();
+		return false;
+	}
+	std::memcpy(&m_header, m_pData, sizeof(m_header));
+	if(std::memcmp(m_header.rchMagic, k_rchSessionLogMagic, sizeof(m_header.rchMagic)) != 0 || m_header.unVersion != k_unSessionLogVersion){
+		std::cout << "Error: " << strPath << " is not a session log of this version" << std::endl;
+		Close();
+		return false;
+	}
+
+	size_t unOffset = sizeof(SessionFileHeader);
+	while(unOffset + sizeof(SessionRecordHeader) <= m_unBytes){
+		const SessionRecordHeader *pHeader = (const SessionRecordHeader*)(m_pData + unOffset);
+		size_t unNext = unOffset + sizeof(SessionRecordHeader) + PaddedSize(pHeader->unSize);
+		if(unNext > m_unBytes) break;
+		m_vecIndex.push_back({ pHeader->ulFrame, unOffset });
+		if(pHeader->unType == SessionRecord_Frame && pHeader->ulFrame > m_ulFrameCount) m_ulFrameCount = pHeader->ulFrame;
+		unOffset = unNext;
+	}
+	if(unOffset != m_unBytes){
+		std::cout << "Warning: session " << strPath << " ends in a partial record, it is ignored" << std::endl;
+	}
+	std::stable_sort(m_vecIndex.begin(), m_vecIndex.end(), [](const IndexEntry &a, const IndexEntry &b){ return a.ulFrame < b.ulFrame; });
+
+	if(m_ulFrameCount == 0){
+		std::cout << "Error: session " << strPath << " has no frames" << std::endl;
+		Close();
+		return false;
+	}
+
+	m_ulFrame = 0;
+	m_nFirstFrameNs = 0;
+	m_ulDivergences.store(0);
+	m_ulFirstDivergedFrame.store(k_ulNoFrame);
+	m_pchFirstDivergence.store(nullptr);
+
+	std::cout << "SessionReplayer: " << m_ulFrameCount << " frames, " << m_vecIndex.size() << " records from " << strPath << std::endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void SessionReplayer::Close()
+{
+#ifdef _WIN32
+	m_vecFile.clear();
+	m_vecFile.shrink_to_fit();
+#else
+	if(m_pData) munmap((void*)m_pData, m_unBytes);
+#endif
+	m_pData = nullptr;
+	m_unBytes = 0;
+	m_vecIndex.clear();
+	m_ulFrameCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Main loop, before anything else in the frame.
+//-----------------------------------------------------------------------------
+bool SessionReplayer::BBeginFrame()
+{
+	if(m_ulFrame >= m_ulFrameCount) return false;
+	m_ulFrame++;
+
+	SessionFrame frame;
+	if(!m_bRealTime || !BRead(m_ulFrame, SessionRecord_Frame, frame)) return true;
+
+	if(m_ulFrame == 1){
+		m_nFirstFrameNs = frame.nFrameNs;
+		m_replayStart = std::chrono::steady_clock::now();
+		return true;
+	}
+	std::this_thread::sleep_until(m_replayStart + std::chrono::nanoseconds(frame.nFrameNs - m_nFirstFrameNs));
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+const void* SessionReplayer::FindRecord(uint64_t ulFrame, ESessionRecord eType, uint32_t &unSize) const
+{
+	auto it = std::lower_bound(m_vecIndex.begin(), m_vecIndex.end(), ulFrame, [](const IndexEntry &entry, uint64_t ulValue){ return entry.ulFrame < ulValue; });
+	for(; it != m_vecIndex.end() && it->ulFrame == ulFrame; ++it){
+		const SessionRecordHeader *pHeader = (const SessionRecordHeader*)(m_pData + it->unOffset);
+		if(pHeader->unType != (uint32_t)eType) continue;
+		unSize = pHeader->unSize;
+		return pHeader + 1;
+	}
+	return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Copies a record out if there is one of exactly that size.
+//-----------------------------------------------------------------------------
+bool SessionReplayer::BRead(uint64_t ulFrame, ESessionRecord eType, void *pData, uint32_t unSize) const
+{
+	uint32_t unRecordSize = 0;
+	const void *pRecord = FindRecord(ulFrame, eType, unRecordSize);
+	if(!pRecord || unRecordSize != unSize) return false;
+	std::memcpy(pData, pRecord, unSize);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t SessionReplayer::CountRecords(uint64_t ulFrame, ESessionRecord eType) const
+{
+	uint32_t unCount = 0;
+	auto it = std::lower_bound(m_vecIndex.begin(), m_vecIndex.end(), ulFrame, [](const IndexEntry &entry, uint64_t ulValue){ return entry.ulFrame < ulValue; });
+	for(; it != m_vecIndex.end() && it->ulFrame == ulFrame; ++it){
+		if(((const SessionRecordHeader*)(m_pData + it->unOffset))->unType == (uint32_t)eType) unCount++;
+	}
+	return unCount;
+}
+
+//-----------------------------------------------------------------------------
+void SessionReplayer::ReportDivergence(uint64_t ulFrame, const char *pchWhat)
+{
+	m_ulDivergences.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t ulFirst = m_ulFirstDivergedFrame.load(std::memory_order_relaxed);
+	while(ulFrame < ulFirst){
+		if(m_ulFirstDivergedFrame.compare_exchange_weak(ulFirst, ulFrame)){
+			m_pchFirstDivergence.store(pchWhat);
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+bool SessionReplayer::BReport() const
+{
+	uint64_t ulDivergences = m_ulDivergences.load();
+	std::cout << "SessionReplayer: played " << m_ulFrame << " of " << m_ulFrameCount << " frames of " << m_strPath;
+	if(ulDivergences == 0){
+		std::cout << ", reproduced exactly" << std::endl;
+		return true;
+	}
+	std::cout << ", " << ulDivergences << " values diverged, first " << m_pchFirstDivergence.load() << " in frame " << m_ulFirstDivergedFrame.load() << std::endl;
+	return false;
+}
@@ -0,0 +1,84 @@
+#ifndef SESSIONREPLAYER_HPP
+#define SESSIONREPLAYER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SessionLog.hpp"
+
+//-----------------------------------------------------------------------------
+// Plays a session recorded by SessionRecorder back through the same points
+// that recorded it. The log is mapped and indexed by frame once at open,
+// after which every lookup is read only and safe from any thread.
+//
+// BBeginFrame() takes the place of SessionRecorder::BeginFrame(). In real
+// time it holds each frame back to the spacing it was recorded with,
+// otherwise frames run as fast as the rest of the loop allows. The places
+// that feed recorded values back in also compare what they would have
+// produced themselves against what was recorded, and report a frame whose
+// values differ, so a replay doubles as a check that the session is still
+// reproduced bit for bit.
+//-----------------------------------------------------------------------------
+class SessionReplayer {
+
+public:
+
+	SessionReplayer();
+	~SessionReplayer();
+
+	bool BOpen(const std::string &strPath);
+	void Close();
+	void SetRealTime(bool bRealTime) { m_bRealTime = bRealTime; }
+
+	uint32_t GetFlags() const { return m_header.unFlags; }
+	uint64_t GetFrameCount() const { return m_ulFrameCount; }
+
+	// false once the last recorded frame has been played
+	bool BBeginFrame();
+	uint64_t GetFrame() const { return m_ulFrame; }
+
+	// payload of the first record of a type in a frame, nullptr without one
+	const void* FindRecord(uint64_t ulFrame, ESessionRecord eType, uint32_t &unSize) const;
+	bool BRead(uint64_t ulFrame, ESessionRecord eType, void *pData, uint32_t unSize) const;
+	uint32_t CountRecords(uint64_t ulFrame, ESessionRecord eType) const;
+
+	template<typename T>
+	bool BRead(uint64_t ulFrame, ESessionRecord eType, T &data) const { return BRead(ulFrame, eType, &data, (uint32_t)sizeof(T)); }
+
+	// any thread, pchWhat must outlive the replayer
+	void ReportDivergence(uint64_t ulFrame, const char *pchWhat);
+	// prints the summary, false if anything diverged
+	bool BReport() const;
+
+private:
+
+	struct IndexEntry
+	{
+		uint64_t ulFrame;
+		size_t unOffset;
+	};
+
+	const uint8_t *m_pData;
+	size_t m_unBytes;
+#ifdef _WIN32
+	std::vector<uint8_t> m_vecFile;
+#endif
+	std::string m_strPath;
+	SessionFileHeader m_header;
+	std::vector<IndexEntry> m_vecIndex;		// ordered by frame, then by position in the file
+	uint64_t m_ulFrameCount;
+
+	uint64_t m_ulFrame;
+	bool m_bRealTime;
+	int64_t m_nFirstFrameNs;
+	std::chrono::steady_clock::time_point m_replayStart;
+
+	std::atomic<uint64_t> m_ulDivergences;
+	std::atomic<uint64_t> m_ulFirstDivergedFrame;
+	std::atomic<const char*> m_pchFirstDivergence;
+};
+
+#endif
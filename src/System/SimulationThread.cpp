@@ -0,0 +1,69 @@
+#include "SimulationThread.hpp"
+#include "Profiler.hpp"
+
+SimulationThread::SimulationThread() :
+	m_bKicked(false),
+	m_bQuit(false)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+	Stop();
+}
+
+//-----------------------------------------------------------------------------
+bool SimulationThread::BStart(std::function<void()> fnFrame, const ThreadPolicy &policy)
+{
+	if(m_thread.joinable()) return false;
+
+	m_fnFrame = fnFrame;
+	m_policy = policy;
+	m_bKicked = false;
+	m_bQuit = false;
+	m_thread = std::thread(&SimulationThread::ThreadMain, this);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Render thread, once per frame.
+//-----------------------------------------------------------------------------
+void SimulationThread::Kick()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bKicked = true;
+	}
+	m_condition.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// Lets a running frame finish, then joins.
+//-----------------------------------------------------------------------------
+void SimulationThread::Stop()
+{
+	if(!m_thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bQuit = true;
+	}
+	m_condition.notify_one();
+	m_thread.join();
+}
+
+//-----------------------------------------------------------------------------
+void SimulationThread::ThreadMain()
+{
+	AVR_PROFILE_THREAD("simulation");
+	if(!m_policy.BIsDefault()) BApplyThreadPolicy("simulation", m_policy);
+
+	for(;;){
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]{ return m_bKicked || m_bQuit; });
+			if(m_bQuit) return;
+			m_bKicked = false;
+		}
+		m_fnFrame();
+	}
+}
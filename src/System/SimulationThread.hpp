@@ -0,0 +1,45 @@
+#ifndef SIMULATIONTHREAD_HPP
+#define SIMULATIONTHREAD_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "ThreadPolicy.hpp"
+
+//-----------------------------------------------------------------------------
+// Runs one frame of simulation off the render thread each time it is
+// kicked. Kicks that arrive while a frame is running are folded into one
+// more run, so a slow simulation skips frames rather than queueing them.
+// Results go back through whatever the frame function publishes to,
+// normally a TripleBuffer.
+//-----------------------------------------------------------------------------
+class SimulationThread {
+
+public:
+
+	SimulationThread();
+	~SimulationThread();
+
+	bool BStart(std::function<void()> fnFrame, const ThreadPolicy &policy);
+	void Kick();
+	void Stop();
+
+	bool BIsRunning() const { return m_thread.joinable(); }
+
+private:
+
+	void ThreadMain();
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_bKicked;
+	bool m_bQuit;
+
+	std::function<void()> m_fnFrame;
+	ThreadPolicy m_policy;
+};
+
+#endif
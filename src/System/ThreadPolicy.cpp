@@ -0,0 +1,279 @@
+#include "ThreadPolicy.hpp"
+
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#define strcasecmp _stricmp
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <strings.h>
+#endif
+
+namespace
+{
+	std::mutex s_reportMutex;
+	std::vector<ThreadPolicyReport> s_vecReports;
+	bool s_bMemoryLockRequested = false;
+	bool s_bMemoryLockGranted = false;
+
+	const char* SchedPolicyName(ThreadPolicy::ESchedPolicy ePolicy)
+	{
+		switch(ePolicy)
+		{
+		case ThreadPolicy::Sched_Fifo:       return "fifo";
+		case ThreadPolicy::Sched_RoundRobin: return "rr";
+		default:                             return "default";
+		}
+	}
+
+	//-------------------------------------------------------------------------
+	// Touches the requested number of bytes of stack so the pages are
+	// resident before the thread starts real-time work. Only useful once
+	// the process memory has been locked.
+	//-------------------------------------------------------------------------
+	void PrefaultStack(size_t unBytes)
+	{
+		const size_t unChunk = 4096;
+		volatile unsigned char rubPage[unChunk];
+		for(size_t i = 0; i < unChunk; i += 64) rubPage[i] = 0;
+		if(unBytes > unChunk) PrefaultStack(unBytes - unChunk);
+		// read back after the call so the frame can't be reused as a tail call
+		(void)rubPage[0];
+	}
+
+	bool BApplySchedPolicy(const ThreadPolicy& policy, ThreadPolicyReport& report)
+	{
+		if(policy.eSchedPolicy == ThreadPolicy::Sched_Default) return true;
+
+#ifdef _WIN32
+		// Windows has no SCHED_FIFO/RR, time critical is the closest class
+		if(SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+		{
+			report.bSchedGranted = true;
+			report.nGrantedPriority = GetThreadPriority(GetCurrentThread());
+		}
+#else
+		int nPolicy = policy.eSchedPolicy == ThreadPolicy::Sched_Fifo ? SCHED_FIFO : SCHED_RR;
+		sched_param param;
+		param.sched_priority = policy.nPriority;
+		int nMin = sched_get_priority_min(nPolicy);
+		int nMax = sched_get_priority_max(nPolicy);
+		if(param.sched_priority < nMin) param.sched_priority = nMin;
+		if(param.sched_priority > nMax) param.sched_priority = nMax;
+
+		if(pthread_setschedparam(pthread_self(), nPolicy, &param) == 0)
+		{
+			int nGrantedPolicy = 0;
+			sched_param granted;
+			if(pthread_getschedparam(pthread_self(), &nGrantedPolicy, &granted) == 0 && nGrantedPolicy == nPolicy)
+			{
+				report.bSchedGranted = true;
+				report.nGrantedPriority = granted.sched_priority;
+			}
+		}
+#endif
+		return report.bSchedGranted;
+	}
+
+	bool BApplyAffinity(const ThreadPolicy& policy, ThreadPolicyReport& report)
+	{
+		if(policy.ulCpuMask == 0) return true;
+
+#ifdef _WIN32
+		if(SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)policy.ulCpuMask) != 0)
+		{
+			report.bAffinityGranted = true;
+			report.ulGrantedCpuMask = policy.ulCpuMask;
+		}
+#elif __linux__
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		for(int i = 0; i < 64; i++)
+		{
+			if(policy.ulCpuMask & (1ull << i)) CPU_SET(i, &cpuSet);
+		}
+		if(pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0)
+		{
+			CPU_ZERO(&cpuSet);
+			if(pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0)
+			{
+				for(int i = 0; i < 64; i++)
+				{
+					if(CPU_ISSET(i, &cpuSet)) report.ulGrantedCpuMask |= (1ull << i);
+				}
+				report.bAffinityGranted = report.ulGrantedCpuMask == policy.ulCpuMask;
+			}
+		}
+#endif
+		// macOS only offers affinity tags as a scheduler hint, so nothing is granted there
+		return report.bAffinityGranted;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Applies the policy to the calling thread and records what was granted for
+// the startup report. Returns false if any part of the request was refused.
+//-----------------------------------------------------------------------------
+bool BApplyThreadPolicy(const char* pchThreadName, const ThreadPolicy& policy)
+{
+	ThreadPolicyReport report;
+	report.strThreadName = pchThreadName;
+	report.requested = policy;
+
+	bool bSched = BApplySchedPolicy(policy, report);
+	bool bAffinity = BApplyAffinity(policy, report);
+
+	if(policy.unPrefaultStackBytes > 0)
+	{
+		PrefaultStack(policy.unPrefaultStackBytes);
+		report.bStackPrefaulted = true;
+	}
+
+	// perf threads restart with every orchestra swap, keep only the latest
+	// report for each thread name so the list doesn't grow
+	std::lock_guard<std::mutex> lock(s_reportMutex);
+	for(ThreadPolicyReport& existing : s_vecReports)
+	{
+		if(existing.strThreadName == report.strThreadName)
+		{
+			existing = report;
+			return bSched && bAffinity;
+		}
+	}
+	s_vecReports.push_back(report);
+
+	return bSched && bAffinity;
+}
+
+//-----------------------------------------------------------------------------
+// Locks all current and future pages of the process into RAM so the audio
+// thread never takes a page fault.
+//-----------------------------------------------------------------------------
+bool BLockProcessMemory()
+{
+	std::lock_guard<std::mutex> lock(s_reportMutex);
+	s_bMemoryLockRequested = true;
+
+#ifdef _WIN32
+	s_bMemoryLockGranted = false;
+#else
+	s_bMemoryLockGranted = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#endif
+
+	return s_bMemoryLockGranted;
+}
+
+//-----------------------------------------------------------------------------
+// Accepts "fifo", "rr" or "default".
+//-----------------------------------------------------------------------------
+bool BParseSchedPolicy(const char* pchName, ThreadPolicy::ESchedPolicy& ePolicy)
+{
+	if(!strcasecmp(pchName, "fifo"))
+	{
+		ePolicy = ThreadPolicy::Sched_Fifo;
+	}
+	else if(!strcasecmp(pchName, "rr"))
+	{
+		ePolicy = ThreadPolicy::Sched_RoundRobin;
+	}
+	else if(!strcasecmp(pchName, "default"))
+	{
+		ePolicy = ThreadPolicy::Sched_Default;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Parses a cpu mask given either as hex ("0x0c") or as a list of cores and
+// ranges ("2,3" or "4-7"). Returns 0 if the string could not be parsed.
+//-----------------------------------------------------------------------------
+uint64_t ParseCpuMask(const char* pchMask)
+{
+	if(!pchMask) return 0;
+
+	if(pchMask[0] == '0' && (pchMask[1] == 'x' || pchMask[1] == 'X'))
+	{
+		return strtoull(pchMask, nullptr, 16);
+	}
+
+	uint64_t ulMask = 0;
+	const char* pch = pchMask;
+	while(*pch)
+	{
+		char* pchEnd;
+		long nFirst = strtol(pch, &pchEnd, 10);
+		if(pchEnd == pch) return 0;
+		long nLast = nFirst;
+		pch = pchEnd;
+		if(*pch == '-')
+		{
+			pch++;
+			nLast = strtol(pch, &pchEnd, 10);
+			if(pchEnd == pch) return 0;
+			pch = pchEnd;
+		}
+		for(long i = nFirst; i <= nLast && i < 64; i++)
+		{
+			if(i >= 0) ulMask |= (1ull << i);
+		}
+		if(*pch == ',') pch++;
+	}
+	return ulMask;
+}
+
+//-----------------------------------------------------------------------------
+// Prints the policies requested for each thread next to what was granted.
+//-----------------------------------------------------------------------------
+void PrintThreadPolicyReport()
+{
+	std::lock_guard<std::mutex> lock(s_reportMutex);
+
+	std::cout << "Thread policy report:" << std::endl;
+	if(s_bMemoryLockRequested)
+	{
+		std::cout << "  mlockall: " << (s_bMemoryLockGranted ? "granted" : "refused") << std::endl;
+	}
+
+	for(const ThreadPolicyReport& report : s_vecReports)
+	{
+		const ThreadPolicy& req = report.requested;
+		std::cout << "  " << report.strThreadName << ": sched " << SchedPolicyName(req.eSchedPolicy);
+		if(req.eSchedPolicy != ThreadPolicy::Sched_Default)
+		{
+			std::cout << " " << req.nPriority << " -> ";
+			if(report.bSchedGranted)
+				std::cout << "granted (priority " << report.nGrantedPriority << ")";
+			else
+				std::cout << "refused";
+		}
+
+		if(req.ulCpuMask != 0)
+		{
+			std::cout << ", cpus 0x" << std::hex << req.ulCpuMask << " -> ";
+			if(report.bAffinityGranted)
+				std::cout << "granted";
+			else if(report.ulGrantedCpuMask != 0)
+				std::cout << "partial 0x" << report.ulGrantedCpuMask;
+			else
+				std::cout << "refused";
+			std::cout << std::dec;
+		}
+
+		if(report.bStackPrefaulted)
+		{
+			std::cout << ", stack prefaulted " << req.unPrefaultStackBytes << " bytes";
+		}
+		std::cout << std::endl;
+	}
+}
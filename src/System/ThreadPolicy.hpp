@@ -0,0 +1,48 @@
+#ifndef THREADPOLICY_HPP
+#define THREADPOLICY_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+//-----------------------------------------------------------------------------
+// Scheduling, affinity and stack prefault settings for one class of thread
+// (audio, render or worker). A zero cpu mask leaves the affinity untouched
+// and Sched_Default leaves the scheduling class untouched.
+//-----------------------------------------------------------------------------
+struct ThreadPolicy
+{
+	enum ESchedPolicy
+	{
+		Sched_Default = 0,
+		Sched_Fifo,
+		Sched_RoundRobin
+	};
+
+	ESchedPolicy eSchedPolicy = Sched_Default;
+	int nPriority = 0;
+	uint64_t ulCpuMask = 0;
+	size_t unPrefaultStackBytes = 0;
+
+	bool BIsDefault() const { return eSchedPolicy == Sched_Default && ulCpuMask == 0 && unPrefaultStackBytes == 0; }
+};
+
+// What was asked for and what the OS actually granted for one thread.
+struct ThreadPolicyReport
+{
+	std::string strThreadName;
+	ThreadPolicy requested;
+	bool bSchedGranted = false;
+	int nGrantedPriority = 0;
+	bool bAffinityGranted = false;
+	uint64_t ulGrantedCpuMask = 0;
+	bool bStackPrefaulted = false;
+};
+
+bool BApplyThreadPolicy(const char* pchThreadName, const ThreadPolicy& policy);
+bool BLockProcessMemory();
+bool BParseSchedPolicy(const char* pchName, ThreadPolicy::ESchedPolicy& ePolicy);
+uint64_t ParseCpuMask(const char* pchMask);
+void PrintThreadPolicyReport();
+
+#endif
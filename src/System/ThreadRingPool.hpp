@@ -0,0 +1,98 @@
+#ifndef THREADRINGPOOL_HPP
+#define THREADRINGPOOL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// One ring per thread for recording without a lock, as the logger and the
+// profiler do. A thread takes a ring the first time it asks for one and
+// hands it back when it exits. Rings are never freed: the next thread that
+// starts reuses one (perf threads come and go with every orchestra swap),
+// and a reader can keep using a ring pointer after its thread has gone.
+//
+// T is value initialised and needs std::atomic<bool> bInUse and uint32_t
+// unThreadId, which the pool sets. There is one pool per T, and as threads
+// can outlive the statics it is best never destroyed.
+//-----------------------------------------------------------------------------
+template <typename T>
+class ThreadRingPool {
+
+public:
+
+	// the calling thread's ring, taken from the pool on first use
+	T* GetThreadRing()
+	{
+		static thread_local Handle s_handle;
+		if(!s_handle.pRing) s_handle.pRing = Acquire();
+		return s_handle.pRing;
+	}
+
+	// makes sure unCount rings are free, so threads started later take one
+	// without allocating
+	void Reserve(uint32_t unCount)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint32_t unFree = 0;
+		for(std::unique_ptr<T> &pRing : m_vecRings){
+			if(!pRing->bInUse.load()) unFree++;
+		}
+		for(; unFree < unCount; unFree++){
+			m_vecRings.push_back(CreateRing());
+			m_vecRings.back()->bInUse = false;
+		}
+	}
+
+	// every ring handed out so far, the pointers stay valid
+	void GetRings(std::vector<T*> &vecRings)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		vecRings.clear();
+		for(std::unique_ptr<T> &pRing : m_vecRings) vecRings.push_back(pRing.get());
+	}
+
+	// with the pool locked, for readers that only copy
+	template <typename F>
+	void ForEach(F visit)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(std::unique_ptr<T> &pRing : m_vecRings) visit(*pRing);
+	}
+
+private:
+
+	struct Handle
+	{
+		T* pRing = nullptr;
+		// whatever is left in the ring is still read
+		~Handle() { if(pRing) pRing->bInUse = false; }
+	};
+
+	T* Acquire()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(std::unique_ptr<T> &pRing : m_vecRings){
+			bool bFree = false;
+			if(pRing->bInUse.compare_exchange_strong(bFree, true)) return pRing.get();
+		}
+		m_vecRings.push_back(CreateRing());
+		return m_vecRings.back().get();
+	}
+
+	// with the pool locked
+	std::unique_ptr<T> CreateRing()
+	{
+		std::unique_ptr<T> pRing(new T());
+		pRing->bInUse = true;
+		pRing->unThreadId = (uint32_t)m_vecRings.size() + 1;
+		return pRing;
+	}
+
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<T>> m_vecRings;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Hands whole values from one producer thread to one consumer thread without
+// either side waiting. The producer fills GetWriteBuffer() and calls
+// Publish(); the consumer calls BAcquire() and reads GetReadBuffer(), which
+// is the newest published value. Values published in between are dropped.
+//-----------------------------------------------------------------------------
+template <typename T>
+class TripleBuffer {
+
+public:
+
+	TripleBuffer() :
+		m_unWrite(0),
+		m_unRead(1),
+		m_unMiddle(2)
+	{
+	}
+
+	// producer
+	T& GetWriteBuffer() { return m_rBuffers[m_unWrite]; }
+
+	void Publish()
+	{
+		uint8_t unOld = m_unMiddle.exchange((uint8_t)(m_unWrite | k_unFresh), std::memory_order_acq_rel);
+		m_unWrite = unOld & k_unIndexMask;
+	}
+
+	// consumer, true if there was something new
+	bool BAcquire()
+	{
+		if(!(m_unMiddle.load(std::memory_order_relaxed) & k_unFresh)) return false;
+		uint8_t unOld = m_unMiddle.exchange(m_unRead, std::memory_order_acq_rel);
+		m_unRead = unOld & k_unIndexMask;
+		return true;
+	}
+
+	const T& GetReadBuffer() const { return m_rBuffers[m_unRead]; }
+
+private:
+
+	static const uint8_t k_unIndexMask = 0x3;
+	static const uint8_t k_unFresh = 0x4;
+
+	T m_rBuffers[3];
+	uint8_t m_unWrite;
+	uint8_t m_unRead;
+	// index of the spare buffer, with k_unFresh set if it holds a value the
+	// consumer hasn't seen
+	std::atomic<uint8_t> m_unMiddle;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "JobSystem.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Hammers the job system with the patterns the frame uses: ParallelFor over
+// more items than one grain, so the work really splits across the workers,
+// with the counter on the stack of the waiting thread, and continuations
+// held on one counter and released into another, including a release that
+// runs inline and releases another counter. Best run under
+// ThreadSanitizer or AddressSanitizer, a counter used after its wait
+// returned shows up there before it shows up as a wrong sum.
+//-----------------------------------------------------------------------------
+namespace
+{
+	const uint32_t k_unRounds = 20000;
+	const uint32_t k_unItems = 64;
+	const uint32_t k_unGrain = 4;
+	const uint32_t k_unContinuations = 8;
+
+	bool BParallelForCoversEveryItem(JobSystem &jobSystem)
+	{
+		std::vector<std::atomic<uint32_t>> vecHits(k_unItems);
+		for(uint32_t unRound = 0; unRound < k_unRounds; unRound++){
+			for(auto &hits : vecHits) hits.store(0, std::memory_order_relaxed);
+
+			auto visit = [&vecHits](uint32_t unBegin, uint32_t unEnd){
+				for(uint32_t i = unBegin; i < unEnd; i++) vecHits[i].fetch_add(1, std::memory_order_relaxed);
+			};
+			jobSystem.ParallelFor(k_unItems, k_unGrain, visit);
+
+			for(uint32_t i = 0; i < k_unItems; i++){
+				if(vecHits[i].load(std::memory_order_relaxed) != 1){
+					std::cout << "Error: ParallelFor round " << unRound << " ran item " << i << " " << vecHits[i].load() << " times" << std::endl;
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// a ParallelFor inside each chunk of another, so workers wait on
+	// counters of their own while others finish them
+	bool BNestedParallelFor(JobSystem &jobSystem)
+	{
+		for(uint32_t unRound = 0; unRound < k_unRounds / 10; unRound++){
+			std::atomic<uint32_t> unTotal(0);
+			auto inner = [&unTotal](uint32_t unBegin, uint32_t unEnd){
+				unTotal.fetch_add(unEnd - unBegin, std::memory_order_relaxed);
+			};
+			auto outer = [&jobSystem, &inner](uint32_t unBegin, uint32_t unEnd){
+				for(uint32_t i = unBegin; i < unEnd; i++) jobSystem.ParallelFor(k_unItems, k_unGrain, inner);
+			};
+			jobSystem.ParallelFor(k_unItems / 4, 1, outer);
+
+			if(unTotal.load() != k_unItems * (k_unItems / 4)){
+				std::cout << "Error: nested ParallelFor round " << unRound << " covered " << unTotal.load() << " items" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct ChainContext
+	{
+		std::atomic<uint32_t> unFirst;
+		std::atomic<uint32_t> unSecond;
+		std::atomic<bool> bOutOfOrder;
+	};
+
+	void RunFirst(const void* pContext, uint32_t, uint32_t)
+	{
+		ChainContext* pChain = (ChainContext*)pContext;
+		pChain->unFirst.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void RunSecond(const void* pContext, uint32_t, uint32_t)
+	{
+		ChainContext* pChain = (ChainContext*)pContext;
+		if(pChain->unFirst.load(std::memory_order_relaxed) != k_unContinuations) pChain->bOutOfOrder = true;
+		pChain->unSecond.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// continuations held on one stack counter, counted on another
+	bool BContinuationsRunAfter(JobSystem &jobSystem)
+	{
+		for(uint32_t unRound = 0; unRound < k_unRounds / 10; unRound++){
+			ChainContext chain;
+			chain.unFirst = 0;
+			chain.unSecond = 0;
+			chain.bOutOfOrder = false;
+
+			JobCounter first;
+			JobCounter second;
+			for(uint32_t i = 0; i < k_unContinuations; i++){
+				Job job = { &RunFirst, &chain, 0, 1, &first };
+				jobSystem.Submit(job);
+			}
+			for(uint32_t i = 0; i < k_unContinuations; i++){
+				Job job = { &RunSecond, &chain, 0, 1, &second };
+				jobSystem.SubmitAfter(job, first);
+			}
+			jobSystem.Wait(first);
+			jobSystem.Wait(second);
+
+			if(chain.bOutOfOrder || chain.unSecond.load() != k_unContinuations){
+				std::cout << "Error: continuation round " << unRound << " ran " << chain.unSecond.load() << " of " << k_unContinuations << (chain.bOutOfOrder ? ", some too early" : "") << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct ReleaseContext
+	{
+		JobSystem* pJobSystem;
+		JobCounter* pOuter;
+		JobCounter* pInner;
+		JobCounter* pLast;
+		std::atomic<uint32_t> unRan;
+	};
+
+	void RunCounted(const void* pContext, uint32_t, uint32_t)
+	{
+		((ReleaseContext*)pContext)->unRan.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// holds B and C on the outer counter and D on B's, so releasing the
+	// outer counter runs B, which releases D while C is still to go
+	void RunHolder(const void* pContext, uint32_t, uint32_t)
+	{
+		ReleaseContext* pRelease = (ReleaseContext*)pContext;
+		Job jobB = { &RunCounted, pRelease, 0, 1, pRelease->pInner };
+		Job jobC = { &RunCounted, pRelease, 0, 1, pRelease->pLast };
+		Job jobD = { &RunCounted, pRelease, 0, 1, pRelease->pLast };
+		pRelease->pJobSystem->SubmitAfter(jobB, *pRelease->pOuter);
+		pRelease->pJobSystem->SubmitAfter(jobC, *pRelease->pOuter);
+		pRelease->pJobSystem->SubmitAfter(jobD, *pRelease->pInner);
+		pRelease->unRan.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// with no workers released jobs run inline, inside the release of the
+	// counter that held them
+	bool BNestedReleaseRunsEverything(JobSystem &jobSystem)
+	{
+		for(uint32_t unRound = 0; unRound < k_unRounds / 10; unRound++){
+			JobCounter outer;
+			JobCounter inner;
+			JobCounter last;
+			ReleaseContext release;
+			release.pJobSystem = &jobSystem;
+			release.pOuter = &outer;
+			release.pInner = &inner;
+			release.pLast = &last;
+			release.unRan = 0;
+
+			Job holder = { &RunHolder, &release, 0, 1, &outer };
+			jobSystem.Submit(holder);
+			// inline, everything has run by now; a lost or repeated job would
+			// leave the waits below spinning for good
+			if(jobSystem.GetWorkerCount() == 0 && !(outer.BIsDone() && inner.BIsDone() && last.BIsDone())){
+				std::cout << "Error: release round " << unRound << " lost or repeated a continuation" << std::endl;
+				return false;
+			}
+			jobSystem.Wait(outer);
+			jobSystem.Wait(inner);
+			jobSystem.Wait(last);
+
+			if(release.unRan.load() != 4){
+				std::cout << "Error: release round " << unRound << " ran " << release.unRan.load() << " of 4 jobs" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool BRunAll(uint32_t unWorkers)
+	{
+		JobSystem jobSystem;
+		if(!jobSystem.BStart(unWorkers, ThreadPolicy())) return false;
+
+		bool bPass = BParallelForCoversEveryItem(jobSystem)
+			&& BNestedParallelFor(jobSystem)
+			&& BContinuationsRunAfter(jobSystem)
+			&& BNestedReleaseRunsEverything(jobSystem);
+		jobSystem.Stop();
+		return bPass;
+	}
+}
+
+int main()
+{
+	uint32_t rWorkers[] = { 0, 1, 3, 7 };
+	for(uint32_t unWorkers : rWorkers){
+		if(!BRunAll(unWorkers)){
+			std::cout << "Error: job system stress failed with " << unWorkers << " workers" << std::endl;
+			return 1;
+		}
+	}
+	std::cout << "Job system stress passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,318 @@
+#include "MockVRBackend.hpp"
+#include "Profiler.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+	const vr::TrackedDeviceIndex_t k_unLeftHandDevice = 1;
+	const vr::TrackedDeviceIndex_t k_unRightHandDevice = 2;
+
+	vr::HmdMatrix34_t MakePose(float fYaw, float fPitch, float fX, float fY, float fZ)
+	{
+		float fCy = std::cos(fYaw), fSy = std::sin(fYaw);
+		float fCp = std::cos(fPitch), fSp = std::sin(fPitch);
+		// yaw about y, then pitch about x
+		vr::HmdMatrix34_t mat = {{
+			{ fCy, fSy * fSp, fSy * fCp, fX },
+			{ 0.0f, fCp, -fSp, fY },
+			{ -fSy, fCy * fSp, fCy * fCp, fZ }
+		}};
+		return mat;
+	}
+
+	void FillPoses(const PoseTrace::Sample &sample, vr::TrackedDevicePose_t* pPoses, uint32_t unCount)
+	{
+		for(uint32_t unDevice = 0; unDevice < unCount; unDevice++){
+			vr::TrackedDevicePose_t &pose = pPoses[unDevice];
+			std::memset(&pose, 0, sizeof(pose));
+			if(unDevice >= PoseTrace::Device_Count) continue;
+
+			pose.bDeviceIsConnected = true;
+			pose.bPoseIsValid = sample.rbValid[unDevice];
+			pose.eTrackingResult = pose.bPoseIsValid ? vr::TrackingResult_Running_OK : vr::TrackingResult_Running_OutOfRange;
+			pose.mDeviceToAbsoluteTracking = sample.rmatPose[unDevice];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+MockVRBackend::MockVRBackend(const MockVRConfig &config) :
+	m_config(config),
+	m_ulFrame(0),
+	m_nPeriodNs(0),
+	m_dTraceTime(0.0),
+	m_nLastVsyncNs(0),
+	m_unDroppedFrames(0),
+	m_unReprojectedFrames(0),
+	m_unReadFramebuffer(0)
+{
+	m_rbSubmitted[0] = m_rbSubmitted[1] = true;
+	m_rEyeFramebuffers[0] = m_rEyeFramebuffers[1] = 0;
+	m_rEyeTextures[0] = m_rEyeTextures[1] = 0;
+}
+
+//-----------------------------------------------------------------------------
+MockVRBackend::~MockVRBackend()
+{
+	Shutdown();
+}
+
+//-----------------------------------------------------------------------------
+bool MockVRBackend::BInit()
+{
+	if(!m_config.strPoseTrace.empty() && !m_trace.BLoad(m_config.strPoseTrace)) return false;
+
+	m_nPeriodNs = m_config.fDisplayFrequency > 0.0f ? (int64_t)(1.0e9 / m_config.fDisplayFrequency) : 0;
+	m_nLastVsyncNs = Profiler::NowNs();
+
+	std::cout << "Mock VR: " << m_config.unRenderWidth << "x" << m_config.unRenderHeight << " per eye, ";
+	if(m_nPeriodNs > 0) std::cout << m_config.fDisplayFrequency << " Hz";
+	else std::cout << "unpaced";
+	if(!m_trace.BIsEmpty()) std::cout << ", replaying " << m_config.strPoseTrace << " (" << m_trace.GetDuration() << " s)";
+	std::cout << std::endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// GL goes with the context, so this runs before the window closes.
+//-----------------------------------------------------------------------------
+void MockVRBackend::Shutdown()
+{
+	if(m_unReadFramebuffer){
+		glDeleteFramebuffers(1, &m_unReadFramebuffer);
+		glDeleteFramebuffers(2, m_rEyeFramebuffers);
+		glDeleteTextures(2, m_rEyeTextures);
+	}
+	m_unReadFramebuffer = 0;
+	m_rEyeFramebuffers[0] = m_rEyeFramebuffers[1] = 0;
+	m_rEyeTextures[0] = m_rEyeTextures[1] = 0;
+}
+
+//-----------------------------------------------------------------------------
+std::string MockVRBackend::GetTrackedDeviceString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop)
+{
+	switch(prop){
+		case vr::Prop_TrackingSystemName_String: return "mock";
+		case vr::Prop_SerialNumber_String: return "mock-" + std::to_string(unDevice);
+		default: break;
+	}
+	return "";
+}
+
+//-----------------------------------------------------------------------------
+vr::ETrackedDeviceClass MockVRBackend::GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDevice)
+{
+	if(unDevice == vr::k_unTrackedDeviceIndex_Hmd) return vr::TrackedDeviceClass_HMD;
+	if(unDevice == k_unLeftHandDevice || unDevice == k_unRightHandDevice) return vr::TrackedDeviceClass_Controller;
+	return vr::TrackedDeviceClass_Invalid;
+}
+
+//-----------------------------------------------------------------------------
+void MockVRBackend::GetRecommendedRenderTargetSize(uint32_t &unWidth, uint32_t &unHeight)
+{
+	unWidth = m_config.unRenderWidth;
+	unHeight = m_config.unRenderHeight;
+}
+
+//-----------------------------------------------------------------------------
+void MockVRBackend::GetProjectionRaw(vr::Hmd_Eye nEye, float &fLeft, float &fRight, float &fTop, float &fBottom)
+{
+	fLeft = nEye == vr::Eye_Left ? m_config.fTanLeft : -m_config.fTanRight;
+	fRight = nEye == vr::Eye_Left ? m_config.fTanRight : -m_config.fTanLeft;
+	fTop = m_config.fTanTop;
+	fBottom = m_config.fTanBottom;
+}
+
+//-----------------------------------------------------------------------------
+// An off centre GL projection from the raw tangents, as the runtime builds
+// it. Top is negative, the tangents are in y down terms.
+//-----------------------------------------------------------------------------
+vr::HmdMatrix44_t MockVRBackend::GetProjectionMatrix(vr::Hmd_Eye nEye, float fNear, float fFar)
+{
+	float fLeft, fRight, fTop, fBottom;
+	GetProjectionRaw(nEye, fLeft, fRight, fTop, fBottom);
+
+	float fIdx = 1.0f / (fRight - fLeft);
+	float fIdy = 1.0f / (fBottom - fTop);
+	float fIdz = 1.0f / (fFar - fNear);
+	float fSx = fRight + fLeft;
+	float fSy = fBottom + fTop;
+
+	vr::HmdMatrix44_t mat;
+	std::memset(&mat, 0, sizeof(mat));
+	mat.m[0][0] = 2.0f * fIdx;	mat.m[0][2] = fSx * fIdx;
+	mat.m[1][1] = 2.0f * fIdy;	mat.m[1][2] = fSy * fIdy;
+	mat.m[2][2] = -(fFar + fNear) * fIdz;	mat.m[2][3] = -2.0f * fFar * fNear * fIdz;
+	mat.m[3][2] = -1.0f;
+	return mat;
+}
+
+//-----------------------------------------------------------------------------
+vr::HmdMatrix34_t MockVRBackend::GetEyeToHeadTransform(vr::Hmd_Eye nEye)
+{
+	float fHalfIpd = m_config.fIpd * 0.5f;
+	return MakePose(0.0f, 0.0f, nEye == vr::Eye_Left ? -fHalfIpd : fHalfIpd, 0.0f, 0.0f);
+}
+
+//-----------------------------------------------------------------------------
+float MockVRBackend::GetSecondsSinceLastVsync()
+{
+	return (float)((double)(Profiler::NowNs() - m_nLastVsyncNs) * 1.0e-9);
+}
+
+//-----------------------------------------------------------------------------
+// The frame WaitGetPoses() last started is seen a frame and the photon
+// delay after its vsync, at its trace time; a prediction is the trace that
+// far either side of it.
+//-----------------------------------------------------------------------------
+bool MockVRBackend::BGetPredictedPoses(float fSecondsFromNow, vr::TrackedDevicePose_t* pPoses, uint32_t unCount)
+{
+	int64_t nTargetNs = Profiler::NowNs() + (int64_t)((double)fSecondsFromNow * 1.0e9);
+	double dTime;
+	{
+		std::lock_guard<std::mutex> lock(m_mutexVsync);
+		int64_t nPhotonsNs = m_nLastVsyncNs + (int64_t)(1.0e9 / (double)GetDisplayFrequency()) + (int64_t)((double)m_config.fSecondsFromVsyncToPhotons * 1.0e9);
+		dTime = m_dTraceTime + (double)(nTargetNs - nPhotonsNs) * 1.0e-9;
+	}
+
+	PoseTrace::Sample sample;
+	GetPoses(dTime < 0.0 ? 0.0 : dTime, sample);
+	FillPoses(sample, pPoses, unCount);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// The trace, or standing at 1.6 m looking around slowly with the hands out
+// in front.
+//-----------------------------------------------------------------------------
+void MockVRBackend::GetPoses(double dTime, PoseTrace::Sample &sample) const
+{
+	if(!m_trace.BIsEmpty()){
+		sample = m_trace.SampleAt(dTime);
+		return;
+	}
+
+	float fT = (float)dTime;
+	sample.dTime = dTime;
+	sample.rbValid[PoseTrace::Device_Hmd] = true;
+	sample.rmatPose[PoseTrace::Device_Hmd] = MakePose(0.6f * std::sin(0.4f * fT), 0.15f * std::sin(0.23f * fT), 0.0f, 1.6f, 0.0f);
+	sample.rbValid[PoseTrace::Device_LeftHand] = true;
+	sample.rmatPose[PoseTrace::Device_LeftHand] = MakePose(0.0f, -0.5f, -0.2f, 1.2f + 0.05f * std::sin(1.1f * fT), -0.4f);
+	sample.rbValid[PoseTrace::Device_RightHand] = true;
+	sample.rmatPose[PoseTrace::Device_RightHand] = MakePose(0.0f, -0.5f, 0.2f, 1.2f + 0.05f * std::cos(0.9f * fT), -0.4f);
+}
+
+//-----------------------------------------------------------------------------
+void MockVRBackend::UpdateInput(VRInputState &state)
+{
+	PoseTrace::Sample sample;
+	GetPoses(m_dTraceTime, sample);
+
+	state.bRotate3D = false;
+	state.bAnalogValid = false;
+	for(int nHand = 0; nHand < 2; nHand++){
+		VRInputState::Hand &hand = state.rHand[nHand];
+		hand.bPoseValid = sample.rbValid[PoseTrace::Device_LeftHand + nHand];
+		hand.matPose = sample.rmatPose[PoseTrace::Device_LeftHand + nHand];
+		hand.bHidden = false;
+		hand.unDevice = nHand == 0 ? k_unLeftHandDevice : k_unRightHandDevice;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Sleeps to the next simulated vsync, or returns at once when unpaced, and
+// advances the trace by one frame.
+//-----------------------------------------------------------------------------
+void MockVRBackend::WaitGetPoses(vr::TrackedDevicePose_t* pPoses, uint32_t unCount)
+{
+	if(!m_rbSubmitted[0] || !m_rbSubmitted[1]) m_unDroppedFrames++;
+	m_rbSubmitted[0] = m_rbSubmitted[1] = false;
+
+	int64_t nNowNs = Profiler::NowNs();
+	int64_t nVsyncNs = nNowNs;
+	if(m_nPeriodNs > 0){
+		// every vsync already gone by since the last one showed the old frame again
+		int64_t nMissed = (nNowNs - m_nLastVsyncNs) / m_nPeriodNs;
+		if(nMissed > 0) m_unReprojectedFrames += (uint32_t)nMissed;
+		nVsyncNs = m_nLastVsyncNs + (nMissed + 1) * m_nPeriodNs;
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(nVsyncNs)));
+	}
+
+	m_ulFrame++;
+	{
+		std::lock_guard<std::mutex> lock(m_mutexVsync);
+		m_nLastVsyncNs = nVsyncNs;
+		m_dTraceTime = (double)m_ulFrame / (double)GetDisplayFrequency();
+	}
+
+	PoseTrace::Sample sample;
+	GetPoses(m_dTraceTime, sample);
+	FillPoses(sample, pPoses, unCount);
+}
+
+//-----------------------------------------------------------------------------
+bool MockVRBackend::BCreateEyeTargets()
+{
+	glGenFramebuffers(1, &m_unReadFramebuffer);
+	glGenFramebuffers(2, m_rEyeFramebuffers);
+	glGenTextures(2, m_rEyeTextures);
+	for(int nEye = 0; nEye < 2; nEye++){
+		glBindTexture(GL_TEXTURE_2D, m_rEyeTextures[nEye]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_config.unRenderWidth, m_config.unRenderHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_rEyeFramebuffers[nEye]);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_rEyeTextures[nEye], 0);
+		if(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+			std::cout << "Error: Mock VR eye target not created -- MockVRBackend::BCreateEyeTargets" << std::endl;
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			return false;
+		}
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Scales the bounds of the submitted texture into the eye's own texture. v
+// runs top down as the compositor has it, GL rows bottom up.
+//-----------------------------------------------------------------------------
+bool MockVRBackend::BSubmit(vr::Hmd_Eye nEye, GLuint unTexture, const vr::VRTextureBounds_t &bounds, const vr::HmdMatrix34_t* pRenderPose)
+{
+	AVR_PROFILE_SCOPE("MockVRBackend::BSubmit");
+	if(!m_unReadFramebuffer && !BCreateEyeTargets()) return false;
+
+	GLint nWidth = 0, nHeight = 0;
+	glBindTexture(GL_TEXTURE_2D, unTexture);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &nWidth);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &nHeight);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	if(nWidth == 0 || nHeight == 0) return false;
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_unReadFramebuffer);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, unTexture, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_rEyeFramebuffers[nEye]);
+	glBlitFramebuffer(
+		(GLint)(bounds.uMin * nWidth), (GLint)((1.0f - bounds.vMax) * nHeight),
+		(GLint)(bounds.uMax * nWidth), (GLint)((1.0f - bounds.vMin) * nHeight),
+		0, 0, m_config.unRenderWidth, m_config.unRenderHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	m_rbSubmitted[nEye] = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+bool MockVRBackend::BGetCompositorStats(uint32_t &unDroppedFrames, uint32_t &unReprojectedFrames)
+{
+	unDroppedFrames = m_unDroppedFrames;
+	unReprojectedFrames = m_unReprojectedFrames;
+	return true;
+}
@@ -0,0 +1,100 @@
+#ifndef MOCKVRBACKEND_HPP
+#define MOCKVRBACKEND_HPP
+
+#include "VRBackend.hpp"
+#include "PoseTrace.hpp"
+
+#include <mutex>
+
+struct MockVRConfig
+{
+	uint32_t unRenderWidth = 1512;
+	uint32_t unRenderHeight = 1680;
+	float fIpd = 0.064f;						// metres
+	float fDisplayFrequency = 90.0f;			// 0 runs unpaced
+	float fSecondsFromVsyncToPhotons = 0.011f;
+	// tangents of the left eye's half angles, the right eye mirrors them
+	float fTanLeft = -1.25f;
+	float fTanRight = 1.05f;
+	float fTanTop = -1.15f;
+	float fTanBottom = 1.15f;
+	std::string strPoseTrace;					// empty moves the head and hands on their own
+};
+
+//-----------------------------------------------------------------------------
+// A stand in for the SteamVR runtime, for running the stereo path without a
+// headset. WaitGetPoses() blocks to a simulated vsync at the display
+// frequency and hands out the head and hand poses of a recorded trace, or
+// a slow synthetic sway without one. Trace time advances a frame period
+// per frame rather than with the wall clock, so a run is repeatable.
+// A prediction asked for between frames is measured from the photon time
+// of the frame WaitGetPoses() last started, whose pose is the trace at the
+// frame's time, so predicting to that frame's photons gives the same pose.
+//
+// Submit() resolves the submitted part of each eye into textures of the
+// mock's own, like the compositor reading them would. A vsync that passes
+// without a new frame counts as reprojected, a frame started without both
+// eyes submitted as dropped.
+//-----------------------------------------------------------------------------
+class MockVRBackend : public IVRBackend {
+
+public:
+
+	MockVRBackend(const MockVRConfig &config);
+	~MockVRBackend();
+
+	const char* GetName() const override { return "Mock"; }
+	bool BInit() override;
+	bool BInitCompositor() override { return true; }
+	void Shutdown() override;
+
+	std::string GetTrackedDeviceString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop) override;
+	vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDevice) override;
+
+	void GetRecommendedRenderTargetSize(uint32_t &unWidth, uint32_t &unHeight) override;
+	vr::HmdMatrix44_t GetProjectionMatrix(vr::Hmd_Eye nEye, float fNear, float fFar) override;
+	void GetProjectionRaw(vr::Hmd_Eye nEye, float &fLeft, float &fRight, float &fTop, float &fBottom) override;
+	vr::HmdMatrix34_t GetEyeToHeadTransform(vr::Hmd_Eye nEye) override;
+
+	float GetDisplayFrequency() override { return m_config.fDisplayFrequency > 0.0f ? m_config.fDisplayFrequency : 90.0f; }
+	float GetSecondsFromVsyncToPhotons() override { return m_config.fSecondsFromVsyncToPhotons; }
+	float GetSecondsSinceLastVsync() override;
+	bool BGetPredictedPoses(float fSecondsFromNow, vr::TrackedDevicePose_t* pPoses, uint32_t unCount) override;
+
+	bool BPollNextEvent(vr::VREvent_t &event) override { return false; }
+	bool BIsInputAvailable() override { return true; }
+	void UpdateInput(VRInputState &state) override;
+	ERenderModelStatus PollRenderModel(const char* pchRenderModelName, vr::RenderModel_t** ppModel) override { return RenderModelStatus_Failed; }
+	ERenderModelStatus PollRenderModelTexture(vr::TextureID_t unTexture, vr::RenderModel_TextureMap_t** ppTexture) override { return RenderModelStatus_Failed; }
+	void FreeRenderModel(vr::RenderModel_t* pModel) override {}
+	void FreeRenderModelTexture(vr::RenderModel_TextureMap_t* pTexture) override {}
+
+	void WaitGetPoses(vr::TrackedDevicePose_t* pPoses, uint32_t unCount) override;
+	bool BSubmit(vr::Hmd_Eye nEye, GLuint unTexture, const vr::VRTextureBounds_t &bounds, const vr::HmdMatrix34_t* pRenderPose) override;
+	bool BGetCompositorStats(uint32_t &unDroppedFrames, uint32_t &unReprojectedFrames) override;
+
+private:
+
+	void GetPoses(double dTime, PoseTrace::Sample &sample) const;
+	bool BCreateEyeTargets();
+
+	MockVRConfig m_config;
+	PoseTrace m_trace;
+
+	uint64_t m_ulFrame;
+	int64_t m_nPeriodNs;
+	// written by WaitGetPoses(), read by predictions from other threads
+	std::mutex m_mutexVsync;
+	double m_dTraceTime;
+	int64_t m_nLastVsyncNs;
+
+	bool m_rbSubmitted[2];
+	uint32_t m_unDroppedFrames;
+	uint32_t m_unReprojectedFrames;
+
+	GLuint m_unReadFramebuffer;
+	GLuint m_rEyeFramebuffers[2];
+	GLuint m_rEyeTextures[2];
+};
+
+#endif
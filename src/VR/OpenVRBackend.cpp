@@ -0,0 +1,357 @@
+#include <iostream>
+
+#include "OpenVRBackend.hpp"
+#include "SystemInfo.hpp"
+
+#ifdef _WIN32
+#include "pathtools.h"
+#elif __linux__
+#include <limits.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const int k_nLeft = 0;
+	const int k_nRight = 1;
+}
+
+//-----------------------------------------------------------------------------
+OpenVRBackend::OpenVRBackend(bool bDebugPrint) :
+	m_pHMD(NULL),
+	m_bDebugPrint(bDebugPrint)
+{
+	helper = std::make_unique<VR_Helper>();
+}
+
+//-----------------------------------------------------------------------------
+// Loads the SteamVR runtime and the action manifest.
+//-----------------------------------------------------------------------------
+bool OpenVRBackend::BInit()
+{
+	vr::EVRInitError eError = vr::VRInitError_None;
+
+#ifdef _WIN32
+	m_pHMD = vr::VR_Init(&eError, vr::VRApplication_Scene);
+#else
+	m_pHMD = vr::VR_Init(&eError, vr::VRApplication_Utility);
+#endif
+
+	if(eError != vr::VRInitError_None)
+	{
+		m_pHMD = NULL;
+		return false;
+	}
+
+//*********** removing pathtools from osx build *************//
+#ifdef __APPLE__
+	std::string manifestPath = "/Users/bryandunphy/Projects/5CellAVR/src/VR/avr_actions.json";
+	vr::VRInput()->SetActionManifestPath(manifestPath.c_str());
+#elif _WIN32
+	vr::VRInput()->SetActionManifestPath( Path_MakeAbsolute( "../../src/VR/avr_actions.json", Path_StripFilename( Path_GetExecutablePath() ) ).c_str() );
+#elif __linux__
+	//same layout as windows, relative to the executable
+	char rchExe[PATH_MAX];
+	ssize_t nLength = readlink("/proc/self/exe", rchExe, sizeof(rchExe) - 1);
+	std::string manifestPath = "../../src/VR/avr_actions.json";
+	if(nLength > 0)
+	{
+		std::string exePath(rchExe, (size_t)nLength);
+		manifestPath = exePath.substr(0, exePath.find_last_of('/') + 1) + manifestPath;
+	}
+	vr::VRInput()->SetActionManifestPath(manifestPath.c_str());
+#endif
+
+	vr::VRInput()->GetActionHandle( "/actions/avr/in/RotateStructure", &m_actionRotateStructure);
+	vr::VRInput()->GetActionHandle( "/actions/avr/in/HideThisController", &m_actionHideThisController);
+	vr::VRInput()->GetActionHandle( "/actions/avr/in/TriggerHaptic", &m_actionTriggerHaptic );
+	vr::VRInput()->GetActionHandle( "/actions/avr/in/AnalogInput", &m_actionAnalongInput );
+
+	vr::VRInput()->GetActionSetHandle( "/actions/avr", &m_actionsetAvr );
+
+	vr::VRInput()->GetActionHandle( "/actions/avr/out/Haptic_Left", &m_rHand[k_nLeft].m_actionHaptic );
+	vr::VRInput()->GetInputSourceHandle( "/user/hand/left", &m_rHand[k_nLeft].m_source );
+	vr::VRInput()->GetActionHandle( "/actions/avr/in/Hand_Left", &m_rHand[k_nLeft].m_actionPose );
+
+	vr::VRInput()->GetActionHandle( "/actions/avr/out/Haptic_Right", &m_rHand[k_nRight].m_actionHaptic );
+	vr::VRInput()->GetInputSourceHandle( "/user/hand/right", &m_rHand[k_nRight].m_source );
+	vr::VRInput()->GetActionHandle( "/actions/avr/in/Hand_Right", &m_rHand[k_nRight].m_actionPose );
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+bool OpenVRBackend::BInitCompositor()
+{
+	if ( !vr::VRCompositor() )
+	{
+		std::cout << "Compositor initialization failed.\n" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void OpenVRBackend::Shutdown()
+{
+	if(m_pHMD)
+	{
+		vr::VR_Shutdown();
+		m_pHMD = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+std::string OpenVRBackend::GetTrackedDeviceString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop)
+{
+	return helper->GetTrackedDeviceString(unDevice, prop);
+}
+
+//-----------------------------------------------------------------------------
+vr::ETrackedDeviceClass OpenVRBackend::GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDevice)
+{
+	return m_pHMD->GetTrackedDeviceClass(unDevice);
+}
+
+//-----------------------------------------------------------------------------
+void OpenVRBackend::GetRecommendedRenderTargetSize(uint32_t &unWidth, uint32_t &unHeight)
+{
+	m_pHMD->GetRecommendedRenderTargetSize(&unWidth, &unHeight);
+}
+
+//-----------------------------------------------------------------------------
+vr::HmdMatrix44_t OpenVRBackend::GetProjectionMatrix(vr::Hmd_Eye nEye, float fNear, float fFar)
+{
+	return m_pHMD->GetProjectionMatrix(nEye, fNear, fFar);
+}
+
+//-----------------------------------------------------------------------------
+void OpenVRBackend::GetProjectionRaw(vr::Hmd_Eye nEye, float &fLeft, float &fRight, float &fTop, float &fBottom)
+{
+	m_pHMD->GetProjectionRaw(nEye, &fLeft, &fRight, &fTop, &fBottom);
+}
+
+//-----------------------------------------------------------------------------
+vr::HmdMatrix34_t OpenVRBackend::GetEyeToHeadTransform(vr::Hmd_Eye nEye)
+{
+	return m_pHMD->GetEyeToHeadTransform(nEye);
+}
+
+//-----------------------------------------------------------------------------
+float OpenVRBackend::GetDisplayFrequency()
+{
+	return m_pHMD->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+}
+
+//-----------------------------------------------------------------------------
+float OpenVRBackend::GetSecondsFromVsyncToPhotons()
+{
+	return m_pHMD->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+}
+
+//-----------------------------------------------------------------------------
+float OpenVRBackend::GetSecondsSinceLastVsync()
+{
+	float fSecondsSinceLastVsync = 0.0f;
+	m_pHMD->GetTimeSinceLastVsync(&fSecondsSinceLastVsync, NULL);
+	return fSecondsSinceLastVsync;
+}
+
+//-----------------------------------------------------------------------------
+bool OpenVRBackend::BGetPredictedPoses(float fSecondsFromNow, vr::TrackedDevicePose_t* pPoses, uint32_t unCount)
+{
+	if(!m_pHMD) return false;
+
+	m_pHMD->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, fSecondsFromNow, pPoses, unCount);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+bool OpenVRBackend::BPollNextEvent(vr::VREvent_t &event)
+{
+	return m_pHMD->PollNextEvent(&event, sizeof(event));
+}
+
+//-----------------------------------------------------------------------------
+bool OpenVRBackend::BIsInputAvailable()
+{
+	return m_pHMD->IsInputAvailable();
+}
+
+//-----------------------------------------------------------------------------
+// Process SteamVR action state. UpdateActionState is called each frame to
+// update the state of the actions themselves. The application controls
+// which action sets are active with the provided array of
+// VRActiveActionSet_t structs.
+//-----------------------------------------------------------------------------
+void OpenVRBackend::UpdateInput(VRInputState &state)
+{
+	vr::VRActiveActionSet_t actionSet = {0};
+	actionSet.ulActionSet = m_actionsetAvr;
+	vr::VRInput()->UpdateActionState(&actionSet, sizeof(actionSet), 1);
+
+	state.bRotate3D = false;
+	vr::VRInputValueHandle_t ulDevice;
+	if(helper->GetDigitalActionState(m_actionRotateStructure, &ulDevice))
+	{
+		if(ulDevice == m_rHand[k_nLeft].m_source || ulDevice == m_rHand[k_nRight].m_source)
+		{
+			state.bRotate3D = true;
+		}
+	}
+
+	vr::VRInputValueHandle_t ulHapticDevice;
+	if (helper->GetDigitalActionRisingEdge(m_actionTriggerHaptic, &ulHapticDevice))
+	{
+		if (ulHapticDevice == m_rHand[k_nLeft].m_source)
+		{
+			vr::VRInput()->TriggerHapticVibrationAction(m_rHand[k_nLeft].m_actionHaptic, 0, 1, 4.f, 1.0f, vr::k_ulInvalidInputValueHandle);
+		}
+		if (ulHapticDevice == m_rHand[k_nRight].m_source)
+		{
+			vr::VRInput()->TriggerHapticVibrationAction(m_rHand[k_nRight].m_actionHaptic, 0, 1, 4.f, 1.0f, vr::k_ulInvalidInputValueHandle);
+		}
+	}
+
+	vr::InputAnalogActionData_t analogData;
+	state.bAnalogValid = false;
+	if ( vr::VRInput()->GetAnalogActionData( m_actionAnalongInput, &analogData, sizeof( analogData ), vr::k_ulInvalidInputValueHandle ) == vr::VRInputError_None && analogData.bActive )
+	{
+		state.bAnalogValid = true;
+		state.rfAnalog[0] = analogData.x;
+		state.rfAnalog[1] = analogData.y;
+	}
+
+	state.rHand[k_nLeft].bHidden = false;
+	state.rHand[k_nRight].bHidden = false;
+
+	vr::VRInputValueHandle_t ulHideDevice;
+	if (helper->GetDigitalActionState(m_actionHideThisController, &ulHideDevice))
+	{
+		if (ulHideDevice == m_rHand[k_nLeft].m_source)
+		{
+			state.rHand[k_nLeft].bHidden = true;
+		}
+		if (ulHideDevice == m_rHand[k_nRight].m_source)
+		{
+			state.rHand[k_nRight].bHidden = true;
+		}
+	}
+
+	for (int nHand = k_nLeft; nHand <= k_nRight; nHand++)
+	{
+		vr::InputPoseActionData_t poseData;
+		VRInputState::Hand &hand = state.rHand[nHand];
+		hand.unDevice = vr::k_unTrackedDeviceIndexInvalid;
+
+#if defined(__APPLE__) || defined(__linux__)
+		if ( vr::VRInput()->GetPoseActionDataRelativeToNow( m_rHand[nHand].m_actionPose, vr::TrackingUniverseStanding, 0, &poseData, sizeof( poseData ), vr::k_ulInvalidInputValueHandle ) != vr::VRInputError_None
+#else
+		if ( vr::VRInput()->GetPoseActionData( m_rHand[nHand].m_actionPose, vr::TrackingUniverseStanding, 0, &poseData, sizeof( poseData ), vr::k_ulInvalidInputValueHandle ) != vr::VRInputError_None
+#endif
+			|| !poseData.bActive || !poseData.pose.bPoseIsValid )
+		{
+			hand.bPoseValid = false;
+		}
+		else
+		{
+			hand.bPoseValid = true;
+			hand.matPose = poseData.pose.mDeviceToAbsoluteTracking;
+
+			vr::InputOriginInfo_t originInfo;
+			if ( vr::VRInput()->GetOriginTrackedDeviceInfo( poseData.activeOrigin, &originInfo, sizeof( originInfo ) ) == vr::VRInputError_None )
+			{
+				hand.unDevice = originInfo.trackedDeviceIndex;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads a render model and its texture from the runtime
+//-----------------------------------------------------------------------------
+ERenderModelStatus OpenVRBackend::PollRenderModel(const char* pchRenderModelName, vr::RenderModel_t** ppModel)
+{
+	vr::EVRRenderModelError error = vr::VRRenderModels()->LoadRenderModel_Async(pchRenderModelName, ppModel);
+	if (error == vr::VRRenderModelError_Loading)
+		return RenderModelStatus_Loading;
+
+	if (error != vr::VRRenderModelError_None)
+	{
+		if(m_bDebugPrint){
+		dprintf("Unable to load render model %s - %s\n", pchRenderModelName, vr::VRRenderModels()->GetRenderModelErrorNameFromEnum(error));
+		}
+		return RenderModelStatus_Failed;
+	}
+	return RenderModelStatus_Ready;
+}
+
+//-----------------------------------------------------------------------------
+ERenderModelStatus OpenVRBackend::PollRenderModelTexture(vr::TextureID_t unTexture, vr::RenderModel_TextureMap_t** ppTexture)
+{
+	vr::EVRRenderModelError error = vr::VRRenderModels()->LoadTexture_Async(unTexture, ppTexture);
+	if (error == vr::VRRenderModelError_Loading)
+		return RenderModelStatus_Loading;
+
+	if (error != vr::VRRenderModelError_None)
+	{
+		if(m_bDebugPrint){
+		dprintf("Unable to load render texture id:%d - %s\n", unTexture, vr::VRRenderModels()->GetRenderModelErrorNameFromEnum(error));
+		}
+		return RenderModelStatus_Failed;
+	}
+	return RenderModelStatus_Ready;
+}
+
+//-----------------------------------------------------------------------------
+void OpenVRBackend::FreeRenderModel(vr::RenderModel_t* pModel)
+{
+	vr::VRRenderModels()->FreeRenderModel(pModel);
+}
+
+//-----------------------------------------------------------------------------
+void OpenVRBackend::FreeRenderModelTexture(vr::RenderModel_TextureMap_t* pTexture)
+{
+	vr::VRRenderModels()->FreeTexture(pTexture);
+}
+
+//-----------------------------------------------------------------------------
+void OpenVRBackend::WaitGetPoses(vr::TrackedDevicePose_t* pPoses, uint32_t unCount)
+{
+	vr::VRCompositor()->WaitGetPoses(pPoses, unCount, NULL, 0);
+}
+
+//-----------------------------------------------------------------------------
+bool OpenVRBackend::BSubmit(vr::Hmd_Eye nEye, GLuint unTexture, const vr::VRTextureBounds_t &bounds, const vr::HmdMatrix34_t* pRenderPose)
+{
+	if(pRenderPose)
+	{
+		// the compositor reprojects from the pose the eye was drawn with
+		vr::VRTextureWithPose_t eyeTexture;
+		eyeTexture.handle = (void*)(uintptr_t)unTexture;
+		eyeTexture.eType = vr::TextureType_OpenGL;
+		eyeTexture.eColorSpace = vr::ColorSpace_Gamma;
+		eyeTexture.mDeviceToAbsoluteTracking = *pRenderPose;
+		return vr::VRCompositor()->Submit(nEye, &eyeTexture, &bounds, vr::Submit_TextureWithPose) == vr::VRCompositorError_None;
+	}
+
+	vr::Texture_t eyeTexture = {(void*)(uintptr_t)unTexture, vr::TextureType_OpenGL, vr::ColorSpace_Gamma };
+	return vr::VRCompositor()->Submit(nEye, &eyeTexture, &bounds) == vr::VRCompositorError_None;
+}
+
+//-----------------------------------------------------------------------------
+// Dropped and reprojected frame counts since the compositor started on this
+// process.
+//-----------------------------------------------------------------------------
+bool OpenVRBackend::BGetCompositorStats(uint32_t &unDroppedFrames, uint32_t &unReprojectedFrames)
+{
+	if (!m_pHMD || !vr::VRCompositor())
+		return false;
+
+	vr::Compositor_CumulativeStats stats;
+	vr::VRCompositor()->GetCumulativeStats(&stats, sizeof(stats));
+	unDroppedFrames = stats.m_nNumDroppedFrames;
+	unReprojectedFrames = stats.m_nNumReprojectedFrames;
+	return true;
+}
@@ -0,0 +1,85 @@
+#ifndef OPENVRBACKEND_HPP
+#define OPENVRBACKEND_HPP
+
+#include <memory>
+
+#include "VRBackend.hpp"
+
+//-----------------------------------------------------------------------------
+// The SteamVR runtime: IVRSystem, the compositor, the input actions from
+// avr_actions.json and the render models.
+//-----------------------------------------------------------------------------
+class OpenVRBackend : public IVRBackend {
+
+public:
+
+	OpenVRBackend(bool bDebugPrint);
+
+	const char* GetName() const override { return "OpenVR"; }
+	bool BInit() override;
+	bool BInitCompositor() override;
+	void Shutdown() override;
+
+	std::string GetTrackedDeviceString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop) override;
+	vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDevice) override;
+
+	void GetRecommendedRenderTargetSize(uint32_t &unWidth, uint32_t &unHeight) override;
+	vr::HmdMatrix44_t GetProjectionMatrix(vr::Hmd_Eye nEye, float fNear, float fFar) override;
+	void GetProjectionRaw(vr::Hmd_Eye nEye, float &fLeft, float &fRight, float &fTop, float &fBottom) override;
+	vr::HmdMatrix34_t GetEyeToHeadTransform(vr::Hmd_Eye nEye) override;
+
+	float GetDisplayFrequency() override;
+	float GetSecondsFromVsyncToPhotons() override;
+	float GetSecondsSinceLastVsync() override;
+	bool BGetPredictedPoses(float fSecondsFromNow, vr::TrackedDevicePose_t* pPoses, uint32_t unCount) override;
+
+	bool BPollNextEvent(vr::VREvent_t &event) override;
+	bool BIsInputAvailable() override;
+	void UpdateInput(VRInputState &state) override;
+	ERenderModelStatus PollRenderModel(const char* pchRenderModelName, vr::RenderModel_t** ppModel) override;
+	ERenderModelStatus PollRenderModelTexture(vr::TextureID_t unTexture, vr::RenderModel_TextureMap_t** ppTexture) override;
+	void FreeRenderModel(vr::RenderModel_t* pModel) override;
+	void FreeRenderModelTexture(vr::RenderModel_TextureMap_t* pTexture) override;
+
+	void WaitGetPoses(vr::TrackedDevicePose_t* pPoses, uint32_t unCount) override;
+	bool BSubmit(vr::Hmd_Eye nEye, GLuint unTexture, const vr::VRTextureBounds_t &bounds, const vr::HmdMatrix34_t* pRenderPose) override;
+	bool BGetCompositorStats(uint32_t &unDroppedFrames, uint32_t &unReprojectedFrames) override;
+
+private:
+
+	std::unique_ptr<VR_Helper> helper;
+	vr::IVRSystem *m_pHMD;
+	bool m_bDebugPrint;
+
+	struct HandActions_t
+	{
+#ifdef __APPLE__
+		VRInputValueHandle_t m_source = vr::k_ulInvalidInputValueHandle;
+		VRActionHandle_t m_actionPose = vr::k_ulInvalidActionHandle;
+		VRActionHandle_t m_actionHaptic = vr::k_ulInvalidActionHandle;
+#else
+		vr::VRInputValueHandle_t m_source = vr::k_ulInvalidInputValueHandle;
+		vr::VRActionHandle_t m_actionPose = vr::k_ulInvalidActionHandle;
+		vr::VRActionHandle_t m_actionHaptic = vr::k_ulInvalidActionHandle;
+#endif
+	};
+	HandActions_t m_rHand[2];
+
+#ifdef __APPLE__
+	VRActionHandle_t m_actionRotateStructure = vr::k_ulInvalidActionHandle;
+	VRActionHandle_t m_actionHideThisController = vr::k_ulInvalidActionHandle;
+	VRActionHandle_t m_actionTriggerHaptic = vr::k_ulInvalidActionHandle;
+	VRActionHandle_t m_actionAnalongInput = vr::k_ulInvalidActionHandle;
+
+	VRActionSetHandle_t m_actionsetAvr = vr::k_ulInvalidActionSetHandle;
+#else
+	vr::VRActionHandle_t m_actionRotateStructure = vr::k_ulInvalidActionHandle;
+	vr::VRActionHandle_t m_actionHideThisController = vr::k_ulInvalidActionHandle;
+	vr::VRActionHandle_t m_actionTriggerHaptic = vr::k_ulInvalidActionHandle;
+	vr::VRActionHandle_t m_actionAnalongInput = vr::k_ulInvalidActionHandle;
+
+	vr::VRActionSetHandle_t m_actionsetAvr = vr::k_ulInvalidActionSetHandle;
+#endif
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "PoseSampler.hpp"
+#include "Profiler.hpp"
+
+#include <chrono>
+
+namespace
+{
+	// the runtime's tracking updates at about 1 kHz, sampling faster gains nothing
+	const std::chrono::microseconds k_samplePeriod(1000);
+}
+
+//-----------------------------------------------------------------------------
+PoseSampler::PoseSampler() :
+	m_pBackend(nullptr),
+	m_bStopping(false),
+	m_nPhotonNs(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+PoseSampler::~PoseSampler()
+{
+	Stop();
+}
+
+//-----------------------------------------------------------------------------
+bool PoseSampler::BStart(IVRBackend* pBackend)
+{
+	if(m_sampler.joinable()) return false;
+
+	m_pBackend = pBackend;
+	m_bStopping = false;
+	m_sampler = std::thread(&PoseSampler::SamplerLoop, this);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void PoseSampler::Stop()
+{
+	if(!m_sampler.joinable()) return;
+
+	m_bStopping = true;
+	m_sampler.join();
+}
+
+//-----------------------------------------------------------------------------
+bool PoseSampler::BLatest(int64_t nPhotonNs, Snapshot &snapshot)
+{
+	m_snapshots.BAcquire();
+	const Snapshot &latest = m_snapshots.GetReadBuffer();
+	if(!latest.bValid || latest.nPhotonNs != nPhotonNs) return false;
+
+	snapshot = latest;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Sampler thread. Nothing is published until the first photon time is set.
+//-----------------------------------------------------------------------------
+void PoseSampler::SamplerLoop()
+{
+	vr::TrackedDevicePose_t hmdPose;
+
+	while(!m_bStopping.load(std::memory_order_relaxed))
+	{
+		int64_t nPhotonNs = m_nPhotonNs.load(std::memory_order_acquire);
+		if(nPhotonNs > 0)
+		{
+			int64_t nNowNs = Profiler::NowNs();
+			float fSecondsFromNow = nPhotonNs > nNowNs ? (float)((double)(nPhotonNs - nNowNs) * 1.0e-9) : 0.0f;
+			if(m_pBackend->BGetPredictedPoses(fSecondsFromNow, &hmdPose, 1))
+			{
+				Snapshot &snapshot = m_snapshots.GetWriteBuffer();
+				snapshot.bValid = hmdPose.bPoseIsValid;
+				snapshot.matHmd = hmdPose.mDeviceToAbsoluteTracking;
+				snapshot.nPhotonNs = nPhotonNs;
+				snapshot.nSampleNs = nNowNs;
+				m_snapshots.Publish();
+			}
+		}
+		std::this_thread::sleep_for(k_samplePeriod);
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef POSESAMPLER_HPP
+#define POSESAMPLER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "VRBackend.hpp"
+#include "TripleBuffer.hpp"
+
+//-----------------------------------------------------------------------------
+// Asks the runtime for the head pose about once a millisecond on a thread of
+// its own, predicted to when the frame being drawn will be seen, and hands
+// the newest one to the render thread without either side waiting.
+//
+// WaitGetPoses() predicts the head from where it was at the top of the
+// frame; by the time the eyes are drawn that is several milliseconds of
+// simulation and culling old. Latching the sampler's latest snapshot just
+// before each eye leaves only the draw itself between the tracker and the
+// pose it is drawn with.
+//
+// SetPhotonTime() once a frame gives the time to predict to. A snapshot
+// carries the time it was predicted for, so one taken for the previous
+// frame is never mistaken for this one's.
+//-----------------------------------------------------------------------------
+class PoseSampler {
+
+public:
+
+	struct Snapshot
+	{
+		bool bValid = false;
+		vr::HmdMatrix34_t matHmd;		// device to tracking, as the runtime gives it
+		int64_t nPhotonNs = 0;			// predicted for
+		int64_t nSampleNs = 0;			// taken at
+	};
+
+	PoseSampler();
+	~PoseSampler();
+
+	bool BStart(IVRBackend* pBackend);
+	// has to come before the runtime shuts down
+	void Stop();
+	bool BIsRunning() const { return m_sampler.joinable(); }
+
+	void SetPhotonTime(int64_t nPhotonNs) { m_nPhotonNs.store(nPhotonNs, std::memory_order_release); }
+
+	// render thread, the newest snapshot predicted for nPhotonNs, false if
+	// there isn't one yet
+	bool BLatest(int64_t nPhotonNs, Snapshot &snapshot);
+
+private:
+
+	void SamplerLoop();
+
+	IVRBackend* m_pBackend;
+	std::thread m_sampler;
+	std::atomic<bool> m_bStopping;
+	std::atomic<int64_t> m_nPhotonNs;
+	TripleBuffer<Snapshot> m_snapshots;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "PoseTrace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+//-----------------------------------------------------------------------------
+bool PoseTrace::BLoad(const std::string &strPath)
+{
+	std::ifstream file(strPath);
+	if(!file){
+		std::cout << "Error: could not open pose trace " << strPath << std::endl;
+		return false;
+	}
+
+	m_vecSamples.clear();
+	std::string strLine;
+	uint32_t unLine = 0;
+	while(std::getline(file, strLine)){
+		unLine++;
+		if(strLine.empty() || strLine[0] == '#') continue;
+
+		std::istringstream stream(strLine);
+		Sample sample;
+		stream >> sample.dTime;
+		for(uint32_t d = 0; d < Device_Count; d++){
+			int nValid = 0;
+			stream >> nValid;
+			sample.rbValid[d] = nValid != 0;
+			for(uint32_t r = 0; r < 3; r++){
+				for(uint32_t c = 0; c < 4; c++) stream >> sample.rmatPose[d].m[r][c];
+			}
+		}
+		if(stream.fail()){
+			std::cout << "Error: pose trace " << strPath << " line " << unLine << " is malformed" << std::endl;
+			return false;
+		}
+		if(!m_vecSamples.empty() && sample.dTime < m_vecSamples.back().dTime){
+			std::cout << "Error: pose trace " << strPath << " goes back in time at line " << unLine << std::endl;
+			return false;
+		}
+		m_vecSamples.push_back(sample);
+	}
+
+	if(m_vecSamples.empty()){
+		std::cout << "Error: pose trace " << strPath << " has no samples" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+bool PoseTrace::BSave(const std::string &strPath) const
+{
+	std::ofstream file(strPath);
+	if(!file){
+		std::cout << "Error: could not open " << strPath << " for the pose trace" << std::endl;
+		return false;
+	}
+
+	file << "# seconds, then valid + 3x4 row major for hmd, left hand, right hand\n";
+	file << std::fixed << std::setprecision(6);
+	for(const Sample &sample : m_vecSamples){
+		file << sample.dTime;
+		for(uint32_t d = 0; d < Device_Count; d++){
+			file << ' ' << (sample.rbValid[d] ? 1 : 0);
+			for(uint32_t r = 0; r < 3; r++){
+				for(uint32_t c = 0; c < 4; c++) file << ' ' << sample.rmatPose[d].m[r][c];
+			}
+		}
+		file << '\n';
+	}
+
+	std::cout << "PoseTrace: wrote " << m_vecSamples.size() << " samples to " << strPath << std::endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+const PoseTrace::Sample& PoseTrace::SampleAt(double dTime) const
+{
+	double dDuration = GetDuration();
+	if(dDuration > 0.0) dTime = std::fmod(dTime, dDuration);
+
+	auto it = std::upper_bound(m_vecSamples.begin(), m_vecSamples.end(), dTime, [](double dValue, const Sample &sample){
+		return dValue < sample.dTime;
+	});
+	return it == m_vecSamples.begin() ? m_vecSamples.front() : *(it - 1);
+}
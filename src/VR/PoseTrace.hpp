@@ -0,0 +1,50 @@
+#ifndef POSETRACE_HPP
+#define POSETRACE_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "VR_Helper.hpp"
+
+//-----------------------------------------------------------------------------
+// Head and hand poses over time, recorded from a session and replayed by
+// the mock runtime. Stored as text, one sample a line: the time in seconds,
+// then for the HMD, the left hand and the right hand a valid flag and the
+// twelve values of the 3x4 device to tracking matrix, row major.
+//-----------------------------------------------------------------------------
+class PoseTrace {
+
+public:
+
+	enum EDevice
+	{
+		Device_Hmd = 0,
+		Device_LeftHand,
+		Device_RightHand,
+		Device_Count
+	};
+
+	struct Sample
+	{
+		double dTime;
+		bool rbValid[Device_Count];
+		vr::HmdMatrix34_t rmatPose[Device_Count];
+	};
+
+	bool BLoad(const std::string &strPath);
+	bool BSave(const std::string &strPath) const;
+
+	void Add(const Sample &sample) { m_vecSamples.push_back(sample); }
+	bool BIsEmpty() const { return m_vecSamples.empty(); }
+	double GetDuration() const { return m_vecSamples.empty() ? 0.0 : m_vecSamples.back().dTime; }
+
+	// the last sample at or before dTime, looping over the trace
+	const Sample& SampleAt(double dTime) const;
+
+private:
+
+	std::vector<Sample> m_vecSamples;
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include "RenderModelLoader.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+namespace
+{
+	// how often the runtime is asked again while anything is still loading
+	const std::chrono::milliseconds k_pollInterval(2);
+}
+
+//-----------------------------------------------------------------------------
+RenderModelLoader::RenderModelLoader() :
+	m_pBackend(nullptr),
+	m_bStopping(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+RenderModelLoader::~RenderModelLoader()
+{
+	Stop();
+}
+
+//-----------------------------------------------------------------------------
+bool RenderModelLoader::BStart(IVRBackend* pBackend)
+{
+	if(m_loader.joinable()) return false;
+
+	m_pBackend = pBackend;
+	m_bStopping = false;
+	m_loader = std::thread(&RenderModelLoader::LoaderLoop, this);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Gives back to the runtime whatever it handed over that was never
+// uploaded. Has to come before the runtime shuts down.
+//-----------------------------------------------------------------------------
+void RenderModelLoader::Stop()
+{
+	if(!m_loader.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_one();
+	m_loader.join();
+
+	for(ModelLoad& load : m_dequeLoaded) Free(load);
+	for(ModelLoad& load : m_dequeUploading) Free(load);
+	m_dequeLoaded.clear();
+	m_dequeUploading.clear();
+	m_vecRequests.clear();
+	m_setTexturesLoading.clear();
+	m_setTexturesLoaded.clear();
+}
+
+//-----------------------------------------------------------------------------
+void RenderModelLoader::CleanUp()
+{
+	for(auto& model : m_mapModels)
+	{
+		delete model.second.pModel;
+	}
+	m_mapModels.clear();
+
+	for(auto& texture : m_mapTextures)
+	{
+		glDeleteTextures(1, &texture.second);
+	}
+	m_mapTextures.clear();
+}
+
+//-----------------------------------------------------------------------------
+CGLRenderModel* RenderModelLoader::FindOrRequest(const std::string& strName, bool& bLoading)
+{
+	std::string strKey(strName);
+	std::transform(strKey.begin(), strKey.end(), strKey.begin(), [](unsigned char c){ return (char)std::tolower(c); });
+
+	auto it = m_mapModels.find(strKey);
+	if(it != m_mapModels.end())
+	{
+		bLoading = it->second.eState == ModelState_Loading;
+		return it->second.pModel;
+	}
+
+	bLoading = false;
+	if(!m_loader.joinable()) return nullptr;
+
+	m_mapModels[strKey] = CacheEntry();
+	bLoading = true;
+
+	ModelLoad load;
+	load.strName = strName;
+	load.strKey = strKey;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_vecRequests.push_back(std::move(load));
+	}
+	m_wake.notify_one();
+	return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Textures go up on their own, a frame's budget allowing, so a model with
+// a large texture takes two frames rather than one long one.
+//-----------------------------------------------------------------------------
+void RenderModelLoader::ProcessUploads(size_t unByteBudget)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while(!m_dequeLoaded.empty())
+		{
+			m_dequeUploading.push_back(std::move(m_dequeLoaded.front()));
+			m_dequeLoaded.pop_front();
+		}
+	}
+
+	size_t unSpent = 0;
+	while(!m_dequeUploading.empty() && (unSpent == 0 || unSpent < unByteBudget))
+	{
+		ModelLoad& load = m_dequeUploading.front();
+		if(!load.pModel)
+		{
+			FinishUpload(load, 0);
+			m_dequeUploading.pop_front();
+			continue;
+		}
+
+		vr::TextureID_t unTexture = load.pModel->diffuseTextureId;
+		if(load.pTexture)
+		{
+			m_mapTextures[unTexture] = CGLRenderModel::CreateDiffuseTexture(*load.pTexture);
+			unSpent += (size_t)load.pTexture->unWidth * load.pTexture->unHeight * 4;
+			m_pBackend->FreeRenderModelTexture(load.pTexture);
+			load.pTexture = nullptr;
+			continue;
+		}
+
+		auto it = m_mapTextures.find(unTexture);
+		unSpent += sizeof(vr::RenderModel_Vertex_t) * load.pModel->unVertexCount + sizeof(uint16_t) * load.pModel->unTriangleCount * 3;
+		FinishUpload(load, it != m_mapTextures.end() ? it->second : 0);
+		m_dequeUploading.pop_front();
+	}
+}
+
+//-----------------------------------------------------------------------------
+void RenderModelLoader::FinishUpload(ModelLoad& load, GLuint glTexture)
+{
+	CacheEntry& entry = m_mapModels[load.strKey];
+	if(load.pModel && glTexture)
+	{
+		CGLRenderModel* pRenderModel = new CGLRenderModel(load.strName);
+		if(pRenderModel->BInit(*load.pModel, glTexture))
+		{
+			entry.pModel = pRenderModel;
+			entry.eState = ModelState_Ready;
+		}
+		else
+		{
+			delete pRenderModel;
+		}
+	}
+
+	if(entry.eState != ModelState_Ready)
+	{
+		entry.eState = ModelState_Failed;
+		Logger::Write(LogLevel_Warning, "Unable to load render model %s\n", load.strName.c_str());
+	}
+	Free(load);
+}
+
+//-----------------------------------------------------------------------------
+void RenderModelLoader::Free(ModelLoad& load)
+{
+	if(load.pModel) m_pBackend->FreeRenderModel(load.pModel);
+	if(load.pTexture) m_pBackend->FreeRenderModelTexture(load.pTexture);
+	load.pModel = nullptr;
+	load.pTexture = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Loads finish in the order they were asked for where they can, and a
+// model waiting on a texture another load is fetching is handed over only
+// after that one, so its texture is always up by the time it is uploaded.
+//-----------------------------------------------------------------------------
+void RenderModelLoader::LoaderLoop()
+{
+	std::vector<ModelLoad> vecDone;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for(;;)
+	{
+		if(m_vecInFlight.empty())
+			m_wake.wait(lock, [this]{ return m_bStopping || !m_vecRequests.empty(); });
+		else
+			m_wake.wait_for(lock, k_pollInterval, [this]{ return m_bStopping; });
+		if(m_bStopping) break;
+
+		for(ModelLoad& load : m_vecRequests) m_vecInFlight.push_back(std::move(load));
+		m_vecRequests.clear();
+		lock.unlock();
+
+		for(size_t i = 0; i < m_vecInFlight.size();)
+		{
+			if(BPoll(m_vecInFlight[i]))
+			{
+				vecDone.push_back(std::move(m_vecInFlight[i]));
+				m_vecInFlight.erase(m_vecInFlight.begin() + i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		lock.lock();
+		for(ModelLoad& load : vecDone) m_dequeLoaded.push_back(std::move(load));
+		vecDone.clear();
+	}
+	lock.unlock();
+
+	for(ModelLoad& load : m_vecInFlight) Free(load);
+	m_vecInFlight.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Loader thread. True once the load is done with, whether or not it worked.
+//-----------------------------------------------------------------------------
+bool RenderModelLoader::BPoll(ModelLoad& load)
+{
+	if(!load.pModel)
+	{
+		ERenderModelStatus eStatus = m_pBackend->PollRenderModel(load.strName.c_str(), &load.pModel);
+		if(eStatus != RenderModelStatus_Ready)
+		{
+			load.pModel = nullptr;
+			return eStatus == RenderModelStatus_Failed;
+		}
+	}
+
+	vr::TextureID_t unTexture = load.pModel->diffuseTextureId;
+	if(!load.bOwnsTexture)
+	{
+		if(m_setTexturesLoaded.count(unTexture)) return true;
+		if(m_setTexturesLoading.count(unTexture)) return false;
+		m_setTexturesLoading.insert(unTexture);
+		load.bOwnsTexture = true;
+	}
+
+	ERenderModelStatus eStatus = m_pBackend->PollRenderModelTexture(unTexture, &load.pTexture);
+	if(eStatus == RenderModelStatus_Loading)
+	{
+		load.pTexture = nullptr;
+		return false;
+	}
+
+	m_setTexturesLoading.erase(unTexture);
+	if(eStatus == RenderModelStatus_Ready)
+	{
+		m_setTexturesLoaded.insert(unTexture);
+		return true;
+	}
+
+	// no use without its texture; another load of it may still try again
+	load.pTexture = nullptr;
+	m_pBackend->FreeRenderModel(load.pModel);
+	load.pModel = nullptr;
+	return true;
+}
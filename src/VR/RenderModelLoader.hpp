@@ -0,0 +1,106 @@
+#ifndef RENDERMODELLOADER_HPP
+#define RENDERMODELLOADER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "VRBackend.hpp"
+#include "CGLRenderModel.hpp"
+
+//-----------------------------------------------------------------------------
+// Loads controller render models without stalling the frame. The runtime
+// fetches models and textures asynchronously and has to be polled until
+// they arrive, which can take seconds the first time a controller shows
+// up; a thread of its own does the polling, and the render thread only
+// ever looks a name up in the cache.
+//
+// What the loader thread hands back is uploaded to GL by ProcessUploads(),
+// called once a frame on the render thread, a bounded number of bytes at a
+// time so a model arriving never costs a frame its budget. Models that
+// share a diffuse texture, the left and right hand of most controllers,
+// share one GL texture, and the runtime is asked for it once.
+//-----------------------------------------------------------------------------
+class RenderModelLoader {
+
+public:
+
+	RenderModelLoader();
+	~RenderModelLoader();
+
+	// the backend has to outlive the loader, or at least Stop()
+	bool BStart(IVRBackend* pBackend);
+	void Stop();
+
+	// render thread. The model once it is uploaded, nullptr while it loads
+	// or if the runtime has none by that name; the first call queues it.
+	CGLRenderModel* FindOrRequest(const std::string& strName, bool& bLoading);
+
+	// render thread with the GL context current, at least one upload a
+	// frame whatever the budget
+	void ProcessUploads(size_t unByteBudget);
+
+	// render thread with the GL context current, after Stop()
+	void CleanUp();
+
+private:
+
+	enum EModelState
+	{
+		ModelState_Loading,
+		ModelState_Ready,
+		ModelState_Failed
+	};
+
+	struct CacheEntry
+	{
+		EModelState eState = ModelState_Loading;
+		CGLRenderModel* pModel = nullptr;
+	};
+
+	// queued by the render thread, polled by the loader thread and handed
+	// back once done; pModel is nullptr if loading failed, and pTexture if
+	// the texture came with an earlier model
+	struct ModelLoad
+	{
+		std::string strName;
+		std::string strKey;
+		vr::RenderModel_t* pModel = nullptr;
+		vr::RenderModel_TextureMap_t* pTexture = nullptr;
+		bool bOwnsTexture = false;				// the one load asking the runtime for it
+	};
+
+	void LoaderLoop();
+	bool BPoll(ModelLoad& load);
+	void Free(ModelLoad& load);
+	void FinishUpload(ModelLoad& load, GLuint glTexture);
+
+	IVRBackend* m_pBackend;
+	std::thread m_loader;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::vector<ModelLoad> m_vecRequests;
+	std::deque<ModelLoad> m_dequeLoaded;		// in the order they finished
+	bool m_bStopping;
+
+	// loader thread only
+	std::vector<ModelLoad> m_vecInFlight;
+	std::unordered_set<vr::TextureID_t> m_setTexturesLoading;
+	std::unordered_set<vr::TextureID_t> m_setTexturesLoaded;
+
+	// render thread only, keyed by the lower cased name
+	std::unordered_map<std::string, CacheEntry> m_mapModels;
+	std::unordered_map<vr::TextureID_t, GLuint> m_mapTextures;
+	std::deque<ModelLoad> m_dequeUploading;		// pTexture is nullptr once its texture is up
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "TrackedDeviceRegistry.hpp"
+
+static_assert(vr::k_unMaxTrackedDeviceCount <= 64, "one bit per device in the dirty and connected masks");
+
+//-----------------------------------------------------------------------------
+TrackedDeviceRegistry::TrackedDeviceRegistry() :
+	m_pBackend(nullptr),
+	m_ulDirty(~0ull),
+	m_ulConnected(0),
+	m_unConnectedCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+void TrackedDeviceRegistry::Reset(IVRBackend* pBackend)
+{
+	m_pBackend = pBackend;
+	m_ulDirty = ~0ull;
+	m_ulConnected = 0;
+	m_unConnectedCount = 0;
+	if(!m_pBackend) return;
+
+	for(uint32_t unDevice = 0; unDevice < vr::k_unMaxTrackedDeviceCount; unDevice++)
+	{
+		if(GetClass(unDevice) != vr::TrackedDeviceClass_Invalid)
+			SetConnected(unDevice, true);
+	}
+}
+
+//-----------------------------------------------------------------------------
+void TrackedDeviceRegistry::ProcessEvent(const vr::VREvent_t &event)
+{
+	if(event.trackedDeviceIndex >= vr::k_unMaxTrackedDeviceCount) return;
+
+	switch(event.eventType)
+	{
+	case vr::VREvent_TrackedDeviceActivated:
+		m_ulDirty |= 1ull << event.trackedDeviceIndex;
+		SetConnected(event.trackedDeviceIndex, true);
+		break;
+	case vr::VREvent_TrackedDeviceDeactivated:
+		m_ulDirty |= 1ull << event.trackedDeviceIndex;
+		SetConnected(event.trackedDeviceIndex, false);
+		break;
+	case vr::VREvent_TrackedDeviceUpdated:
+		m_ulDirty |= 1ull << event.trackedDeviceIndex;
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The list is only rebuilt when a device comes or goes, in index order so
+// the head is always first.
+//-----------------------------------------------------------------------------
+void TrackedDeviceRegistry::SetConnected(vr::TrackedDeviceIndex_t unDevice, bool bConnected)
+{
+	uint64_t ulBit = 1ull << unDevice;
+	if(bConnected == ((m_ulConnected & ulBit) != 0)) return;
+
+	if(bConnected)
+		m_ulConnected |= ulBit;
+	else
+		m_ulConnected &= ~ulBit;
+
+	m_unConnectedCount = 0;
+	for(uint32_t unIndex = 0; unIndex < vr::k_unMaxTrackedDeviceCount; unIndex++)
+	{
+		if(m_ulConnected & (1ull << unIndex))
+			m_runConnected[m_unConnectedCount++] = unIndex;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Forgets what was cached for a device that changed since it was last read.
+// The string buffers are kept for when it is fetched again.
+//-----------------------------------------------------------------------------
+TrackedDeviceRegistry::Device& TrackedDeviceRegistry::Refresh(vr::TrackedDeviceIndex_t unDevice)
+{
+	Device &device = m_rDevices[unDevice];
+	uint64_t ulBit = 1ull << unDevice;
+	if(m_ulDirty & ulBit)
+	{
+		device.bClassKnown = false;
+		device.chClass = 0;
+		for(auto &property : device.vecStrings) property.first = (vr::TrackedDeviceProperty)0;
+		m_ulDirty &= ~ulBit;
+	}
+	return device;
+}
+
+//-----------------------------------------------------------------------------
+vr::ETrackedDeviceClass TrackedDeviceRegistry::GetClass(vr::TrackedDeviceIndex_t unDevice)
+{
+	if(unDevice >= vr::k_unMaxTrackedDeviceCount || !m_pBackend) return vr::TrackedDeviceClass_Invalid;
+
+	Device &device = Refresh(unDevice);
+	if(!device.bClassKnown)
+	{
+		device.eClass = m_pBackend->GetTrackedDeviceClass(unDevice);
+		device.bClassKnown = true;
+	}
+	return device.eClass;
+}
+
+//-----------------------------------------------------------------------------
+char TrackedDeviceRegistry::GetClassChar(vr::TrackedDeviceIndex_t unDevice)
+{
+	if(unDevice >= vr::k_unMaxTrackedDeviceCount) return '?';
+
+	vr::ETrackedDeviceClass eClass = GetClass(unDevice);
+	Device &device = m_rDevices[unDevice];
+	if(device.chClass == 0)
+	{
+		switch (eClass)
+		{
+		case vr::TrackedDeviceClass_Controller:        device.chClass = 'C'; break;
+		case vr::TrackedDeviceClass_HMD:               device.chClass = 'H'; break;
+		case vr::TrackedDeviceClass_Invalid:           device.chClass = 'I'; break;
+		case vr::TrackedDeviceClass_GenericTracker:    device.chClass = 'G'; break;
+		case vr::TrackedDeviceClass_TrackingReference: device.chClass = 'T'; break;
+		default:                                       device.chClass = '?'; break;
+		}
+	}
+	return device.chClass;
+}
+
+//-----------------------------------------------------------------------------
+// The reference holds until the next call for the same device.
+//-----------------------------------------------------------------------------
+const std::string& TrackedDeviceRegistry::GetString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop)
+{
+	if(unDevice >= vr::k_unMaxTrackedDeviceCount || !m_pBackend) return m_strEmpty;
+
+	Device &device = Refresh(unDevice);
+	for(auto &property : device.vecStrings)
+	{
+		if(property.first == prop) return property.second;
+	}
+
+	// reuse a slot freed by Refresh() before growing
+	for(auto &property : device.vecStrings)
+	{
+		if(property.first == (vr::TrackedDeviceProperty)0)
+		{
+			property.first = prop;
+			property.second = m_pBackend->GetTrackedDeviceString(unDevice, prop);
+			return property.second;
+		}
+	}
+	device.vecStrings.emplace_back(prop, m_pBackend->GetTrackedDeviceString(unDevice, prop));
+	return device.vecStrings.back().second;
+}
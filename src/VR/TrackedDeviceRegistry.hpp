@@ -0,0 +1,66 @@
+#ifndef TRACKEDDEVICEREGISTRY_HPP
+#define TRACKEDDEVICEREGISTRY_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "VRBackend.hpp"
+
+//-----------------------------------------------------------------------------
+// What the runtime says about each tracked device, asked for once and kept
+// until the device changes. Every property read through the runtime is a
+// round trip and a string allocation, and the render model name of both
+// hands is wanted every frame; here it is a lookup.
+//
+// ProcessEvent() marks a device dirty when the runtime reports it
+// activated, deactivated or updated, and the next read fetches it again.
+// The registry also keeps the devices currently connected as a compact
+// list, so per frame work walks the few devices there are rather than
+// every slot the runtime has.
+//
+// Render thread only.
+//-----------------------------------------------------------------------------
+class TrackedDeviceRegistry {
+
+public:
+
+	TrackedDeviceRegistry();
+
+	// asks the runtime which devices are already connected
+	void Reset(IVRBackend* pBackend);
+	void ProcessEvent(const vr::VREvent_t &event);
+
+	const uint32_t* GetConnectedDevices() const { return m_runConnected; }
+	uint32_t GetConnectedCount() const { return m_unConnectedCount; }
+
+	vr::ETrackedDeviceClass GetClass(vr::TrackedDeviceIndex_t unDevice);
+	// 'H', 'C', 'G', 'T', 'I' or '?', for the pose count line
+	char GetClassChar(vr::TrackedDeviceIndex_t unDevice);
+	// empty if the device doesn't have it
+	const std::string& GetString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop);
+
+private:
+
+	struct Device
+	{
+		bool bClassKnown = false;
+		vr::ETrackedDeviceClass eClass = vr::TrackedDeviceClass_Invalid;
+		char chClass = 0;
+		std::vector<std::pair<vr::TrackedDeviceProperty, std::string>> vecStrings;
+	};
+
+	Device& Refresh(vr::TrackedDeviceIndex_t unDevice);
+	void SetConnected(vr::TrackedDeviceIndex_t unDevice, bool bConnected);
+
+	IVRBackend* m_pBackend;
+	Device m_rDevices[vr::k_unMaxTrackedDeviceCount];
+	uint64_t m_ulDirty;				// a bit per device, cleared when it is read again
+	uint64_t m_ulConnected;
+	uint32_t m_runConnected[vr::k_unMaxTrackedDeviceCount];
+	uint32_t m_unConnectedCount;
+	std::string m_strEmpty;
+};
+
+#endif
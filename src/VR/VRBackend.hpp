@@ -0,0 +1,86 @@
+#ifndef VRBACKEND_HPP
+#define VRBACKEND_HPP
+
+#include <string>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+#include "VR_Helper.hpp"
+
+//-----------------------------------------------------------------------------
+// What the input actions resolved to this frame, for both hands.
+//-----------------------------------------------------------------------------
+struct VRInputState
+{
+	struct Hand
+	{
+		bool bPoseValid = false;
+		vr::HmdMatrix34_t matPose;
+		bool bHidden = false;
+		vr::TrackedDeviceIndex_t unDevice = vr::k_unTrackedDeviceIndexInvalid;	// behind the pose, for its render model
+	};
+
+	bool bRotate3D = false;
+	bool bAnalogValid = false;
+	float rfAnalog[2] = {0.0f, 0.0f};
+	Hand rHand[2];
+};
+
+enum ERenderModelStatus
+{
+	RenderModelStatus_Loading,
+	RenderModelStatus_Ready,
+	RenderModelStatus_Failed
+};
+
+//-----------------------------------------------------------------------------
+// Everything VR_Manager asks of the VR runtime. OpenVRBackend talks to
+// SteamVR; MockVRBackend stands in for it without a headset, so the full
+// two eye frame loop, controllers and compositor timing run anywhere.
+//-----------------------------------------------------------------------------
+class IVRBackend {
+
+public:
+
+	virtual ~IVRBackend() {}
+
+	virtual const char* GetName() const = 0;
+	virtual bool BInit() = 0;
+	virtual bool BInitCompositor() = 0;
+	virtual void Shutdown() = 0;
+
+	virtual std::string GetTrackedDeviceString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop) = 0;
+	virtual vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDevice) = 0;
+
+	virtual void GetRecommendedRenderTargetSize(uint32_t &unWidth, uint32_t &unHeight) = 0;
+	virtual vr::HmdMatrix44_t GetProjectionMatrix(vr::Hmd_Eye nEye, float fNear, float fFar) = 0;
+	virtual void GetProjectionRaw(vr::Hmd_Eye nEye, float &fLeft, float &fRight, float &fTop, float &fBottom) = 0;
+	virtual vr::HmdMatrix34_t GetEyeToHeadTransform(vr::Hmd_Eye nEye) = 0;
+
+	virtual float GetDisplayFrequency() = 0;
+	virtual float GetSecondsFromVsyncToPhotons() = 0;
+	virtual float GetSecondsSinceLastVsync() = 0;
+	// safe from any thread, where the devices are predicted to be that long
+	// from now
+	virtual bool BGetPredictedPoses(float fSecondsFromNow, vr::TrackedDevicePose_t* pPoses, uint32_t unCount) = 0;
+
+	virtual bool BPollNextEvent(vr::VREvent_t &event) = 0;
+	virtual bool BIsInputAvailable() = 0;
+	virtual void UpdateInput(VRInputState &state) = 0;
+	// polled from the render model loader's thread until no longer loading,
+	// what comes back ready belongs to the runtime until it is freed
+	virtual ERenderModelStatus PollRenderModel(const char* pchRenderModelName, vr::RenderModel_t** ppModel) = 0;
+	virtual ERenderModelStatus PollRenderModelTexture(vr::TextureID_t unTexture, vr::RenderModel_TextureMap_t** ppTexture) = 0;
+	virtual void FreeRenderModel(vr::RenderModel_t* pModel) = 0;
+	virtual void FreeRenderModelTexture(vr::RenderModel_TextureMap_t* pTexture) = 0;
+
+	// blocks until the runtime wants the next frame started
+	virtual void WaitGetPoses(vr::TrackedDevicePose_t* pPoses, uint32_t unCount) = 0;
+	// pRenderPose is the head pose the eye was drawn with, null if it was
+	// the one WaitGetPoses() gave
+	virtual bool BSubmit(vr::Hmd_Eye nEye, GLuint unTexture, const vr::VRTextureBounds_t &bounds, const vr::HmdMatrix34_t* pRenderPose) = 0;
+	virtual bool BGetCompositorStats(uint32_t &unDroppedFrames, uint32_t &unReprojectedFrames) = 0;
+};
+
+#endif
@@ -8,6 +8,8 @@
 #include "openvr/openvr.h"
 #elif _WIN32
 #include "openvr.h"
+#else
+#include "openvr/openvr.h"
 #endif
 
 class VR_Helper {
@@ -19,7 +21,7 @@ public :
 #ifdef __APPLE__
 	bool GetDigitalActionRisingEdge(VRActionHandle_t action, VRInputValueHandle_t *pDevicePath = nullptr);
 	bool GetDigitalActionState(VRActionHandle_t action, VRInputValueHandle_t *pDevicePath = nullptr);
-#elif _WIN32
+#else
 	bool GetDigitalActionRisingEdge(vr::VRActionHandle_t action, vr::VRInputValueHandle_t *pDevicePath = nullptr);
 	bool GetDigitalActionState(vr::VRActionHandle_t action, vr::VRInputValueHandle_t *pDevicePath = nullptr);
 #endif
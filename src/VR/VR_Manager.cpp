@@ -2,10 +2,13 @@
 #include <cstring>
 
 #include "VR_Manager.hpp"
+#include "OpenVRBackend.hpp"
+#include "MockVRBackend.hpp"
+#include "Profiler.hpp"
 
 #include <GL/glew.h>
 
-#ifdef __APPLE__ 
+#if defined(__APPLE__) || defined(__linux__)
 #include "GLFW/glfw3.h"
 
 #define _stricmp strcasecmp
@@ -13,81 +16,81 @@
 
 #elif _WIN32 
 #include "glfw3.h"
-#include "pathtools.h"
 #endif
 
+namespace
+{
+	// a matrix conversion is cheap, don't split the device array finer than this
+	const uint32_t k_unPosesPerJob = 16;
+	// GL upload of controller render models per frame, a texture or a mesh
+	// larger than this still goes up whole
+	const size_t k_unRenderModelUploadBytes = 1024 * 1024;
+}
+
 //-----------------------------------------
 // Constructor
 //------------------------------------------
 VR_Manager::VR_Manager(std::unique_ptr<ExecutionFlags>& flagPtr) : 
+	m_bActive(false),
+	m_bEyeConfigurationChanged(false),
+	m_fDisplayFrequency(0.0f),
+	m_fSecondsFromVsyncToPhotons(0.0f),
+	m_bLateLatch(true),
+	m_nPhotonNs(0),
+	m_nPoseNs(0),
 	m_bRotate3D(false),
-	m_pHMD(NULL),
 	m_iValidPoseCount(0),
-	m_strPoseClasses(""){
-
-	helper = std::make_unique<VR_Helper>();
+	m_nRecordStartNs(-1),
+	m_pJobSystem(nullptr),
+	m_pSessionRecorder(nullptr),
+	m_pSessionReplayer(nullptr){
 
 	m_bDebugPrint = flagPtr->flagDPrint; 
+
+	if(flagPtr->flagMockVR){
+		MockVRConfig config;
+		config.strPoseTrace = flagPtr->strMockVRTrace;
+		config.fDisplayFrequency = flagPtr->fMockVRFrequency;
+		if(flagPtr->unMockVRWidth > 0 && flagPtr->unMockVRHeight > 0){
+			config.unRenderWidth = flagPtr->unMockVRWidth;
+			config.unRenderHeight = flagPtr->unMockVRHeight;
+		}
+		if(flagPtr->fMockVRIpd > 0.0f) config.fIpd = flagPtr->fMockVRIpd * 0.001f;
+		m_pBackend = std::make_unique<MockVRBackend>(config);
+	} else {
+		m_pBackend = std::make_unique<OpenVRBackend>(m_bDebugPrint);
+	}
+
+	m_strRecordPoses = flagPtr->strRecordPoses;
+	m_bLateLatch = flagPtr->flagLateLatch;
+	m_rbRenderPoseLatched[0] = m_rbRenderPoseLatched[1] = false;
+	m_rchPoseClasses[0] = 0;
+	m_mat4HMDPose = glm::mat4(1.0f);
 }
 
 //-------------------------------------
 bool VR_Manager::BInit(){
 
-	// Load SteamVR runtime
-	vr::EVRInitError eError = vr::VRInitError_None;
-
-#ifdef _WIN32
-	m_pHMD = vr::VR_Init(&eError, vr::VRApplication_Scene);
-#else
-	m_pHMD = vr::VR_Init(&eError, vr::VRApplication_Utility);
-#endif
-
-	if(eError != vr::VRInitError_None)
-	{
-		m_pHMD = NULL;
+	if(!m_pBackend->BInit())
 		return false;
-	}
+	m_bActive = true;
 	
 	m_strDriver = "No Driver";
 	m_strDisplay = "No Display";
 
-	m_strDriver = helper->GetTrackedDeviceString(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_TrackingSystemName_String);
-	m_strDisplay = helper->GetTrackedDeviceString(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SerialNumber_String);
+	m_strDriver = m_pBackend->GetTrackedDeviceString(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_TrackingSystemName_String);
+	m_strDisplay = m_pBackend->GetTrackedDeviceString(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SerialNumber_String);
 
 	std::cout << "Device name: " << m_strDriver << "\nDevice number: " << m_strDisplay << std::endl;
 
-	//if (!BInitCompositor())
-	//{
-	//	std::cout << __FUNCTION__ << " - Failed to initialize VR Compositor!\n" << std::endl;
-	//	return false;
-	//}
-
-//*********** removing pathtools from osx build *************//
-#ifdef __APPLE__
-	std::string manifestPath = "/Users/bryandunphy/Projects/5CellAVR/src/VR/avr_actions.json";
-	vr::VRInput()->SetActionManifestPath(manifestPath.c_str()); 
-#elif _WIN32
-	vr::VRInput()->SetActionManifestPath( Path_MakeAbsolute( "../../src/VR/avr_actions.json", Path_StripFilename( Path_GetExecutablePath() ) ).c_str() );
-#endif
-	
-	vr::VRInput()->GetActionHandle( "/actions/avr/in/RotateStructure", &m_actionRotateStructure);
-	vr::VRInput()->GetActionHandle( "/actions/avr/in/HideThisController", &m_actionHideThisController);
-	vr::VRInput()->GetActionHandle( "/actions/avr/in/TriggerHaptic", &m_actionTriggerHaptic );
-	vr::VRInput()->GetActionHandle( "/actions/avr/in/AnalogInput", &m_actionAnalongInput );
-
-	vr::VRInput()->GetActionSetHandle( "/actions/avr", &m_actionsetAvr );
-
-	vr::VRInput()->GetActionHandle( "/actions/avr/out/Haptic_Left", &m_rHand[Left].m_actionHaptic );
-	vr::VRInput()->GetInputSourceHandle( "/user/hand/left", &m_rHand[Left].m_source );
-	vr::VRInput()->GetActionHandle( "/actions/avr/in/Hand_Left", &m_rHand[Left].m_actionPose );
-
-	vr::VRInput()->GetActionHandle( "/actions/avr/out/Haptic_Right", &m_rHand[Right].m_actionHaptic );
-	vr::VRInput()->GetInputSourceHandle( "/user/hand/right", &m_rHand[Right].m_source );
-	vr::VRInput()->GetActionHandle( "/actions/avr/in/Hand_Right", &m_rHand[Right].m_actionPose );
-
 	m_fNearClip = 0.1f;
 	m_fFarClip = 30.0f;
 
+	m_deviceRegistry.Reset(m_pBackend.get());
+	m_renderModelLoader.BStart(m_pBackend.get());
+	if(m_bLateLatch)
+		m_poseSampler.BStart(m_pBackend.get());
+
 	return true;
 }
 
@@ -97,15 +100,7 @@ bool VR_Manager::BInit(){
 //-----------------------------------------------------------------------------
 bool VR_Manager::BInitCompositor()
 {
-	vr::EVRInitError peError = vr::VRInitError_None;
-
-	if ( !vr::VRCompositor() )
-	{
-		std::cout << "Compositor initialization failed.\n" << std::endl;
-		return false;
-	}
-
-	return true;
+	return m_pBackend->BInitCompositor();
 }
 
 
@@ -113,17 +108,25 @@ bool VR_Manager::BInitCompositor()
 //--------------------------------------
 void VR_Manager::ExitVR(){
 
-	if(m_pHMD)
+	if(!m_strRecordPoses.empty() && !m_recordedPoses.BIsEmpty())
 	{
-		vr::VR_Shutdown();
-		m_pHMD = NULL;
+		m_recordedPoses.BSave(m_strRecordPoses);
 	}
 
-	for( std::vector< CGLRenderModel * >::iterator i = m_vecRenderModels.begin(); i != m_vecRenderModels.end(); i++ )
+	m_renderModelLoader.Stop();
+	m_poseSampler.Stop();
+
+	if(m_bActive)
 	{
-		delete (*i);
+		m_pBackend->Shutdown();
+		m_bActive = false;
+	}
+
+	m_renderModelLoader.CleanUp();
+	for (EHand eHand = Left; eHand <= Right; ((int&)eHand)++)
+	{
+		m_rHand[eHand].m_pRenderModel = nullptr;
 	}
-	m_vecRenderModels.clear();
 
 }
 
@@ -132,135 +135,107 @@ void VR_Manager::ExitVR(){
 //-----------------------------------------------------------------------------
 bool VR_Manager::HandleInput()
 {
+	AVR_PROFILE_SCOPE("VR_Manager::HandleInput");
 	bool bRet = false;
 
+	m_renderModelLoader.ProcessUploads(k_unRenderModelUploadBytes);
+
 	// Process SteamVR events
 	vr::VREvent_t event;
-	while(m_pHMD->PollNextEvent(&event, sizeof(event)))
+	while(m_pBackend->BPollNextEvent(event))
 	{
 		ProcessVREvent(event);
 	}
 
-	// Process SteamVR action state
-	// UpdateActionState is called each frame to update the state of the actions themselves. The application
-	// controls which action sets are active with the provided array of VRActiveActionSet_t structs.
-	vr::VRActiveActionSet_t actionSet = {0};
-	actionSet.ulActionSet = m_actionsetAvr;
-	vr::VRInput()->UpdateActionState(&actionSet, sizeof(actionSet), 1);
+	m_pBackend->UpdateInput(m_inputState);
+	RecordOrReplayInput();
 
-	m_bRotate3D = false;
-	vr::VRInputValueHandle_t ulDevice;
-	if(helper->GetDigitalActionState(m_actionRotateStructure, &ulDevice))
+	m_bRotate3D = m_inputState.bRotate3D;
+	if(m_inputState.bAnalogValid)
 	{
-		if(ulDevice == m_rHand[Left].m_source || ulDevice == m_rHand[Right].m_source)
-		{
-			m_bRotate3D = true;
-		}
-	} 
+		m_vAnalogValue[0] = m_inputState.rfAnalog[0];
+		m_vAnalogValue[1] = m_inputState.rfAnalog[1];
+	}
 
-	vr::VRInputValueHandle_t ulHapticDevice;
-	if (helper->GetDigitalActionRisingEdge(m_actionTriggerHaptic, &ulHapticDevice))
+	for (EHand eHand = Left; eHand <= Right; ((int&)eHand)++)
 	{
-		if (ulHapticDevice == m_rHand[Left].m_source)
-		{
-			vr::VRInput()->TriggerHapticVibrationAction(m_rHand[Left].m_actionHaptic, 0, 1, 4.f, 1.0f, vr::k_ulInvalidInputValueHandle);
-		}
-		if (ulHapticDevice == m_rHand[Right].m_source)
+		const VRInputState::Hand &hand = m_inputState.rHand[eHand];
+		m_rHand[eHand].m_bShowController = hand.bPoseValid && !hand.bHidden;
+		if(!hand.bPoseValid)
+			continue;
+
+		m_rHand[eHand].m_rmat4Pose = ConvertSteamVRMatrixToGlmMat4( hand.matPose );
+		const std::string &strRenderModelName = m_deviceRegistry.GetString( hand.unDevice, vr::Prop_RenderModelName_String );
+		if ( !strRenderModelName.empty() && ( strRenderModelName != m_rHand[eHand].m_sRenderModelName || m_rHand[eHand].m_bRenderModelLoading ) )
 		{
-			vr::VRInput()->TriggerHapticVibrationAction(m_rHand[Right].m_actionHaptic, 0, 1, 4.f, 1.0f, vr::k_ulInvalidInputValueHandle);
+			m_rHand[eHand].m_pRenderModel = FindOrLoadRenderModel(strRenderModelName, m_rHand[eHand].m_bRenderModelLoading);
+			m_rHand[eHand].m_sRenderModelName = strRenderModelName;
 		}
 	}
 
-	vr::InputAnalogActionData_t analogData;
-	if ( vr::VRInput()->GetAnalogActionData( m_actionAnalongInput, &analogData, sizeof( analogData ), vr::k_ulInvalidInputValueHandle ) == vr::VRInputError_None && analogData.bActive )
-	{
-		m_vAnalogValue[0] = analogData.x;
-		m_vAnalogValue[1] = analogData.y;
-	}
-
-	m_rHand[Left].m_bShowController = true;
-	m_rHand[Right].m_bShowController = true;
+	return bRet;
+}
 
-	vr::VRInputValueHandle_t ulHideDevice;
-	if (helper->GetDigitalActionState(m_actionHideThisController, &ulHideDevice))
+//-----------------------------------------------------------------------------
+// Writes the actions of this frame to the session log, or when replaying
+// one puts the recorded actions in place of the live ones. Render model
+// names aren't recorded, those of the live runtime are kept.
+//-----------------------------------------------------------------------------
+void VR_Manager::RecordOrReplayInput()
+{
+	if (m_pSessionRecorder)
 	{
-		if (ulHideDevice == m_rHand[Left].m_source)
+		SessionInput input;
+		input.unFlags = (m_inputState.bRotate3D ? SessionInput::k_unRotate3D : 0) | (m_inputState.bAnalogValid ? SessionInput::k_unAnalogValid : 0);
+		input.rfAnalog[0] = m_inputState.rfAnalog[0];
+		input.rfAnalog[1] = m_inputState.rfAnalog[1];
+		for (uint32_t unHand = 0; unHand < 2; unHand++)
 		{
-			m_rHand[Left].m_bShowController = false;
-		}
-		if (ulHideDevice == m_rHand[Right].m_source)
-		{
-			m_rHand[Right].m_bShowController = false;
+			const VRInputState::Hand &hand = m_inputState.rHand[unHand];
+			if (hand.bPoseValid) input.unFlags |= SessionInput::HandValid(unHand);
+			if (hand.bHidden) input.unFlags |= SessionInput::HandHidden(unHand);
+			memcpy(input.rfHandPose[unHand], hand.matPose.m, sizeof(input.rfHandPose[unHand]));
 		}
+		m_pSessionRecorder->Record(SessionRecord_Input, input);
 	}
 
-	for (EHand eHand = Left; eHand <= Right; ((int&)eHand)++)
+	SessionInput input;
+	if (m_pSessionReplayer && m_pSessionReplayer->BRead(m_pSessionReplayer->GetFrame(), SessionRecord_Input, input))
 	{
-		vr::InputPoseActionData_t poseData;
-
-#ifdef __APPLE__
-		if ( vr::VRInput()->GetPoseActionDataRelativeToNow( m_rHand[eHand].m_actionPose, vr::TrackingUniverseStanding, 0, &poseData, sizeof( poseData ), vr::k_ulInvalidInputValueHandle ) != vr::VRInputError_None
-			|| !poseData.bActive || !poseData.pose.bPoseIsValid )
-		{
-			m_rHand[eHand].m_bShowController = false;
-		}
-		else
-		{
-			m_rHand[eHand].m_rmat4Pose = ConvertSteamVRMatrixToGlmMat4( poseData.pose.mDeviceToAbsoluteTracking );
-#elif _WIN32
-		if ( vr::VRInput()->GetPoseActionData( m_rHand[eHand].m_actionPose, vr::TrackingUniverseStanding, 0, &poseData, sizeof( poseData ), vr::k_ulInvalidInputValueHandle ) != vr::VRInputError_None
-			|| !poseData.bActive || !poseData.pose.bPoseIsValid )
-		{
-			m_rHand[eHand].m_bShowController = false;
-		}
-		else
+		m_inputState.bRotate3D = (input.unFlags & SessionInput::k_unRotate3D) != 0;
+		m_inputState.bAnalogValid = (input.unFlags & SessionInput::k_unAnalogValid) != 0;
+		m_inputState.rfAnalog[0] = input.rfAnalog[0];
+		m_inputState.rfAnalog[1] = input.rfAnalog[1];
+		for (uint32_t unHand = 0; unHand < 2; unHand++)
 		{
-			m_rHand[eHand].m_rmat4Pose = ConvertSteamVRMatrixToGlmMat4( poseData.pose.mDeviceToAbsoluteTracking );
-#endif
-
-			vr::InputOriginInfo_t originInfo;
-			if ( vr::VRInput()->GetOriginTrackedDeviceInfo( poseData.activeOrigin, &originInfo, sizeof( originInfo ) ) == vr::VRInputError_None 
-				&& originInfo.trackedDeviceIndex != vr::k_unTrackedDeviceIndexInvalid )
-			{
-				std::string sRenderModelName = helper->GetTrackedDeviceString( originInfo.trackedDeviceIndex, vr::Prop_RenderModelName_String );
-				if ( sRenderModelName != m_rHand[eHand].m_sRenderModelName )
-				{
-					m_rHand[eHand].m_pRenderModel = FindOrLoadRenderModel(sRenderModelName.c_str());
-					m_rHand[eHand].m_sRenderModelName = sRenderModelName;
-				}
-			}
+			VRInputState::Hand &hand = m_inputState.rHand[unHand];
+			hand.bPoseValid = (input.unFlags & SessionInput::HandValid(unHand)) != 0;
+			hand.bHidden = (input.unFlags & SessionInput::HandHidden(unHand)) != 0;
+			memcpy(hand.matPose.m, input.rfHandPose[unHand], sizeof(input.rfHandPose[unHand]));
 		}
 	}
-
-	return bRet;
 }
 
 //-----------------------------------------------------------------------------
-// This function gets the dimensions of the far clip plane from
-// the projection matrix each frame. These values are then used to update
-// the quad sent to the raymarching shader.
-// ----------------------------------------------------------------------------
-glm::vec4 VR_Manager::GetFarPlaneDimensions(vr::Hmd_Eye nEye){
-	
-	float* pfLeft = new float;
-	float* pfRight = new float;
-	float* pfTop = new float;
-	float* pfBottom = new float;
-
-	m_pHMD->GetProjectionRaw(nEye, pfLeft, pfRight, pfTop, pfBottom);
-
-	float tanLeft = *pfLeft;
-	float tanRight = *pfRight;
-	float tanTop = *pfTop;
-	float tanBottom = *pfBottom;
-
-	delete pfLeft;
-	delete pfRight;
-	delete pfTop;
-	delete pfBottom;
+// Same for the head pose WaitGetPoses returned.
+//-----------------------------------------------------------------------------
+void VR_Manager::RecordOrReplayHmdPose()
+{
+	vr::TrackedDevicePose_t &hmdPose = m_rTrackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd];
+	if (m_pSessionRecorder)
+	{
+		SessionPose pose;
+		pose.unValid = hmdPose.bPoseIsValid ? 1 : 0;
+		memcpy(pose.rfPose, hmdPose.mDeviceToAbsoluteTracking.m, sizeof(pose.rfPose));
+		m_pSessionRecorder->Record(SessionRecord_HmdPose, pose);
+	}
 
-	glm::vec4 planeDimensions = glm::vec4(tanLeft, tanRight, tanTop, tanBottom);
-	return planeDimensions;
+	SessionPose pose;
+	if (m_pSessionReplayer && m_pSessionReplayer->BRead(m_pSessionReplayer->GetFrame(), SessionRecord_HmdPose, pose))
+	{
+		hmdPose.bPoseIsValid = pose.unValid != 0;
+		memcpy(hmdPose.mDeviceToAbsoluteTracking.m, pose.rfPose, sizeof(pose.rfPose));
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -268,6 +243,8 @@ glm::vec4 VR_Manager::GetFarPlaneDimensions(vr::Hmd_Eye nEye){
 //-----------------------------------------------------------------------------
 void VR_Manager::ProcessVREvent(const vr::VREvent_t & event)
 {
+	m_deviceRegistry.ProcessEvent(event);
+
 	switch(event.eventType)
 	{
 	case vr::VREvent_TrackedDeviceDeactivated:
@@ -278,6 +255,13 @@ void VR_Manager::ProcessVREvent(const vr::VREvent_t & event)
 	case vr::VREvent_TrackedDeviceUpdated:
 		{
 			std::cout << "Device " << event.trackedDeviceIndex << " updated." << std::endl;
+			if(event.trackedDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd)
+				m_bEyeConfigurationChanged = true;
+		}
+		break;
+	case vr::VREvent_IpdChanged:
+		{
+			m_bEyeConfigurationChanged = true;
 		}
 		break;
 	}
@@ -298,78 +282,64 @@ glm::mat4 VR_Manager::ConvertSteamVRMatrixToGlmMat4(const vr::HmdMatrix34_t &mat
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Finds a render model we've already loaded or loads a new one
+// Purpose: Finds a render model we've already loaded or starts loading a new
+//          one in the background. Asked again each frame while bLoading.
 //-----------------------------------------------------------------------------
-CGLRenderModel* VR_Manager::FindOrLoadRenderModel(const char* pchRenderModelName)
+CGLRenderModel* VR_Manager::FindOrLoadRenderModel(const std::string& strRenderModelName, bool& bLoading)
 {
-	CGLRenderModel* pRenderModel = NULL;
-	for(std::vector<CGLRenderModel*>::iterator i = m_vecRenderModels.begin(); i != m_vecRenderModels.end(); i++)
-	{
-		if(!_stricmp((*i)->GetName().c_str(), pchRenderModelName))
-		{
-			pRenderModel = *i;
-			break;
-		}
-	}
+	return m_renderModelLoader.FindOrRequest(strRenderModelName, bLoading);
+}
 
-	// load the model if we didn't find one
-	if(!pRenderModel)
-	{
-		vr::RenderModel_t* pModel;
-		vr::EVRRenderModelError error;
-		while (1)
-		{
-			error = vr::VRRenderModels()->LoadRenderModel_Async(pchRenderModelName, &pModel);
-			if (error != vr::VRRenderModelError_Loading)
-				break;
+//-----------------------------------------------------------------------------
+// Seconds from now until a frame submitted next reaches the display, as the
+// compositor predicts it for pose prediction. Only the time since vsync is
+// asked for, the rest is cached with the eye configuration.
+//-----------------------------------------------------------------------------
+float VR_Manager::GetSecondsToPhotons()
+{
+	if (!m_bActive)
+		return 0.0f;
 
-			helper->ThreadSleep(1);
-		}
+	float fSecondsSinceLastVsync = m_pBackend->GetSecondsSinceLastVsync();
+	float fFrameDuration = m_fDisplayFrequency > 0.0f ? 1.0f / m_fDisplayFrequency : 0.0f;
 
-		if (error != vr::VRRenderModelError_None)
-		{
-			if(m_bDebugPrint){
-			dprintf("Unable to load render model %s - %s\n", pchRenderModelName, vr::VRRenderModels()->GetRenderModelErrorNameFromEnum(error));
-			}
-			return NULL; // move on to the next tracked device
-		}
+	return fFrameDuration - fSecondsSinceLastVsync + m_fSecondsFromVsyncToPhotons;
+}
 
-		vr::RenderModel_TextureMap_t* pTexture;
-		while (1)
-		{
-			error = vr::VRRenderModels()->LoadTexture_Async(pModel->diffuseTextureId, &pTexture);
-			if (error != vr::VRRenderModelError_Loading)
-				break;
+//-----------------------------------------------------------------------------
+// Dropped and reprojected frame counts since the compositor started on this
+// process.
+//-----------------------------------------------------------------------------
+bool VR_Manager::BGetCompositorStats(uint32_t &unDroppedFrames, uint32_t &unReprojectedFrames)
+{
+	if (!m_bActive)
+		return false;
 
-			helper->ThreadSleep(1);
-		}
+	return m_pBackend->BGetCompositorStats(unDroppedFrames, unReprojectedFrames);
+}
 
-		if (error != vr::VRRenderModelError_None)
-		{
-			if(m_bDebugPrint){
-			dprintf("Unable to load render texture id:%d for render model %s\n", pModel->diffuseTextureId, pchRenderModelName);
-			}
-			vr::VRRenderModels()->FreeRenderModel(pModel);
-			return NULL; // move on to the next tracked device
-		}
+//-----------------------------------------------------------------------------
+bool VR_Manager::BIsInputAvailable()
+{
+	return m_bActive && m_pBackend->BIsInputAvailable();
+}
 
-		pRenderModel = new CGLRenderModel(pchRenderModelName);
-		if (!pRenderModel->BInit(*pModel, *pTexture))
-		{
-			if(m_bDebugPrint){
-			dprintf("Unable to create GL model from render model %s\n", pchRenderModelName);
-			}
-			delete pRenderModel;
-			pRenderModel = NULL;
-		}
-		else
-		{
-			m_vecRenderModels.push_back(pRenderModel);
-		}
-		vr::VRRenderModels()->FreeRenderModel(pModel);
-		vr::VRRenderModels()->FreeTexture(pTexture);
-	}
-	return pRenderModel;
+//-----------------------------------------------------------------------------
+void VR_Manager::GetRecommendedRenderTargetSize(uint32_t &unWidth, uint32_t &unHeight)
+{
+	m_pBackend->GetRecommendedRenderTargetSize(unWidth, unHeight);
+}
+
+//-----------------------------------------------------------------------------
+// Hands an eye's resolved texture to the compositor. Bounds are in the
+// compositor's terms, v running top down. A late latched eye goes with the
+// pose it was drawn with, or the compositor would reproject it from the
+// wrong one.
+//-----------------------------------------------------------------------------
+bool VR_Manager::BSubmit(vr::Hmd_Eye nEye, GLuint unTexture, const vr::VRTextureBounds_t &bounds)
+{
+	const vr::HmdMatrix34_t* pRenderPose = m_rbRenderPoseLatched[nEye] ? &m_rmatRenderPose[nEye] : nullptr;
+	return m_bActive && m_pBackend->BSubmit(nEye, unTexture, bounds, pRenderPose);
 }
 
 //-----------------------------------------------------------------------------
@@ -377,122 +347,104 @@ CGLRenderModel* VR_Manager::FindOrLoadRenderModel(const char* pchRenderModelName
 //-----------------------------------------------------------------------------
 void VR_Manager::UpdateHMDMatrixPose()
 {
-	if (!m_pHMD)
+	AVR_PROFILE_SCOPE("UpdateHMDMatrixPose");
+	if (!m_bActive)
 		return;
 
-	vr::VRCompositor()->WaitGetPoses(m_rTrackedDevicePose, vr::k_unMaxTrackedDeviceCount, NULL, 0);
+	{
+		AVR_PROFILE_SCOPE("WaitGetPoses");
+		m_pBackend->WaitGetPoses(m_rTrackedDevicePose, vr::k_unMaxTrackedDeviceCount);
+	}
+	RecordOrReplayHmdPose();
+
+	// the sampler predicts to the same photons the frame's poses are for
+	m_nPoseNs = Profiler::NowNs();
+	m_nPhotonNs = m_nPoseNs + (int64_t)(GetSecondsToPhotons() * 1.0e9f);
+	m_poseSampler.SetPhotonTime(m_nPhotonNs);
+	m_rbRenderPoseLatched[vr::Eye_Left] = m_rbRenderPoseLatched[vr::Eye_Right] = false;
+
+	// only connected devices have poses, the conversions are independent of each other
+	const uint32_t* punDevices = m_deviceRegistry.GetConnectedDevices();
+	uint32_t unDeviceCount = m_deviceRegistry.GetConnectedCount();
+	auto convertPoses = [this, punDevices](uint32_t unBegin, uint32_t unEnd){
+		for (uint32_t i = unBegin; i < unEnd; ++i)
+		{
+			uint32_t nDevice = punDevices[i];
+			if (m_rTrackedDevicePose[nDevice].bPoseIsValid)
+				m_rmat4DevicePose[nDevice] = ConvertSteamVRMatrixToGlmMat4(m_rTrackedDevicePose[nDevice].mDeviceToAbsoluteTracking);
+		}
+	};
+	if (m_pJobSystem)
+		m_pJobSystem->ParallelFor(unDeviceCount, k_unPosesPerJob, convertPoses);
+	else
+		convertPoses(0, unDeviceCount);
 
 	m_iValidPoseCount = 0;
-	m_strPoseClasses = "";
-	for (int nDevice = 0; nDevice < vr::k_unMaxTrackedDeviceCount; ++nDevice)
+	for (uint32_t i = 0; i < unDeviceCount; ++i)
 	{
-		if (m_rTrackedDevicePose[nDevice].bPoseIsValid)
+		if (m_rTrackedDevicePose[punDevices[i]].bPoseIsValid)
 		{
-			m_iValidPoseCount++;
-			m_rmat4DevicePose[nDevice] = ConvertSteamVRMatrixToGlmMat4(m_rTrackedDevicePose[nDevice].mDeviceToAbsoluteTracking);
-			if (m_rDevClassChar[nDevice]==0)
-			{
-				switch (m_pHMD->GetTrackedDeviceClass(nDevice))
-				{
-				case vr::TrackedDeviceClass_Controller:        m_rDevClassChar[nDevice] = 'C'; break;
-				case vr::TrackedDeviceClass_HMD:               m_rDevClassChar[nDevice] = 'H'; break;
-				case vr::TrackedDeviceClass_Invalid:           m_rDevClassChar[nDevice] = 'I'; break;
-				case vr::TrackedDeviceClass_GenericTracker:    m_rDevClassChar[nDevice] = 'G'; break;
-				case vr::TrackedDeviceClass_TrackingReference: m_rDevClassChar[nDevice] = 'T'; break;
-				default:                                       m_rDevClassChar[nDevice] = '?'; break;
-				}
-			}
-			m_strPoseClasses += m_rDevClassChar[nDevice];
+			m_rchPoseClasses[m_iValidPoseCount++] = m_deviceRegistry.GetClassChar(punDevices[i]);
 		}
 	}
+	m_rchPoseClasses[m_iValidPoseCount] = 0;
 
 	if (m_rTrackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd].bPoseIsValid)
 	{
 		m_mat4HMDPose = m_rmat4DevicePose[vr::k_unTrackedDeviceIndex_Hmd];
 		m_mat4HMDPose = glm::inverse(m_mat4HMDPose);
 	}
-}
 
-//-----------------------------------------------------------------------------
-//  Gets a Current View Projection Matrix with respect to nEye,
-//  which may be an Eye_Left or an Eye_Right.
-//-----------------------------------------------------------------------------
-glm::mat4 VR_Manager::GetCurrentViewProjectionMatrix(vr::Hmd_Eye nEye)
-{
-	glm::mat4 matMVP;
-	if(nEye == vr::Eye_Left)
-	{
-		matMVP = m_mat4ProjectionLeft * m_mat4eyePosLeft * m_mat4HMDPose;
-	}
-	else if(nEye == vr::Eye_Right)
-	{
-		matMVP = m_mat4ProjectionRight * m_mat4eyePosRight *  m_mat4HMDPose;
-	}
+	if (m_bEyeConfigurationChanged)
+		UpdateEyeConfiguration();
+	UpdateFrameCamera();
 
-	return matMVP;
+	if (!m_strRecordPoses.empty())
+		RecordPoses();
 }
 
 //-----------------------------------------------------------------------------
-// Gets the current ViewEye matrix.
-// ----------------------------------------------------------------------------
-glm::mat4 VR_Manager::GetCurrentViewEyeMatrix(vr::Hmd_Eye nEye)
+// Just before an eye is drawn, trades the head pose WaitGetPoses gave for
+// the sampler's newest prediction to the same photons and recomposes that
+// eye's camera. Keeps the frame's pose when nothing newer has come in, and
+// always when replaying a session, which has to draw what was recorded.
+//-----------------------------------------------------------------------------
+void VR_Manager::LateLatchEye(vr::Hmd_Eye nEye)
 {
-	glm::mat4 matVE;
-	if(nEye == vr::Eye_Left)
-	{
-		matVE = m_mat4eyePosLeft * m_mat4HMDPose;
-	}
-	else if(nEye == vr::Eye_Right)
-	{
-		matVE = m_mat4eyePosRight * m_mat4HMDPose;
-	}
+	m_rbRenderPoseLatched[nEye] = false;
+	if (!m_bActive || !m_poseSampler.BIsRunning() || m_pSessionReplayer)
+		return;
 
-	return matVE;
-}
+	PoseSampler::Snapshot snapshot;
+	if (!m_poseSampler.BLatest(m_nPhotonNs, snapshot) || snapshot.nSampleNs < m_nPoseNs)
+		return;
 
-//------------------------------------------------------------------------------
-// Gets current View Matrix.
-// -----------------------------------------------------------------------------
-glm::mat4 VR_Manager::GetCurrentViewMatrix(vr::Hmd_Eye nEye)
-{
-	glm::mat4 matV = m_mat4HMDPose;
-	return matV;
+	m_mat4HMDPose = glm::inverse(ConvertSteamVRMatrixToGlmMat4(snapshot.matHmd));
+	m_rmatRenderPose[nEye] = snapshot.matHmd;
+	m_rbRenderPoseLatched[nEye] = true;
+	UpdateEyeCamera(nEye);
 }
 
 //-----------------------------------------------------------------------------
-// Gets current Eye Matrix
-// ----------------------------------------------------------------------------
-glm::mat4 VR_Manager::GetCurrentEyeMatrix(vr::Hmd_Eye nEye)
-{
-	glm::mat4 matE;
-	if(nEye == vr::Eye_Left)
-	{
-		matE = m_mat4eyePosLeft;
-	}
-	else if(nEye == vr::Eye_Right)
-	{
-		matE = m_mat4eyePosRight;
-	}
-
-	return matE;
-}
-
+// Appends this frame's head and controller poses to the trace -recordposes
+// writes on exit, for the mock runtime to replay.
 //-----------------------------------------------------------------------------
-// Gets current Projection Matrix
-// ----------------------------------------------------------------------------
-glm::mat4 VR_Manager::GetCurrentProjectionMatrix(vr::Hmd_Eye nEye)
+void VR_Manager::RecordPoses()
 {
-	glm::mat4 matP;
-	if(nEye == vr::Eye_Left)
-	{
-		matP = m_mat4ProjectionLeft;
-	}
-	else if(nEye == vr::Eye_Right)
+	int64_t nNowNs = Profiler::NowNs();
+	if (m_nRecordStartNs < 0)
+		m_nRecordStartNs = nNowNs;
+
+	PoseTrace::Sample sample;
+	sample.dTime = (double)(nNowNs - m_nRecordStartNs) * 1.0e-9;
+	sample.rbValid[PoseTrace::Device_Hmd] = m_rTrackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd].bPoseIsValid;
+	sample.rmatPose[PoseTrace::Device_Hmd] = m_rTrackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd].mDeviceToAbsoluteTracking;
+	for (EHand eHand = Left; eHand <= Right; ((int&)eHand)++)
 	{
-		matP = m_mat4ProjectionRight;
+		sample.rbValid[PoseTrace::Device_LeftHand + eHand] = m_inputState.rHand[eHand].bPoseValid;
+		sample.rmatPose[PoseTrace::Device_LeftHand + eHand] = m_inputState.rHand[eHand].matPose;
 	}
-
-	return matP;
+	m_recordedPoses.Add(sample);
 }
 
 //-----------------------------------------------------------------------------
@@ -503,28 +455,27 @@ bool VR_Manager::BSetupCameras()
 	//Arbitrary vector to test whether matrices returned below are identity
 	glm::vec4 testVec4 = glm::vec4(1.3f, 2.6f, 0.5f, 3.9f);
 
-	m_mat4ProjectionLeft = GetHMDMatrixProjectionEye(vr::Eye_Left);	
+	UpdateEyeConfiguration();
+	UpdateFrameCamera();
+
 	glm::vec4 testResult = m_mat4ProjectionLeft * testVec4;
 	if(testResult == testVec4){
 		std::cout << "Error: Left eye projection matrix returned identity!" << std::endl;
 		return false;
 	}
 
-	m_mat4ProjectionRight = GetHMDMatrixProjectionEye(vr::Eye_Right);
 	testResult = m_mat4ProjectionRight * testVec4;
 	if(testResult == testVec4){
 		std::cout << "Error: Right eye projection matrix returned identity!" << std::endl;
 		return false;
 	}
 
-	m_mat4eyePosLeft = GetHMDMatrixPoseEye(vr::Eye_Left);
 	testResult = m_mat4eyePosLeft * testVec4;
 	if(testResult == testVec4){
 		std::cout << "Error: Left eye pose matrix returned identity!" << std::endl;
 		return false;
 	}
 
-	m_mat4eyePosRight = GetHMDMatrixPoseEye(vr::Eye_Right);
 	testResult = m_mat4eyePosRight * testVec4;
 	if(testResult == testVec4){
 		std::cout << "Error: Right eye pose matrix returned identity!" << std::endl;
@@ -534,15 +485,80 @@ bool VR_Manager::BSetupCameras()
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Asks the runtime for what only changes with the IPD or the display: the
+// eye offsets and projections and the display timing. Once at start up and again on the pose
+// after the runtime says one of them changed.
+//-----------------------------------------------------------------------------
+void VR_Manager::UpdateEyeConfiguration()
+{
+	m_mat4ProjectionLeft = GetHMDMatrixProjectionEye(vr::Eye_Left);
+	m_mat4ProjectionRight = GetHMDMatrixProjectionEye(vr::Eye_Right);
+	m_mat4eyePosLeft = GetHMDMatrixPoseEye(vr::Eye_Left);
+	m_mat4eyePosRight = GetHMDMatrixPoseEye(vr::Eye_Right);
+
+	for (int nEye = vr::Eye_Left; nEye <= vr::Eye_Right; nEye++)
+	{
+		float fLeft = 0.0f, fRight = 0.0f, fTop = 0.0f, fBottom = 0.0f;
+		if (m_bActive)
+			m_pBackend->GetProjectionRaw((vr::Hmd_Eye)nEye, fLeft, fRight, fTop, fBottom);
+		m_rvRawTangents[nEye] = glm::vec4(fLeft, fRight, fTop, fBottom);
+	}
+	m_fDisplayFrequency = m_bActive ? m_pBackend->GetDisplayFrequency() : 0.0f;
+	m_fSecondsFromVsyncToPhotons = m_bActive ? m_pBackend->GetSecondsFromVsyncToPhotons() : 0.0f;
+	m_bEyeConfigurationChanged = false;
+}
+
+//-----------------------------------------------------------------------------
+// Composes both eyes' cameras from the head pose just taken, so drawing an
+// eye only reads them.
+//-----------------------------------------------------------------------------
+void VR_Manager::UpdateFrameCamera()
+{
+	for (int nEye = vr::Eye_Left; nEye <= vr::Eye_Right; nEye++)
+		UpdateEyeCamera(nEye);
+}
+
+//-----------------------------------------------------------------------------
+void VR_Manager::UpdateEyeCamera(int nEye)
+{
+	EyeCamera &camera = m_frameCamera.rEye[nEye];
+	camera.matProjection = nEye == vr::Eye_Left ? m_mat4ProjectionLeft : m_mat4ProjectionRight;
+	camera.matEye = nEye == vr::Eye_Left ? m_mat4eyePosLeft : m_mat4eyePosRight;
+	camera.matView = m_mat4HMDPose;
+	camera.matViewEye = camera.matEye * camera.matView;
+	camera.matViewProjection = camera.matProjection * camera.matViewEye;
+	camera.matInverseProjection = glm::inverse(camera.matProjection);
+	camera.matInverseViewEye = glm::inverse(camera.matViewEye);
+	camera.vRawTangents = m_rvRawTangents[nEye];
+
+	// planes straight from the rows of the view projection
+	const glm::mat4 &m = camera.matViewProjection;
+	glm::vec4 rvRow[4];
+	for (int nRow = 0; nRow < 4; nRow++)
+		rvRow[nRow] = glm::vec4(m[0][nRow], m[1][nRow], m[2][nRow], m[3][nRow]);
+	for (int nAxis = 0; nAxis < 3; nAxis++)
+	{
+		camera.rvFrustumPlanes[nAxis * 2] = rvRow[3] + rvRow[nAxis];
+		camera.rvFrustumPlanes[nAxis * 2 + 1] = rvRow[3] - rvRow[nAxis];
+	}
+	for (int nPlane = 0; nPlane < 6; nPlane++)
+	{
+		float fLength = glm::length(glm::vec3(camera.rvFrustumPlanes[nPlane]));
+		if (fLength > 0.0f)
+			camera.rvFrustumPlanes[nPlane] = camera.rvFrustumPlanes[nPlane] / fLength;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Gets a Matrix Projection Eye with respect to nEye.
 //-----------------------------------------------------------------------------
 glm::mat4 VR_Manager::GetHMDMatrixProjectionEye(vr::Hmd_Eye nEye)
 {
-	if (!m_pHMD)
+	if (!m_bActive)
 		return glm::mat4(0.0);
 
-	vr::HmdMatrix44_t mat = m_pHMD->GetProjectionMatrix(nEye, m_fNearClip, m_fFarClip);
+	vr::HmdMatrix44_t mat = m_pBackend->GetProjectionMatrix(nEye, m_fNearClip, m_fFarClip);
 
 	return glm::mat4(
 		mat.m[0][0], mat.m[1][0], mat.m[2][0], mat.m[3][0],
@@ -557,10 +573,10 @@ glm::mat4 VR_Manager::GetHMDMatrixProjectionEye(vr::Hmd_Eye nEye)
 //-----------------------------------------------------------------------------
 glm::mat4 VR_Manager::GetHMDMatrixPoseEye(vr::Hmd_Eye nEye)
 {
-	if ( !m_pHMD )
+	if ( !m_bActive )
 		return glm::mat4(0.0);
 
-	vr::HmdMatrix34_t matEyeHead = m_pHMD->GetEyeToHeadTransform(nEye);
+	vr::HmdMatrix34_t matEyeHead = m_pBackend->GetEyeToHeadTransform(nEye);
 	glm::mat4 matrixObj = glm::mat4(
 		matEyeHead.m[0][0], matEyeHead.m[1][0], matEyeHead.m[2][0], 0.0, 
 		matEyeHead.m[0][1], matEyeHead.m[1][1], matEyeHead.m[2][1], 0.0,
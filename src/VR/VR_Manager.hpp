@@ -6,14 +6,44 @@
 #include <memory>
 
 #include "VR_Helper.hpp"
+#include "VRBackend.hpp"
+#include "PoseTrace.hpp"
 //#include "openvr.h"
 //#include "Matrices.h"
 #include "CGLRenderModel.hpp"
+#include "RenderModelLoader.hpp"
+#include "TrackedDeviceRegistry.hpp"
+#include "PoseSampler.hpp"
 #include "SystemInfo.hpp"
+#include "JobSystem.hpp"
+#include "SessionRecorder.hpp"
+#include "SessionReplayer.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+//-----------------------------------------------------------------------------
+// Everything the renderer asks about an eye's camera, worked out once each
+// time the pose is updated and read only until the next update.
+//-----------------------------------------------------------------------------
+struct EyeCamera
+{
+	glm::mat4 matProjection;
+	glm::mat4 matEye;				// head to eye
+	glm::mat4 matView;				// tracking to head, the same for both eyes
+	glm::mat4 matViewEye;			// tracking to eye
+	glm::mat4 matViewProjection;
+	glm::mat4 matInverseProjection;
+	glm::mat4 matInverseViewEye;	// eye to tracking
+	glm::vec4 rvFrustumPlanes[6];	// left, right, bottom, top, near, far in tracking space, normals point in
+	glm::vec4 vRawTangents;			// left, right, top, bottom as GetProjectionRaw gives them
+};
+
+struct FrameCamera
+{
+	EyeCamera rEye[2];				// by vr::Hmd_Eye
+};
+
 class VR_Manager {
 
 public:
@@ -22,27 +52,40 @@ public:
 
 	bool BInit();
 	bool BInitCompositor();
+	void SetJobSystem(JobSystem* pJobSystem) { m_pJobSystem = pJobSystem; }
+	void SetSession(SessionRecorder* pRecorder, SessionReplayer* pReplayer) { m_pSessionRecorder = pRecorder; m_pSessionReplayer = pReplayer; }
 	void ExitVR();
 	bool HandleInput();
 	void ProcessVREvent(const vr::VREvent_t &event);
 	glm::mat4 ConvertSteamVRMatrixToGlmMat4(const vr::HmdMatrix34_t &matPose);
-	CGLRenderModel* FindOrLoadRenderModel(const char* pchRenderModelName);
+	CGLRenderModel* FindOrLoadRenderModel(const std::string& strRenderModelName, bool& bLoading);
 
 	bool BSetupCameras();
 	void UpdateHMDMatrixPose();
+	void LateLatchEye(vr::Hmd_Eye nEye);
+	// when the pose from the last UpdateHMDMatrixPose is seen, 0 before the first
+	int64_t GetPhotonNs() const { return m_nPhotonNs; }
+	bool BGetCompositorStats(uint32_t &unDroppedFrames, uint32_t &unReprojectedFrames);
+	bool BIsActive() const { return m_bActive; }
+	bool BIsInputAvailable();
+	void GetRecommendedRenderTargetSize(uint32_t &unWidth, uint32_t &unHeight);
+	// refresh rate of the headset, 0 if the runtime doesn't say
+	float GetDisplayFrequency() const { return m_fDisplayFrequency; }
+	bool BSubmit(vr::Hmd_Eye nEye, GLuint unTexture, const vr::VRTextureBounds_t &bounds);
 	glm::mat4 GetHMDMatrixProjectionEye(vr::Hmd_Eye nEye);
 	glm::mat4 GetHMDMatrixPoseEye(vr::Hmd_Eye nEye);
-	glm::mat4 GetCurrentViewProjectionMatrix(vr::Hmd_Eye nEye);
-	glm::mat4 GetCurrentViewEyeMatrix(vr::Hmd_Eye nEye);
-	glm::mat4 GetCurrentViewMatrix(vr::Hmd_Eye nEye);
-	glm::mat4 GetCurrentProjectionMatrix(vr::Hmd_Eye nEye);
-	glm::mat4 GetCurrentEyeMatrix(vr::Hmd_Eye nEye);
+	const FrameCamera& GetFrameCamera() const { return m_frameCamera; }
+	const glm::mat4& GetCurrentViewProjectionMatrix(vr::Hmd_Eye nEye) const { return m_frameCamera.rEye[nEye].matViewProjection; }
+	const glm::mat4& GetCurrentViewEyeMatrix(vr::Hmd_Eye nEye) const { return m_frameCamera.rEye[nEye].matViewEye; }
+	const glm::mat4& GetCurrentViewMatrix(vr::Hmd_Eye nEye) const { return m_frameCamera.rEye[nEye].matView; }
+	const glm::mat4& GetCurrentProjectionMatrix(vr::Hmd_Eye nEye) const { return m_frameCamera.rEye[nEye].matProjection; }
+	const glm::mat4& GetCurrentEyeMatrix(vr::Hmd_Eye nEye) const { return m_frameCamera.rEye[nEye].matEye; }
 
 	bool BGetRotate3DTrigger();
 	float GetNearClip();
 	float GetFarClip();
 
-	glm::vec4 GetFarPlaneDimensions(vr::Hmd_Eye nEye);
+	const glm::vec4& GetFarPlaneDimensions(vr::Hmd_Eye nEye) const { return m_frameCamera.rEye[nEye].vRawTangents; }
 
 	enum EHand
 	{
@@ -54,26 +97,26 @@ public:
 
 private:
 
-	std::unique_ptr<VR_Helper> helper;
-	vr::IVRSystem *m_pHMD;		
+	void RecordPoses();
+	float GetSecondsToPhotons();
+	void UpdateEyeConfiguration();
+	void UpdateFrameCamera();
+	void UpdateEyeCamera(int nEye);
+	void RecordOrReplayInput();
+	void RecordOrReplayHmdPose();
+
+	std::unique_ptr<IVRBackend> m_pBackend;
+	bool m_bActive;
 
 	std::string m_strDriver;
 	std::string m_strDisplay;
 
 	struct ControllerInfo_t
 	{
-#ifdef __APPLE__
-		VRInputValueHandle_t m_source = vr::k_ulInvalidInputValueHandle;
-		VRActionHandle_t m_actionPose = vr::k_ulInvalidActionHandle;
-		VRActionHandle_t m_actionHaptic = vr::k_ulInvalidActionHandle;
-#elif _WIN32
-		vr::VRInputValueHandle_t m_source = vr::k_ulInvalidInputValueHandle;
-		vr::VRActionHandle_t m_actionPose = vr::k_ulInvalidActionHandle;
-		vr::VRActionHandle_t m_actionHaptic = vr::k_ulInvalidActionHandle;
-#endif
 		glm::mat4 m_rmat4Pose;
 		CGLRenderModel *m_pRenderModel = nullptr;
 		std::string m_sRenderModelName;
+		bool m_bRenderModelLoading = false;
 		bool m_bShowController;
 	};
 	ControllerInfo_t m_rHand[2];
@@ -88,34 +131,42 @@ private:
 
 	glm::mat4 m_mat4HMDPose;
 
-	std::vector<CGLRenderModel*> m_vecRenderModels;
+	glm::vec4 m_rvRawTangents[2];
+	bool m_bEyeConfigurationChanged;	// IPD or display changed, picked up with the next pose
+	float m_fDisplayFrequency;
+	float m_fSecondsFromVsyncToPhotons;
+	FrameCamera m_frameCamera;
+
+	RenderModelLoader m_renderModelLoader;
+	TrackedDeviceRegistry m_deviceRegistry;
+
+	// -nolatelatch draws both eyes with the pose WaitGetPoses gave
+	bool m_bLateLatch;
+	PoseSampler m_poseSampler;
+	int64_t m_nPhotonNs;				// this frame's, what the sampler predicts to
+	int64_t m_nPoseNs;					// when WaitGetPoses returned, a snapshot must be newer
+	vr::HmdMatrix34_t m_rmatRenderPose[2];
+	bool m_rbRenderPoseLatched[2];		// submitted with the eye when set
 	
-#ifdef __APPLE__
-	VRActionHandle_t m_actionRotateStructure = vr::k_ulInvalidActionHandle;
-	VRActionHandle_t m_actionHideThisController = vr::k_ulInvalidActionHandle;
-	VRActionHandle_t m_actionTriggerHaptic = vr::k_ulInvalidActionHandle;
-	VRActionHandle_t m_actionAnalongInput = vr::k_ulInvalidActionHandle;
-	
-	VRActionSetHandle_t m_actionsetAvr = vr::k_ulInvalidActionSetHandle;
-#elif _WIN32
-	vr::VRActionHandle_t m_actionRotateStructure = vr::k_ulInvalidActionHandle;
-	vr::VRActionHandle_t m_actionHideThisController = vr::k_ulInvalidActionHandle;
-	vr::VRActionHandle_t m_actionTriggerHaptic = vr::k_ulInvalidActionHandle;
-	vr::VRActionHandle_t m_actionAnalongInput = vr::k_ulInvalidActionHandle;
-	
-	vr::VRActionSetHandle_t m_actionsetAvr = vr::k_ulInvalidActionSetHandle;
-#endif
+	VRInputState m_inputState;
+
+	// -recordposes, written out on exit
+	std::string m_strRecordPoses;
+	PoseTrace m_recordedPoses;
+	int64_t m_nRecordStartNs;
 
 	vr::TrackedDevicePose_t m_rTrackedDevicePose[ vr::k_unMaxTrackedDeviceCount ];
 	int m_iValidPoseCount;
-	std::string m_strPoseClasses;                            // what classes we saw poses for this frame
+	char m_rchPoseClasses[vr::k_unMaxTrackedDeviceCount + 1];  // what classes we saw poses for this frame
 	glm::mat4 m_rmat4DevicePose[vr::k_unMaxTrackedDeviceCount];
-	char m_rDevClassChar[vr::k_unMaxTrackedDeviceCount];   // for each device, a character representing its class
 	float m_fNearClip;
 	float m_fFarClip;
 	bool m_bDebugPrint;
 
 	bool m_bRotate3D;
-	
+
+	JobSystem* m_pJobSystem;
+	SessionRecorder* m_pSessionRecorder;
+	SessionReplayer* m_pSessionReplayer;
 };
 #endif
@@ -24,7 +24,7 @@ CGLRenderModel::~CGLRenderModel()
 //-----------------------------------------------------------------------------
 // Purpose: Allocates and populates the GL resources for a render model
 //-----------------------------------------------------------------------------
-bool CGLRenderModel::BInit( const vr::RenderModel_t & vrModel, const vr::RenderModel_TextureMap_t & vrDiffuseTexture )
+bool CGLRenderModel::BInit( const vr::RenderModel_t & vrModel, GLuint glDiffuseTexture )
 {
 	// create and bind a VAO to hold state for this model
 	glGenVertexArrays( 1, &m_glVertArray );
@@ -50,9 +50,21 @@ bool CGLRenderModel::BInit( const vr::RenderModel_t & vrModel, const vr::RenderM
 
 	glBindVertexArray( 0 );
 
-	// create and populate the texture
-	glGenTextures(1, &m_glTexture );
-	glBindTexture( GL_TEXTURE_2D, m_glTexture );
+	m_glTexture = glDiffuseTexture;
+	m_unVertexCount = vrModel.unTriangleCount * 3;
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Creates the mipmapped GL texture for a render model's diffuse map
+//-----------------------------------------------------------------------------
+GLuint CGLRenderModel::CreateDiffuseTexture( const vr::RenderModel_TextureMap_t & vrDiffuseTexture )
+{
+	GLuint glTexture = 0;
+	glGenTextures(1, &glTexture );
+	glBindTexture( GL_TEXTURE_2D, glTexture );
 
 	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, vrDiffuseTexture.unWidth, vrDiffuseTexture.unHeight,
 		0, GL_RGBA, GL_UNSIGNED_BYTE, vrDiffuseTexture.rubTextureMapData );
@@ -71,9 +83,7 @@ bool CGLRenderModel::BInit( const vr::RenderModel_t & vrModel, const vr::RenderM
 
 	glBindTexture( GL_TEXTURE_2D, 0 );
 
-	m_unVertexCount = vrModel.unTriangleCount * 3;
-
-	return true;
+	return glTexture;
 }
 
 
@@ -91,6 +101,7 @@ void CGLRenderModel::Cleanup()
 		m_glVertArray = 0;
 		m_glVertBuffer = 0;
 	}
+	m_glTexture = 0;
 }
 
 
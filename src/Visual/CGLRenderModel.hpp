@@ -1,3 +1,6 @@
+#ifndef CGLRENDERMODEL_HPP
+#define CGLRENDERMODEL_HPP
+
 #include <string>
 #include <GL/glew.h>
 
@@ -5,6 +8,8 @@
 #include "openvr/openvr.h"
 #elif _WIN32 
 #include "openvr.h"
+#else
+#include "openvr/openvr.h"
 #endif
 
 class CGLRenderModel
@@ -13,7 +18,9 @@ public:
 	CGLRenderModel( const std::string & sRenderModelName );
 	~CGLRenderModel();
 
-	bool BInit( const vr::RenderModel_t & vrModel, const vr::RenderModel_TextureMap_t & vrDiffuseTexture );
+	// the texture is shared between models and stays with whoever created it
+	bool BInit( const vr::RenderModel_t & vrModel, GLuint glDiffuseTexture );
+	static GLuint CreateDiffuseTexture( const vr::RenderModel_TextureMap_t & vrDiffuseTexture );
 	void Cleanup();
 	void Draw();
 	const std::string & GetName() const { return m_sModelName; }
@@ -26,3 +33,5 @@ private:
 	GLsizei m_unVertexCount;
 	std::string m_sModelName;
 };
+
+#endif
@@ -0,0 +1,105 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// of the frame budget the whole GPU frame aims for, the compositor needs the rest
+	const float k_fTargetBudgetFraction = 0.8f;
+	// no change while the eyes are within this fraction of their target
+	const float k_fDeadBand = 0.1f;
+	const float k_fDownGain = 0.5f;
+	const float k_fUpGain = 0.1f;
+	// late samples still timing the previous viewport
+	const uint32_t k_unSettleSamples = 3;
+	// viewport sizes move in steps of this many pixels
+	const uint32_t k_unViewportStep = 8;
+}
+
+//-----------------------------------------------------------------------------
+DynamicResolution::DynamicResolution() :
+	m_bEnabled(true),
+	m_fMinScale(0.6f),
+	m_fMaxScale(1.4f),
+	m_unNominalWidth(0),
+	m_unNominalHeight(0),
+	m_unTargetWidth(0),
+	m_unTargetHeight(0),
+	m_fScale(1.0f),
+	m_unViewportWidth(0),
+	m_unViewportHeight(0),
+	m_unSamplesToSkip(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+void DynamicResolution::SetScaleRange(float fMinScale, float fMaxScale)
+{
+	m_fMinScale = std::max(fMinScale, 0.1f);
+	m_fMaxScale = std::max(fMaxScale, m_fMinScale);
+}
+
+//-----------------------------------------------------------------------------
+// Sizes the targets. Disabled, they are exactly the nominal size and the
+// scale stays at one. The largest scale comes down if GL can't allocate it.
+//-----------------------------------------------------------------------------
+void DynamicResolution::SetNominalSize(uint32_t unWidth, uint32_t unHeight, uint32_t unMaxTargetSize)
+{
+	m_unNominalWidth = std::max(unWidth, 1u);
+	m_unNominalHeight = std::max(unHeight, 1u);
+
+	if(!m_bEnabled){
+		m_fMinScale = m_fMaxScale = 1.0f;
+	} else if(unMaxTargetSize > 0){
+		float fLargest = (float)unMaxTargetSize / (float)std::max(m_unNominalWidth, m_unNominalHeight);
+		m_fMaxScale = std::min(m_fMaxScale, fLargest);
+		m_fMinScale = std::min(m_fMinScale, m_fMaxScale);
+	}
+
+	m_unTargetWidth = std::max((uint32_t)std::ceil(m_unNominalWidth * m_fMaxScale), 1u);
+	m_unTargetHeight = std::max((uint32_t)std::ceil(m_unNominalHeight * m_fMaxScale), 1u);
+
+	m_fScale = std::min(std::max(1.0f, m_fMinScale), m_fMaxScale);
+	m_unSamplesToSkip = 0;
+	ApplyScale();
+}
+
+//-----------------------------------------------------------------------------
+void DynamicResolution::Update(float fEyesGpuMs, float fOtherGpuMs, float fBudgetMs)
+{
+	if(!m_bEnabled || fEyesGpuMs <= 0.0f || fBudgetMs <= 0.0f) return;
+	if(m_unSamplesToSkip > 0){
+		m_unSamplesToSkip--;
+		return;
+	}
+
+	float fEyesTargetMs = std::max(fBudgetMs * k_fTargetBudgetFraction - fOtherGpuMs, fBudgetMs * 0.1f);
+	float fRatio = fEyesTargetMs / fEyesGpuMs;
+	if(fRatio >= 1.0f && fRatio <= 1.0f + k_fDeadBand) return;
+
+	float fWanted = m_fScale * std::sqrt(fRatio);
+	float fGain = fRatio < 1.0f ? k_fDownGain : k_fUpGain;
+	m_fScale = std::min(std::max(m_fScale + (fWanted - m_fScale) * fGain, m_fMinScale), m_fMaxScale);
+
+	uint32_t unOldWidth = m_unViewportWidth;
+	uint32_t unOldHeight = m_unViewportHeight;
+	ApplyScale();
+	if(m_unViewportWidth != unOldWidth || m_unViewportHeight != unOldHeight) m_unSamplesToSkip = k_unSettleSamples;
+}
+
+//-----------------------------------------------------------------------------
+// Rounds to whole steps, keeping the aspect of the nominal size close and
+// never leaving the target.
+//-----------------------------------------------------------------------------
+void DynamicResolution::ApplyScale()
+{
+	uint32_t unWidth = (uint32_t)(m_unNominalWidth * m_fScale + 0.5f);
+	uint32_t unHeight = (uint32_t)(m_unNominalHeight * m_fScale + 0.5f);
+	if(m_fScale != 1.0f){
+		unWidth = std::max((unWidth + k_unViewportStep / 2) / k_unViewportStep * k_unViewportStep, k_unViewportStep);
+		unHeight = std::max((unHeight + k_unViewportStep / 2) / k_unViewportStep * k_unViewportStep, k_unViewportStep);
+	}
+	m_unViewportWidth = std::min(unWidth, m_unTargetWidth);
+	m_unViewportHeight = std::min(unHeight, m_unTargetHeight);
+}
@@ -0,0 +1,64 @@
+#ifndef DYNAMICRESOLUTION_HPP
+#define DYNAMICRESOLUTION_HPP
+
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Picks the eye buffer resolution each frame to hold the GPU inside the
+// frame budget. The eye targets are allocated once at the nominal size
+// times the largest scale and the eyes render into a viewport in the
+// bottom left corner of them, so changing the scale never reallocates.
+//
+// Update() takes the timing of the eye passes as the GPU reports it, a
+// couple of frames late. Cost is taken to follow the pixel count, so the
+// scale moves by the square root of the time ratio: quickly down when over
+// the target, slowly back up when there is headroom, and not at all in a
+// band around the target. After a change a few samples are skipped so the
+// old resolution's timings don't move it again.
+//-----------------------------------------------------------------------------
+class DynamicResolution {
+
+public:
+
+	DynamicResolution();
+
+	void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+	bool BIsEnabled() const { return m_bEnabled; }
+	void SetScaleRange(float fMinScale, float fMaxScale);
+
+	// the recommended eye size and the largest target GL can allocate
+	void SetNominalSize(uint32_t unWidth, uint32_t unHeight, uint32_t unMaxTargetSize);
+	uint32_t GetTargetWidth() const { return m_unTargetWidth; }
+	uint32_t GetTargetHeight() const { return m_unTargetHeight; }
+
+	// fOtherGpuMs is what doesn't scale with the eyes, the companion window and the HUD
+	void Update(float fEyesGpuMs, float fOtherGpuMs, float fBudgetMs);
+
+	float GetScale() const { return m_fScale; }
+	uint32_t GetViewportWidth() const { return m_unViewportWidth; }
+	uint32_t GetViewportHeight() const { return m_unViewportHeight; }
+
+	// the share of the target the viewport covers, for sampling it and for the compositor bounds
+	float GetUMax() const { return (float)m_unViewportWidth / (float)m_unTargetWidth; }
+	float GetVMax() const { return (float)m_unViewportHeight / (float)m_unTargetHeight; }
+
+private:
+
+	void ApplyScale();
+
+	bool m_bEnabled;
+	float m_fMinScale;
+	float m_fMaxScale;
+
+	uint32_t m_unNominalWidth;
+	uint32_t m_unNominalHeight;
+	uint32_t m_unTargetWidth;
+	uint32_t m_unTargetHeight;
+
+	float m_fScale;
+	uint32_t m_unViewportWidth;
+	uint32_t m_unViewportHeight;
+	uint32_t m_unSamplesToSkip;
+};
+
+#endif
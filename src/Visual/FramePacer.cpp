@@ -0,0 +1,121 @@
+#include "FramePacer.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+	// how long one glClientWaitSync blocks before it is asked again
+	const GLuint64 k_ulFenceTimeoutNs = 100000000;
+	// left between the end of the work and the refresh, covers sleep overshoot
+	const double k_dLateStartMarginSeconds = 0.002;
+	// per frame, so a single slow frame stops pushing the start early after a second or two
+	const double k_dWorkEstimateDecay = 0.97;
+
+	int64_t SteadyNowNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+//-----------------------------------------------------------------------------
+FramePacer::FramePacer() :
+	m_unFramesInFlight(2),
+	m_bLateStart(false),
+	m_unOldest(0),
+	m_unQueued(0),
+	m_nWorkBeginNs(0),
+	m_nLastSwapNs(0),
+	m_dWorkEstimateSeconds(1.0),
+	m_fWaitMs(0.0f)
+{
+	for(uint32_t i = 0; i < k_unMaxFramesInFlight; i++) m_rFences[i] = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void FramePacer::SetFramesInFlight(uint32_t unFrames)
+{
+	m_unFramesInFlight = std::max(1u, std::min(unFrames, k_unMaxFramesInFlight));
+}
+
+//-----------------------------------------------------------------------------
+// Blocks until fewer than the configured number of frames are still queued
+// on the GPU. The flush bit makes sure the fence can actually be reached.
+//-----------------------------------------------------------------------------
+void FramePacer::WaitForFrameSlot()
+{
+	int64_t nBeginNs = SteadyNowNs();
+
+	while(m_unQueued >= m_unFramesInFlight){
+		AVR_PROFILE_SCOPE("wait for frame slot");
+		GLsync fence = m_rFences[m_unOldest];
+		GLenum eResult = GL_TIMEOUT_EXPIRED;
+		while(eResult == GL_TIMEOUT_EXPIRED){
+			eResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, k_ulFenceTimeoutNs);
+		}
+		glDeleteSync(fence);
+		m_rFences[m_unOldest] = nullptr;
+		m_unOldest = (m_unOldest + 1) % k_unMaxFramesInFlight;
+		m_unQueued--;
+	}
+
+	m_nWorkBeginNs = SteadyNowNs();
+	m_fWaitMs = (float)(m_nWorkBeginNs - nBeginNs) * 1.0e-6f;
+}
+
+//-----------------------------------------------------------------------------
+// Sleeps until one refresh after the last swap, less the work estimate and
+// the margin. Assumes the swap returned close to the refresh, so only worth
+// calling with vsync on.
+//-----------------------------------------------------------------------------
+void FramePacer::WaitForLateStart(double dRefreshSeconds)
+{
+	if(!m_bLateStart || m_nLastSwapNs == 0 || dRefreshSeconds <= 0.0) return;
+
+	int64_t nNowNs = SteadyNowNs();
+	int64_t nStartNs = m_nLastSwapNs + (int64_t)((dRefreshSeconds - m_dWorkEstimateSeconds - k_dLateStartMarginSeconds) * 1.0e9);
+	if(nStartNs <= nNowNs || nStartNs - nNowNs > (int64_t)(dRefreshSeconds * 1.0e9)) return;
+
+	{
+		AVR_PROFILE_SCOPE("late start");
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(nStartNs)));
+	}
+
+	m_nWorkBeginNs = SteadyNowNs();
+	m_fWaitMs += (float)(m_nWorkBeginNs - nNowNs) * 1.0e-6f;
+}
+
+//-----------------------------------------------------------------------------
+void FramePacer::WorkDone()
+{
+	double dWorkSeconds = (double)(SteadyNowNs() - m_nWorkBeginNs) * 1.0e-9;
+	m_dWorkEstimateSeconds = std::max(dWorkSeconds, m_dWorkEstimateSeconds * k_dWorkEstimateDecay);
+}
+
+//-----------------------------------------------------------------------------
+void FramePacer::FrameSubmitted()
+{
+	m_nLastSwapNs = SteadyNowNs();
+
+	// only after a missed WaitForFrameSlot, never wait on the frame just submitted
+	if(m_unQueued == k_unMaxFramesInFlight){
+		glDeleteSync(m_rFences[m_unOldest]);
+		m_unOldest = (m_unOldest + 1) % k_unMaxFramesInFlight;
+		m_unQueued--;
+	}
+	m_rFences[(m_unOldest + m_unQueued) % k_unMaxFramesInFlight] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_unQueued++;
+}
+
+//-----------------------------------------------------------------------------
+void FramePacer::CleanUp()
+{
+	for(uint32_t i = 0; i < k_unMaxFramesInFlight; i++){
+		if(m_rFences[i]) glDeleteSync(m_rFences[i]);
+		m_rFences[i] = nullptr;
+	}
+	m_unOldest = 0;
+	m_unQueued = 0;
+}
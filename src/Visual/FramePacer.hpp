@@ -0,0 +1,61 @@
+#ifndef FRAMEPACER_HPP
+#define FRAMEPACER_HPP
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Keeps the CPU at most a few frames ahead of the GPU without draining it.
+// A fence goes in behind every swap and the top of the next frame waits only
+// on the oldest one, once the configured number of frames is in flight, so
+// the CPU and the GPU overlap instead of taking turns.
+//
+// Without a compositor the pacer can also start the frame late: it sleeps
+// until the latest point that still leaves the recent worst CPU work time,
+// plus a margin, before the next refresh, so input and simulation are
+// sampled as close to the display as possible. With a headset this is the
+// compositor's job, WaitGetPoses already returns just ahead of its vsync.
+//-----------------------------------------------------------------------------
+class FramePacer {
+
+public:
+
+	static const uint32_t k_unMaxFramesInFlight = 4;
+
+	FramePacer();
+
+	void SetFramesInFlight(uint32_t unFrames);
+	uint32_t GetFramesInFlight() const { return m_unFramesInFlight; }
+	void SetLateStart(bool bLateStart) { m_bLateStart = bLateStart; }
+
+	// top of the frame, before the frame time is sampled
+	void WaitForFrameSlot();
+	void WaitForLateStart(double dRefreshSeconds);
+
+	// either side of the swap
+	void WorkDone();
+	void FrameSubmitted();
+
+	void CleanUp();
+
+	// time spent blocked in the two waits this frame
+	float GetWaitMs() const { return m_fWaitMs; }
+	uint32_t GetQueuedFrames() const { return m_unQueued; }
+
+private:
+
+	uint32_t m_unFramesInFlight;
+	bool m_bLateStart;
+
+	GLsync m_rFences[k_unMaxFramesInFlight];
+	uint32_t m_unOldest;
+	uint32_t m_unQueued;
+
+	int64_t m_nWorkBeginNs;
+	int64_t m_nLastSwapNs;
+	double m_dWorkEstimateSeconds;
+	float m_fWaitMs;
+};
+
+#endif
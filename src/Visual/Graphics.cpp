@@ -6,6 +6,8 @@
 #endif
 
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <stdlib.h>
 
 #include "lodepng.h"
@@ -13,11 +15,21 @@
 #include "ShaderManager.hpp"
 #include "Log.hpp"
 #include "SystemInfo.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
 
 #ifndef _countof
 #define _countof(x) (sizeof(x)/sizeof((x)[0]))
 #endif
 
+// two hands are one job's worth, this only splits once there are more tracked controllers
+static const uint32_t k_unHandsPerJob = 4;
+// a frame this long dumps the profile, at most once per interval
+static const double k_dProfileStallSeconds = 0.1;
+static const double k_dProfileStallInterval = 10.0;
+// per frame, for the controller lines and the HUD with room to spare
+static const GLsizeiptr k_nStreamBytesPerFrame = 512 * 1024;
+
 //******** TERRIBLE GLOBAL VARIABLES HAVE TO FIX THIS WHEN I GET A CHANCE**********//
 bool m_bFirstMouse = true;
 double m_dLastX = 320.0f;
@@ -37,20 +49,24 @@ Graphics::Graphics(std::unique_ptr<ExecutionFlags>& flagPtr) :
 	m_iTrackedControllerCount_Last(-1),
 	m_iValidPoseCount_Last(-1),
 	m_unControllerVAO(0),
-	m_glControllerVertBuffer(0),
+	m_nControllerFirstVertex(0),
 	m_unSceneVAO(0),
 	m_glMainShaderProgramID(0),
 	m_unCompanionWindowProgramID(0),
 	m_unControllerTransformProgramID(0),
 	m_unRenderModelProgramID(0),	
+	m_unPerfHudProgramID(0),
 	m_nControllerMatrixLocation(-1),
 	m_nRenderModelMatrixLocation(-1),
 	m_bVblank(true),
 	m_bGLFinishHack(true),
 	m_bDebugOpenGL(false),
 	m_unImageCount(0),
-	m_fDeltaTime(0.0),
-	m_fLastFrame(0.0)
+	m_pJobSystem(nullptr),
+	m_pSessionRecorder(nullptr),
+	m_pSessionReplayer(nullptr),
+	m_ulAudioDeadlineCursor(0),
+	m_fDeltaTime(0.0)
 	//m_uiFrameNumber(0)
 {
 	m_bDebugOpenGL = flagPtr->flagDebugOpenGL;
@@ -58,11 +74,35 @@ Graphics::Graphics(std::unique_ptr<ExecutionFlags>& flagPtr) :
 	m_bGLFinishHack = flagPtr->flagGLFinishHack;
 	m_bDebugPrintMessages = flagPtr->flagDPrint;	
 	m_bDevMode = flagPtr->flagDevMode;
+	m_audioThreadPolicy = flagPtr->audioThreadPolicy;
+	m_nAudioThreads = flagPtr->nAudioThreads;
+	m_fCrossfadeTime = flagPtr->fCrossfadeTime;
+	m_bReloadKeyDown = false;
+	m_bPauseKeyDown = false;
+	m_bScaleKeyDown = false;
+	m_bProfileKeyDown = false;
+	m_bHudKeyDown = false;
+	m_bHudEyes = flagPtr->flagHudEyes;
+	m_perfHud.SetVisible(flagPtr->flagHud || flagPtr->flagHudEyes);
+	m_fFrameBudgetMs = 1000.0f / 90.0f;
+	m_framePacer.SetFramesInFlight((uint32_t)std::max(flagPtr->nFramesInFlight, 1));
+	m_framePacer.SetLateStart(flagPtr->flagLateStart);
+	m_dynamicResolution.SetEnabled(flagPtr->flagDynamicResolution);
+	m_dynamicResolution.SetScaleRange(flagPtr->fDynamicResolutionMin, flagPtr->fDynamicResolutionMax);
+	m_ulDynamicResolutionSamples = 0;
+	m_nCompanionUVScaleLocation = -1;
+	m_dLastProfileDump = -k_dProfileStallInterval;
+	m_bLatencyTest = flagPtr->flagLatencyTest;
+	m_memoryMonitor.Init(flagPtr->fMemoryReportSeconds, flagPtr->fSoakHours, flagPtr->fSoakBudgetMb);
+	//nobody watching, no window and no sound card
+	m_bHeadless = m_bLatencyTest || m_memoryMonitor.BIsSoaking();
+	m_bPipeline = flagPtr->flagPipeline;
+	m_simulationThreadPolicy = flagPtr->workerThreadPolicy;
 
 	m_pRotationVal = std::make_unique<int>();
 	*m_pRotationVal = 0;
 
-	m_bRecordScreen = true;
+	m_bRecordScreen = flagPtr->flagRecordScreen;
 
 	//m_tStartTime = time(0);
 
@@ -70,6 +110,25 @@ Graphics::Graphics(std::unique_ptr<ExecutionFlags>& flagPtr) :
 
 
 
+//----------------------------------------------------------------------
+// Per-frame work on the CPU side goes through the job system. Call
+// before BInitGL so the scene has it from the first frame.
+// ---------------------------------------------------------------------
+void Graphics::SetJobSystem(JobSystem* pJobSystem){
+	m_pJobSystem = pJobSystem;
+	fiveCell.setJobSystem(pJobSystem);
+}
+
+//----------------------------------------------------------------------
+// A session recorder, a replayer or neither, not owned. Frame time, the
+// dev camera and what FiveCell exchanges with the orchestra go through it.
+// ---------------------------------------------------------------------
+void Graphics::SetSession(SessionRecorder* pRecorder, SessionReplayer* pReplayer){
+	m_pSessionRecorder = pRecorder;
+	m_pSessionReplayer = pReplayer;
+	fiveCell.setSession(pRecorder, pReplayer);
+}
+
 //----------------------------------------------------------------------
 // Initialise OpenGL context, companion window, glew and vsync.
 // ---------------------------------------------------------------------	
@@ -86,12 +145,10 @@ bool Graphics::BInitGL(bool fullscreen){
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_SAMPLES, 4);
+	if(m_bHeadless) glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 	
 	if(m_bDebugOpenGL){
 		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
-		glDebugMessageCallback( (GLDEBUGPROC)DebugCallback, nullptr);
-		glDebugMessageControl( GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE );
-		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 	}
 
 	if(!fullscreen){
@@ -123,6 +180,13 @@ bool Graphics::BInitGL(bool fullscreen){
 	glewExperimental = GL_TRUE;
 	glewInit();
 
+	//needs the context and the entry points. Not synchronous, the driver may
+	//call back from its own threads and the log doesn't mind
+	if(m_bDebugOpenGL && glDebugMessageCallback){
+		glDebugMessageCallback( (GLDEBUGPROC)DebugCallback, nullptr);
+		glDebugMessageControl( GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE );
+	}
+
 	if(m_bVblank){
 #ifdef _WIN32
 	//turn on vsync on windows
@@ -149,6 +213,8 @@ bool Graphics::BInitGL(bool fullscreen){
 	glDepthFunc(GL_LESS);//depth testing interprets a smaller value as 'closer'
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	//the eye clears use this, it used to be set every frame after the swap
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
 	// setup scene geometry
 	skyboxShaderProg = BCreateSceneShaders("skybox");
@@ -177,10 +243,13 @@ bool Graphics::BInitGL(bool fullscreen){
 		return false;
 	}
 	std::string csdFileName = "mode5cell.csd";
-	if(!fiveCell.setup(csdFileName, skyboxShaderProg, soundObjShaderProg, groundPlaneShaderProg, fiveCellShaderProg, quadShaderProg)) {
+	if(!fiveCell.setup(csdFileName, skyboxShaderProg, soundObjShaderProg, groundPlaneShaderProg, fiveCellShaderProg, quadShaderProg, m_audioThreadPolicy, m_nAudioThreads, m_fCrossfadeTime, m_bHeadless)) {
 		std::cout << "fiveCell setup failed: Graphics BInitGL" << std::endl;
 		return false;
 	}
+	if(m_bPipeline && !fiveCell.startSimulationThread(m_simulationThreadPolicy)){
+		std::cout << "Warning: simulation thread could not be started, simulating on the render thread" << std::endl;
+	}
 
 	//create matrices for devmode
 	if(m_bDevMode){
@@ -305,37 +374,49 @@ GLuint Graphics::BCreateSceneShaders(std::string shaderName){
 	std::string vertShaderName = vertName.append(".vert");
 	std::string fragShaderName = fragName.append(".frag");
 
-	//load shaders
+	//load shaders, the sources are calloc'd
 	const char* vertShader;
 	bool isVertLoaded = load_shader(vertShaderName.c_str(), vertShader);
 	if(!isVertLoaded) return NULL;
 	
 	const char* fragShader;
 	bool isFragLoaded = load_shader(fragShaderName.c_str(), fragShader);
-	if(!isFragLoaded) return NULL;
+	if(!isFragLoaded){
+		free((void*)vertShader);
+		return NULL;
+	}
 	
 	GLuint vs = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vs, 1, &vertShader, NULL);
 	glCompileShader(vs);
-	delete[] vertShader;
-	//check for compile errors
-	bool isVertCompiled = shader_compile_check(vs);
-	if(!isVertCompiled) return NULL;
+	free((void*)vertShader);
 	
 	GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
 	glShaderSource(fs, 1, &fragShader, NULL);
 	glCompileShader(fs);
-	delete[] fragShader;
+	free((void*)fragShader);
+
 	//check for compile errors
-	bool isFragCompiled = shader_compile_check(fs);
-	if(!isFragCompiled) return NULL;
+	if(!shader_compile_check(vs) || !shader_compile_check(fs)){
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+		return NULL;
+	}
 	
 	GLuint shaderProg = glCreateProgram();
 	glAttachShader(shaderProg, fs);
 	glAttachShader(shaderProg, vs);
 	glLinkProgram(shaderProg);
+	//the program keeps what it linked, the shader objects aren't needed after
+	glDetachShader(shaderProg, fs);
+	glDetachShader(shaderProg, vs);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
 	bool didShadersLink = shader_link_check(shaderProg);
-	if(!didShadersLink) return NULL;
+	if(!didShadersLink){
+		glDeleteProgram(shaderProg);
+		return NULL;
+	}
 
 	return shaderProg;
 }
@@ -419,10 +500,11 @@ bool Graphics::BCreateDefaultShaders()
 		"#version 410 core\n"
 		"layout(location = 0) in vec4 position;\n"
 		"layout(location = 1) in vec2 v2UVIn;\n"
+		"uniform vec2 uvScale;\n"
 		"noperspective out vec2 v2UV;\n"
 		"void main()\n"
 		"{\n"
-		"	v2UV = v2UVIn;\n"
+		"	v2UV = v2UVIn * uvScale;\n"
 		"	gl_Position = position;\n"
 		"}\n",
 
@@ -437,13 +519,47 @@ bool Graphics::BCreateDefaultShaders()
 		"}\n"
 		);
 
+	//the eyes only fill part of their targets with dynamic resolution
+	m_nCompanionUVScaleLocation = glGetUniformLocation(m_unCompanionWindowProgramID, "uvScale");
+
+	m_unPerfHudProgramID = CompileGLShader(
+		"PerfHud",
+
+		// vertex shader, canvas pixels mapped to clip space by transform
+		"#version 410 core\n"
+		"uniform vec4 transform;\n"
+		"layout(location = 0) in vec2 position;\n"
+		"layout(location = 1) in vec2 v2UVIn;\n"
+		"layout(location = 2) in vec4 v4ColorIn;\n"
+		"noperspective out vec2 v2UV;\n"
+		"out vec4 v4Color;\n"
+		"void main()\n"
+		"{\n"
+		"	v2UV = v2UVIn;\n"
+		"	v4Color = v4ColorIn;\n"
+		"	gl_Position = vec4(position * transform.xy + transform.zw, 0.0, 1.0);\n"
+		"}\n",
+
+		// fragment shader, the atlas only holds coverage
+		"#version 410 core\n"
+		"uniform sampler2D glyphs;\n"
+		"noperspective in vec2 v2UV;\n"
+		"in vec4 v4Color;\n"
+		"out vec4 outputColor;\n"
+		"void main()\n"
+		"{\n"
+		"	outputColor = vec4(v4Color.rgb, v4Color.a * texture(glyphs, v2UV).r);\n"
+		"}\n"
+		);
+
 	if(!m_bDevMode){
 		return m_unControllerTransformProgramID != 0
 			&& m_unRenderModelProgramID != 0
-			&& m_unCompanionWindowProgramID != 0;
+			&& m_unCompanionWindowProgramID != 0
+			&& m_unPerfHudProgramID != 0;
 	} 
 
-	return m_unCompanionWindowProgramID != 0;
+	return m_unCompanionWindowProgramID != 0 && m_unPerfHudProgramID != 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -510,11 +626,22 @@ GLuint Graphics::CompileGLShader( const char *pchShaderName, const char *pchVert
 bool Graphics::BSetupStereoRenderTargets(std::unique_ptr<VR_Manager>& vrm)
 {
 	if (!m_bDevMode && vrm != nullptr){
-		vrm->m_pHMD->GetRecommendedRenderTargetSize( &m_nRenderWidth, &m_nRenderHeight );
+		vrm->GetRecommendedRenderTargetSize( m_nRenderWidth, m_nRenderHeight );
 	} else if (!m_bDevMode && vrm == nullptr){
 		return false;
 	}
 
+	//the targets are allocated at the largest scale dynamic resolution will use
+	GLint nMaxRenderbufferSize = 0;
+	GLint nMaxTextureSize = 0;
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &nMaxRenderbufferSize);
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &nMaxTextureSize);
+	m_dynamicResolution.SetNominalSize(m_nRenderWidth, m_nRenderHeight, (uint32_t)std::min(nMaxRenderbufferSize, nMaxTextureSize));
+	if(m_dynamicResolution.BIsEnabled()){
+		std::cout << "Graphics: eye targets " << m_dynamicResolution.GetTargetWidth() << "x" << m_dynamicResolution.GetTargetHeight()
+			<< " for a nominal " << m_nRenderWidth << "x" << m_nRenderHeight << std::endl;
+	}
+
 	bool fboL = BCreateFrameBuffer(leftEyeDesc);
 
 	if(!m_bDevMode){
@@ -535,17 +662,20 @@ bool Graphics::BSetupStereoRenderTargets(std::unique_ptr<VR_Manager>& vrm)
 //-----------------------------------------------------------------------------
 bool Graphics::BCreateFrameBuffer(FramebufferDesc& framebufferDesc)
 {
+	GLsizei nTargetWidth = (GLsizei)m_dynamicResolution.GetTargetWidth();
+	GLsizei nTargetHeight = (GLsizei)m_dynamicResolution.GetTargetHeight();
+
 	glGenFramebuffers(1, &framebufferDesc.m_nRenderFramebufferId );
 	glBindFramebuffer(GL_FRAMEBUFFER, framebufferDesc.m_nRenderFramebufferId);
 
 	glGenRenderbuffers(1, &framebufferDesc.m_nDepthBufferId);
 	glBindRenderbuffer(GL_RENDERBUFFER, framebufferDesc.m_nDepthBufferId);
-	glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT, m_nRenderWidth, m_nRenderHeight );
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT, nTargetWidth, nTargetHeight );
 	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,	framebufferDesc.m_nDepthBufferId );
 
 	glGenTextures(1, &framebufferDesc.m_nRenderTextureId );
 	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, framebufferDesc.m_nRenderTextureId );
-	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGBA8, m_nRenderWidth, m_nRenderHeight, true);
+	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGBA8, nTargetWidth, nTargetHeight, true);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, framebufferDesc.m_nRenderTextureId, 0);
 
 	glGenFramebuffers(1, &framebufferDesc.m_nResolveFramebufferId );
@@ -555,7 +685,7 @@ bool Graphics::BCreateFrameBuffer(FramebufferDesc& framebufferDesc)
 	glBindTexture(GL_TEXTURE_2D, framebufferDesc.m_nResolveTextureId );
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_nRenderWidth, m_nRenderHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, nTargetWidth, nTargetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebufferDesc.m_nResolveTextureId, 0);
 
 	// check FBO status
@@ -619,6 +749,19 @@ bool Graphics::BSetupCompanionWindow()
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+	// the screen grab reads into the same buffer every frame
+	if(m_bRecordScreen) m_vecScreenPixels.resize(4 * (size_t)m_nCompanionWindowWidth * m_nCompanionWindowHeight);
+
+	if(!m_streamingBuffer.BInit(k_nStreamBytesPerFrame)){
+		std::cout << "Error: streaming buffer not set up" << std::endl;
+		return false;
+	}
+
+	if(!m_perfHud.BInit(m_unPerfHudProgramID, &m_streamingBuffer)){
+		std::cout << "Error: performance HUD not set up" << std::endl;
+		return false;
+	}
+
 	return true;
 }
 
@@ -671,6 +814,70 @@ void Graphics::DevProcessInput(GLFWwindow *window){
 	
 	if(m_vec3DevCamPos.y < 0.0f || m_vec3DevCamPos.y > 0.0f) m_vec3DevCamPos.y = 0.0f;
 }
+
+//-----------------------------------------------------------------------------
+// The keyboard and mouse camera stands in for the head without a headset,
+// so it is what a dev mode session records.
+//-----------------------------------------------------------------------------
+void Graphics::RecordOrReplayDevCamera()
+{
+	SessionDevCamera camera;
+	if(m_pSessionRecorder){
+		for(int i = 0; i < 3; i++){
+			camera.rfPos[i] = m_vec3DevCamPos[i];
+			camera.rfFront[i] = m_vec3DevCamFront[i];
+		}
+		m_pSessionRecorder->Record(SessionRecord_DevCamera, camera);
+	}
+	if(m_pSessionReplayer && m_pSessionReplayer->BRead(m_pSessionReplayer->GetFrame(), SessionRecord_DevCamera, camera)){
+		m_vec3DevCamPos = glm::vec3(camera.rfPos[0], camera.rfPos[1], camera.rfPos[2]);
+		m_vec3DevCamFront = glm::vec3(camera.rfFront[0], camera.rfFront[1], camera.rfFront[2]);
+	}
+}
+//-----------------------------------------------------------------------------
+// Feeds each new timing of the eye passes to the resolution controller. The
+// companion window and the HUD don't scale with the eyes.
+//-----------------------------------------------------------------------------
+void Graphics::UpdateDynamicResolution()
+{
+	uint64_t ulSamples = m_perfHud.GetGpuSampleCount(PerfHud::GpuPass_Eyes);
+	if(ulSamples == m_ulDynamicResolutionSamples) return;
+	m_ulDynamicResolutionSamples = ulSamples;
+
+	float fOtherGpuMs = m_perfHud.GetLastGpuMs(PerfHud::GpuPass_Companion) + m_perfHud.GetLastGpuMs(PerfHud::GpuPass_Hud);
+	m_dynamicResolution.Update(m_perfHud.GetLastGpuMs(PerfHud::GpuPass_Eyes), fOtherGpuMs, m_fFrameBudgetMs);
+}
+
+//-----------------------------------------------------------------------------
+// Gathers what the HUD shows from the compositor and the audio session and
+// rebuilds its batch for this frame.
+//-----------------------------------------------------------------------------
+void Graphics::UpdatePerfHud(std::unique_ptr<VR_Manager>& vrm)
+{
+	PerfHud::FrameStats stats;
+	stats.fBudgetMs = m_fFrameBudgetMs;
+	stats.fPacingWaitMs = m_framePacer.GetWaitMs();
+	stats.unFramesInFlight = m_framePacer.GetFramesInFlight();
+	stats.fResolutionScale = m_dynamicResolution.GetScale();
+	if(!m_bDevMode && vrm){
+		stats.bCompositor = vrm->BGetCompositorStats(stats.unDroppedFrames, stats.unReprojectedFrames);
+	}
+
+	const AudioDeadlineMonitor* pMonitor = fiveCell.GetAudioDeadlineMonitor();
+	if(pMonitor){
+		AudioDeadlineMonitor::Snapshot snapshot;
+		pMonitor->GetSnapshot(snapshot);
+		if(snapshot.ulBlocks > 0 && snapshot.dPeriodMs > 0.0){
+			stats.bAudio = true;
+			stats.dAudioLoad = snapshot.dMeanBlockMs / snapshot.dPeriodMs;
+			stats.dAudioLoadP99 = snapshot.LoadPercentile(0.99);
+			stats.ulAudioOverruns = snapshot.ulOverruns;
+		}
+	}
+
+	m_perfHud.Update(stats);
+}
+
 //-----------------------------------------------------------------------------
 // Main function that renders textures to hmd.
 //-----------------------------------------------------------------------------
@@ -679,25 +886,94 @@ bool Graphics::BRenderFrame(std::unique_ptr<VR_Manager>& vrm)
 	//update values from controller actions
 	//if(vrm->BGetRotate3DTrigger()) IncreaseRotationValue(m_pRotationVal);
 
+	//block only on the oldest frame still on the GPU, and without a compositor
+	//start as late as the refresh allows
+	m_framePacer.WaitForFrameSlot();
+	if(m_bDevMode && m_bVblank) m_framePacer.WaitForLateStart(m_fFrameBudgetMs * 1.0e-3);
+	m_streamingBuffer.BeginFrame();
+
+	LatencyProbe& probe = fiveCell.GetLatencyProbe();
+	probe.BeginFrame();
+
+	//the only time read of the frame, the simulation catches up in fixed steps
+	SessionFrame sessionFrame;
+	if(m_pSessionReplayer && m_pSessionReplayer->BRead(m_pSessionReplayer->GetFrame(), SessionRecord_Frame, sessionFrame)){
+		m_frameClock.SetNextSimDelta(sessionFrame.dSimDelta);
+	} else if(m_memoryMonitor.BIsSoaking()){
+		//a soak covers simulated hours as fast as the frames render
+		m_frameClock.SetNextSimDelta(m_frameClock.GetStepSeconds());
+	}
+	m_frameClock.Tick();
+	if(m_pSessionRecorder){
+		sessionFrame.nFrameNs = m_frameClock.GetFrameNs();
+		sessionFrame.dSimDelta = m_frameClock.GetSimDelta();
+		m_pSessionRecorder->Record(SessionRecord_Frame, sessionFrame);
+	}
+	m_perfHud.BeginFrame(m_frameClock.GetFrameDelta());
+	//last frame's scratch on this thread is done with
+	JobSystem::ResetScratch();
+	if(Profiler::BIsEnabled() && m_frameClock.GetFrameIndex() > 90 && m_frameClock.GetFrameDelta() > k_dProfileStallSeconds
+		&& m_frameClock.GetFrameTime() - m_dLastProfileDump > k_dProfileStallInterval){
+		std::cout << "Frame took " << m_frameClock.GetFrameDelta() * 1000.0 << " ms, dumping the profile" << std::endl;
+		Profiler::BDump("avr_stall_" + std::to_string(m_frameClock.GetFrameIndex()) + ".json");
+		m_dLastProfileDump = m_frameClock.GetFrameTime();
+	}
+	uint32_t unSimSteps = 0;
+	while(m_frameClock.BStep()) unSimSteps++;
+
+	//when this frame will be seen, so sound events can be put on the same moment
+	int64_t nFrameStartNs = m_frameClock.GetFrameNs();
+	if(!m_bDevMode && vrm && vrm->BIsActive()){
+		//the photons the poses this frame draws with were predicted to, the
+		//same ones the pose sampler predicts to
+		float fDisplayFrequency = vrm->GetDisplayFrequency();
+		int64_t nPhotonNs = vrm->GetPhotonNs();
+		if(nPhotonNs == 0) nPhotonNs = nFrameStartNs + (fDisplayFrequency > 0.0f ? (int64_t)(1.0e9f / fDisplayFrequency) : 0);
+		fiveCell.GetClockBridge().SetFramePhotonTime(nPhotonNs);
+		if(fDisplayFrequency > 0.0f) m_fFrameBudgetMs = 1000.0f / fDisplayFrequency;
+	} else {
+		//no compositor prediction, assume the next refresh of the monitor
+		const GLFWvidmode* vmode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		int nRefreshRate = (vmode && vmode->refreshRate > 0) ? vmode->refreshRate : 60;
+		fiveCell.GetClockBridge().SetFramePhotonTime(nFrameStartNs + 1000000000LL / nRefreshRate);
+		m_fFrameBudgetMs = 1000.0f / (float)nRefreshRate;
+	}
+	UpdateDynamicResolution();
+	UpdatePerfHud(vrm);
+
+	fiveCell.uploadWaveforms();
+
 	// for now as fast as possible
-	if ( !m_bDevMode && vrm->m_pHMD )
+	if ( !m_bDevMode && vrm->BIsActive() )
 	{
 		RenderControllerAxes(vrm);
+		UpdateScene(vrm, unSimSteps);
 		RenderStereoTargets(vrm);
+		probe.MarkDraw();
 		RenderCompanionWindow();
 
-		vr::Texture_t leftEyeTexture = {(void*)(uintptr_t)leftEyeDesc.m_nResolveTextureId, vr::TextureType_OpenGL, vr::ColorSpace_Gamma };
-		vr::VRCompositor()->Submit(vr::Eye_Left, &leftEyeTexture);
-		vr::Texture_t rightEyeTexture = {(void*)(uintptr_t)rightEyeDesc.m_nResolveTextureId, vr::TextureType_OpenGL, vr::ColorSpace_Gamma };
-		vr::VRCompositor()->Submit(vr::Eye_Right, &rightEyeTexture);
+		//only the rendered corner of the targets, bottom left in GL terms and the
+		//compositor's v runs top down, so it is the bottom of the v range
+		vr::VRTextureBounds_t eyeBounds;
+		eyeBounds.uMin = 0.0f;
+		eyeBounds.uMax = m_dynamicResolution.GetUMax();
+		eyeBounds.vMin = 1.0f - m_dynamicResolution.GetVMax();
+		eyeBounds.vMax = 1.0f;
+
+		vrm->BSubmit(vr::Eye_Left, leftEyeDesc.m_nResolveTextureId, eyeBounds);
+		vrm->BSubmit(vr::Eye_Right, rightEyeDesc.m_nResolveTextureId, eyeBounds);
+		probe.MarkSubmit();
 	} else if(m_bDevMode && vrm == nullptr){
 		
-		float currentFrame = glfwGetTime();
-		m_fDeltaTime = currentFrame - m_fLastFrame;
+		//camera moves in real time, even with the simulation paused
+		m_fDeltaTime = (float)m_frameClock.GetFrameDelta();
 		DevProcessInput(m_pGLContext);
+		RecordOrReplayDevCamera();
+		probe.MarkPose();
+		UpdateScene(vrm, unSimSteps);
 		RenderStereoTargets(vrm);
+		probe.MarkDraw();
 		RenderCompanionWindow();
-		m_fLastFrame = currentFrame;
 	} else if(!m_bDevMode && vrm == nullptr){
 		std::cout << "ERROR: vrm not assigned : RenderFrame()" << std::endl;
 		return true;
@@ -709,29 +985,28 @@ bool Graphics::BRenderFrame(std::unique_ptr<VR_Manager>& vrm)
 		// happen right before and after the vsync causing all kinds of jittering issues. This glFinish()
 		// appears to clear that up. Temporary fix while I try to get nvidia to investigate this problem.
 		// 1/29/2014 mikesart
+		AVR_PROFILE_SCOPE("glFinish hack");
 		glFinish();
 	}
 
 	// SwapWindow
 	{
+		m_framePacer.WorkDone();
 		glfwSwapBuffers(m_pGLContext);
 		if(m_bDevMode) glfwSetCursorPosCallback(m_pGLContext, DevMouseCallback);
+		//without a compositor the swap is the hand off
+		if(m_bDevMode) probe.MarkSubmit();
 	}
 
-	// Clear
-	{
-		// We want to make sure the glFinish waits for the entire present to complete, not just the submission
-		// of the command. So, we do a clear here right here so the glFinish will wait fully for the swap.
-		glClearColor( 0, 0, 0, 1 );
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	}
+	// fence behind the swap, the next frame waits on it once enough frames are queued
+	m_streamingBuffer.EndFrame();
+	m_framePacer.FrameSubmitted();
 
-	// Flush and wait for swap.
-	if (m_bVblank)
-	{
-		glFlush();
-		glFinish();
-	}
+	m_memoryMonitor.Update(m_frameClock.GetSimTime());
+
+	probe.EndFrame();
+
+	if(m_bDebugPrintMessages) PrintAudioDeadlineEvents();
 
 	if(!m_bDevMode){
 		// Spew out the controller and pose count whenever they change.
@@ -740,10 +1015,12 @@ bool Graphics::BRenderFrame(std::unique_ptr<VR_Manager>& vrm)
 			m_iValidPoseCount_Last = vrm->m_iValidPoseCount;
 			m_iTrackedControllerCount_Last = m_iTrackedControllerCount;
 			
-			std::printf( "PoseCount:%d(%s) Controllers:%d\n", vrm->m_iValidPoseCount, m_strPoseClasses.c_str(), m_iTrackedControllerCount );
+			Logger::Write(LogLevel_Info, "PoseCount:%d(%s) Controllers:%d\n", vrm->m_iValidPoseCount, vrm->m_rchPoseClasses, m_iTrackedControllerCount );
 		}
 
 		vrm->UpdateHMDMatrixPose();
+		//the next frame renders with this pose
+		probe.MarkPose();
 		return false;
 	} 
 
@@ -752,6 +1029,87 @@ bool Graphics::BRenderFrame(std::unique_ptr<VR_Manager>& vrm)
 	//std::cout << *m_pRotationVal << std::endl;
 }
 
+//-----------------------------------------------------------------------------
+// Hands FiveCell the frame's simulation steps and the head it is heard from,
+// once per frame before the eyes are drawn. The view matrix is the same for
+// both eyes.
+//-----------------------------------------------------------------------------
+void Graphics::UpdateScene(std::unique_ptr<VR_Manager>& vrm, uint32_t unSimSteps)
+{
+	SimulationInput input;
+	if(!m_bDevMode){
+		input.viewMat = vrm->GetCurrentViewMatrix(vr::Eye_Left);
+		input.camPos = glm::vec3(input.viewMat[0][3], input.viewMat[1][3], input.viewMat[2][3]);
+	} else {
+		input.viewMat = glm::lookAt(m_vec3DevCamPos, m_vec3DevCamPos + m_vec3DevCamFront, m_vec3DevCamUp);
+		input.camPos = m_vec3DevCamPos;
+	}
+	input.steps = unSimSteps;
+	input.stepSeconds = m_frameClock.GetStepSeconds();
+	input.alpha = (float)m_frameClock.GetAlpha();
+	input.poseNs = fiveCell.GetLatencyProbe().GetPoseNs();
+	if(m_pSessionRecorder) input.frame = m_pSessionRecorder->GetFrame();
+	else if(m_pSessionReplayer) input.frame = m_pSessionReplayer->GetFrame();
+
+	fiveCell.update(input);
+}
+
+//-----------------------------------------------------------------------------
+// Prints any audio blocks that came close to or missed their deadline since
+// the last frame, stamped on the same steady clock as the frame so audio
+// glitches can be matched against render spikes.
+//-----------------------------------------------------------------------------
+void Graphics::PrintAudioDeadlineEvents()
+{
+	const AudioDeadlineMonitor* pMonitor = fiveCell.GetAudioDeadlineMonitor();
+	if(!pMonitor) return;
+
+	AudioDeadlineMonitor::DeadlineEvent rEvents[16];
+	uint32_t unCount = pMonitor->DrainEvents(rEvents, 16, m_ulAudioDeadlineCursor);
+	if(unCount == 0) return;
+
+	int64_t nFrameNs = AudioDeadlineMonitor::NowNs();
+	AudioDeadlineMonitor::Snapshot snapshot;
+	pMonitor->GetSnapshot(snapshot);
+	for(uint32_t i = 0; i < unCount; i++)
+	{
+		AVR_LOG_RATE_LIMITED(20, LogLevel_Warning, "Audio %s: block %.3fms of %.3fms at t=%.3fms (frame t=%.3fms) overruns:%llu\n",
+			rEvents[i].bOverrun ? "overrun" : "near miss",
+			rEvents[i].fBlockMs, snapshot.dPeriodMs,
+			(double)rEvents[i].nTimestampNs / 1.0e6, (double)nFrameNs / 1.0e6,
+			(unsigned long long)snapshot.ulOverruns);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Prints the latency distributions and checks the two end to end paths
+// against the budget. Fails if either path has no samples, which means the
+// chain is broken.
+//-----------------------------------------------------------------------------
+bool Graphics::BReportLatency(float fBudgetMs)
+{
+	LatencyProbe& probe = fiveCell.GetLatencyProbe();
+	probe.PrintReport();
+
+	bool bPass = true;
+	LatencyProbe::ELatencyMetric rChecked[2] = { LatencyProbe::Latency_AudioToSubmit, LatencyProbe::Latency_PoseToOutput };
+	for(int i = 0; i < 2; i++)
+	{
+		double dP99 = probe.GetPercentileMs(rChecked[i], 0.99);
+		if(probe.GetCount(rChecked[i]) == 0)
+		{
+			std::cout << "Error: no samples for " << LatencyProbe::MetricName(rChecked[i]) << std::endl;
+			bPass = false;
+		}
+		else if(dP99 > fBudgetMs)
+		{
+			std::cout << "Error: " << LatencyProbe::MetricName(rChecked[i]) << " p99 " << dP99 << "ms is over the " << fBudgetMs << "ms budget" << std::endl;
+			bPass = false;
+		}
+	}
+	return bPass;
+}
+
 //-----------------------------------------------------------------------------
 // This function increases the angle for the 3D rotation of the structure
 // ----------------------------------------------------------------------------
@@ -770,73 +1128,83 @@ void Graphics::IncreaseRotationValue(std::unique_ptr<int>& pVal){
 //-----------------------------------------------------------------------------
 void Graphics::RenderControllerAxes(std::unique_ptr<VR_Manager>& vrm)
 {
+	// nothing left over from an earlier frame's region
+	m_uiControllerVertCount = 0;
+
 	// Don't attempt to update controllers if input is not available
-	if( !vrm->m_pHMD->IsInputAvailable() )
+	if( !vrm->BIsInputAvailable() )
 		return;
 
-	std::vector<float> vertdataarray;
-
-	m_uiControllerVertCount = 0;
-	m_iTrackedControllerCount = 0;
+	// 3 axes and the ray, a line each, 6 floats a vertex
+	const uint32_t unFloatsPerHand = 4 * 2 * 6;
+	float* pVertData = (float*)JobSystem::AllocScratch(2 * unFloatsPerHand * sizeof(float));
+	if(!pVertData)
+		return;
+	bool rbShowHand[2];
 
-	// this for loop shuold use eHand iterators from VR::Manager	
-	for (int i = 0; i <= 1; i++)
+	// each hand fills its own slot, so the hands can be built as separate jobs
+	auto buildHandAxes = [&](uint32_t unBegin, uint32_t unEnd)
 	{
-		if ( !vrm->m_rHand[i].m_bShowController )
-			continue;
-
-		const glm::mat4& mat = vrm->m_rHand[i].m_rmat4Pose;
-
-		glm::vec4 center = mat * glm::vec4( 0, 0, 0, 1 );
-
-		for ( int i = 0; i < 3; ++i )
+		for (uint32_t unHand = unBegin; unHand < unEnd; unHand++)
 		{
-			glm::vec3 color( 0, 0, 0 );
-			glm::vec4 point( 0, 0, 0, 1 );
-			point[i] += 0.05f;  // offset in X, Y, Z
-			color[i] = 1.0;  // R, G, B
-			point = mat * point;
-			vertdataarray.push_back( center.x );
-			vertdataarray.push_back( center.y );
-			vertdataarray.push_back( center.z );
-
-			vertdataarray.push_back( color.x );
-			vertdataarray.push_back( color.y );
-			vertdataarray.push_back( color.z );
-		
-			vertdataarray.push_back( point.x );
-			vertdataarray.push_back( point.y );
-			vertdataarray.push_back( point.z );
-		
-			vertdataarray.push_back( color.x );
-			vertdataarray.push_back( color.y );
-			vertdataarray.push_back( color.z );
-		
-			m_uiControllerVertCount += 2;
-		}
-
-		glm::vec4 start = mat * glm::vec4( 0, 0, -0.02f, 1 );
-		glm::vec4 end = mat * glm::vec4( 0, 0, -39.f, 1 );
-		glm::vec3 color( .92f, .92f, .71f );
+			rbShowHand[unHand] = vrm->m_rHand[unHand].m_bShowController;
+			if ( !rbShowHand[unHand] )
+				continue;
 
-		vertdataarray.push_back( start.x );vertdataarray.push_back( start.y );vertdataarray.push_back( start.z );
-		vertdataarray.push_back( color.x );vertdataarray.push_back( color.y );vertdataarray.push_back( color.z );
+			const glm::mat4& mat = vrm->m_rHand[unHand].m_rmat4Pose;
+			float* pVert = pVertData + unHand * unFloatsPerHand;
+			auto pushVert = [&pVert](const glm::vec4& pos, const glm::vec3& color)
+			{
+				*pVert++ = pos.x; *pVert++ = pos.y; *pVert++ = pos.z;
+				*pVert++ = color.x; *pVert++ = color.y; *pVert++ = color.z;
+			};
+
+			glm::vec4 center = mat * glm::vec4( 0, 0, 0, 1 );
+
+			for ( int i = 0; i < 3; ++i )
+			{
+				glm::vec3 color( 0, 0, 0 );
+				glm::vec4 point( 0, 0, 0, 1 );
+				point[i] += 0.05f;  // offset in X, Y, Z
+				color[i] = 1.0;  // R, G, B
+				point = mat * point;
+				pushVert( center, color );
+				pushVert( point, color );
+			}
+
+			glm::vec4 start = mat * glm::vec4( 0, 0, -0.02f, 1 );
+			glm::vec4 end = mat * glm::vec4( 0, 0, -39.f, 1 );
+			glm::vec3 color( .92f, .92f, .71f );
+			pushVert( start, color );
+			pushVert( end, color );
+		}
+	};
+	if (m_pJobSystem)
+		m_pJobSystem->ParallelFor(2, k_unHandsPerJob, buildHandAxes);
+	else
+		buildHandAxes(0, 2);
 
-		vertdataarray.push_back( end.x );vertdataarray.push_back( end.y );vertdataarray.push_back( end.z );
-		vertdataarray.push_back( color.x );vertdataarray.push_back( color.y );vertdataarray.push_back( color.z );
-		m_uiControllerVertCount += 2;
+	// close the gap a hidden left hand leaves
+	m_iTrackedControllerCount = 0;
+	for (int i = 0; i <= 1; i++)
+	{
+		if ( !rbShowHand[i] )
+			continue;
+		if ( m_uiControllerVertCount != (unsigned int)i * 8 )
+			memmove( pVertData + m_uiControllerVertCount * 6, pVertData + i * unFloatsPerHand, unFloatsPerHand * sizeof(float) );
+		m_uiControllerVertCount += 8;
 	}
 
+	GLuint stride = 2 * 3 * sizeof( float );
+
 	// Setup the VAO the first time through.
 	if ( m_unControllerVAO == 0 )
 	{
 		glGenVertexArrays( 1, &m_unControllerVAO );
 		glBindVertexArray( m_unControllerVAO );
 
-		glGenBuffers( 1, &m_glControllerVertBuffer );
-		glBindBuffer( GL_ARRAY_BUFFER, m_glControllerVertBuffer );
+		glBindBuffer( GL_ARRAY_BUFFER, m_streamingBuffer.GetBuffer() );
 
-		GLuint stride = 2 * 3 * sizeof( float );
 		uintptr_t offset = 0;
 
 		glEnableVertexAttribArray( 0 );
@@ -849,13 +1217,19 @@ void Graphics::RenderControllerAxes(std::unique_ptr<VR_Manager>& vrm)
 		glBindVertexArray( 0 );
 	}
 
-	glBindBuffer( GL_ARRAY_BUFFER, m_glControllerVertBuffer );
-
-	// set vertex data if we have some
-	if( vertdataarray.size() > 0 )
+	// set vertex data if we have some, copied in whole so the mapping is only written
+	if( m_uiControllerVertCount > 0 )
 	{
-		//$ TODO: Use glBufferSubData for this...
-		glBufferData( GL_ARRAY_BUFFER, sizeof(float) * vertdataarray.size(), &vertdataarray[0], GL_STREAM_DRAW );
+		StreamingBuffer::Allocation allocation;
+		if ( !m_streamingBuffer.BAllocate( stride * m_uiControllerVertCount, stride, allocation ) )
+		{
+			m_uiControllerVertCount = 0;
+			return;
+		}
+		memcpy( allocation.pData, pVertData, allocation.nSize );
+		m_streamingBuffer.Commit( allocation );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		m_nControllerFirstVertex = (GLint)( allocation.nOffset / stride );
 	}
 }
 
@@ -868,10 +1242,19 @@ void Graphics::RenderStereoTargets(std::unique_ptr<VR_Manager>& vrm)
 	//glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glEnable(GL_MULTISAMPLE);
 
+	//the part of the targets dynamic resolution picked for this frame
+	GLint nViewportWidth = (GLint)m_dynamicResolution.GetViewportWidth();
+	GLint nViewportHeight = (GLint)m_dynamicResolution.GetViewportHeight();
+
+	m_perfHud.BeginGpuPass(PerfHud::GpuPass_Eyes);
+
 	// Left Eye
 	glBindFramebuffer(GL_FRAMEBUFFER, leftEyeDesc.m_nRenderFramebufferId);
- 	glViewport(0, 0, m_nRenderWidth, m_nRenderHeight);
+ 	glViewport(0, 0, nViewportWidth, nViewportHeight);
+	//the freshest head pose, right before the eye's draws are issued
+	if(!m_bDevMode && vrm != nullptr) vrm->LateLatchEye(vr::Eye_Left);
  	RenderScene(vr::Eye_Left, vrm);
+	if(m_bHudEyes) DrawPerfHudInEye();
  	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	
 	glDisable(GL_MULTISAMPLE);
@@ -879,7 +1262,7 @@ void Graphics::RenderStereoTargets(std::unique_ptr<VR_Manager>& vrm)
  	glBindFramebuffer(GL_READ_FRAMEBUFFER, leftEyeDesc.m_nRenderFramebufferId);
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, leftEyeDesc.m_nResolveFramebufferId);
 
-   	glBlitFramebuffer(0, 0, m_nRenderWidth, m_nRenderHeight, 0, 0, m_nRenderWidth, m_nRenderHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+   	glBlitFramebuffer(0, 0, nViewportWidth, nViewportHeight, 0, 0, nViewportWidth, nViewportHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
 	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
@@ -890,8 +1273,10 @@ void Graphics::RenderStereoTargets(std::unique_ptr<VR_Manager>& vrm)
 		
 		// Right Eye
 		glBindFramebuffer(GL_FRAMEBUFFER, rightEyeDesc.m_nRenderFramebufferId);
-		glViewport(0, 0, m_nRenderWidth, m_nRenderHeight);
+		glViewport(0, 0, nViewportWidth, nViewportHeight);
+		vrm->LateLatchEye(vr::Eye_Right);
 		RenderScene(vr::Eye_Right, vrm);
+		if(m_bHudEyes) DrawPerfHudInEye();
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		glDisable(GL_MULTISAMPLE);
@@ -899,11 +1284,25 @@ void Graphics::RenderStereoTargets(std::unique_ptr<VR_Manager>& vrm)
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, rightEyeDesc.m_nRenderFramebufferId);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, rightEyeDesc.m_nResolveFramebufferId);
 
-		glBlitFramebuffer(0, 0, m_nRenderWidth, m_nRenderHeight, 0, 0, m_nRenderWidth, m_nRenderHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBlitFramebuffer(0, 0, nViewportWidth, nViewportHeight, 0, 0, nViewportWidth, nViewportHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 	}
+
+	m_perfHud.EndGpuPass(PerfHud::GpuPass_Eyes);
+}
+
+//-----------------------------------------------------------------------------
+// The HUD in the eye buffer that is bound, below the centre of view where
+// it can be read without looking into the lens edges.
+//-----------------------------------------------------------------------------
+void Graphics::DrawPerfHudInEye()
+{
+	int nWidth = (int)m_dynamicResolution.GetViewportWidth();
+	int nHeight = (int)m_dynamicResolution.GetViewportHeight();
+	float fPixelScale = (float)nWidth / 1200.0f;
+	m_perfHud.Draw(nWidth, nHeight, (float)nWidth * 0.3f, (float)nHeight * 0.6f, fPixelScale);
 }
 
 //-----------------------------------------------------------------------------
@@ -915,27 +1314,23 @@ void Graphics::RenderScene(vr::Hmd_Eye nEye, std::unique_ptr<VR_Manager>& vrm)
 	glm::mat4 currentProjMatrix;
 	glm::mat4 currentViewMatrix;
 	glm::mat4 currentEyeMatrix;
-	glm::vec3 cameraFront;
-	glm::vec3 cameraPosition;
 
 	//glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glEnable(GL_DEPTH_TEST);
 
+	const EyeCamera* pEyeCamera = nullptr;
 	if(!m_bDevMode){
-		currentProjMatrix = vrm->GetCurrentProjectionMatrix(nEye);
-		currentViewMatrix = vrm->GetCurrentViewMatrix(nEye);
-		currentEyeMatrix = vrm->GetCurrentEyeMatrix(nEye);
-		cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
-		cameraPosition = glm::vec3(currentViewMatrix[0][3], currentViewMatrix[1][3], currentViewMatrix[2][3]);
+		pEyeCamera = &vrm->GetFrameCamera().rEye[nEye];
+		currentProjMatrix = pEyeCamera->matProjection;
+		currentViewMatrix = pEyeCamera->matView;
+		currentEyeMatrix = pEyeCamera->matEye;
 	} else {
 		//*** put manual matrices here***//
 		currentProjMatrix = m_matDevProjMatrix;  
 		m_matDevViewMatrix = glm::lookAt(m_vec3DevCamPos, m_vec3DevCamPos + m_vec3DevCamFront, m_vec3DevCamUp);	
 		currentViewMatrix = m_matDevViewMatrix;
 		currentEyeMatrix = glm::mat4(1.0f);
-		cameraFront = m_vec3DevCamFront;
-		cameraPosition = m_vec3DevCamPos;
 	}
 
 	////draw texture quad
@@ -954,23 +1349,20 @@ void Graphics::RenderScene(vr::Hmd_Eye nEye, std::unique_ptr<VR_Manager>& vrm)
 	//glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	//glBindVertexArray(0);
 
-	//update variables for fiveCell
-	fiveCell.update(currentProjMatrix, currentViewMatrix, cameraFront, cameraPosition);
-	
 	//draw fiveCell scene
 	fiveCell.draw(skyboxShaderProg, groundPlaneShaderProg, soundObjShaderProg, fiveCellShaderProg, quadShaderProg, currentProjMatrix, currentViewMatrix, currentEyeMatrix);
 
-	if(!m_bDevMode && vrm){
+	if(pEyeCamera){
 	
-		bool bIsInputAvailable = vrm->m_pHMD->IsInputAvailable();
+		bool bIsInputAvailable = vrm->BIsInputAvailable();
 
 		if (bIsInputAvailable)
 		{
 			// draw the controller axis lines
 			glUseProgram(m_unControllerTransformProgramID);
-			glUniformMatrix4fv(m_nControllerMatrixLocation, 1, GL_FALSE, &vrm->GetCurrentViewProjectionMatrix(nEye)[0][0]);
+			glUniformMatrix4fv(m_nControllerMatrixLocation, 1, GL_FALSE, &pEyeCamera->matViewProjection[0][0]);
 			glBindVertexArray(m_unControllerVAO);
-			glDrawArrays(GL_LINES, 0, m_uiControllerVertCount);
+			glDrawArrays(GL_LINES, m_nControllerFirstVertex, m_uiControllerVertCount);
 			glBindVertexArray(0);
 		}
 
@@ -984,7 +1376,7 @@ void Graphics::RenderScene(vr::Hmd_Eye nEye, std::unique_ptr<VR_Manager>& vrm)
 				continue;
 
 			const glm::mat4& matDeviceToTracking = vrm->m_rHand[i].m_rmat4Pose;
-			glm::mat4 matMVP = vrm->GetCurrentViewProjectionMatrix(nEye) * matDeviceToTracking;
+			glm::mat4 matMVP = pEyeCamera->matViewProjection * matDeviceToTracking;
 			glUniformMatrix4fv(m_nRenderModelMatrixLocation, 1, GL_FALSE, &matMVP[0][0]);
 
 			vrm->m_rHand[i].m_pRenderModel->Draw();
@@ -999,11 +1391,14 @@ void Graphics::RenderScene(vr::Hmd_Eye nEye, std::unique_ptr<VR_Manager>& vrm)
 //-----------------------------------------------------------------------------
 void Graphics::RenderCompanionWindow()
 {
+	AVR_PROFILE_SCOPE("RenderCompanionWindow");
+	m_perfHud.BeginGpuPass(PerfHud::GpuPass_Companion);
 	glDisable(GL_DEPTH_TEST);
 	glViewport(0, 0, m_nCompanionWindowWidth, m_nCompanionWindowHeight);
 
 	glBindVertexArray(m_unCompanionWindowVAO);
 	glUseProgram(m_unCompanionWindowProgramID);
+	glUniform2f(m_nCompanionUVScaleLocation, m_dynamicResolution.GetUMax(), m_dynamicResolution.GetVMax());
 
 	// render left eye (first half of index array )
 	glBindTexture(GL_TEXTURE_2D, leftEyeDesc.m_nResolveTextureId);
@@ -1020,22 +1415,20 @@ void Graphics::RenderCompanionWindow()
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	//glDrawElements(GL_TRIANGLES, m_uiCompanionWindowIndexSize/2, GL_UNSIGNED_SHORT, (const void *)(uintptr_t)(m_uiCompanionWindowIndexSize));
 
-	// Read pixels to memory to save as png **to do - change to C++14 style**
-	if(m_bRecordScreen){
-		GLubyte *pixels = (GLubyte*) malloc(4 * m_nCompanionWindowWidth * m_nCompanionWindowHeight);
-
-		if(pixels){
-			glReadPixels(0, 0, m_nCompanionWindowWidth, m_nCompanionWindowHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-		}
-	
-		//WriteToPNG(pixels);
-
-		free(pixels);
-		pixels = nullptr;
+	// -recordscreen only, the read waits for the gpu to finish the frame
+	if(m_bRecordScreen && !m_vecScreenPixels.empty()){
+		GLubyte *pixels = m_vecScreenPixels.data();
+		glReadPixels(0, 0, m_nCompanionWindowWidth, m_nCompanionWindowHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		WriteToPNG(pixels);
 	}
 
 	glBindVertexArray(0);
 	glUseProgram(0);
+	m_perfHud.EndGpuPass(PerfHud::GpuPass_Companion);
+
+	m_perfHud.BeginGpuPass(PerfHud::GpuPass_Hud);
+	m_perfHud.Draw(m_nCompanionWindowWidth, m_nCompanionWindowHeight, 10.0f, 10.0f, 1.0f);
+	m_perfHud.EndGpuPass(PerfHud::GpuPass_Hud);
 }
 
 //----------------------------------------------------------------------
@@ -1043,8 +1436,8 @@ void Graphics::RenderCompanionWindow()
 //----------------------------------------------------------------------
 void Graphics::WriteToPNG(GLubyte* &data){
 
-	char* filename = (char*) malloc(32);
-	snprintf(filename, sizeof(char) * 32, "stills3/image%04d.png", m_unImageCount);
+	char filename[32];
+	snprintf(filename, sizeof(filename), "stills3/image%04d.png", m_unImageCount);
 
 	//FILE* imageFile;
 	//imageFile = fopen(filename, "wb");
@@ -1059,8 +1452,6 @@ void Graphics::WriteToPNG(GLubyte* &data){
 	}
 
 	m_unImageCount++;
-	free(filename);
-	filename = nullptr;
 }
 
 //----------------------------------------------------------------------
@@ -1093,6 +1484,13 @@ void Graphics::CleanUpGL(std::unique_ptr<VR_Manager>& vrm){
 		if ( m_unCompanionWindowProgramID )
 		{
 			glDeleteProgram( m_unCompanionWindowProgramID );
+		}
+		m_perfHud.CleanUp();
+		m_streamingBuffer.CleanUp();
+		m_framePacer.CleanUp();
+		if ( m_unPerfHudProgramID )
+		{
+			glDeleteProgram( m_unPerfHudProgramID );
 		}	
 
 		glDeleteRenderbuffers( 1, &leftEyeDesc.m_nDepthBufferId );
@@ -1140,5 +1538,38 @@ bool Graphics::TempEsc(){
 			return true;
 	}
 
+	//F5 recompiles the orchestra and crossfades to it
+	bool bReloadKey = GLFW_PRESS == glfwGetKey(m_pGLContext, GLFW_KEY_F5);
+	if(bReloadKey && !m_bReloadKeyDown){
+		if(!fiveCell.BReloadOrchestra()) std::cout << "Orchestra swap already in progress" << std::endl;
+	}
+	m_bReloadKeyDown = bReloadKey;
+
+	//P pauses the simulation, - and = halve and double its speed
+	bool bPauseKey = GLFW_PRESS == glfwGetKey(m_pGLContext, GLFW_KEY_P);
+	if(bPauseKey && !m_bPauseKeyDown) m_frameClock.SetPaused(!m_frameClock.BIsPaused());
+	m_bPauseKeyDown = bPauseKey;
+
+	bool bSlowerKey = GLFW_PRESS == glfwGetKey(m_pGLContext, GLFW_KEY_MINUS);
+	bool bFasterKey = GLFW_PRESS == glfwGetKey(m_pGLContext, GLFW_KEY_EQUAL);
+	if((bSlowerKey || bFasterKey) && !m_bScaleKeyDown){
+		m_frameClock.SetTimeScale(m_frameClock.GetTimeScale() * (bFasterKey ? 2.0 : 0.5));
+		std::cout << "Time scale " << m_frameClock.GetTimeScale() << std::endl;
+	}
+	m_bScaleKeyDown = bSlowerKey || bFasterKey;
+
+	//F1 shows and hides the performance HUD
+	bool bHudKey = GLFW_PRESS == glfwGetKey(m_pGLContext, GLFW_KEY_F1);
+	if(bHudKey && !m_bHudKeyDown) m_perfHud.SetVisible(!m_perfHud.BIsVisible());
+	m_bHudKeyDown = bHudKey;
+
+	//F9 writes the profile of the last few seconds
+	bool bProfileKey = GLFW_PRESS == glfwGetKey(m_pGLContext, GLFW_KEY_F9);
+	if(bProfileKey && !m_bProfileKeyDown){
+		if(Profiler::BIsEnabled()) Profiler::BDump("avr_profile_" + std::to_string(m_frameClock.GetFrameIndex()) + ".json");
+		else std::cout << "Profiler not built, configure with -DAVR_ENABLE_PROFILER=ON" << std::endl;
+	}
+	m_bProfileKeyDown = bProfileKey;
+
 	return false;
 }
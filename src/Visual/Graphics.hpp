@@ -3,12 +3,19 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 //#include <ctime>
 
 #include "FiveCell.hpp"
 #include "VR_Manager.hpp"
-
-#ifdef __APPLE__ 
+#include "FrameClock.hpp"
+#include "PerfHud.hpp"
+#include "FramePacer.hpp"
+#include "StreamingBuffer.hpp"
+#include "MemoryMonitor.hpp"
+#include "DynamicResolution.hpp"
+
+#if defined(__APPLE__) || defined(__linux__)
 #include "GLFW/glfw3.h"
 #elif _WIN32 
 #include "glfw3.h"
@@ -20,6 +27,8 @@ class Graphics{
 public:
 
 	Graphics(std::unique_ptr<ExecutionFlags>& flagPtr);
+	void SetJobSystem(JobSystem* pJobSystem);
+	void SetSession(SessionRecorder* pRecorder, SessionReplayer* pReplayer);
 	bool BInitGL(bool fullscreen = true);
 	bool BCreateDefaultShaders();
 	GLuint BCreateSceneShaders(std::string shaderName);
@@ -29,6 +38,7 @@ public:
 	bool BSetupCompanionWindow();
 	//void DevMouseCallback(GLFWwindow* window, double xpos, double ypos);
 	void DevProcessInput(GLFWwindow *window);
+	void RecordOrReplayDevCamera();
 	bool BRenderFrame(std::unique_ptr<VR_Manager>& vrm);
 	void RenderControllerAxes(std::unique_ptr<VR_Manager>& vrm);
 	void RenderStereoTargets(std::unique_ptr<VR_Manager>& vrm);
@@ -37,6 +47,14 @@ public:
 	void WriteToPNG(GLubyte* &data);
 	bool TempEsc();
 	void IncreaseRotationValue(std::unique_ptr<int>& pVal);
+	void UpdateScene(std::unique_ptr<VR_Manager>& vrm, uint32_t unSimSteps);
+	void UpdateDynamicResolution();
+	void UpdatePerfHud(std::unique_ptr<VR_Manager>& vrm);
+	void DrawPerfHudInEye();
+	void PrintAudioDeadlineEvents();
+	bool BReportLatency(float fBudgetMs);
+	bool BSoakDone() const { return m_memoryMonitor.BSoakDone(m_frameClock.GetSimTime()); }
+	bool BReportSoak() { return m_memoryMonitor.BReportSoak(); }
 
 private:
 
@@ -80,7 +98,7 @@ private:
 	unsigned int m_uiControllerVertCount;
 
 	GLuint m_unControllerVAO;
-	GLuint m_glControllerVertBuffer;
+	GLint m_nControllerFirstVertex;	// in the streaming buffer, this frame
 	//GLint m_nSceneMatrixLocation;
 	glm::mat4 m_mat4HMDPose;
 	GLuint m_unSceneVAO;
@@ -107,12 +125,39 @@ private:
 	int m_iTrackedControllerCount;
 	int m_iTrackedControllerCount_Last;
 	int m_iValidPoseCount_Last;
-	std::string m_strPoseClasses;                            // what classes we saw poses for this frame
 
 	bool m_bDebugOpenGL;
 	bool m_bDebugPrintMessages;
 	bool m_bDevMode;
 
+	ThreadPolicy m_audioThreadPolicy;
+	int m_nAudioThreads;
+	float m_fCrossfadeTime;
+	bool m_bReloadKeyDown;
+	bool m_bPauseKeyDown;
+	bool m_bScaleKeyDown;
+	bool m_bProfileKeyDown;
+	bool m_bHudKeyDown;
+	bool m_bHudEyes;
+	float m_fFrameBudgetMs;
+	PerfHud m_perfHud;
+	FramePacer m_framePacer;
+	StreamingBuffer m_streamingBuffer;
+	DynamicResolution m_dynamicResolution;
+	uint64_t m_ulDynamicResolutionSamples;
+	GLint m_nCompanionUVScaleLocation;
+	GLuint m_unPerfHudProgramID;
+	double m_dLastProfileDump;
+	bool m_bLatencyTest;
+	bool m_bHeadless;
+	MemoryMonitor m_memoryMonitor;
+	bool m_bPipeline;
+	ThreadPolicy m_simulationThreadPolicy;
+	JobSystem* m_pJobSystem;
+	SessionRecorder* m_pSessionRecorder;
+	SessionReplayer* m_pSessionReplayer;
+	uint64_t m_ulAudioDeadlineCursor;
+
 	//GLint resolution; 
 	GLint m_gliViewEyeProjLocation;
 	GLint m_nViewMatrixLocation;
@@ -135,6 +180,7 @@ private:
 
 	unsigned int m_unImageCount;	
 	bool m_bRecordScreen;
+	std::vector<GLubyte> m_vecScreenPixels;
 
 	//time_t m_tStartTime;
 	//unsigned int m_uiFrameNumber;
@@ -165,7 +211,9 @@ private:
 	glm::vec3 m_vec3DevCamUp;
 
 	float m_fDeltaTime;
-	float m_fLastFrame;	
+
+	//sampled once per frame, drives the fixed step simulation
+	FrameClock m_frameClock;
 };
 
 
@@ -1,51 +1,26 @@
 #include <cstdio>
 #include <cstdarg>
-#include <ctime>
 
-#ifdef __APPLE__
+#if defined(__APPLE__) || defined(__linux__)
 #include <GL/glew.h>
 #elif _WIN32
 #include "GL/glew.h"
 #endif
 
 #include "Log.hpp"
+#include "Logger.hpp"
 
-//starts log file
-bool restart_gl_log(){
-	FILE* file = fopen(GL_LOG_FILE, "w");
-	if(!file){
-		fprintf(stderr, "ERROR: Could not open GL_LOG_FILE log file %s file for appending\n", GL_LOG_FILE);
-		return false;
-	}
-
-	time_t now = time(NULL);
-	char* date = ctime(&now);
-	fprintf(file, "Shader Setup log. local time %s\n", date);
-	fclose(file);
-	return true;
-}
-
-//writes log info to file
+//writes log info to the asynchronous log, which goes to its file and the console
 bool gl_log_err(const char* message, ...){
 	va_list argptr;
-	FILE* file = fopen(GL_LOG_FILE, "a");
-	if(!file){
-		fprintf(stderr, "ERROR: could not open GL_LOG_FILE %s file for appending\n", GL_LOG_FILE);
-		return false;
-	}
-
-	va_start(argptr, message);
-	vfprintf(file, message, argptr);
-	va_end(argptr);
 	va_start(argptr, message);
-	vfprintf(stderr, message, argptr);
+	Logger::WriteV(LogLevel_Info, message, argptr);
 	va_end(argptr);
-	fclose(file);
 	return true;
 }
 
 void glfw_error_callback(int error, const char* description){
-	gl_log_err("GLFW ERROR: code %i msg: %s\n", error, description);
+	Logger::Write(LogLevel_Error, "GLFW ERROR: code %i msg: %s\n", error, description);
 }
 
 //reports OpenGL system info
@@ -1,9 +1,6 @@
 #ifndef LOG_HPP
 #define LOG_HPP
 
-#define GL_LOG_FILE "gl.log"
-
-bool restart_gl_log();
 bool gl_log_err(const char* message, ...);
 void glfw_error_callback(int error, const char* description);
 void log_gl_params();
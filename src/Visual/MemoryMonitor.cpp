@@ -0,0 +1,248 @@
+#include "MemoryMonitor.hpp"
+#include "SystemInfo.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	// where a census starts looking before any object has been seen
+	const GLuint k_unMinScanLimit = 4096;
+	// the baseline waits for start up to settle, at most this long
+	const double k_dMaxWarmupSeconds = 300.0;
+	const uint32_t k_unTopSites = 8;
+	const double k_dBytesPerMb = 1024.0 * 1024.0;
+
+	GLboolean BIsObject(MemoryMonitor::EGLObject eObject, GLuint unName)
+	{
+		switch(eObject)
+		{
+		case MemoryMonitor::GLObject_Buffer:		return glIsBuffer(unName);
+		case MemoryMonitor::GLObject_Texture:		return glIsTexture(unName);
+		case MemoryMonitor::GLObject_VertexArray:	return glIsVertexArray(unName);
+		case MemoryMonitor::GLObject_Framebuffer:	return glIsFramebuffer(unName);
+		case MemoryMonitor::GLObject_Renderbuffer:	return glIsRenderbuffer(unName);
+		case MemoryMonitor::GLObject_Shader:		return glIsShader(unName);
+		case MemoryMonitor::GLObject_Program:		return glIsProgram(unName);
+		default:									return GL_FALSE;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+MemoryMonitor::MemoryMonitor() :
+	m_dReportSeconds(0.0),
+	m_dSoakSeconds(0.0),
+	m_dWarmupSeconds(0.0),
+	m_dBudgetBytes(0.0),
+	m_dNextReport(0.0),
+	m_bHasBaseline(false)
+{
+	for(uint32_t i = 0; i < GLObject_Count; i++) m_runScanLimit[i] = k_unMinScanLimit;
+}
+
+//-----------------------------------------------------------------------------
+void MemoryMonitor::Init(double dReportSeconds, double dSoakHours, double dBudgetMb)
+{
+	m_dReportSeconds = std::max(dReportSeconds, 0.0);
+	m_dSoakSeconds = std::max(dSoakHours, 0.0) * 3600.0;
+	m_dWarmupSeconds = std::min(k_dMaxWarmupSeconds, m_dSoakSeconds * 0.1);
+	m_dBudgetBytes = dBudgetMb * k_dBytesPerMb;
+	m_dNextReport = m_dReportSeconds;
+	m_bHasBaseline = false;
+
+	if(AllocationTracker::BIsEnabled() && (m_dReportSeconds > 0.0 || BIsSoaking()))
+	{
+		m_vecSites.resize(AllocationTracker::k_unSiteSlots);
+		m_vecBaselineSites.resize(AllocationTracker::k_unSiteSlots);
+	}
+
+	if(BIsSoaking())
+		Logger::Write(LogLevel_Info, "Soak: %.2f simulated hours, %.1f MB budget, baseline at %.0f s\n", dSoakHours, dBudgetMb, m_dWarmupSeconds);
+	if(m_dReportSeconds > 0.0)
+		Logger::Write(LogLevel_Info, "Memory report every %.0f simulated seconds, heap %s\n", m_dReportSeconds, AllocationTracker::BIsEnabled() ? "tracked" : "not tracked");
+}
+
+//-----------------------------------------------------------------------------
+void MemoryMonitor::Update(double dSimTime)
+{
+	m_latest.dSimTime = dSimTime;
+
+	if(BIsSoaking() && !m_bHasBaseline && dSimTime >= m_dWarmupSeconds)
+	{
+		TakeSample(m_baseline);
+		m_baseline.dSimTime = dSimTime;
+		m_vecBaselineSites = m_vecSites;
+		m_bHasBaseline = true;
+		LogSample("Soak baseline", m_baseline);
+	}
+
+	if(m_dReportSeconds <= 0.0 || dSimTime < m_dNextReport) return;
+
+	// a long stall still reports once
+	while(m_dNextReport <= dSimTime) m_dNextReport += m_dReportSeconds;
+
+	TakeSample(m_latest);
+	m_latest.dSimTime = dSimTime;
+	LogSample("Memory", m_latest);
+	if(m_bHasBaseline)
+		LogTopSites(m_vecBaselineSites);
+	else
+		LogTopSites(std::vector<AllocationTracker::SiteStats>());
+}
+
+//-----------------------------------------------------------------------------
+// Growth is measured from the baseline, what start up allocated once is not
+// counted against the budget.
+//-----------------------------------------------------------------------------
+bool MemoryMonitor::BReportSoak()
+{
+	if(!BIsSoaking()) return true;
+
+	if(!m_bHasBaseline)
+	{
+		Logger::Write(LogLevel_Error, "Error: soak ended at %.0f s, before its baseline at %.0f s\n", m_latest.dSimTime, m_dWarmupSeconds);
+		return false;
+	}
+
+	double dSimTime = m_latest.dSimTime;
+	TakeSample(m_latest);
+	m_latest.dSimTime = dSimTime;
+	LogSample("Soak end", m_latest);
+	LogTopSites(m_vecBaselineSites);
+
+	bool bPass = true;
+	double dHours = (m_latest.dSimTime - m_baseline.dSimTime) / 3600.0;
+	if(AllocationTracker::BIsEnabled())
+	{
+		double dHeapGrowth = (double)(m_latest.heap.nLiveBytes - m_baseline.heap.nLiveBytes);
+		if(dHeapGrowth > m_dBudgetBytes)
+		{
+			Logger::Write(LogLevel_Error, "Error: live heap grew %.2f MB in %.2f simulated hours, over the %.1f MB budget\n", dHeapGrowth / k_dBytesPerMb, dHours, m_dBudgetBytes / k_dBytesPerMb);
+			bPass = false;
+		}
+	}
+
+	double dResidentGrowth = (double)m_latest.ulResidentBytes - (double)m_baseline.ulResidentBytes;
+	if(dResidentGrowth > m_dBudgetBytes)
+	{
+		Logger::Write(LogLevel_Error, "Error: resident set grew %.2f MB in %.2f simulated hours, over the %.1f MB budget\n", dResidentGrowth / k_dBytesPerMb, dHours, m_dBudgetBytes / k_dBytesPerMb);
+		bPass = false;
+	}
+
+	for(uint32_t i = 0; i < GLObject_Count; i++)
+	{
+		if(m_latest.runGLObjects[i] > m_baseline.runGLObjects[i])
+		{
+			Logger::Write(LogLevel_Error, "Error: GL %s count grew from %u to %u\n", GLObjectName((EGLObject)i), m_baseline.runGLObjects[i], m_latest.runGLObjects[i]);
+			bPass = false;
+		}
+	}
+
+	if(bPass) Logger::Write(LogLevel_Info, "Soak passed, %.2f simulated hours past the baseline\n", dHours);
+	return bPass;
+}
+
+//-----------------------------------------------------------------------------
+const char* MemoryMonitor::GLObjectName(EGLObject eObject)
+{
+	switch(eObject)
+	{
+	case GLObject_Buffer:		return "buffer";
+	case GLObject_Texture:		return "texture";
+	case GLObject_VertexArray:	return "vertex array";
+	case GLObject_Framebuffer:	return "framebuffer";
+	case GLObject_Renderbuffer:	return "renderbuffer";
+	case GLObject_Shader:		return "shader";
+	case GLObject_Program:		return "program";
+	default:					return "unknown";
+	}
+}
+
+//-----------------------------------------------------------------------------
+void MemoryMonitor::TakeSample(Sample &sample)
+{
+	AllocationTracker::GetTotals(sample.heap);
+	sample.ulResidentBytes = (uint64_t)GetResidentMemoryBytes();
+	CountGLObjects(sample.runGLObjects);
+	if(!m_vecSites.empty()) AllocationTracker::GetSites(m_vecSites.data());
+}
+
+//-----------------------------------------------------------------------------
+// The names GL hands out are small and mostly reused, so scanning up to
+// twice the highest live name finds everything and stays a few thousand
+// calls for each kind.
+//-----------------------------------------------------------------------------
+void MemoryMonitor::CountGLObjects(uint32_t* pCounts)
+{
+	for(uint32_t i = 0; i < GLObject_Count; i++)
+	{
+		EGLObject eObject = (EGLObject)i;
+		GLuint unHighest = 0;
+		pCounts[i] = 0;
+		for(GLuint unName = 1; unName <= m_runScanLimit[i]; unName++)
+		{
+			if(!BIsObject(eObject, unName)) continue;
+			pCounts[i]++;
+			unHighest = unName;
+		}
+		m_runScanLimit[i] = std::max(k_unMinScanLimit, unHighest * 2);
+	}
+}
+
+//-----------------------------------------------------------------------------
+void MemoryMonitor::LogSample(const char* pchLabel, const Sample &sample)
+{
+	const uint32_t* pGL = sample.runGLObjects;
+	if(AllocationTracker::BIsEnabled())
+	{
+		Logger::Write(LogLevel_Info, "%s at %.2f h: heap %.1f MB in %lld blocks, resident %.1f MB, gl buf %u tex %u vao %u fbo %u rbo %u shader %u prog %u\n",
+			pchLabel, sample.dSimTime / 3600.0, (double)sample.heap.nLiveBytes / k_dBytesPerMb, (long long)sample.heap.nLiveBlocks, (double)sample.ulResidentBytes / k_dBytesPerMb,
+			pGL[GLObject_Buffer], pGL[GLObject_Texture], pGL[GLObject_VertexArray], pGL[GLObject_Framebuffer], pGL[GLObject_Renderbuffer], pGL[GLObject_Shader], pGL[GLObject_Program]);
+	}
+	else
+	{
+		Logger::Write(LogLevel_Info, "%s at %.2f h: resident %.1f MB, gl buf %u tex %u vao %u fbo %u rbo %u shader %u prog %u\n",
+			pchLabel, sample.dSimTime / 3600.0, (double)sample.ulResidentBytes / k_dBytesPerMb,
+			pGL[GLObject_Buffer], pGL[GLObject_Texture], pGL[GLObject_VertexArray], pGL[GLObject_Framebuffer], pGL[GLObject_Renderbuffer], pGL[GLObject_Shader], pGL[GLObject_Program]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+void MemoryMonitor::LogTopSites(const std::vector<AllocationTracker::SiteStats> &vecFrom)
+{
+	if(m_vecSites.empty()) return;
+
+	bool bGrowth = !vecFrom.empty();
+	uint32_t runTop[k_unTopSites];
+	int64_t rnTopBytes[k_unTopSites];
+	uint32_t unTopCount = 0;
+
+	for(uint32_t unSlot = 0; unSlot < AllocationTracker::k_unSiteSlots; unSlot++)
+	{
+		int64_t nBytes = m_vecSites[unSlot].nLiveBytes - (bGrowth ? vecFrom[unSlot].nLiveBytes : 0);
+		if(nBytes <= 0) continue;
+		if(unTopCount == k_unTopSites && nBytes <= rnTopBytes[k_unTopSites - 1]) continue;
+
+		// insertion into the short sorted list
+		uint32_t unAt = std::min(unTopCount, k_unTopSites - 1);
+		while(unAt > 0 && rnTopBytes[unAt - 1] < nBytes)
+		{
+			runTop[unAt] = runTop[unAt - 1];
+			rnTopBytes[unAt] = rnTopBytes[unAt - 1];
+			unAt--;
+		}
+		runTop[unAt] = unSlot;
+		rnTopBytes[unAt] = nBytes;
+		if(unTopCount < k_unTopSites) unTopCount++;
+	}
+
+	char rchSite[256];
+	for(uint32_t i = 0; i < unTopCount; i++)
+	{
+		const AllocationTracker::SiteStats &site = m_vecSites[runTop[i]];
+		int64_t nBlocks = site.nLiveBlocks - (bGrowth ? vecFrom[runTop[i]].nLiveBlocks : 0);
+		AllocationTracker::DescribeSite(site.ulSite, rchSite, sizeof(rchSite));
+		Logger::Write(LogLevel_Info, "  %s%.1f KB %s%lld blocks %s\n", bGrowth ? "+" : "", (double)rnTopBytes[i] / 1024.0, bGrowth && nBlocks >= 0 ? "+" : "", (long long)nBlocks, rchSite);
+	}
+}
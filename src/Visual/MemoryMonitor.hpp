@@ -0,0 +1,93 @@
+#ifndef MEMORYMONITOR_HPP
+#define MEMORYMONITOR_HPP
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+
+//-----------------------------------------------------------------------------
+// Watches what the process holds over a long run: live heap by call site
+// when built with AVR_TRACK_ALLOCATIONS, the resident set, and how many GL
+// buffers, textures, vertex arrays, framebuffers, renderbuffers, shaders
+// and programs exist. Every report interval of simulated time it logs one
+// compact line and the sites holding the most.
+//
+// GL objects are counted by asking glIs* about every name up to a little
+// past the highest one seen, so the count covers objects made through any
+// entry point, the GL 1.1 texture calls included. A name that was generated
+// but never bound isn't an object yet and isn't counted.
+//
+// In a soak, a baseline is taken once start up has settled and at the end
+// BReportSoak() compares against it. Everything runs on the render thread
+// with the context current.
+//-----------------------------------------------------------------------------
+class MemoryMonitor {
+
+public:
+
+	enum EGLObject
+	{
+		GLObject_Buffer = 0,
+		GLObject_Texture,
+		GLObject_VertexArray,
+		GLObject_Framebuffer,
+		GLObject_Renderbuffer,
+		GLObject_Shader,
+		GLObject_Program,
+		GLObject_Count
+	};
+
+	MemoryMonitor();
+
+	// dReportSeconds 0 logs nothing periodically, dSoakHours 0 is no soak
+	void Init(double dReportSeconds, double dSoakHours, double dBudgetMb);
+
+	// after the swap, with the simulated time
+	void Update(double dSimTime);
+
+	bool BIsSoaking() const { return m_dSoakSeconds > 0.0; }
+	bool BSoakDone(double dSimTime) const { return BIsSoaking() && dSimTime >= m_dSoakSeconds; }
+	// logs the growth since the baseline, false if anything grew past the
+	// budget or no baseline was taken
+	bool BReportSoak();
+
+	static const char* GLObjectName(EGLObject eObject);
+
+private:
+
+	struct Sample
+	{
+		double dSimTime = 0.0;
+		AllocationTracker::SiteStats heap;
+		uint64_t ulResidentBytes = 0;
+		uint32_t runGLObjects[GLObject_Count] = {};
+	};
+
+	void TakeSample(Sample &sample);
+	void CountGLObjects(uint32_t* pCounts);
+	void LogSample(const char* pchLabel, const Sample &sample);
+	// the sites that grew most since vecFrom, or that hold most if it is empty
+	void LogTopSites(const std::vector<AllocationTracker::SiteStats> &vecFrom);
+
+	double m_dReportSeconds;
+	double m_dSoakSeconds;
+	double m_dWarmupSeconds;
+	double m_dBudgetBytes;
+	double m_dNextReport;
+
+	bool m_bHasBaseline;
+	Sample m_baseline;
+	Sample m_latest;
+
+	// one per site slot, sized once so sampling allocates nothing
+	std::vector<AllocationTracker::SiteStats> m_vecBaselineSites;
+	std::vector<AllocationTracker::SiteStats> m_vecSites;
+
+	// how far the next census looks for each kind of object
+	GLuint m_runScanLimit[GLObject_Count];
+};
+
+#endif
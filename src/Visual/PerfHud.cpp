@@ -0,0 +1,435 @@
+#include "PerfHud.hpp"
+#include "SystemInfo.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// 5x7 glyphs, one byte per row with the leftmost pixel in bit 4
+	const char* k_pchGlyphChars = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:%/-";
+	const uint8_t k_rGlyphRows[][7] = {
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// ' '
+		{ 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e },	// '0'
+		{ 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e },	// '1'
+		{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f },	// '2'
+		{ 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e },	// '3'
+		{ 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 },	// '4'
+		{ 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e },	// '5'
+		{ 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e },	// '6'
+		{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	// '7'
+		{ 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e },	// '8'
+		{ 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c },	// '9'
+		{ 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },	// 'A'
+		{ 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e },	// 'B'
+		{ 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e },	// 'C'
+		{ 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c },	// 'D'
+		{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f },	// 'E'
+		{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 },	// 'F'
+		{ 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f },	// 'G'
+		{ 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },	// 'H'
+		{ 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e },	// 'I'
+		{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c },	// 'J'
+		{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },	// 'K'
+		{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f },	// 'L'
+		{ 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 },	// 'M'
+		{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },	// 'N'
+		{ 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },	// 'O'
+		{ 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 },	// 'P'
+		{ 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d },	// 'Q'
+		{ 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 },	// 'R'
+		{ 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e },	// 'S'
+		{ 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// 'T'
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },	// 'U'
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 },	// 'V'
+		{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a },	// 'W'
+		{ 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 },	// 'X'
+		{ 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04, 0x04 },	// 'Y'
+		{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f },	// 'Z'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c },	// '.'
+		{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 },	// ':'
+		{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },	// '%'
+		{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },	// '/'
+		{ 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 },	// '-'
+	};
+
+	// every glyph sits in an 8x8 cell of the atlas, the last cell is solid
+	const uint32_t k_unCellSize = 8;
+	const uint32_t k_unGlyphWidth = 5;
+	const uint32_t k_unGlyphHeight = 7;
+
+	// canvas layout, in overlay pixels
+	const float k_fTextScale = 2.0f;
+	const float k_fLineHeight = 18.0f;
+	const float k_fPadding = 8.0f;
+	const float k_fGraphHeight = 64.0f;
+	const float k_fBarWidth = 2.0f;
+	const float k_fPanelWidth = 2.0f * k_fPadding + k_fBarWidth * PerfHud::k_unHistoryFrames + 80.0f;
+
+	// recomputing the percentiles every frame would be wasted work
+	const uint32_t k_unPercentileInterval = 30;
+	const uint32_t k_unMemoryInterval = 45;
+
+	const float k_rfBackground[4] = { 0.0f, 0.0f, 0.0f, 0.6f };
+	const float k_rfText[4] = { 0.9f, 0.9f, 0.9f, 1.0f };
+	const float k_rfWarning[4] = { 1.0f, 0.35f, 0.25f, 1.0f };
+	const float k_rfBarGood[4] = { 0.3f, 0.85f, 0.35f, 0.9f };
+	const float k_rfBarOver[4] = { 1.0f, 0.3f, 0.2f, 0.9f };
+	const float k_rfBudgetLine[4] = { 1.0f, 1.0f, 0.4f, 0.8f };
+
+	const uint32_t k_unFloatsPerVertex = 8;
+}
+
+PerfHud::PerfHud() :
+	m_bVisible(false),
+	m_unProgram(0),
+	m_nTransformLocation(-1),
+	m_nGlyphsLocation(-1),
+	m_unVAO(0),
+	m_pStream(nullptr),
+	m_unGlyphTexture(0),
+	m_unAtlasCells(0),
+	m_ulUploadedFrame(~0ull),
+	m_nFirstVertex(0),
+	m_unFrameHead(0),
+	m_unFramesRecorded(0),
+	m_fFrameP50(0.0f),
+	m_fFrameP99(0.0f),
+	m_unQueryFrame(0),
+	m_bHaveCompositorBase(false),
+	m_unDroppedBase(0),
+	m_unReprojectedBase(0),
+	m_dResidentMb(0.0),
+	m_ulFrames(0)
+{
+	std::memset(m_rfFrameMs, 0, sizeof(m_rfFrameMs));
+	std::memset(m_rQueries, 0, sizeof(m_rQueries));
+	std::memset(m_rbQueryPending, 0, sizeof(m_rbQueryPending));
+	std::memset(m_rbPassOpen, 0, sizeof(m_rbPassOpen));
+	std::memset(m_rfGpuMs, 0, sizeof(m_rfGpuMs));
+	std::memset(m_rfGpuLastMs, 0, sizeof(m_rfGpuLastMs));
+	std::memset(m_rulGpuSamples, 0, sizeof(m_rulGpuSamples));
+	std::memset(m_rGlyphIndex, 0, sizeof(m_rGlyphIndex));
+}
+
+//-----------------------------------------------------------------------------
+// Builds the glyph atlas, the vertex buffer and the timer queries. Needs the
+// GL context and the program compiled by Graphics.
+//-----------------------------------------------------------------------------
+bool PerfHud::BInit(GLuint unProgram, StreamingBuffer* pStream)
+{
+	if(unProgram == 0 || !pStream) return false;
+	m_unProgram = unProgram;
+	m_pStream = pStream;
+	m_nTransformLocation = glGetUniformLocation(m_unProgram, "transform");
+	m_nGlyphsLocation = glGetUniformLocation(m_unProgram, "glyphs");
+	if(m_nTransformLocation == -1 || m_nGlyphsLocation == -1){
+		std::cout << "Error: PerfHud shader uniforms not found" << std::endl;
+		return false;
+	}
+
+	uint32_t unGlyphs = (uint32_t)std::strlen(k_pchGlyphChars);
+	for(uint32_t i = 0; i < unGlyphs; i++) m_rGlyphIndex[(uint8_t)k_pchGlyphChars[i]] = (uint8_t)i;
+	m_unAtlasCells = unGlyphs + 1;
+
+	uint32_t unAtlasWidth = m_unAtlasCells * k_unCellSize;
+	std::vector<uint8_t> vecAtlas(unAtlasWidth * k_unCellSize, 0);
+	for(uint32_t g = 0; g < unGlyphs; g++){
+		for(uint32_t y = 0; y < k_unGlyphHeight; y++){
+			for(uint32_t x = 0; x < k_unGlyphWidth; x++){
+				if(k_rGlyphRows[g][y] & (1 << (k_unGlyphWidth - 1 - x))) vecAtlas[y * unAtlasWidth + g * k_unCellSize + x] = 255;
+			}
+		}
+	}
+	for(uint32_t y = 0; y < k_unCellSize; y++){
+		for(uint32_t x = 0; x < k_unCellSize; x++) vecAtlas[y * unAtlasWidth + unGlyphs * k_unCellSize + x] = 255;
+	}
+
+	glGenTextures(1, &m_unGlyphTexture);
+	glBindTexture(GL_TEXTURE_2D, m_unGlyphTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, unAtlasWidth, k_unCellSize, 0, GL_RED, GL_UNSIGNED_BYTE, vecAtlas.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenVertexArrays(1, &m_unVAO);
+	glBindVertexArray(m_unVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, pStream->GetBuffer());
+
+	GLsizei nStride = k_unFloatsPerVertex * sizeof(float);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, nStride, (const void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, nStride, (const void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, nStride, (const void*)(4 * sizeof(float)));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenQueries(k_unQueryFrames * GpuPass_Count, &m_rQueries[0][0]);
+
+	// graph bars plus a few hundred characters of text
+	m_vecVerts.reserve((k_unHistoryFrames + 512) * 6 * k_unFloatsPerVertex);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void PerfHud::CleanUp()
+{
+	if(m_rQueries[0][0]) glDeleteQueries(k_unQueryFrames * GpuPass_Count, &m_rQueries[0][0]);
+	if(m_unVAO) glDeleteVertexArrays(1, &m_unVAO);
+	if(m_unGlyphTexture) glDeleteTextures(1, &m_unGlyphTexture);
+	std::memset(m_rQueries, 0, sizeof(m_rQueries));
+	m_pStream = nullptr;
+	m_unVAO = 0;
+	m_unGlyphTexture = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Top of the frame. Records the frame time and picks up whichever GPU
+// timings of earlier frames have arrived.
+//-----------------------------------------------------------------------------
+void PerfHud::BeginFrame(double dFrameDeltaSeconds)
+{
+	m_ulFrames++;
+	if(m_ulFrames > 1){
+		m_rfFrameMs[m_unFrameHead] = (float)(dFrameDeltaSeconds * 1000.0);
+		m_unFrameHead = (m_unFrameHead + 1) % k_unHistoryFrames;
+		if(m_unFramesRecorded < k_unHistoryFrames) m_unFramesRecorded++;
+	}
+
+	if(m_unVAO == 0) return;
+	m_unQueryFrame = (m_unQueryFrame + 1) % k_unQueryFrames;
+	CollectGpuTimers();
+}
+
+//-----------------------------------------------------------------------------
+// Reads every finished query. A query still pending in the slot this frame
+// is about to use means the GPU is more than two frames behind; that pass
+// then goes untimed this frame rather than waiting for it.
+//-----------------------------------------------------------------------------
+void PerfHud::CollectGpuTimers()
+{
+	for(uint32_t f = 0; f < k_unQueryFrames; f++){
+		for(uint32_t p = 0; p < GpuPass_Count; p++){
+			if(!m_rbQueryPending[f][p]) continue;
+
+			GLint nAvailable = 0;
+			glGetQueryObjectiv(m_rQueries[f][p], GL_QUERY_RESULT_AVAILABLE, &nAvailable);
+			if(!nAvailable) continue;
+
+			GLuint64 ulElapsedNs = 0;
+			glGetQueryObjectui64v(m_rQueries[f][p], GL_QUERY_RESULT, &ulElapsedNs);
+			m_rbQueryPending[f][p] = false;
+
+			float fMs = (float)((double)ulElapsedNs * 1.0e-6);
+			m_rfGpuMs[p] = m_rfGpuMs[p] == 0.0f ? fMs : m_rfGpuMs[p] * 0.9f + fMs * 0.1f;
+			m_rfGpuLastMs[p] = fMs;
+			m_rulGpuSamples[p]++;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Passes must not nest, GL allows one time elapsed query at a time.
+//-----------------------------------------------------------------------------
+void PerfHud::BeginGpuPass(EGpuPass ePass)
+{
+	if(m_unVAO == 0 || m_rbQueryPending[m_unQueryFrame][ePass]) return;
+	glBeginQuery(GL_TIME_ELAPSED, m_rQueries[m_unQueryFrame][ePass]);
+	m_rbPassOpen[ePass] = true;
+}
+
+//-----------------------------------------------------------------------------
+void PerfHud::EndGpuPass(EGpuPass ePass)
+{
+	if(!m_rbPassOpen[ePass]) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	m_rbPassOpen[ePass] = false;
+	m_rbQueryPending[m_unQueryFrame][ePass] = true;
+}
+
+//-----------------------------------------------------------------------------
+// Rebuilds the batch for this frame. Does nothing while hidden apart from
+// keeping the compositor baseline.
+//-----------------------------------------------------------------------------
+void PerfHud::Update(const FrameStats &stats)
+{
+	if(stats.bCompositor && !m_bHaveCompositorBase){
+		m_unDroppedBase = stats.unDroppedFrames;
+		m_unReprojectedBase = stats.unReprojectedFrames;
+		m_bHaveCompositorBase = true;
+	}
+
+	if(!m_bVisible || m_unVAO == 0) return;
+
+	if(m_ulFrames % k_unPercentileInterval == 0 && m_unFramesRecorded > 0){
+		float rfSorted[k_unHistoryFrames];
+		std::memcpy(rfSorted, m_rfFrameMs, m_unFramesRecorded * sizeof(float));
+		uint32_t unP50 = m_unFramesRecorded / 2;
+		uint32_t unP99 = (uint32_t)((m_unFramesRecorded - 1) * 0.99f);
+		std::nth_element(rfSorted, rfSorted + unP50, rfSorted + m_unFramesRecorded);
+		m_fFrameP50 = rfSorted[unP50];
+		std::nth_element(rfSorted, rfSorted + unP99, rfSorted + m_unFramesRecorded);
+		m_fFrameP99 = rfSorted[unP99];
+	}
+	if(m_ulFrames % k_unMemoryInterval == 1){
+		m_dResidentMb = (double)GetResidentMemoryBytes() / (1024.0 * 1024.0);
+	}
+
+	m_vecVerts.clear();
+	m_ulUploadedFrame = ~0ull;
+
+	float fPanelHeight = 2.0f * k_fPadding + k_fLineHeight * 5.0f + k_fGraphHeight + 4.0f;
+	AddSolid(0.0f, 0.0f, k_fPanelWidth, fPanelHeight, k_rfBackground);
+
+	char rchLine[160];
+	float fY = k_fPadding;
+	float fLastMs = m_rfFrameMs[(m_unFrameHead + k_unHistoryFrames - 1) % k_unHistoryFrames];
+	std::snprintf(rchLine, sizeof(rchLine), "FRAME %5.2f MS  P50 %5.2f  P99 %5.2f  BUDGET %5.2f", fLastMs, m_fFrameP50, m_fFrameP99, stats.fBudgetMs);
+	AddText(k_fPadding, fY, rchLine, m_fFrameP99 > stats.fBudgetMs ? k_rfWarning : k_rfText);
+	fY += k_fLineHeight;
+
+	// oldest frame on the left, the graph tops out at twice the budget
+	float fGraphBottom = fY + k_fGraphHeight;
+	float fGraphMaxMs = stats.fBudgetMs > 0.0f ? stats.fBudgetMs * 2.0f : 33.3f;
+	for(uint32_t i = 0; i < m_unFramesRecorded; i++){
+		uint32_t unIndex = (m_unFrameHead + k_unHistoryFrames - m_unFramesRecorded + i) % k_unHistoryFrames;
+		float fMs = m_rfFrameMs[unIndex];
+		float fHeight = std::min(fMs / fGraphMaxMs, 1.0f) * k_fGraphHeight;
+		float fX = k_fPadding + (float)(k_unHistoryFrames - m_unFramesRecorded + i) * k_fBarWidth;
+		AddSolid(fX, fGraphBottom - fHeight, fX + k_fBarWidth, fGraphBottom, fMs > stats.fBudgetMs ? k_rfBarOver : k_rfBarGood);
+	}
+	float fBudgetY = fGraphBottom - k_fGraphHeight * 0.5f;
+	AddSolid(k_fPadding, fBudgetY, k_fPadding + k_fBarWidth * k_unHistoryFrames, fBudgetY + 1.0f, k_rfBudgetLine);
+	fY = fGraphBottom + 4.0f;
+
+	if(stats.bCompositor){
+		uint32_t unDropped = stats.unDroppedFrames - m_unDroppedBase;
+		uint32_t unReprojected = stats.unReprojectedFrames - m_unReprojectedBase;
+		std::snprintf(rchLine, sizeof(rchLine), "DROPPED %u  REPROJECTED %u  RES %3.0f%%", unDropped, unReprojected, stats.fResolutionScale * 100.0f);
+		AddText(k_fPadding, fY, rchLine, unDropped > 0 ? k_rfWarning : k_rfText);
+	}else{
+		std::snprintf(rchLine, sizeof(rchLine), "NO COMPOSITOR  RES %3.0f%%", stats.fResolutionScale * 100.0f);
+		AddText(k_fPadding, fY, rchLine, k_rfText);
+	}
+	fY += k_fLineHeight;
+
+	std::snprintf(rchLine, sizeof(rchLine), "GPU EYES %5.2f  COMPANION %5.2f  HUD %5.2f MS",
+		m_rfGpuMs[GpuPass_Eyes], m_rfGpuMs[GpuPass_Companion], m_rfGpuMs[GpuPass_Hud]);
+	AddText(k_fPadding, fY, rchLine, k_rfText);
+	fY += k_fLineHeight;
+
+	if(stats.bAudio){
+		std::snprintf(rchLine, sizeof(rchLine), "AUDIO LOAD %3.0f%%  P99 %3.0f%%  OVERRUNS %llu",
+			stats.dAudioLoad * 100.0, stats.dAudioLoadP99 * 100.0, (unsigned long long)stats.ulAudioOverruns);
+		AddText(k_fPadding, fY, rchLine, stats.dAudioLoadP99 > 0.8 || stats.ulAudioOverruns > 0 ? k_rfWarning : k_rfText);
+	}else{
+		AddText(k_fPadding, fY, "AUDIO -", k_rfText);
+	}
+	fY += k_fLineHeight;
+
+	std::snprintf(rchLine, sizeof(rchLine), "RSS %.1f MB  PACING WAIT %5.2f MS  %u AHEAD", m_dResidentMb, stats.fPacingWaitMs, stats.unFramesInFlight);
+	AddText(k_fPadding, fY, rchLine, k_rfText);
+}
+
+//-----------------------------------------------------------------------------
+// One draw of the whole batch into whatever framebuffer is bound. The batch
+// is copied into the streaming buffer on the first draw of the frame only.
+//-----------------------------------------------------------------------------
+void PerfHud::Draw(int nTargetWidth, int nTargetHeight, float fOriginX, float fOriginY, float fPixelScale)
+{
+	if(!m_bVisible || m_unVAO == 0 || m_vecVerts.empty()) return;
+
+	if(m_ulUploadedFrame != m_pStream->GetFrame()){
+		GLsizeiptr nStride = k_unFloatsPerVertex * sizeof(float);
+		StreamingBuffer::Allocation allocation;
+		if(!m_pStream->BAllocate((GLsizeiptr)(m_vecVerts.size() * sizeof(float)), nStride, allocation)) return;
+		std::memcpy(allocation.pData, m_vecVerts.data(), allocation.nSize);
+		m_pStream->Commit(allocation);
+		m_nFirstVertex = (GLint)(allocation.nOffset / nStride);
+		m_ulUploadedFrame = m_pStream->GetFrame();
+	}
+
+	// canvas pixels, y down, to clip space of the target
+	float fScaleX = 2.0f * fPixelScale / (float)nTargetWidth;
+	float fScaleY = -2.0f * fPixelScale / (float)nTargetHeight;
+	float fOffsetX = 2.0f * fOriginX / (float)nTargetWidth - 1.0f;
+	float fOffsetY = 1.0f - 2.0f * fOriginY / (float)nTargetHeight;
+
+	GLboolean bDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean bBlend = glIsEnabled(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glUseProgram(m_unProgram);
+	glUniform4f(m_nTransformLocation, fScaleX, fScaleY, fOffsetX, fOffsetY);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_unGlyphTexture);
+	glUniform1i(m_nGlyphsLocation, 0);
+
+	glBindVertexArray(m_unVAO);
+	glDrawArrays(GL_TRIANGLES, m_nFirstVertex, (GLsizei)(m_vecVerts.size() / k_unFloatsPerVertex));
+	glBindVertexArray(0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if(bDepthTest) glEnable(GL_DEPTH_TEST);
+	if(!bBlend) glDisable(GL_BLEND);
+}
+
+//-----------------------------------------------------------------------------
+void PerfHud::AddQuad(float fX0, float fY0, float fX1, float fY1, float fU0, float fV0, float fU1, float fV1, const float *pColor)
+{
+	const float rfCorners[6][4] = {
+		{ fX0, fY0, fU0, fV0 }, { fX1, fY0, fU1, fV0 }, { fX1, fY1, fU1, fV1 },
+		{ fX0, fY0, fU0, fV0 }, { fX1, fY1, fU1, fV1 }, { fX0, fY1, fU0, fV1 }
+	};
+	for(int i = 0; i < 6; i++){
+		m_vecVerts.insert(m_vecVerts.end(), rfCorners[i], rfCorners[i] + 4);
+		m_vecVerts.insert(m_vecVerts.end(), pColor, pColor + 4);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Solid quads sample the middle of the solid atlas cell.
+//-----------------------------------------------------------------------------
+void PerfHud::AddSolid(float fX0, float fY0, float fX1, float fY1, const float *pColor)
+{
+	float fU = ((float)(m_unAtlasCells - 1) + 0.5f) / (float)m_unAtlasCells;
+	AddQuad(fX0, fY0, fX1, fY1, fU, 0.5f, fU, 0.5f, pColor);
+}
+
+//-----------------------------------------------------------------------------
+// Lower case is drawn as upper case, characters without a glyph as spaces.
+// Returns where the next character would go.
+//-----------------------------------------------------------------------------
+float PerfHud::AddText(float fX, float fY, const char *pchText, const float *pColor)
+{
+	float fAtlasWidth = (float)(m_unAtlasCells * k_unCellSize);
+	float fGlyphW = k_unGlyphWidth * k_fTextScale;
+	float fGlyphH = k_unGlyphHeight * k_fTextScale;
+	float fAdvance = (k_unGlyphWidth + 1) * k_fTextScale;
+
+	for(; *pchText; pchText++, fX += fAdvance){
+		uint8_t ch = (uint8_t)std::toupper((unsigned char)*pchText);
+		uint8_t unGlyph = ch < 128 ? m_rGlyphIndex[ch] : 0;
+		if(unGlyph == 0) continue;
+
+		float fU0 = (float)(unGlyph * k_unCellSize) / fAtlasWidth;
+		float fU1 = (float)(unGlyph * k_unCellSize + k_unGlyphWidth) / fAtlasWidth;
+		float fV1 = (float)k_unGlyphHeight / (float)k_unCellSize;
+		AddQuad(fX, fY, fX + fGlyphW, fY + fGlyphH, fU0, 0.0f, fU1, fV1, pColor);
+	}
+	return fX;
+}
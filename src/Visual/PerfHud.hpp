@@ -0,0 +1,125 @@
+#ifndef PERFHUD_HPP
+#define PERFHUD_HPP
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "StreamingBuffer.hpp"
+
+//-----------------------------------------------------------------------------
+// Performance overlay for the companion window and, optionally, the eye
+// buffers: a frame time graph against the frame budget, frame time p50/p99,
+// dropped and reprojected frames from the compositor, GPU pass timings,
+// audio block load and resident memory.
+//
+// Text is a built in 5x7 bitmap font in a one channel atlas. Update()
+// builds the whole overlay into one vertex batch, the first Draw() of a
+// frame copies it into the streaming buffer and every Draw() renders it
+// with a single draw call, so drawing it again per eye costs one call.
+//
+// GPU passes are timed with GL_TIME_ELAPSED queries, one set per frame
+// over three frames, and read back only once they are available, so
+// timing never stalls the pipeline.
+//-----------------------------------------------------------------------------
+class PerfHud {
+
+public:
+
+	enum EGpuPass
+	{
+		GpuPass_Eyes = 0,
+		GpuPass_Companion,
+		GpuPass_Hud,
+		GpuPass_Count
+	};
+
+	// what the rest of the frame knows, gathered by Graphics
+	struct FrameStats
+	{
+		float fBudgetMs = 0.0f;
+		float fPacingWaitMs = 0.0f;
+		uint32_t unFramesInFlight = 0;
+		float fResolutionScale = 1.0f;	// of the recommended eye size
+		bool bCompositor = false;
+		uint32_t unDroppedFrames = 0;
+		uint32_t unReprojectedFrames = 0;
+		bool bAudio = false;
+		double dAudioLoad = 0.0;	// fraction of the block period
+		double dAudioLoadP99 = 0.0;
+		uint64_t ulAudioOverruns = 0;
+	};
+
+	static const uint32_t k_unHistoryFrames = 240;
+	static const uint32_t k_unQueryFrames = 3;
+
+	PerfHud();
+
+	bool BInit(GLuint unProgram, StreamingBuffer* pStream);
+	void CleanUp();
+
+	void SetVisible(bool bVisible) { m_bVisible = bVisible; }
+	bool BIsVisible() const { return m_bVisible; }
+
+	void BeginFrame(double dFrameDeltaSeconds);
+	void BeginGpuPass(EGpuPass ePass);
+	void EndGpuPass(EGpuPass ePass);
+	void Update(const FrameStats &stats);
+
+	// the latest raw timing of a pass and how many have come back so far,
+	// for whatever else adapts to the GPU load
+	float GetLastGpuMs(EGpuPass ePass) const { return m_rfGpuLastMs[ePass]; }
+	uint64_t GetGpuSampleCount(EGpuPass ePass) const { return m_rulGpuSamples[ePass]; }
+
+	// fOriginX/Y and fPixelScale place the overlay in target pixels
+	void Draw(int nTargetWidth, int nTargetHeight, float fOriginX, float fOriginY, float fPixelScale);
+
+private:
+
+	void CollectGpuTimers();
+	void AddQuad(float fX0, float fY0, float fX1, float fY1, float fU0, float fV0, float fU1, float fV1, const float *pColor);
+	void AddSolid(float fX0, float fY0, float fX1, float fY1, const float *pColor);
+	float AddText(float fX, float fY, const char *pchText, const float *pColor);
+
+	bool m_bVisible;
+
+	GLuint m_unProgram;
+	GLint m_nTransformLocation;
+	GLint m_nGlyphsLocation;
+	GLuint m_unVAO;
+	StreamingBuffer* m_pStream;
+	GLuint m_unGlyphTexture;
+	uint32_t m_unAtlasCells;
+	uint8_t m_rGlyphIndex[128];
+
+	// x, y, u, v, r, g, b, a per vertex, canvas pixels with y down
+	std::vector<float> m_vecVerts;
+	uint64_t m_ulUploadedFrame;		// streaming buffer frame the batch went up in
+	GLint m_nFirstVertex;
+
+	// frame times, ms
+	float m_rfFrameMs[k_unHistoryFrames];
+	uint32_t m_unFrameHead;
+	uint32_t m_unFramesRecorded;
+	float m_fFrameP50;
+	float m_fFrameP99;
+
+	GLuint m_rQueries[k_unQueryFrames][GpuPass_Count];
+	bool m_rbQueryPending[k_unQueryFrames][GpuPass_Count];
+	bool m_rbPassOpen[GpuPass_Count];
+	uint32_t m_unQueryFrame;
+	float m_rfGpuMs[GpuPass_Count];
+	float m_rfGpuLastMs[GpuPass_Count];
+	uint64_t m_rulGpuSamples[GpuPass_Count];
+
+	// compositor counters are cumulative for the process, shown from HUD start
+	bool m_bHaveCompositorBase;
+	uint32_t m_unDroppedBase;
+	uint32_t m_unReprojectedBase;
+
+	double m_dResidentMb;
+	uint64_t m_ulFrames;
+};
+
+#endif
@@ -1,7 +1,7 @@
 #include <cstdio>
 #include <cstdlib>
 
-#ifdef __APPLE__
+#if defined(__APPLE__) || defined(__linux__)
 #include <GL/glew.h>
 #elif _WIN32
 #include "GL/glew.h"
@@ -13,8 +13,9 @@
 #include <iostream>
 #include <fstream>
 
+//read shaders from file, the caller frees string with free()
 bool load_shader(const char* filename, const char* &string){
-	//read shaders from file
+	string = nullptr;
 	FILE* f = fopen(filename, "r");
 
 	if(!f){
@@ -27,11 +28,16 @@ bool load_shader(const char* filename, const char* &string){
 	size_t size = ftell(f);
 
 	//calloc() initialises memory to zero
-	string = (const char*)calloc(sizeof(char), size + 1);
+	char* source = (char*)calloc(sizeof(char), size + 1);
+	if(!source){
+		fclose(f);
+		return false;
+	}
 
 	rewind(f);
-	fread((void*)string, sizeof(char), size, f);
-	printf("%s\n", string);
+	fread(source, sizeof(char), size, f);
+	fclose(f);
+	string = source;
 	return true;
 }
 
@@ -0,0 +1,153 @@
+#include "StreamingBuffer.hpp"
+#include "Profiler.hpp"
+
+#include <iostream>
+
+namespace
+{
+	// how long one glClientWaitSync blocks before it is asked again
+	const GLuint64 k_ulFenceTimeoutNs = 100000000;
+}
+
+//-----------------------------------------------------------------------------
+StreamingBuffer::StreamingBuffer() :
+	m_glBuffer(0),
+	m_nRegionBytes(0),
+	m_unRegionCount(0),
+	m_pMapped(nullptr),
+	m_unRegion(0),
+	m_nCursor(0),
+	m_ulFrame(0),
+	m_unStalls(0)
+{
+	for(uint32_t i = 0; i < k_unRegions; i++) m_rFences[i] = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+bool StreamingBuffer::BInit(GLsizeiptr nBytesPerFrame)
+{
+	m_nRegionBytes = nBytesPerFrame;
+
+	glGenBuffers(1, &m_glBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
+
+	if(GLEW_ARB_buffer_storage){
+		GLsizeiptr nBytes = m_nRegionBytes * k_unRegions;
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, nBytes, nullptr, flags);
+		m_pMapped = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, nBytes, flags);
+		if(m_pMapped) m_unRegionCount = k_unRegions;
+	}
+
+	if(!m_pMapped){
+		// no persistent mapping, one region orphaned every frame
+		if(GLEW_ARB_buffer_storage){
+			glDeleteBuffers(1, &m_glBuffer);
+			glGenBuffers(1, &m_glBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
+		}
+		glBufferData(GL_ARRAY_BUFFER, m_nRegionBytes, nullptr, GL_STREAM_DRAW);
+		m_vecCpuRegion.assign((size_t)m_nRegionBytes, 0);
+		m_unRegionCount = 1;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// BeginFrame() moves to the first region
+	m_unRegion = m_unRegionCount - 1;
+	m_nCursor = m_nRegionBytes;
+
+	std::cout << "StreamingBuffer: " << m_nRegionBytes / 1024 << " KB a frame, " << (m_pMapped ? "persistent mapping" : "orphaned per frame") << std::endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void StreamingBuffer::CleanUp()
+{
+	for(uint32_t i = 0; i < k_unRegions; i++){
+		if(m_rFences[i]) glDeleteSync(m_rFences[i]);
+		m_rFences[i] = nullptr;
+	}
+	if(m_pMapped){
+		glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		m_pMapped = nullptr;
+	}
+	if(m_glBuffer) glDeleteBuffers(1, &m_glBuffer);
+	m_glBuffer = 0;
+	m_vecCpuRegion.clear();
+	m_vecCpuRegion.shrink_to_fit();
+}
+
+//-----------------------------------------------------------------------------
+// Top of the frame, after the frame pacer's wait.
+//-----------------------------------------------------------------------------
+void StreamingBuffer::BeginFrame()
+{
+	if(m_glBuffer == 0) return;
+
+	m_ulFrame++;
+	m_unRegion = (m_unRegion + 1) % m_unRegionCount;
+	m_nCursor = 0;
+
+	if(!m_pMapped){
+		glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
+		glBufferData(GL_ARRAY_BUFFER, m_nRegionBytes, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
+	GLsync fence = m_rFences[m_unRegion];
+	if(!fence) return;
+
+	GLenum eResult = glClientWaitSync(fence, 0, 0);
+	if(eResult == GL_TIMEOUT_EXPIRED){
+		AVR_PROFILE_SCOPE("wait for stream region");
+		m_unStalls++;
+		while(eResult == GL_TIMEOUT_EXPIRED){
+			eResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, k_ulFenceTimeoutNs);
+		}
+	}
+	glDeleteSync(fence);
+	m_rFences[m_unRegion] = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// After the frame's last draw that reads from the buffer.
+//-----------------------------------------------------------------------------
+void StreamingBuffer::EndFrame()
+{
+	if(!m_pMapped) return;
+
+	if(m_rFences[m_unRegion]) glDeleteSync(m_rFences[m_unRegion]);
+	m_rFences[m_unRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+//-----------------------------------------------------------------------------
+bool StreamingBuffer::BAllocate(GLsizeiptr nBytes, GLsizeiptr nAlign, Allocation &allocation)
+{
+	allocation = Allocation();
+	if(m_glBuffer == 0 || nBytes <= 0) return false;
+	if(nAlign <= 0) nAlign = 1;
+
+	// aligned in the whole buffer, so an offset always divides by the stride
+	GLintptr nRegionBase = (GLintptr)m_unRegion * m_nRegionBytes;
+	GLintptr nOffset = nRegionBase + m_nCursor;
+	nOffset = (nOffset + nAlign - 1) / nAlign * nAlign;
+	if(nOffset + nBytes > nRegionBase + m_nRegionBytes) return false;
+
+	m_nCursor = nOffset + nBytes - nRegionBase;
+	allocation.nOffset = nOffset;
+	allocation.nSize = nBytes;
+	allocation.pData = m_pMapped ? m_pMapped + nOffset : m_vecCpuRegion.data() + (nOffset - nRegionBase);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void StreamingBuffer::Commit(const Allocation &allocation)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
+	if(m_pMapped || !allocation.pData) return;
+
+	glBufferSubData(GL_ARRAY_BUFFER, allocation.nOffset, allocation.nSize, allocation.pData);
+}
@@ -0,0 +1,80 @@
+#ifndef STREAMINGBUFFER_HPP
+#define STREAMINGBUFFER_HPP
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "FramePacer.hpp"
+
+//-----------------------------------------------------------------------------
+// One vertex buffer for everything rebuilt each frame: controller lines,
+// debug geometry, per instance data, the HUD. Each frame hands out
+// sub-allocations from its own region of the buffer, so a frame never
+// writes where the GPU may still be reading.
+//
+// With ARB_buffer_storage the buffer is persistently mapped and split into
+// one region per frame that can be in flight, plus the one being built. A
+// fence goes in behind each region at the end of the frame and BeginFrame()
+// waits on it before the region is reused, which with the frame pacer
+// holding the CPU back already has always passed. Allocations are written
+// in place and Commit() does nothing.
+//
+// On a plain 4.1 context there is one region, orphaned at the top of every
+// frame; allocations are written to a CPU copy and Commit() sends each one
+// with glBufferSubData.
+//
+// Vertex arrays point at GetBuffer() from offset 0 and draw from the first
+// vertex an allocation starts at. Nothing grows after BInit(), a frame that
+// asks for more than its region gets nothing.
+//-----------------------------------------------------------------------------
+class StreamingBuffer {
+
+public:
+
+	static const uint32_t k_unRegions = FramePacer::k_unMaxFramesInFlight + 1;
+
+	struct Allocation
+	{
+		void* pData = nullptr;
+		GLintptr nOffset = 0;			// from the start of the buffer
+		GLsizeiptr nSize = 0;
+	};
+
+	StreamingBuffer();
+
+	bool BInit(GLsizeiptr nBytesPerFrame);
+	void CleanUp();
+
+	void BeginFrame();
+	void EndFrame();
+
+	// nAlign need not be a power of two, use the vertex stride so the
+	// offset divides into a first vertex
+	bool BAllocate(GLsizeiptr nBytes, GLsizeiptr nAlign, Allocation &allocation);
+	// once written, leaves GL_ARRAY_BUFFER bound to the buffer
+	void Commit(const Allocation &allocation);
+
+	GLuint GetBuffer() const { return m_glBuffer; }
+	bool BIsPersistent() const { return m_pMapped != nullptr; }
+	// frames begun so far, allocations are good for the frame they were made in
+	uint64_t GetFrame() const { return m_ulFrame; }
+	uint32_t GetStalls() const { return m_unStalls; }
+
+private:
+
+	GLuint m_glBuffer;
+	GLsizeiptr m_nRegionBytes;
+	uint32_t m_unRegionCount;
+	uint8_t* m_pMapped;
+	std::vector<uint8_t> m_vecCpuRegion;
+	GLsync m_rFences[k_unRegions];
+
+	uint32_t m_unRegion;
+	GLsizeiptr m_nCursor;				// within the current region
+	uint64_t m_ulFrame;
+	uint32_t m_unStalls;				// times BeginFrame() found the GPU still reading
+};
+
+#endif
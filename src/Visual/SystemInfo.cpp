@@ -1,17 +1,23 @@
 #include "SystemInfo.hpp"
+#include "Logger.hpp"
 
 #include <cstdio>
 #include <cstdarg>
+#include <cstring>
 #include <string>
 #include <iostream>
 
 #ifdef __APPLE__
 #define vsprintf_s vsnprintf
+#include <mach/mach.h>
 #elif _WIN32
 #include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
 #endif
 
-#ifndef _WIN32
+#if !defined(_WIN32) && !defined(APIENTRY)
 #define APIENTRY
 #endif
 
@@ -34,42 +40,32 @@ void _update_fps_counter(GLFWwindow* window){
 
 //-----------------------------------------------------------------------------
 // Purpose: Outputs a set of optional arguments to debugging output, using
-//          the printf format setting specified in fmt*.
+//          the printf format setting specified in fmt*. Every caller reports
+//          a failure, so it logs as an error.
 //-----------------------------------------------------------------------------
 void dprintf(const char *fmt, ... )
 {
 	va_list args;
-	char buffer[ 2048 ];
-
 	va_start( args, fmt );
-
-#ifdef __APPLE__
-	vsprintf(buffer, fmt, args);
-#elif _WIN32
-	vsprintf_s( buffer, fmt, args );
-#endif
-
+	Logger::WriteV( LogLevel_Error, fmt, args );
 	va_end( args );
-
-	printf( "%s", buffer );
-
-#ifdef __APPLE__
-	std::string charString = buffer;
-	std::cout << "Debug Message from dprintf() (SystemInfo.cpp): " << charString << std::endl; 
-#elif _WIN32
-	OutputDebugStringA( buffer );
-#endif
-
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Outputs the string in message to debugging output.
-//          All other parameters are ignored.
-//          Does not return any meaningful value or reference.
+// Purpose: Outputs the string in message to debugging output at a level
+//          following the GL severity. Drivers can repeat a message every
+//          draw, so it is rate limited.
 //-----------------------------------------------------------------------------
 void APIENTRY DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const char* message, const void* userParam)
 {
-	dprintf( "GL Error: %s\n", message );
+	ELogLevel eLevel = LogLevel_Debug;
+	switch(severity){
+		case GL_DEBUG_SEVERITY_HIGH: eLevel = LogLevel_Error; break;
+		case GL_DEBUG_SEVERITY_MEDIUM: eLevel = LogLevel_Warning; break;
+		case GL_DEBUG_SEVERITY_LOW: eLevel = LogLevel_Info; break;
+		default: break;
+	}
+	AVR_LOG_RATE_LIMITED(20, eLevel, "GL Error: %s\n", message);
 }
 
 float FConvertUint32ToFloat(uint32_t val)
@@ -79,3 +75,29 @@ float FConvertUint32ToFloat(uint32_t val)
 	std::memcpy(&returnVal, &val, sizeof(float));
 	return returnVal;
 }
+
+//-----------------------------------------------------------------------------
+// Purpose: Physical memory the process currently holds, 0 if unknown.
+//-----------------------------------------------------------------------------
+size_t GetResidentMemoryBytes()
+{
+#ifdef __APPLE__
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+	return (size_t)info.resident_size;
+#elif _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return (size_t)counters.WorkingSetSize;
+#else
+	long pages = 0;
+	long resident = 0;
+	FILE* pFile = fopen("/proc/self/statm", "r");
+	if(!pFile) return 0;
+	int nRead = fscanf(pFile, "%ld %ld", &pages, &resident);
+	fclose(pFile);
+	if(nRead != 2) return 0;
+	return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
@@ -1,17 +1,22 @@
 #ifndef SYSTEMINFO_HPP 
 #define SYSTEMINFO_HPP
 
-#ifdef __APPLE__
+#if defined(__APPLE__) || defined(__linux__)
 #include <GLFW/glfw3.h>
 #define vsprintf_s vsnprintf
 #elif _WIN32
 #include "glfw3.h"
 #endif
 
+#include "ThreadPolicy.hpp"
+
+#include <string>
+
 void _update_fps_counter(GLFWwindow* window);
 void dprintf(const char *fmt, ... );
 void APIENTRY DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const char* message, const void* userParam);
 float FConvertUint32ToFloat(uint32_t val);
+size_t GetResidentMemoryBytes();
 
 struct ExecutionFlags
 	{
@@ -20,6 +25,33 @@ struct ExecutionFlags
 		bool flagGLFinishHack;			
 		bool flagDPrint;
 		bool flagDevMode;
+		bool flagLockMemory;
+		int nAudioThreads;
+		float fCrossfadeTime;
+		bool flagLatencyTest;
+		float fSoakHours;
+		float fSoakBudgetMb;
+		float fMemoryReportSeconds;
+		bool flagPipeline;
+		bool flagHud;
+		bool flagHudEyes;
+		bool flagRecordScreen;
+		int nFramesInFlight;
+		bool flagLateStart;
+		bool flagDynamicResolution;
+		float fDynamicResolutionMin;
+		float fDynamicResolutionMax;
+		bool flagLateLatch;
+		bool flagMockVR;
+		std::string strMockVRTrace;
+		float fMockVRFrequency;
+		uint32_t unMockVRWidth;
+		uint32_t unMockVRHeight;
+		float fMockVRIpd;
+		std::string strRecordPoses;
+		ThreadPolicy audioThreadPolicy;
+		ThreadPolicy renderThreadPolicy;
+		ThreadPolicy workerThreadPolicy;
 	};
 
 #endif
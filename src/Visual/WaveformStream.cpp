@@ -0,0 +1,197 @@
+#include "WaveformStream.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+// counts wrap at 2^32, which the ring length has to divide
+static_assert((WaveformStream::k_unRingLength & (WaveformStream::k_unRingLength - 1)) == 0, "the ring length must be a power of two");
+
+WaveformStream::WaveformStream() :
+	m_unSources(0),
+	m_glBuffer(0),
+	m_glTexture(0),
+	m_pMapped(nullptr),
+	m_unBoundProgram(0),
+	m_nWaveformLocation(-1),
+	m_nWaveHeadLocation(-1),
+	m_nWaveLengthLocation(-1),
+	m_unWritten(0),
+	m_unUploaded(0),
+	m_pActiveCsound(nullptr),
+	m_nActiveChannelSet(0)
+{
+	for(int i = 0; i < 2; i++){
+		for(uint32_t j = 0; j < k_unMaxSources; j++) m_rpChannels[i][j] = nullptr;
+	}
+}
+
+WaveformStream::~WaveformStream()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Creates the ring buffer and its texture. Needs a current GL context and
+// has to happen before the Csound session starts.
+//-----------------------------------------------------------------------------
+bool WaveformStream::BInit(uint32_t unSources)
+{
+	if(unSources > k_unMaxSources) unSources = k_unMaxSources;
+	m_unSources = unSources;
+
+	GLsizeiptr nBytes = (GLsizeiptr)(m_unSources * k_unRingLength * sizeof(float));
+
+	glGenBuffers(1, &m_glBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_glBuffer);
+
+	if(GLEW_ARB_buffer_storage){
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_TEXTURE_BUFFER, nBytes, nullptr, flags);
+		m_pMapped = (float*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, nBytes, flags);
+		if(m_pMapped){
+			for(uint32_t i = 0; i < m_unSources * k_unRingLength; i++) m_pMapped[i] = 0.0f;
+		}
+	}
+
+	if(!m_pMapped){
+		// no persistent mapping, fall back to a CPU ring and one upload a frame
+		if(GLEW_ARB_buffer_storage){
+			glDeleteBuffers(1, &m_glBuffer);
+			glGenBuffers(1, &m_glBuffer);
+			glBindBuffer(GL_TEXTURE_BUFFER, m_glBuffer);
+		}
+		m_vecCpuRing.assign(m_unSources * k_unRingLength, 0.0f);
+		glBufferData(GL_TEXTURE_BUFFER, nBytes, m_vecCpuRing.data(), GL_STREAM_DRAW);
+	}
+
+	glGenTextures(1, &m_glTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, m_glTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, m_glBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	std::cout << "WaveformStream: " << m_unSources << " sources, " << (m_pMapped ? "persistent mapping" : "per frame upload") << std::endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// The session has to be stopped first, the performance thread writes into
+// the mapping.
+//-----------------------------------------------------------------------------
+void WaveformStream::CleanUp()
+{
+	if(m_pMapped){
+		glBindBuffer(GL_TEXTURE_BUFFER, m_glBuffer);
+		glUnmapBuffer(GL_TEXTURE_BUFFER);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		m_pMapped = nullptr;
+	}
+	if(m_glTexture) glDeleteTextures(1, &m_glTexture);
+	if(m_glBuffer) glDeleteBuffers(1, &m_glBuffer);
+	m_glTexture = 0;
+	m_glBuffer = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Binds the waveN channels of a newly compiled session and makes it the one
+// that feeds the ring.
+//-----------------------------------------------------------------------------
+void WaveformStream::OnSessionStart(Csound &csound)
+{
+	int nSet = 1 - m_nActiveChannelSet.load(std::memory_order_relaxed);
+	for(uint32_t i = 0; i < m_unSources; i++){
+		std::string strChannel = "wave" + std::to_string(i);
+		if(csound.GetChannelPtr(m_rpChannels[nSet][i], strChannel.c_str(), CSOUND_AUDIO_CHANNEL | CSOUND_OUTPUT_CHANNEL) != 0){
+			std::cout << "Csound audio channel " << strChannel << " not available" << std::endl;
+			m_rpChannels[nSet][i] = nullptr;
+		}
+	}
+	m_nActiveChannelSet.store(nSet, std::memory_order_release);
+	m_pActiveCsound.store(&csound, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Runs before each block, so the channels hold the block that just
+// finished. Copies ksmps samples per source into the ring.
+//-----------------------------------------------------------------------------
+void WaveformStream::OnAudioBlock(Csound &csound)
+{
+	if(m_pActiveCsound.load(std::memory_order_acquire) != &csound) return;
+	int nSet = m_nActiveChannelSet.load(std::memory_order_acquire);
+
+	float* pRing = m_pMapped ? m_pMapped : m_vecCpuRing.data();
+	if(!pRing) return;
+
+	uint32_t unKsmps = (uint32_t)csound.GetKsmps();
+	uint32_t unWritten = m_unWritten.load(std::memory_order_relaxed);
+	// the CPU ring may still hold samples the render thread is about to send
+	if(!m_pMapped && unWritten - m_unUploaded.load(std::memory_order_acquire) + unKsmps > k_unRingLength) return;
+	uint32_t unHead = unWritten % k_unRingLength;
+
+	for(uint32_t i = 0; i < m_unSources; i++){
+		const MYFLT* pSamples = m_rpChannels[nSet][i];
+		if(!pSamples) continue;
+		float* pSourceRing = pRing + i * k_unRingLength;
+		for(uint32_t n = 0; n < unKsmps; n++){
+			pSourceRing[(unHead + n) % k_unRingLength] = (float)pSamples[n];
+		}
+	}
+
+	m_unWritten.store(unWritten + unKsmps, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Render thread, once per frame. Nothing to do with a persistent mapping.
+// Sends the samples written since the last upload, at most two spans per
+// source where they wrap, and only then lets the performance thread reuse
+// them.
+//-----------------------------------------------------------------------------
+void WaveformStream::Upload()
+{
+	if(m_pMapped || m_vecCpuRing.empty()) return;
+
+	uint32_t unWritten = m_unWritten.load(std::memory_order_acquire);
+	uint32_t unUploaded = m_unUploaded.load(std::memory_order_relaxed);
+	if(unWritten == unUploaded) return;
+
+	uint32_t unCount = std::min(unWritten - unUploaded, k_unRingLength);
+	uint32_t unBegin = (unWritten - unCount) % k_unRingLength;
+	uint32_t unFirst = std::min(unCount, k_unRingLength - unBegin);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_glBuffer);
+	for(uint32_t i = 0; i < m_unSources; i++){
+		uint32_t unSourceBase = i * k_unRingLength;
+		glBufferSubData(GL_TEXTURE_BUFFER, (GLintptr)((unSourceBase + unBegin) * sizeof(float)), (GLsizeiptr)(unFirst * sizeof(float)), m_vecCpuRing.data() + unSourceBase + unBegin);
+		if(unCount > unFirst){
+			glBufferSubData(GL_TEXTURE_BUFFER, (GLintptr)(unSourceBase * sizeof(float)), (GLsizeiptr)((unCount - unFirst) * sizeof(float)), m_vecCpuRing.data() + unSourceBase);
+		}
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	m_unUploaded.store(unWritten, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Binds the ring to a texture unit and sets the waveform, waveHead and
+// waveLength uniforms. Shaders read sample k back from the newest with
+// texelFetch(waveform, source * waveLength + (waveHead - 1 - k) % waveLength).
+//-----------------------------------------------------------------------------
+void WaveformStream::Bind(GLuint unProgram, GLint nTextureUnit)
+{
+	glActiveTexture(GL_TEXTURE0 + nTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, m_glTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	if(unProgram != m_unBoundProgram){
+		m_unBoundProgram = unProgram;
+		m_nWaveformLocation = glGetUniformLocation(unProgram, "waveform");
+		m_nWaveHeadLocation = glGetUniformLocation(unProgram, "waveHead");
+		m_nWaveLengthLocation = glGetUniformLocation(unProgram, "waveLength");
+	}
+
+	glUseProgram(unProgram);
+	glUniform1i(m_nWaveformLocation, nTextureUnit);
+	// without a mapping the buffer only holds what was uploaded
+	uint32_t unHead = m_pMapped ? m_unWritten.load(std::memory_order_acquire) : m_unUploaded.load(std::memory_order_relaxed);
+	glUniform1i(m_nWaveHeadLocation, (GLint)(unHead % k_unRingLength));
+	glUniform1i(m_nWaveLengthLocation, (GLint)k_unRingLength);
+}
@@ -0,0 +1,74 @@
+#ifndef WAVEFORMSTREAM_HPP
+#define WAVEFORMSTREAM_HPP
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <vector>
+
+#include "AudioBlockListener.hpp"
+
+//-----------------------------------------------------------------------------
+// Streams each source's raw audio (the waveN a-rate channels) into a ring
+// held in a GL texture buffer, one R32F texel per sample, source major.
+// Shaders read it through a samplerBuffer with texelFetch.
+//
+// Where ARB_buffer_storage is available the buffer is persistently mapped
+// and the performance thread writes straight into it, so the render thread
+// does nothing. On a plain 4.1 context the samples go to a CPU ring and
+// Upload() sends only what was added since the last frame. The performance
+// thread never writes where the render thread hasn't uploaded yet; if the
+// render thread falls a whole ring behind, blocks are dropped until it
+// catches up.
+//-----------------------------------------------------------------------------
+class WaveformStream : public AudioBlockListener {
+
+public:
+
+	static const uint32_t k_unRingLength = 4096;
+	static const uint32_t k_unMaxSources = 16;
+
+	WaveformStream();
+	~WaveformStream();
+
+	bool BInit(uint32_t unSources);
+	void CleanUp();
+
+	// AudioBlockListener
+	void OnSessionStart(Csound &csound) override;
+	void OnAudioBlock(Csound &csound) override;
+
+	void Upload();
+	void Bind(GLuint unProgram, GLint nTextureUnit);
+
+	bool BIsPersistent() const { return m_pMapped != nullptr; }
+
+private:
+
+	uint32_t m_unSources;
+
+	GLuint m_glBuffer;
+	GLuint m_glTexture;
+	float* m_pMapped;
+	std::vector<float> m_vecCpuRing;
+
+	GLuint m_unBoundProgram;
+	GLint m_nWaveformLocation;
+	GLint m_nWaveHeadLocation;
+	GLint m_nWaveLengthLocation;
+
+	// samples per source since the start, wrapping; the ring position is
+	// the count modulo the ring length. Written goes up on the performance
+	// thread, uploaded on the render thread.
+	std::atomic<uint32_t> m_unWritten;
+	std::atomic<uint32_t> m_unUploaded;
+
+	// only the most recently started session feeds the ring, so the two
+	// sessions of a crossfade don't interleave their blocks. Its channel
+	// pointers go in the set the other session isn't reading.
+	std::atomic<Csound*> m_pActiveCsound;
+	std::atomic<int> m_nActiveChannelSet;
+	MYFLT* m_rpChannels[2][k_unMaxSources];
+};
+
+#endif
@@ -24,8 +24,14 @@
 #include <iostream>
 #include <exception>
 
+#ifdef __APPLE__
+#include <csound.hpp>
+#else
 #include "csound/csound.hpp"
+#endif
 #include "csPerfThread.hpp"
+#include "AudioDeadlineMonitor.hpp"
+#include "Profiler.hpp"
 #include <sndfile.h>
 
 // ----------------------------------------------------------------------------
@@ -396,6 +402,7 @@ public:
 int CsoundPerformanceThread::Perform()
 {
     int retval = 0;
+    AVR_PROFILE_THREAD("csound perf");
     do {
       while (firstMessage) {
         csoundLockMutex(queueLock);
@@ -429,9 +436,18 @@ int CsoundPerformanceThread::Perform()
         csoundWaitThreadLockNoTimeout(pauseLock);
         csoundNotifyThreadLock(pauseLock);
       }
-      if(processcallback != NULL)
+      if(processcallback != NULL){
+           AVR_PROFILE_SCOPE("block listeners");
            processcallback(cdata);
-      retval = csoundPerformKsmps(csound);
+      }
+      if (deadlineMonitor != NULL)
+           deadlineMonitor->BeginBlock();
+      {
+        AVR_PROFILE_SCOPE("csoundPerformKsmps");
+        retval = csoundPerformKsmps(csound);
+      }
+      if (deadlineMonitor != NULL)
+           deadlineMonitor->EndBlock();
       if (recordData.running) {
           MYFLT *spout = csoundGetSpout(csound);
           int len = csoundGetKsmps(csound) * csoundGetNchnls(csound);
@@ -517,6 +533,7 @@ void CsoundPerformanceThread::csPerfThread_constructor(CSOUND *csound_)
     status = CSOUND_MEMORY;
     cdata = 0;
     processcallback = 0;
+    deadlineMonitor = 0;
     running = 0;
     queueLock = csoundCreateMutex(0);
     if (!queueLock)
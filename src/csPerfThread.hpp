@@ -26,6 +26,7 @@
 
 class CsoundPerformanceThreadMessage;
 class CsPerfThread_PerformScore;
+class AudioDeadlineMonitor;
 
 #ifdef SWIG
 %include <std_string.i>
@@ -132,6 +133,7 @@ class PUBLIC CsoundPerformanceThread {
     recordData_t recordData;
     int  running;
     void (*processcallback)(void *cdata);
+    AudioDeadlineMonitor *deadlineMonitor;
     int  Perform();
     void csPerfThread_constructor(CSOUND *);
     void QueueMessage(CsoundPerformanceThreadMessage *);
@@ -157,6 +159,14 @@ class PUBLIC CsoundPerformanceThread {
     processcallback = Callback;
     cdata = cbdata;
    }
+
+  /**
+   * Sets a monitor that times every csoundPerformKsmps() call.
+   * Must be set before Play() is called.
+   */
+   void SetDeadlineMonitor(AudioDeadlineMonitor *monitor){
+    deadlineMonitor = monitor;
+   }
     /**
      * Returns the Csound instance pointer.
      */
@@ -28,5 +28,5 @@ int main(int argc, char** argv){
 	
 	avr->Exit();
 
-	return 0;
+	return avr->GetExitCode();
 }